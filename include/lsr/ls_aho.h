@@ -200,6 +200,27 @@ unsigned int ls_aho_search(ls_aho_t *pThis,
                            size_t *out_start, size_t *out_end,
                            ls_aho_state_t **out_last_state, void **pattern_ctx);
 
+/** @ls_aho_search_all
+ * @brief Reports every pattern occurrence in the string, including those
+ *  ending inside a longer partial match.  Must be called after tree
+ *  optimization.
+ * @details Unlike \link #ls_aho_search ls_aho_search\endlink this follows
+ *  the fail links for outputs, so it needs a prefix-free pattern set to
+ *  report each pattern with its own context.
+ *
+ * @param[in] pThis - A pointer to an initialized Aho tree object to search.
+ * @param[in] string - A pointer to the string to search through.
+ * @param[in] size - The length of the string.
+ * @param[in] cb - Called with the pattern context of each occurrence;
+ *  the search stops when it returns non-zero.
+ * @param[in] arg - Passed through to \e cb.
+ * @return The number of occurrences reported.
+ *
+ * @see ls_aho_optimizetree
+ */
+int ls_aho_search_all(ls_aho_t *pThis, const char *string, size_t size,
+                      int (*cb)(void *pattern_ctx, void *arg), void *arg);
+
 ls_aho_t *ls_aho_copy(ls_aho_t *pThis);
 
 #ifdef __cplusplus
@@ -31,7 +31,12 @@
  * @file
  */
 
-//#define _USE_PCRE_JIT_
+/* JIT is on wherever the pcre headers know about it; a library built
+ * without JIT support quietly falls back to the interpreter.
+ */
+#if defined(PCRE_CONFIG_JIT) && !defined(__sparc__) && !defined(__sparc64__)
+#define _USE_PCRE_JIT_
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -371,12 +376,6 @@ ls_inline int   ls_pcre_exec(ls_pcre_t *pThis, const char *subject,
                              int length,
                              int startoffset, int options, int *ovector, int ovecsize)
 {
-#ifdef _USE_PCRE_JIT_
-#if !defined(__sparc__) && !defined(__sparc64__)
-    pcre_jit_stack *stack = ls_pcre_get_jit_stack();
-    pcre_assign_jit_stack(pThis->m_extra, NULL, stack);
-#endif
-#endif
     return pcre_exec(pThis->regex, pThis->extra, subject, length, startoffset,
                      options, ovector, ovecsize);
 }
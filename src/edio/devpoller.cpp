@@ -32,6 +32,7 @@ DevPoller::DevPoller()
     : m_fdDP(-1)
     , m_curChanges(0)
 {
+    setTimerWheel(m_reactorIndex.getTimerWheel());
 }
 DevPoller::~DevPoller()
 {
@@ -47,6 +47,7 @@ epoll::epoll()
     , m_pResCur(NULL)
 {
     setFLTag(O_NONBLOCK | O_RDWR);
+    setTimerWheel(m_reactorIndex.getTimerWheel());
     m_pUpdates = new TObjArray<int>();
     m_pUpdates->setCapacity(100);
 }
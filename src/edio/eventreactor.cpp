@@ -18,6 +18,7 @@
 
 
 #include "eventreactor.h"
+#include "multiplexer.h"
 #include "multiplexerfactory.h"
 #include <socket/ls_sock.h>
 
@@ -29,3 +30,11 @@ Multiplexer *EventReactor::getMultiplexer() const
 #endif
     return MultiplexerFactory::getMultiplexer();
 }
+
+
+void EventReactor::armTimer(int ticks)
+{
+    TimerWheel *pWheel = getMultiplexer()->getTimerWheel();
+    if (pWheel)
+        pWheel->add(&m_timerNode, ticks);
+}
@@ -21,6 +21,7 @@
 #define EVENTREACTOR_H
 
 #include <lsdef.h>
+#include <edio/timerwheel.h>
 #include <stddef.h>
 #include <poll.h>
 
@@ -37,6 +38,7 @@ class EventReactor
     int             m_cntHup;
     unsigned short  m_eventSet;
     unsigned short  m_flags;
+    TimerWheelNode  m_timerNode;
 public:
 
     typedef int (*pri_handler)();
@@ -46,12 +48,14 @@ public:
         : m_cntHup(0)
         , m_eventSet(0)
         , m_flags(0)
+        , m_timerNode(this)
     {   m_pollfd.fd = -1;   m_pollfd.events = 0;
         m_pollfd.revents = 0; m_pfd = &m_pollfd; }
     explicit EventReactor(int fd)
         : m_cntHup(0)
         , m_eventSet(0)
         , m_flags(0)
+        , m_timerNode(this)
     {   m_pollfd.fd = fd; m_pollfd.events = 0;
         m_pollfd.revents = 0; m_pfd = &m_pollfd; }
 
@@ -97,6 +101,16 @@ public:
 
     Multiplexer *getMultiplexer() const;
 
+    /**
+     * Have onTimer() called after the given number of multiplexer ticks
+     * instead of on every tick.  Re-arming replaces the previous deadline.
+     * A reactor is put back to one tick before each onTimer() call.
+     */
+    void armTimer(int ticks);
+    void cancelTimer()                  {   m_timerNode.unlink();       }
+    bool isTimerArmed() const           {   return m_timerNode.isArmed();   }
+    TimerWheelNode *getTimerNode()      {   return &m_timerNode;        }
+
     LS_NO_COPY_ASSIGN(EventReactor);
 };
 
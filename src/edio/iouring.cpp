@@ -0,0 +1,597 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+
+#if defined(linux) || defined(__linux) || defined(__linux__) || defined(__gnu_linux__)
+
+#include "iouring.h"
+
+#include <log4cxx/logger.h>
+#include <util/objarray.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_EXT_ARG)
+#define LS_IOURING_ENABLED
+#endif
+
+
+#define IOURING_SQ_ENTRIES      4096
+#define IOURING_RESULT_MAX      64
+
+// user_data layout: bit 63 marks a POLL_REMOVE request, bits 32-62 hold
+// the per-fd sequence number, and the low 32 bits hold the fd.
+#define IOURING_UD_REMOVE       (1ULL << 63)
+#define IOURING_UD_SEQ_MASK     0x7fffffffU
+
+static inline uint64_t makeUserData(int fd, unsigned int seq)
+{
+    return ((uint64_t)(seq & IOURING_UD_SEQ_MASK) << 32) | (uint32_t)fd;
+}
+
+
+struct iouring_ring
+{
+    unsigned int        *sq_head;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_mask;
+    unsigned int        *sq_entries;
+    unsigned int        *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int         sq_local_tail;
+
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    unsigned int        *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void                *sq_ptr;
+    size_t               sq_size;
+    void                *cq_ptr;
+    size_t               cq_size;
+    size_t               sqes_size;
+};
+
+
+IoUring::IoUring()
+    : m_ringfd(-1)
+    , m_pRing(NULL)
+    , m_pResults(NULL)
+    , m_pResEnd(NULL)
+    , m_pResCur(NULL)
+{
+    setFLTag(O_NONBLOCK | O_RDWR);
+    setTimerWheel(m_reactorIndex.getTimerWheel());
+    m_pUpdates = new TObjArray<int>();
+    m_pUpdates->setCapacity(100);
+}
+
+
+IoUring::~IoUring()
+{
+    releaseRing();
+    if (m_pResults)
+        free(m_pResults);
+    if (m_pUpdates)
+        delete m_pUpdates;
+}
+
+
+#ifdef LS_IOURING_ENABLED
+
+int IoUring::setupRing(unsigned int entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_ringfd = syscall(__NR_io_uring_setup, entries, &params);
+    if (m_ringfd == -1)
+        return LS_FAIL;
+    ::fcntl(m_ringfd, F_SETFD, FD_CLOEXEC);
+    if (!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        LS_INFO("[io_uring] kernel lacks IORING_FEAT_EXT_ARG, not usable.");
+        close(m_ringfd);
+        m_ringfd = -1;
+        errno = ENOSYS;
+        return LS_FAIL;
+    }
+
+    m_pRing = (struct iouring_ring *)malloc(sizeof(struct iouring_ring));
+    if (!m_pRing)
+        return LS_FAIL;
+    memset(m_pRing, 0, sizeof(struct iouring_ring));
+    struct iouring_ring *r = m_pRing;
+    r->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    r->cq_size = params.cq_off.cqes
+                 + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (r->cq_size > r->sq_size)
+            r->sq_size = r->cq_size;
+        r->cq_size = r->sq_size;
+    }
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, m_ringfd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED)
+    {
+        r->sq_ptr = NULL;
+        return LS_FAIL;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        r->cq_ptr = r->sq_ptr;
+    else
+    {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, m_ringfd,
+                         IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED)
+        {
+            r->cq_ptr = NULL;
+            return LS_FAIL;
+        }
+    }
+    r->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqes_size,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE,
+                                          m_ringfd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+    {
+        r->sqes = NULL;
+        return LS_FAIL;
+    }
+
+    char *sq = (char *)r->sq_ptr;
+    r->sq_head    = (unsigned int *)(sq + params.sq_off.head);
+    r->sq_tail    = (unsigned int *)(sq + params.sq_off.tail);
+    r->sq_mask    = (unsigned int *)(sq + params.sq_off.ring_mask);
+    r->sq_entries = (unsigned int *)(sq + params.sq_off.ring_entries);
+    r->sq_array   = (unsigned int *)(sq + params.sq_off.array);
+    r->sq_local_tail = *r->sq_tail;
+
+    char *cq = (char *)r->cq_ptr;
+    r->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    r->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    r->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    r->cqes    = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return LS_OK;
+}
+
+
+void IoUring::releaseRing()
+{
+    if (m_pRing)
+    {
+        if (m_pRing->sqes)
+            munmap(m_pRing->sqes, m_pRing->sqes_size);
+        if (m_pRing->cq_ptr && m_pRing->cq_ptr != m_pRing->sq_ptr)
+            munmap(m_pRing->cq_ptr, m_pRing->cq_size);
+        if (m_pRing->sq_ptr)
+            munmap(m_pRing->sq_ptr, m_pRing->sq_size);
+        free(m_pRing);
+        m_pRing = NULL;
+    }
+    if (m_ringfd != -1)
+    {
+        close(m_ringfd);
+        m_ringfd = -1;
+    }
+}
+
+
+int IoUring::init(int capacity)
+{
+    if (m_reactorIndex.allocate(capacity) == -1)
+        return LS_FAIL;
+    if (!m_pResults)
+    {
+        m_pResults = (struct io_uring_cqe *)malloc(
+                         IOURING_RESULT_MAX * sizeof(struct io_uring_cqe));
+        if (!m_pResults)
+            return LS_FAIL;
+        memset(m_pResults, 0, IOURING_RESULT_MAX * sizeof(struct io_uring_cqe));
+    }
+    releaseRing();
+    if (setupRing(IOURING_SQ_ENTRIES) == LS_FAIL)
+    {
+        int err = errno;
+        releaseRing();
+        errno = err;
+        return LS_FAIL;
+    }
+    return LS_OK;
+}
+
+
+static struct io_uring_sqe *getSqe(struct iouring_ring *r)
+{
+    unsigned int head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_local_tail - head >= *r->sq_entries)
+        return NULL;
+    unsigned int idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    r->sq_array[idx] = idx;
+    ++r->sq_local_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+
+static inline unsigned int flushSq(struct iouring_ring *r)
+{
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+    return r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+}
+
+
+int IoUring::enter(unsigned int minComplete, int iTimeoutMilliSec)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned int flags = IORING_ENTER_EXT_ARG;
+    unsigned int toSubmit = flushSq(m_pRing);
+
+    memset(&arg, 0, sizeof(arg));
+    if (minComplete > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (iTimeoutMilliSec >= 0)
+        {
+            ts.tv_sec = iTimeoutMilliSec / 1000;
+            ts.tv_nsec = (iTimeoutMilliSec % 1000) * 1000000;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+    }
+    else if (toSubmit == 0)
+        return 0;
+    int ret = syscall(__NR_io_uring_enter, m_ringfd, toSubmit, minComplete,
+                      flags, &arg, sizeof(arg));
+    if (ret == -1 && errno == ETIME)
+        return 0;
+    return ret;
+}
+
+
+int IoUring::queuePollAdd(int fd, short mask)
+{
+    struct io_uring_sqe *sqe = getSqe(m_pRing);
+    if (!sqe)
+    {
+        if (enter(0, 0) == -1 && errno != EBUSY && errno != EAGAIN)
+            return LS_FAIL;
+        if ((sqe = getSqe(m_pRing)) == NULL)
+            return LS_FAIL;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    sqe->poll32_events = (unsigned int)(unsigned short)mask << 16;
+#else
+    sqe->poll32_events = (unsigned short)mask;
+#endif
+    sqe->user_data = makeUserData(fd, m_reactorIndex.getSeq(fd));
+    m_reactorIndex.setEventSet(fd, mask);
+    return LS_OK;
+}
+
+
+int IoUring::queuePollRemove(int fd)
+{
+    struct io_uring_sqe *sqe = getSqe(m_pRing);
+    if (!sqe)
+    {
+        if (enter(0, 0) == -1 && errno != EBUSY && errno != EAGAIN)
+            return LS_FAIL;
+        if ((sqe = getSqe(m_pRing)) == NULL)
+            return LS_FAIL;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, m_reactorIndex.getSeq(fd));
+    sqe->user_data = IOURING_UD_REMOVE;
+    //A late completion of the removed poll will not match the new sequence.
+    m_reactorIndex.nextSeq(fd);
+    m_reactorIndex.setEventSet(fd, 0);
+    return LS_OK;
+}
+
+
+int IoUring::reapCompletions()
+{
+    struct iouring_ring *r = m_pRing;
+    unsigned int head = *r->cq_head;
+    unsigned int tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    struct io_uring_cqe *p = m_pResults;
+    while (head != tail && p < m_pResults + IOURING_RESULT_MAX)
+    {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        ++head;
+        if (cqe->user_data & IOURING_UD_REMOVE)
+            continue;
+        *p++ = *cqe;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return p - m_pResults;
+}
+
+
+#else
+
+int IoUring::setupRing(unsigned int entries)
+{
+    errno = ENOSYS;
+    return LS_FAIL;
+}
+
+
+void IoUring::releaseRing()
+{
+}
+
+
+int IoUring::init(int capacity)
+{
+    errno = ENOSYS;
+    return LS_FAIL;
+}
+
+
+int IoUring::enter(unsigned int minComplete, int iTimeoutMilliSec)
+{
+    errno = ENOSYS;
+    return LS_FAIL;
+}
+
+
+int IoUring::queuePollAdd(int fd, short mask)
+{
+    return LS_FAIL;
+}
+
+
+int IoUring::queuePollRemove(int fd)
+{
+    return LS_FAIL;
+}
+
+
+int IoUring::reapCompletions()
+{
+    return 0;
+}
+
+#endif
+
+
+int IoUring::add(EventReactor *pHandler, short mask)
+{
+    int fd = pHandler->getfd();
+    if (fd == -1)
+        return LS_FAIL;
+    if (fd > 10000000)
+        return LS_FAIL;
+    if (m_reactorIndex.set(fd, pHandler) == LS_FAIL)
+        return LS_FAIL;
+    //A stale poll may still be armed if the previous owner did not remove().
+    if (m_reactorIndex.getEventSet(fd))
+        queuePollRemove(fd);
+    pHandler->setPollfd();
+    pHandler->setMask2(mask);
+    pHandler->clearRevent();
+    pHandler->updateEventSet();
+    if (!(m_reactorIndex.getUpdateFlags(fd) & ERF_UPDATE))
+    {
+        m_reactorIndex.setUpdateFlags(fd, ERF_UPDATE);
+        appendEvent(fd);
+    }
+    return LS_OK;
+}
+
+
+int IoUring::updateEvents(EventReactor *pHandler, short mask)
+{
+    int fd = pHandler->getfd();
+    if (fd == -1)
+        return LS_OK;
+    assert(pHandler == m_reactorIndex.get(fd));
+    pHandler->setMask2(mask);
+    if (!(m_reactorIndex.getUpdateFlags(fd) & ERF_UPDATE))
+    {
+        m_reactorIndex.setUpdateFlags(fd, ERF_UPDATE);
+        appendEvent(fd);
+    }
+    return LS_OK;
+}
+
+
+int IoUring::remove(EventReactor *pHandler)
+{
+    int fd = pHandler->getfd();
+    if (fd == -1)
+        return LS_OK;
+    if (fd > (int)m_reactorIndex.getUsed())
+        return LS_OK;
+    pHandler->clearRevent();
+    pHandler->updateEventSet();
+    m_reactorIndex.set(fd, NULL);
+    if (m_reactorIndex.getEventSet(fd))
+        return queuePollRemove(fd);
+    return LS_OK;
+}
+
+
+int IoUring::waitAndProcessEvents(int iTimeoutMilliSec)
+{
+    applyEvents();
+    int ret = enter(iTimeoutMilliSec ? 1 : 0, iTimeoutMilliSec);
+    if (ret == -1)
+        return ret;
+    ret = reapCompletions();
+    if (ret <= 0)
+        return ret;
+
+    m_pResEnd = m_pResults + ret;
+    m_pResCur = m_pResults;
+    struct io_uring_cqe *p = m_pResults;
+    while (p < m_pResEnd)
+    {
+        int fd = (int)(uint32_t)p->user_data;
+        unsigned int seq = (unsigned int)(p->user_data >> 32);
+        EventReactor *pReactor = m_reactorIndex.get(fd);
+        if (!pReactor || pReactor->getfd() != fd
+            || ((m_reactorIndex.getSeq(fd) & IOURING_UD_SEQ_MASK) != seq)
+            || p->res == -ECANCELED)
+        {
+            p->user_data = (uint64_t) -1;
+            ++p;
+            continue;
+        }
+        //One-shot poll has fired, it must be armed again.
+        m_reactorIndex.setEventSet(fd, 0);
+        if (!(m_reactorIndex.getUpdateFlags(fd) & ERF_UPDATE))
+        {
+            m_reactorIndex.setUpdateFlags(fd, ERF_UPDATE);
+            appendEvent(fd);
+        }
+        if (p->res < 0)
+            p->res = POLLERR | POLLHUP;
+        pReactor->assignRevent(p->res);
+        ++p;
+    }
+    return processEvents();
+}
+
+
+int IoUring::processEvents()
+{
+    struct io_uring_cqe *p;
+    int count = m_pResEnd - m_pResCur;
+    while (m_pResCur < m_pResEnd)
+    {
+        p = m_pResCur++;
+        if (p->user_data == (uint64_t) -1)
+            continue;
+        int fd = (int)(uint32_t)p->user_data;
+        EventReactor *pReactor = m_reactorIndex.get(fd);
+        if (pReactor && (pReactor->getAssignedRevent() == (short)p->res))
+        {
+            if (p->res & POLLHUP)
+                pReactor->incHupCounter();
+            pReactor->handleEvents(p->res);
+        }
+    }
+    applyEvents();
+    return count;
+}
+
+
+void IoUring::timerExecute()
+{
+    m_reactorIndex.timerExec();
+}
+
+
+void IoUring::continueRead(EventReactor *pHandler)
+{
+    if (!(pHandler->getEvents() & POLLIN))
+        addEvent(pHandler, POLLIN);
+}
+
+
+void IoUring::suspendRead(EventReactor *pHandler)
+{
+    if (pHandler->getEvents() & POLLIN)
+        removeEvent(pHandler, POLLIN);
+}
+
+
+void IoUring::continueWrite(EventReactor *pHandler)
+{
+    if (!(pHandler->getEvents() & POLLOUT))
+        addEvent(pHandler, POLLOUT);
+}
+
+
+void IoUring::suspendWrite(EventReactor *pHandler)
+{
+    if (pHandler->getEvents() & POLLOUT)
+        removeEvent(pHandler, POLLOUT);
+}
+
+
+void IoUring::switchWriteToRead(EventReactor *pHandler)
+{
+    setEvents(pHandler, POLLIN | POLLHUP | POLLERR);
+}
+
+
+void IoUring::switchReadToWrite(EventReactor *pHandler)
+{
+    setEvents(pHandler, POLLOUT | POLLHUP | POLLERR);
+}
+
+
+/**
+ * Turn every pending interest change into SQEs. Nothing is submitted here,
+ * the batch goes to the kernel with the next io_uring_enter().
+ */
+void IoUring::applyEvents()
+{
+    int *p = m_pUpdates->begin();
+    int *pEnd = m_pUpdates->end();
+    while(p < pEnd)
+    {
+        int fd = *p++;
+        m_reactorIndex.setUpdateFlags(fd, 0);
+        EventReactor *pReactor = m_reactorIndex.get(fd);
+        unsigned short armed = m_reactorIndex.getEventSet(fd);
+        unsigned short mask = 0;
+        if (pReactor && pReactor->getfd() == fd)
+            mask = (unsigned short)pReactor->getEvents();
+        if (armed == mask)
+            continue;
+        if (armed)
+            queuePollRemove(fd);
+        if (mask)
+        {
+            queuePollAdd(fd, mask);
+            pReactor->updateEventSet();
+        }
+    }
+    m_pUpdates->clear();
+}
+
+
+void IoUring::appendEvent(int fd)
+{
+    if (m_pUpdates->size() >= m_pUpdates->capacity())
+        m_pUpdates->guarantee(m_pUpdates->capacity() << 1);
+    int *p = m_pUpdates->getNew();
+    *p = fd;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+
+#ifndef IOURING_H
+#define IOURING_H
+
+#if defined(linux) || defined(__linux) || defined(__linux__) || defined(__gnu_linux__)
+
+#include <edio/multiplexer.h>
+#include <edio/reactorindex.h>
+
+/**
+ * io_uring based multiplexer.
+ *
+ * Interest in a fd is expressed with one-shot IORING_OP_POLL_ADD requests.
+ * Mask changes and re-arming are queued as submission queue entries and
+ * flushed together with the wait in a single io_uring_enter(), instead of
+ * one epoll_ctl() per fd. Requires a 5.11+ kernel (IORING_FEAT_EXT_ARG),
+ * init() fails otherwise so the caller can fall back to epoll.
+ */
+struct io_uring_cqe;
+struct iouring_ring;
+template< typename T >
+class TObjArray;
+
+
+class IoUring : public Multiplexer
+{
+    int                  m_ringfd;
+    struct iouring_ring *m_pRing;
+    struct io_uring_cqe *m_pResults;
+    struct io_uring_cqe *m_pResEnd;
+    struct io_uring_cqe *m_pResCur;
+    ReactorIndex         m_reactorIndex;
+    TObjArray<int>      *m_pUpdates;
+
+    int updateEvents(EventReactor *pHandler, short mask);
+
+    void addEvent(EventReactor *pHandler, short mask)
+    {
+        pHandler->orMask2(mask);
+        updateEvents(pHandler, pHandler->getEvents());
+    }
+    void removeEvent(EventReactor *pHandler, short mask)
+    {
+        pHandler->andMask2(~mask);
+        updateEvents(pHandler, pHandler->getEvents());
+    }
+    void setEvents(EventReactor *pHandler, short mask)
+    {
+        if (pHandler->getEvents() != mask)
+        {
+            pHandler->setMask2(mask);
+            updateEvents(pHandler, mask);
+        }
+    }
+
+    int  setupRing(unsigned int entries);
+    void releaseRing();
+
+    int  queuePollAdd(int fd, short mask);
+    int  queuePollRemove(int fd);
+    int  enter(unsigned int minComplete, int iTimeoutMilliSec);
+    int  reapCompletions();
+
+    void applyEvents();
+    void appendEvent(int fd);
+    int  processEvents();
+
+public:
+    IoUring();
+    ~IoUring();
+    virtual int getHandle() const   {   return m_ringfd;    }
+    virtual int init(int capacity = DEFAULT_CAPACITY);
+    virtual int add(EventReactor *pHandler, short mask);
+    virtual int remove(EventReactor *pHandler);
+    virtual int waitAndProcessEvents(int iTimeoutMilliSec);
+    virtual void timerExecute();
+    virtual void setPriHandler(EventReactor::pri_handler handler) {};
+
+    virtual void continueRead(EventReactor *pHandler);
+    virtual void suspendRead(EventReactor *pHandler);
+    virtual void continueWrite(EventReactor *pHandler);
+    virtual void suspendWrite(EventReactor *pHandler);
+    virtual void switchWriteToRead(EventReactor *pHandler);
+    virtual void switchReadToWrite(EventReactor *pHandler);
+
+    LS_NO_COPY_ASSIGN(IoUring);
+
+};
+
+
+#endif
+
+#endif
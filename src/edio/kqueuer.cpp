@@ -42,6 +42,7 @@ KQueuer::KQueuer()
     , m_pChanges(NULL)
       //, m_traceCounter( 0 )
 {
+    setTimerWheel(m_reactorIndex.getTimerWheel());
 }
 KQueuer::~KQueuer()
 {
@@ -21,6 +21,7 @@
 
 Multiplexer::Multiplexer()
     : m_iFLTag(O_NONBLOCK | O_RDWR)
+    , m_pTimerWheel(NULL)
 {}
 
 void Multiplexer::continueRead(EventReactor *pHandler)
@@ -22,9 +22,12 @@
 
 #include <edio/eventreactor.h>
 
+class TimerWheel;
+
 class Multiplexer
 {
     int m_iFLTag;
+    TimerWheel *m_pTimerWheel;
 protected:
     Multiplexer();
 public:
@@ -52,6 +55,10 @@ public:
     int  getFLTag() const   {   return m_iFLTag;        }
     void setFLTag(int tag)  {   m_iFLTag = tag;         }
 
+    // NULL if reactors are still swept on every tick.
+    TimerWheel *getTimerWheel() const   {   return m_pTimerWheel;   }
+    void setTimerWheel(TimerWheel *pWheel)  {   m_pTimerWheel = pWheel; }
+
     LS_NO_COPY_ASSIGN(Multiplexer);
 
 };
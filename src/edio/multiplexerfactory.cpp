@@ -19,6 +19,7 @@
 
 #include <edio/devpoller.h>
 #include <edio/epoll.h>
+#include <edio/iouring.h>
 #include <edio/kqueuer.h>
 #include <edio/poller.h>
 #include <edio/rtsigio.h>
@@ -34,6 +35,7 @@ static const char *s_sType[MultiplexerFactory::BEST + 1] =
     "kqueue",
     "rtsig",
     "epoll",
+    "io_uring",
     "best"
 };
 
@@ -72,7 +74,9 @@ int MultiplexerFactory::getType(const char *pType)
             if (strcasecmp(pType, s_sType[i]) == 0)
                 break;
         }
-        i = BEST;
+        //Only io_uring is honored, anything else uses the platform default.
+        if (i != IO_URING)
+            i = BEST;
     }
     if (i == BEST)
     {
@@ -106,6 +110,8 @@ Multiplexer *MultiplexerFactory::getNew(int type)
     case BEST:
     case EPOLL:
         return new epoll();
+    case IO_URING:
+        return new IoUring();
 #endif
 
 #if defined(sun) || defined(__sun)
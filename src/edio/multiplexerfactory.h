@@ -42,6 +42,7 @@ public:
         KQUEUE,
         RT_SIG,
         EPOLL,
+        IO_URING,
         BEST
     };
     static int getType(const char *pType);
@@ -60,26 +60,31 @@ int ReactorIndex::deallocate()
 //#include <unistd.h>
 //#include <http/httplog.h>
 
+/**
+ * Only reactors whose deadline falls on this tick are visited.  A reactor
+ * that is no longer registered under its fd is simply dropped from the
+ * wheel, set() re-arms it when it is added again.
+ */
 void ReactorIndex::timerExec()
 {
-    unsigned int i;
+    TimerWheelNode due;
+    TimerWheelNode *pNode;
+    EventReactor *pReactor;
+    int fd;
+
     while (((m_iUsed) > 0) && (m_pIndexes[m_iUsed].m_pReactor == NULL))
         --m_iUsed;
-    for (i = 0; i <= m_iUsed; ++i)
+    TimerWheel::initList(&due);
+    m_timerWheel.advance(&due);
+    while ((pNode = TimerWheel::popFront(&due)) != NULL)
     {
-        EventReactor *pReactor = m_pIndexes[i].m_pReactor;
-        if (pReactor)
-        {
-            if (pReactor->getfd() == (int)i)
-                pReactor->onTimer();
-            else
-            {
-//                LS_ERROR( "[%d] ReactorIndex[%d]=%p, getfd()=%d, type: %s", getpid(), i, m_pIndexes[i], m_pIndexes[i]->getfd(),
-//                typeid( *m_pIndexes[i] ).name() ));
-
-                m_pIndexes[i].m_pReactor = NULL;
-            }
-        }
+        pReactor = (EventReactor *)pNode->getObj();
+        fd = pReactor->getfd();
+        if (verify(fd, pReactor) != LS_OK)
+            continue;
+        // Re-arm first, onTimer() may recycle or re-arm the reactor.
+        m_timerWheel.add(pNode, 1);
+        pReactor->onTimer();
     }
 }
 
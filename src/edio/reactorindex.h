@@ -20,16 +20,17 @@
 
 
 #include <lsdef.h>
+#include <edio/eventreactor.h>
+#include <edio/timerwheel.h>
 #include <stddef.h>
 
 #define MAX_FDINDEX 100000
-class EventReactor;
-
 typedef struct ReactorHolder
 {
     EventReactor   *m_pReactor;
     unsigned short  m_eventSet;
     unsigned short  m_flags;
+    unsigned int    m_seq;
 
 } ReactorHolder;
 
@@ -39,6 +40,7 @@ public:
     ReactorHolder  *m_pIndexes;
     unsigned int    m_capacity;
     unsigned int    m_iUsed;
+    TimerWheel      m_timerWheel;
 
     int deallocate();
 
@@ -68,7 +70,13 @@ public:
         }
         if ((unsigned)fd > m_iUsed)
             m_iUsed = fd;
+        if (!pReactor && m_pIndexes[fd].m_pReactor)
+            m_pIndexes[fd].m_pReactor->cancelTimer();
         m_pIndexes[fd].m_pReactor = pReactor;
+        // Polled every tick until the reactor arms its own deadline, a
+        // deadline left by a previous use of a recycled reactor is dropped.
+        if (pReactor)
+            m_timerWheel.add(pReactor->getTimerNode(), 1);
         return LS_OK;
     }
 
@@ -78,6 +86,20 @@ public:
     unsigned short getUpdateFlags(int fd) const
     {   return m_pIndexes[fd].m_flags;  }
 
+    void setEventSet(int fd, unsigned short mask)
+    {   m_pIndexes[fd].m_eventSet = mask;   }
+
+    unsigned short getEventSet(int fd) const
+    {   return m_pIndexes[fd].m_eventSet;   }
+
+    unsigned int getSeq(int fd) const
+    {   return m_pIndexes[fd].m_seq;    }
+
+    unsigned int nextSeq(int fd)
+    {   return ++m_pIndexes[fd].m_seq;  }
+
+    TimerWheel *getTimerWheel()         {   return &m_timerWheel;   }
+
     void timerExec();
     int verify(int fd, EventReactor *pReactor)
     {
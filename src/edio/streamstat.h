@@ -55,6 +55,8 @@ enum stream_flag
     SS_FLAG_RESP_HEADER_SENT   = (1<<22),
     SS_FLAG_BLACK_HOLE         = (1<<23),
     SS_FLAG_READ_EOS           = (1<<24),
+    SS_FLAG_PRI_INCREMENTAL    = (1<<25),
+    SS_FLAG_PRI_SIGNAL         = (1<<26),
 };
 
 inline enum stream_flag operator|(enum stream_flag a, enum stream_flag b)
@@ -0,0 +1,119 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "timerwheel.h"
+
+
+TimerWheel::TimerWheel()
+    : m_iCurTick(0)
+{
+    for (int i = 0; i < LEVELS; ++i)
+        for (int j = 0; j < SLOTS; ++j)
+            m_slots[i][j].initHead();
+}
+
+
+TimerWheel::~TimerWheel()
+{
+    TimerWheelNode *pNode;
+    for (int i = 0; i < LEVELS; ++i)
+        for (int j = 0; j < SLOTS; ++j)
+            while ((pNode = popFront(&m_slots[i][j])) != NULL)
+                ;
+}
+
+
+void TimerWheel::add(TimerWheelNode *pNode, uint32_t ticks)
+{
+    const uint32_t maxTicks = (1U << (SLOT_BITS * LEVELS)) - 1;
+    if (ticks < 1)
+        ticks = 1;
+    else if (ticks > maxTicks)
+        ticks = maxTicks;
+    pNode->unlink();
+    // m_iCurTick is the next tick advance() will process.
+    pNode->m_iExpire = m_iCurTick + ticks - 1;
+    place(pNode);
+}
+
+
+void TimerWheel::place(TimerWheelNode *pNode)
+{
+    uint32_t expire = pNode->m_iExpire;
+    int32_t delta = (int32_t)(expire - m_iCurTick);
+    TimerWheelNode *pSlot;
+    if (delta < 0)
+        pSlot = &m_slots[0][m_iCurTick & SLOT_MASK];
+    else if (delta < (1 << SLOT_BITS))
+        pSlot = &m_slots[0][expire & SLOT_MASK];
+    else if (delta < (1 << (SLOT_BITS * 2)))
+        pSlot = &m_slots[1][(expire >> SLOT_BITS) & SLOT_MASK];
+    else if (delta < (1 << (SLOT_BITS * 3)))
+        pSlot = &m_slots[2][(expire >> (SLOT_BITS * 2)) & SLOT_MASK];
+    else
+        pSlot = &m_slots[3][(expire >> (SLOT_BITS * 3)) & SLOT_MASK];
+    pSlot->append(pNode);
+}
+
+
+int TimerWheel::cascade(int level)
+{
+    int index = (m_iCurTick >> (SLOT_BITS * level)) & SLOT_MASK;
+    TimerWheelNode list;
+    TimerWheelNode *pNode;
+    TimerWheelNode *pSlot = &m_slots[level][index];
+    if (pSlot->isEmpty())
+        return index;
+
+    // Detach the whole slot first, place() may append to the same slot.
+    list.initHead();
+    list.m_pNext = pSlot->m_pNext;
+    list.m_pPrev = pSlot->m_pPrev;
+    list.m_pNext->m_pPrev = &list;
+    list.m_pPrev->m_pNext = &list;
+    pSlot->initHead();
+
+    while ((pNode = popFront(&list)) != NULL)
+        place(pNode);
+    return index;
+}
+
+
+void TimerWheel::advance(TimerWheelNode *pDue)
+{
+    int index = m_iCurTick & SLOT_MASK;
+    if (index == 0)
+    {
+        for (int level = 1; level < LEVELS; ++level)
+            if (cascade(level) != 0)
+                break;
+    }
+
+    TimerWheelNode *pSlot = &m_slots[0][index];
+    if (!pSlot->isEmpty())
+    {
+        TimerWheelNode *pFirst = pSlot->m_pNext;
+        TimerWheelNode *pLast = pSlot->m_pPrev;
+        pFirst->m_pPrev = pDue->m_pPrev;
+        pDue->m_pPrev->m_pNext = pFirst;
+        pLast->m_pNext = pDue;
+        pDue->m_pPrev = pLast;
+        pSlot->initHead();
+    }
+    ++m_iCurTick;
+}
+
@@ -0,0 +1,131 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+
+#include <lsdef.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+
+/**
+ * Intrusive link for TimerWheel, embedded in the object it times.  The
+ * destructor unlinks, so an object may be freed while still armed.
+ */
+class TimerWheelNode
+{
+    friend class TimerWheel;
+
+    TimerWheelNode *m_pNext;
+    TimerWheelNode *m_pPrev;
+    void           *m_pObj;
+    uint32_t        m_iExpire;
+
+public:
+    explicit TimerWheelNode(void *pObj = NULL)
+        : m_pNext(NULL)
+        , m_pPrev(NULL)
+        , m_pObj(pObj)
+        , m_iExpire(0)
+    {}
+    ~TimerWheelNode()                   {   unlink();               }
+
+    void *getObj() const                {   return m_pObj;          }
+    bool isArmed() const                {   return m_pNext != NULL; }
+
+    void unlink()
+    {
+        if (m_pNext)
+        {
+            m_pNext->m_pPrev = m_pPrev;
+            m_pPrev->m_pNext = m_pNext;
+            m_pNext = m_pPrev = NULL;
+        }
+    }
+
+private:
+    void initHead()                     {   m_pNext = m_pPrev = this;   }
+    bool isEmpty() const                {   return m_pNext == this;     }
+    void append(TimerWheelNode *pNode)
+    {
+        pNode->m_pPrev = m_pPrev;
+        pNode->m_pNext = this;
+        m_pPrev->m_pNext = pNode;
+        m_pPrev = pNode;
+    }
+
+    LS_NO_COPY_ASSIGN(TimerWheelNode);
+};
+
+
+/**
+ * Hierarchical timing wheel with four levels of 64 slots, the same layout
+ * as the classic kernel timer wheel.  Arming and cancelling are O(1);
+ * advance() only touches nodes that are due, plus one cascade every 64
+ * ticks.  Delays beyond 64^4 ticks are clamped.
+ */
+class TimerWheel
+{
+public:
+    enum
+    {
+        LEVELS      = 4,
+        SLOT_BITS   = 6,
+        SLOTS       = 1 << SLOT_BITS,
+        SLOT_MASK   = SLOTS - 1,
+    };
+
+    TimerWheel();
+    ~TimerWheel();
+
+    // Fire pNode on the ticks-th advance() from now, ticks >= 1.
+    void add(TimerWheelNode *pNode, uint32_t ticks);
+
+    static void cancel(TimerWheelNode *pNode)
+    {   pNode->unlink();    }
+
+    /**
+     * Moves one tick forward; nodes that expire are unlinked from the
+     * wheel and appended to pDue, which must be an empty list head.
+     */
+    void advance(TimerWheelNode *pDue);
+
+    uint32_t getCurTick() const         {   return m_iCurTick;      }
+
+    static void initList(TimerWheelNode *pHead) {   pHead->initHead();  }
+    static TimerWheelNode *popFront(TimerWheelNode *pHead)
+    {
+        if (pHead->isEmpty())
+            return NULL;
+        TimerWheelNode *pNode = pHead->m_pNext;
+        pNode->unlink();
+        return pNode;
+    }
+
+private:
+    void place(TimerWheelNode *pNode);
+    int  cascade(int level);
+
+    uint32_t        m_iCurTick;
+    TimerWheelNode  m_slots[LEVELS][SLOTS];
+
+    LS_NO_COPY_ASSIGN(TimerWheel);
+};
+
+#endif // TIMERWHEEL_H
@@ -22,6 +22,10 @@
 #include <log4cxx/ilog.h>
 #include <util/linkedobj.h>
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 
 class HttpExtConnector;
 class LoadBalancer;
@@ -32,21 +36,78 @@ class ExtRequest : public DLinkedObj
 {
     int             m_iAttempts;
     LoadBalancer   *m_pLB;
-    int             m_iWorkerTrack;
+    // Load balancer members already tried, first 64 inline, rest on demand
+    uint64_t        m_iWorkerTrack;
+    uint64_t       *m_pWorkerTrackEx;
+    int             m_iWorkerTrackExSize;
+    int64_t         m_iAssignTime;
+    int64_t         m_iQueueTime;
+
+    void clearWorkerTrack()
+    {
+        m_iWorkerTrack = 0;
+        if (m_pWorkerTrackEx)
+            memset(m_pWorkerTrackEx, 0,
+                   m_iWorkerTrackExSize * sizeof(*m_pWorkerTrackEx));
+    }
 
 public:
-    ExtRequest(): m_iAttempts(0), m_pLB(NULL), m_iWorkerTrack(0) {};
-    virtual ~ExtRequest() {};
+    ExtRequest()
+        : m_iAttempts(0), m_pLB(NULL), m_iWorkerTrack(0)
+        , m_pWorkerTrackEx(NULL), m_iWorkerTrackExSize(0), m_iAssignTime(0)
+        , m_iQueueTime(0)
+    {};
+    virtual ~ExtRequest()
+    {
+        if (m_pWorkerTrackEx)
+            free(m_pWorkerTrackEx);
+    };
 
     void setAttempts(int att) {   m_iAttempts = att;  }
     int  getAttempts() const    {   return m_iAttempts; }
     int  incAttempts()          {   return ++m_iAttempts;   }
 
-    void setLB(LoadBalancer *pLB)    {   m_pLB = pLB;    m_iWorkerTrack = 0;   }
+    void setLB(LoadBalancer *pLB)    {   m_pLB = pLB;    clearWorkerTrack();   }
     LoadBalancer *getLB() const        {   return m_pLB;   }
 
-    int getWorkerTrack() const      {   return m_iWorkerTrack;  }
-    void addWorkerTrack(int n)    {   m_iWorkerTrack |= (1 << n);   }
+    bool isWorkerTracked(int n) const
+    {
+        if (n < 64)
+            return (m_iWorkerTrack & (1ULL << n)) != 0;
+        n -= 64;
+        return (n >> 6) < m_iWorkerTrackExSize
+               && (m_pWorkerTrackEx[n >> 6] & (1ULL << (n & 63))) != 0;
+    }
+    void addWorkerTrack(int n)
+    {
+        if (n < 64)
+        {
+            m_iWorkerTrack |= (1ULL << n);
+            return;
+        }
+        n -= 64;
+        if ((n >> 6) >= m_iWorkerTrackExSize)
+        {
+            int size = (n >> 6) + 1;
+            uint64_t *p = (uint64_t *)realloc(m_pWorkerTrackEx,
+                                              size * sizeof(*p));
+            if (!p)
+                return;
+            memset(p + m_iWorkerTrackExSize, 0,
+                   (size - m_iWorkerTrackExSize) * sizeof(*p));
+            m_pWorkerTrackEx = p;
+            m_iWorkerTrackExSize = size;
+        }
+        m_pWorkerTrackEx[n >> 6] |= (1ULL << (n & 63));
+    }
+
+    // When the current worker got the request, in microseconds
+    void setAssignTime(int64_t t)   {   m_iAssignTime = t;      }
+    int64_t getAssignTime() const   {   return m_iAssignTime;   }
+
+    // When it was put in the worker's pending queue, in microseconds
+    void setQueueTime(int64_t t)    {   m_iQueueTime = t;       }
+    int64_t getQueueTime() const    {   return m_iQueueTime;    }
 
 
     virtual void resetConnector() = 0;
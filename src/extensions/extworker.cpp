@@ -32,6 +32,7 @@
 #include <limits.h>
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 
@@ -47,7 +48,40 @@ ExtWorker::ExtWorker(int type)
     , m_lLastRestart(0)
     , m_lIdleTime(0)
     , m_iLingerConns(0)
+    , m_iLatency(0)
+    , m_lLatencyTime(0)
+    , m_iQueueBusySince(0)
+    , m_iQueueWait(0)
+    , m_iShedReqs(0)
 {
+    memset(m_queueHist, 0, sizeof(m_queueHist));
+}
+
+
+void ExtWorker::addLatencySample(int usec)
+{
+    if (usec < 0)
+        return;
+    if (m_iLatency == 0)
+        m_iLatency = usec ? usec : 1;
+    else
+        m_iLatency += (usec - m_iLatency) / 8;
+    m_lLatencyTime = DateTime::s_curTime;
+}
+
+
+/**
+ * A slow worker that stops getting picked would keep its old estimate for
+ * ever, so halve it for every 10 seconds without a fresh sample.
+ */
+int ExtWorker::getLatency(long now) const
+{
+    long idle = now - m_lLatencyTime;
+    if (idle < 10)
+        return m_iLatency;
+    if (idle >= 310)
+        return 0;
+    return m_iLatency >> (idle / 10);
 }
 
 
@@ -167,16 +201,9 @@ void ExtWorker::recycleConn(ExtConn *pConn)
             processPending();
         return;
     }
-    while (!m_reqQueue.empty())
+    ExtRequest *pReq;
+    while ((pReq = dequeueReq()) != NULL)
     {
-
-        ExtRequest *pReq = (ExtRequest *)m_reqQueue.pop_front();
-
-        if (!pReq->isAlive())
-        {
-            LS_DBG_L(pReq, "Client side socket is closed, close connection!");
-            continue;
-        }
         LS_DBG_L(pReq->getLogger(),
                  "[%s] assign pending request [%s] to recycled connection!",
                  m_pConfig->getURL(), pReq->getLogId());
@@ -238,6 +265,7 @@ int  ExtWorker::processRequest(ExtRequest *pReq, int retry)
         {
             LS_DBG_L("[%s] request [%s] is assigned with connection!",
                      m_pConfig->getURL(), pReq->getLogId());
+            m_iQueueWait -= m_iQueueWait >> 3;
             ret = pConn->assignReq(pReq);
             if (ret)
             {
@@ -253,12 +281,21 @@ int  ExtWorker::processRequest(ExtRequest *pReq, int retry)
     LS_DBG_L("[%s] connection unavailable, add new request [%s] "
              "to pending queue!",
              m_pConfig->getURL(), pReq->getLogId());
+    if (!retry && m_pConfig->getQueueTimeout() && !m_reqQueue.empty()
+        && m_iQueueWait > m_pConfig->getQueueTimeout() * 1000)
+    {
+        // recent requests waited past the deadline, this one would too
+        ++m_iShedReqs;
+        LS_DBG_L(pReq, "[%s] queue wait %d ms over limit, reject with 503.",
+                 m_pConfig->getURL(), m_iQueueWait / 1000);
+        return SC_503;
+    }
     pReq->suspend();
     if (retry)
-        m_reqQueue.push_front(pReq);
+        queueReq(pReq, 1);
     else
     {
-        m_reqQueue.append(pReq);
+        queueReq(pReq, 0);
         if ((!pConn) && (m_connPool.getTotalConns() - m_connPool.getFreeConns()
                          < m_connPool.getMaxConns()))
             processPending();
@@ -278,8 +315,141 @@ void ExtWorker::failOutstandingReqs()
             if (pReq->getLB())
                 pReq->tryRecover();
             else
-                pReq->endResponse(SC_503, 0);
+                pReq->setHttpError(SC_503);
+        }
+    }
+}
+
+
+void ExtWorker::queueReq(ExtRequest *pReq, int front)
+{
+    int64_t now = DateTime::getCurTimeInUs();
+    if (m_reqQueue.empty())
+        m_iQueueBusySince = now;
+    pReq->setQueueTime(now);
+    if (front)
+        m_reqQueue.push_front(pReq);
+    else
+        m_reqQueue.append(pReq);
+}
+
+
+/**
+ * CoDel style: the queue is overloaded once it has not drained for a whole
+ * interval, 10 times the target but at least 100ms.
+ */
+bool ExtWorker::isQueueOverloaded(int64_t now) const
+{
+    int target = m_pConfig->getQueueTarget();
+    if (!target || m_reqQueue.empty())
+        return false;
+    int interval = target * 10;
+    if (interval < 100)
+        interval = 100;
+    return now - m_iQueueBusySince > (int64_t)interval * 1000;
+}
+
+
+// in microseconds, 0 for no limit
+int ExtWorker::getQueueDeadline(int64_t now) const
+{
+    if (isQueueOverloaded(now))
+        return m_pConfig->getQueueTarget() * 1000;
+    return m_pConfig->getQueueTimeout() * 1000;
+}
+
+
+void ExtWorker::addQueueWait(int usec)
+{
+    static const int s_bounds[EXTAPP_QHIST_SIZE - 1] =
+    {   1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000   };
+    int i = 0;
+    while (i < EXTAPP_QHIST_SIZE - 1 && usec >= s_bounds[i])
+        ++i;
+    ++m_queueHist[i];
+    m_iQueueWait += (usec - m_iQueueWait) / 8;
+}
+
+
+void ExtWorker::shedReq(ExtRequest *pReq, const char *pReason)
+{
+    ++m_iShedReqs;
+    LS_DBG_L(pReq, "[%s] %s, drop pending request with 503.",
+             m_pConfig->getURL(), pReason);
+    pReq->setHttpError(SC_503);
+}
+
+
+/**
+ * Next pending request worth serving.  Under overload the newest request
+ * is taken first, it is the one whose client is most likely still
+ * waiting; anything queued past the deadline is answered with 503.
+ */
+ExtRequest *ExtWorker::dequeueReq()
+{
+    int64_t now = DateTime::getCurTimeInUs();
+    while (!m_reqQueue.empty())
+    {
+        ExtRequest *pReq;
+        int deadline = getQueueDeadline(now);
+        if (isQueueOverloaded(now))
+        {
+            pReq = (ExtRequest *)m_reqQueue.rbegin();
+            m_reqQueue.remove(pReq);
         }
+        else
+            pReq = (ExtRequest *)m_reqQueue.pop_front();
+
+        if (!pReq->isAlive())
+        {
+            LS_DBG_L(pReq, "Client side socket is closed, close connection!");
+            continue;
+        }
+        int wait = now - pReq->getQueueTime();
+        addQueueWait(wait);
+        if (deadline && wait > deadline)
+        {
+            shedReq(pReq, "queue deadline passed");
+            continue;
+        }
+        return pReq;
+    }
+    return NULL;
+}
+
+
+/**
+ * Requests at the far end of a LIFO queue may never be picked, time them
+ * out here.
+ */
+void ExtWorker::expireQueuedReqs()
+{
+    if (m_reqQueue.empty())
+        return;
+    int64_t now = DateTime::getCurTimeInUs();
+    int deadline = getQueueDeadline(now);
+    if (!deadline)
+        return;
+    DLinkQueue expired;
+    DLinkedObj *pObj = m_reqQueue.begin();
+    while (pObj != m_reqQueue.end())
+    {
+        ExtRequest *pReq = (ExtRequest *)pObj;
+        pObj = pObj->next();
+        if (now - pReq->getQueueTime() > deadline)
+        {
+            m_reqQueue.remove(pReq);
+            expired.append(pReq);
+        }
+    }
+    // ending a response may call back into this worker, do it off the queue
+    while (!expired.empty())
+    {
+        ExtRequest *pReq = (ExtRequest *)expired.pop_front();
+        if (!pReq->isAlive())
+            continue;
+        addQueueWait(now - pReq->getQueueTime());
+        shedReq(pReq, "queue deadline passed");
     }
 }
 
@@ -295,12 +465,9 @@ void ExtWorker::processPending()
             if (!pConn)
                 return;
         }
-        ExtRequest *pReq = (ExtRequest *)m_reqQueue.pop_front();
-        if (!pReq->isAlive())
-        {
-            LS_DBG_L(pReq, "Client side socket is closed, close connection!");
-            continue;
-        }
+        ExtRequest *pReq = dequeueReq();
+        if (!pReq)
+            break;
         int ret = pConn->assignReq(pReq);
         if (ret)
         {
@@ -340,7 +507,7 @@ int ExtWorker::connectionError(ExtConn *pConn, int errCode)
         if (pReq)
         {
             pReq->suspend();
-            m_reqQueue.push_front(pReq);
+            queueReq(pReq, 1);
         }
         return 1;
     }
@@ -463,6 +630,7 @@ int ExtWorker::generateRTReport(int fd, const char *pTypeName)
     detectDiedPid();
     m_connPool.for_each(onConnTimer);
     m_reqStats.finalizeRpt();
+    expireQueuedReqs();
     int inUseConn = m_connPool.getTotalConns() - m_connPool.getFreeConns();
     const HttpVHost *pVHost = m_pConfig->getVHost();
     if ((!pVHost || !pVHost->getName()
@@ -473,15 +641,22 @@ int ExtWorker::generateRTReport(int fd, const char *pTypeName)
                          "EXTAPP [%s] [%s] [%s]: CMAXCONN: %d, EMAXCONN: %d, "
                          "POOL_SIZE: %d, INUSE_CONN: %d, "
                          "IDLE_CONN: %d, WAITQUE_DEPTH: %d, "
-                         "REQ_PER_SEC: %d, TOT_REQS: %d\n",
+                         "REQ_PER_SEC: %d, TOT_REQS: %d, SHED_REQS: %d, "
+                         "QUEUE_MS: [%d %d %d %d %d %d %d %d %d]\n",
                          pTypeName, (pVHost) ? pVHost->getName() : "", m_pConfig->getName(),
                          m_pConfig->getMaxConns(), m_connPool.getMaxConns(),
                          m_connPool.getTotalConns(), inUseConn,
                          m_connPool.getFreeConns(), m_reqQueue.size(),
-                         m_reqStats.getRPS(), m_reqStats.getTotal());
+                         m_reqStats.getRPS(), m_reqStats.getTotal(),
+                         m_iShedReqs, m_queueHist[0], m_queueHist[1],
+                         m_queueHist[2], m_queueHist[3], m_queueHist[4],
+                         m_queueHist[5], m_queueHist[6], m_queueHist[7],
+                         m_queueHist[8]);
         write(fd, achBuf, p - achBuf);
     }
     m_reqStats.reset();
+    m_iShedReqs = 0;
+    memset(m_queueHist, 0, sizeof(m_queueHist));
     cleanStopPids();
 
     long lCurTime = DateTime::s_curTime;
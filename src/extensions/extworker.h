@@ -33,6 +33,10 @@
 #define EXTAPP_AUTHORIZER   2
 #define EXTAPP_FILTER       3
 
+// pending queue wait histogram, upper bounds in ms: 1, 5, 10, 50, 100,
+// 500, 1000, 5000 and above
+#define EXTAPP_QHIST_SIZE   9
+
 class RLimits;
 
 class ExtConn;
@@ -55,11 +59,24 @@ class ExtWorker : public HttpHandler
     long                m_lLastRestart;
     long                m_lIdleTime;
     int                 m_iLingerConns;
+    int                 m_iLatency;
+    long                m_lLatencyTime;
+    int64_t             m_iQueueBusySince;
+    int                 m_iQueueWait;
+    int                 m_iShedReqs;
+    int                 m_queueHist[EXTAPP_QHIST_SIZE];
     ReqStats            m_reqStats;
 
 
     void processPending();
     void failOutstandingReqs();
+    void queueReq(ExtRequest *pReq, int front);
+    ExtRequest *dequeueReq();
+    bool isQueueOverloaded(int64_t now) const;
+    int  getQueueDeadline(int64_t now) const;
+    void addQueueWait(int usec);
+    void shedReq(ExtRequest *pReq, const char *pReason);
+    void expireQueuedReqs();
 
 protected:
     void setConfigPointer(ExtWorkerConfig *pConfig)
@@ -128,6 +145,12 @@ public:
     int  getQueuedReqs() const  {   return m_reqQueue.size();   }
     int  getUtilRatio() const
     {   return m_connPool.getUsedConns() * 1000 / (m_connPool.getMaxConns() + 1); }
+    int  getOutstandingReqs() const
+    {   return m_reqQueue.size() + m_connPool.getUsedConns();   }
+
+    // EWMA of the time to response header, in microseconds
+    void addLatencySample(int usec);
+    int  getLatency(long now) const;
 
     int start();
     virtual int restart()       {   return start();     }
@@ -38,6 +38,8 @@ ExtWorkerConfig::ExtWorkerConfig(const char *pName)
     , m_iTimeout(10)
     , m_iRetryTimeout(3)
     , m_iBuffering(0)
+    , m_iQueueTimeout(0)
+    , m_iQueueTarget(0)
     , m_iKeepAlive(1)
     , m_iDetached(0)
     , m_iMaxIdleTime(INT_MAX)
@@ -61,6 +63,8 @@ ExtWorkerConfig::ExtWorkerConfig()
     , m_iTimeout(10)
     , m_iRetryTimeout(3)
     , m_iBuffering(0)
+    , m_iQueueTimeout(0)
+    , m_iQueueTarget(0)
     , m_iKeepAlive(1)
     , m_iDetached(0)
     , m_iMaxIdleTime(INT_MAX)
@@ -100,6 +104,8 @@ ExtWorkerConfig::ExtWorkerConfig(const ExtWorkerConfig &rhs)
     m_pVHost = rhs.m_pVHost;
     m_iMaxConns = rhs.m_iMaxConns;
     m_iBuffering = rhs.m_iBuffering;
+    m_iQueueTimeout = rhs.m_iQueueTimeout;
+    m_iQueueTarget = rhs.m_iQueueTarget;
     m_iRefAddr = rhs.m_iRefAddr;
     m_iDaemonSuEXEC = rhs.m_iDaemonSuEXEC;
     m_uid = rhs.m_uid;
@@ -210,6 +216,10 @@ void ExtWorkerConfig::config(const XmlNode *pNode)
                      "persistConn", 0, 1, 1);
     int iKeepAliveTimeout = ConfigCtx::getCurConfigCtx()->getLongValue(pNode,
                             "pcKeepAliveTimeout", -1, INT_MAX, INT_MAX);
+    int iQueueTimeout = ConfigCtx::getCurConfigCtx()->getLongValue(pNode,
+                        "queueTimeout", 0, 3600000, 0);
+    int iQueueTarget = ConfigCtx::getCurConfigCtx()->getLongValue(pNode,
+                       "queueTarget", 0, 60000, 0);
 
     if (iKeepAliveTimeout == -1)
         iKeepAliveTimeout = INT_MAX;
@@ -227,6 +237,8 @@ void ExtWorkerConfig::config(const XmlNode *pNode)
     setTimeout(iInitTimeout);
     setRetryTimeout(iRetryTimeout);
     setBuffering(iBuffer);
+    setQueueTimeout(iQueueTimeout);
+    setQueueTarget(iQueueTarget);
     clearEnv();
     const XmlNodeList *pList = NULL;
     if (pNode)
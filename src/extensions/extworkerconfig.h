@@ -49,6 +49,8 @@ class ExtWorkerConfig
     int         m_iTimeout;
     int         m_iRetryTimeout;
     int         m_iBuffering;
+    int         m_iQueueTimeout;
+    int         m_iQueueTarget;
 
     short       m_iKeepAlive;
     short       m_iDetached;
@@ -124,6 +126,14 @@ public:
     int getBuffering() const        {   return m_iBuffering;    }
     void setBuffering(int b)      {   m_iBuffering = b;       }
 
+    // longest wait in the pending queue, in milliseconds, 0 for no limit
+    int getQueueTimeout() const     {   return m_iQueueTimeout;     }
+    void setQueueTimeout(int ms)    {   m_iQueueTimeout = ms;       }
+
+    // CoDel target wait under overload, in milliseconds, 0 to disable
+    int getQueueTarget() const      {   return m_iQueueTarget;      }
+    void setQueueTarget(int ms)     {   m_iQueueTarget = ms;        }
+
     void setPersistConn(int keepAlive) {  m_iKeepAlive = keepAlive;   }
     short isPersistConn() const          {   return m_iKeepAlive;       }
 
@@ -22,6 +22,9 @@
 
 #include <http/httpcgitool.h>
 #include <http/httpextconnector.h>
+#include <http/httplistenerlist.h>
+#include <http/httpreq.h>
+#include <http/httpsession.h>
 #include <http/httpresourcemanager.h>
 #include <http/httpstatuscode.h>
 #include <log4cxx/logger.h>
@@ -617,15 +620,44 @@ void FcgiConnection::suspendWrite()
 }
 
 
+/**
+ * The server, vhost and listener env are pre-encoded, they go out as
+ * records of their own ahead of the per request env, without being
+ * copied.  Queuing a record may flush, so each result is checked.
+ */
 int  FcgiConnection::sendReqHeader()
 {
+    HttpSession *pSession = getConnector()->getHttpSession();
+    const AutoBuf *pVHostEnv =
+        HttpCgiTool::getFcgiVHostEnv(pSession->getReq());
+    const ServerAddrInfo *pAddrInfo =
+        HttpCgiTool::getServerAddrInfo(pSession);
     int size = m_env.size();
     if (size == 0)
     {
-        HttpCgiTool::buildFcgiEnv(&m_env, getConnector()->getHttpSession());
+        HttpCgiTool::buildFcgiEnv(&m_env, pSession, pVHostEnv != NULL,
+                                  pAddrInfo != NULL);
         size = m_env.size();
     }
-    int ret = sendSpecial(m_env.get(), size);
+    int len;
+    const char *pServerEnv = HttpCgiTool::getFcgiServerEnv(&len);
+    int ret = sendSpecial(pServerEnv, len);
+    if (ret == -1)
+        return ret;
+    if (pVHostEnv)
+    {
+        ret = sendSpecial(pVHostEnv->begin(), pVHostEnv->size());
+        if (ret == -1)
+            return ret;
+    }
+    if (pAddrInfo)
+    {
+        ret = sendSpecial(pAddrInfo->getFcgiEnv().begin(),
+                          pAddrInfo->getFcgiEnv().size());
+        if (ret == -1)
+            return ret;
+    }
+    ret = sendSpecial(m_env.get(), size);
     setInProcess(1);
     return ret;
 }
@@ -23,8 +23,8 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 
-int FcgiEnv::add(const char *name, size_t nameLen,
-                 const char *value, size_t valLen)
+int FcgiEnv::addEnv(AutoBuf *pAutoBuf, const char *name, size_t nameLen,
+                    const char *value, size_t valLen)
 {
     if (!name)
         return 0;
@@ -33,15 +33,15 @@ int FcgiEnv::add(const char *name, size_t nameLen,
     //assert( valLen == strlen( value ) );
     if ((nameLen > 1024) || (valLen > 65535))
         return 0;
-    int bufLen = m_buf.available();
+    int bufLen = pAutoBuf->available();
     if (bufLen < (int)(nameLen + valLen + 5))
     {
         int grow = ((nameLen + valLen + 5 - bufLen + 1023) >> 10) << 10;
-        int ret = m_buf.grow(grow);
+        int ret = pAutoBuf->grow(grow);
         if (ret == -1)
             return ret;
     }
-    char *pBuf = m_buf.end();
+    char *pBuf = pAutoBuf->end();
     *pBuf++ = nameLen;
     if (valLen < 128)
         *pBuf++ = valLen ;
@@ -60,7 +60,7 @@ int FcgiEnv::add(const char *name, size_t nameLen,
     memcpy(pBuf, name, nameLen);
     pBuf += nameLen;
     memcpy(pBuf, value, valLen);
-    m_buf.used(pBuf - m_buf.end() + valLen);
+    pAutoBuf->used(pBuf - pAutoBuf->end() + valLen);
     return 0;
 }
 
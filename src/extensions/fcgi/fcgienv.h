@@ -33,13 +33,17 @@ public:
     {   return IEnv::add(name, value); }
 
     int add(const char *name, size_t nameLen,
-            const char *value, size_t valLen);
+            const char *value, size_t valLen)
+    {   return addEnv(&m_buf, name, nameLen, value, valLen);    }
     int add(const char *buf, size_t len)
     {   return m_buf.append(buf, len);   }
     void clear()
     {   m_buf.clear();  }
     const char *get() const {  return m_buf.begin();   }
     int size() const          {  return m_buf.size();     }
+
+    static int addEnv(AutoBuf *pAutoBuf, const char *name, size_t nameLen,
+                      const char *value, size_t valLen);
     LS_NO_COPY_ASSIGN(FcgiEnv);
 };
 
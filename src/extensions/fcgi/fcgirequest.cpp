@@ -20,6 +20,9 @@
 #include "fcgiconnection.h"
 #include <http/httpcgitool.h>
 #include <http/httpextconnector.h>
+#include <http/httplistenerlist.h>
+#include <http/httpreq.h>
+#include <http/httpsession.h>
 #include <http/httplog.h>
 #include <http/httpstatuscode.h>
 
@@ -79,15 +82,43 @@ void  FcgiRequest::abort()
 }
 
 
+/**
+ * The server, vhost and listener env are pre-encoded, they go out as
+ * records of their own ahead of the per request env, without being
+ * copied.
+ */
 int  FcgiRequest::sendReqHeader()
 {
+    HttpSession *pSession = getConnector()->getHttpSession();
+    const AutoBuf *pVHostEnv =
+        HttpCgiTool::getFcgiVHostEnv(pSession->getReq());
+    const ServerAddrInfo *pAddrInfo =
+        HttpCgiTool::getServerAddrInfo(pSession);
     int size = m_env.size();
     if (size == 0)
     {
-        HttpCgiTool::buildFcgiEnv(&m_env, getConnector()->getHttpSession());
+        HttpCgiTool::buildFcgiEnv(&m_env, pSession, pVHostEnv != NULL,
+                                  pAddrInfo != NULL);
         size = m_env.size();
     }
-    int ret = 1;
+    int len;
+    const char *pServerEnv = HttpCgiTool::getFcgiServerEnv(&len);
+    int ret = sendSpecial(pServerEnv, len);
+    if (ret == -1)
+        return ret;
+    if (pVHostEnv)
+    {
+        ret = sendSpecial(pVHostEnv->begin(), pVHostEnv->size());
+        if (ret == -1)
+            return ret;
+    }
+    if (pAddrInfo)
+    {
+        ret = sendSpecial(pAddrInfo->getFcgiEnv().begin(),
+                          pAddrInfo->getFcgiEnv().size());
+        if (ret == -1)
+            return ret;
+    }
     ret = sendSpecial(m_env.get(), size);
     return ret;
 
@@ -18,11 +18,24 @@
 #include "loadbalancer.h"
 #include <extensions/extrequest.h>
 #include <http/handlertype.h>
+#include <http/httpreq.h>
+#include <http/httpsession.h>
+#include <lsr/xxhash.h>
+#include <util/datetime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LB_RING_POINTS      40      // virtual nodes per unit of weight
+#define LB_MAX_WEIGHT       100
 
 
 LoadBalancer::LoadBalancer(const char *pName)
     : ExtWorker(HandlerType::HT_LOADBALANCER)
     , m_lastWorker(0)
+    , m_iStrategy(LB_LEAST_LOAD)
+    , m_iHashKey(LB_KEY_IP)
 {
     setConfigPointer(new ExtWorkerConfig(pName));
 }
@@ -39,9 +52,56 @@ ExtConn *LoadBalancer::newConn()
 }
 
 
-int LoadBalancer::addWorker(ExtWorker *pWorker)
+int LoadBalancer::addWorker(ExtWorker *pWorker, int weight)
+{
+    if (m_members.guarantee(4) == -1)
+        return LS_FAIL;
+    LbMember *pMember = m_members.newObj();
+    if (!pMember)
+        return LS_FAIL;
+    if (weight < 1)
+        weight = 1;
+    else if (weight > LB_MAX_WEIGHT)
+        weight = LB_MAX_WEIGHT;
+    pMember->m_pWorker = pWorker;
+    pMember->m_iWeight = weight;
+    pMember->m_iCurWeight = 0;
+    m_ring.clear();
+    return m_members.size();
+}
+
+
+int LoadBalancer::parseStrategy(const char *pStrategy)
+{
+    if (!pStrategy || strcasecmp(pStrategy, "leastload") == 0)
+        return LB_LEAST_LOAD;
+    if (strcasecmp(pStrategy, "latency") == 0)
+        return LB_LATENCY;
+    if (strcasecmp(pStrategy, "wrr") == 0)
+        return LB_WRR;
+    if (strcasecmp(pStrategy, "hash") == 0)
+        return LB_HASH;
+    return LS_FAIL;
+}
+
+
+/**
+ * "ip", "uri" or "cookie:<name>".
+ */
+int LoadBalancer::setHashKey(const char *pKey)
 {
-    return m_workers.push_back(pWorker);
+    if (!pKey || strcasecmp(pKey, "ip") == 0)
+        m_iHashKey = LB_KEY_IP;
+    else if (strcasecmp(pKey, "uri") == 0)
+        m_iHashKey = LB_KEY_URI;
+    else if (strncasecmp(pKey, "cookie:", 7) == 0 && pKey[7])
+    {
+        m_iHashKey = LB_KEY_COOKIE;
+        m_sHashCookie.setStr(pKey + 7);
+    }
+    else
+        return LS_FAIL;
+    return LS_OK;
 }
 
 
@@ -56,38 +116,228 @@ int LoadBalancer::workerLoadCompare(ExtWorker *pWorker, ExtWorker *pSelect)
 }
 
 
-ExtWorker *LoadBalancer::selectWorker(HttpSession *pSession,
-                                      ExtRequest *pExtReq)
+bool LoadBalancer::isAvail(ExtRequest *pExtReq, int n) const
+{
+    return !pExtReq->isWorkerTracked(n)
+           && m_members.getObj(n)->m_pWorker->getState() != ExtWorker::ST_BAD;
+}
+
+
+int LoadBalancer::selectLeastLoad(ExtRequest *pExtReq)
 {
-    ExtWorker *pWorker, *pSelected = NULL;
-    int select = 0;
+    ExtWorker *pSelected = NULL;
+    int select = -1;
+    for (int n = 0; n < m_members.size(); ++n)
+    {
+        if (pExtReq->isWorkerTracked(n))
+            continue;
+        ExtWorker *pWorker = m_members.getObj(n)->m_pWorker;
+        if (!pSelected || workerLoadCompare(pWorker, pSelected) < 0)
+        {
+            pSelected = pWorker;
+            select = n;
+        }
+    }
+    return select;
+}
+
+
+/**
+ * Power of two choices: sample two members at random and take the one with
+ * the lower latency * (outstanding + 1).  A member without a latency sample
+ * costs nothing, so new or recovered nodes get probed.
+ */
+int LoadBalancer::selectLatency(ExtRequest *pExtReq)
+{
+    int total = m_members.size();
+    int pick[2];
     int n = 0;
-    int track = pExtReq->getWorkerTrack();
-    while (n < m_workers.size())
+
+    for (int tries = 0; tries < 4 && n < 2; ++tries)
     {
-        if ((track & (1 << n)) == 0)
+        int i = rand() % total;
+        if (isAvail(pExtReq, i) && (n == 0 || pick[0] != i))
+            pick[n++] = i;
+    }
+    if (n < 2)
+    {
+        // small or mostly exhausted pool, fill in with a scan
+        for (int i = 0; i < total && n < 2; ++i)
+            if (isAvail(pExtReq, i) && (n == 0 || pick[0] != i))
+                pick[n++] = i;
+        if (n == 0)
+            return selectLeastLoad(pExtReq);
+        if (n == 1)
+            return pick[0];
+    }
+
+    long now = DateTime::s_curTime;
+    ExtWorker *pA = m_members.getObj(pick[0])->m_pWorker;
+    ExtWorker *pB = m_members.getObj(pick[1])->m_pWorker;
+    int64_t costA = (int64_t)pA->getLatency(now)
+                    * (pA->getOutstandingReqs() + 1);
+    int64_t costB = (int64_t)pB->getLatency(now)
+                    * (pB->getOutstandingReqs() + 1);
+    if (costA == costB)
+        return (workerLoadCompare(pB, pA) < 0) ? pick[1] : pick[0];
+    return (costB < costA) ? pick[1] : pick[0];
+}
+
+
+/**
+ * Smooth weighted round-robin, every member gains its weight, the one
+ * with the highest current weight is picked and pays back the total.
+ */
+int LoadBalancer::selectWrr(ExtRequest *pExtReq)
+{
+    int select = -1;
+    int total = 0;
+    for (int n = 0; n < m_members.size(); ++n)
+    {
+        if (!isAvail(pExtReq, n))
+            continue;
+        LbMember *pMember = m_members.getObj(n);
+        pMember->m_iCurWeight += pMember->m_iWeight;
+        total += pMember->m_iWeight;
+        if (select == -1 || pMember->m_iCurWeight
+                            > m_members.getObj(select)->m_iCurWeight)
+            select = n;
+    }
+    if (select == -1)
+        return selectLeastLoad(pExtReq);
+    m_members.getObj(select)->m_iCurWeight -= total;
+    m_lastWorker = select;
+    return select;
+}
+
+
+static int compareRingPoint(const void *p1, const void *p2)
+{
+    uint32_t h1 = ((const LbRingPoint *)p1)->m_iHash;
+    uint32_t h2 = ((const LbRingPoint *)p2)->m_iHash;
+    return (h1 > h2) - (h1 < h2);
+}
+
+
+void LoadBalancer::buildRing()
+{
+    char achKey[256];
+    int len, total = 0;
+    m_ring.clear();
+    for (int n = 0; n < m_members.size(); ++n)
+        total += LB_RING_POINTS * m_members.getObj(n)->m_iWeight;
+    if (m_ring.guarantee(total) == -1)
+        return;
+    for (int n = 0; n < m_members.size(); ++n)
+    {
+        LbMember *pMember = m_members.getObj(n);
+        int points = LB_RING_POINTS * pMember->m_iWeight;
+        for (int i = 0; i < points; ++i)
         {
-            if (!pSelected)
-            {
-                pSelected = m_workers[n];
-                select = n;
-            }
-            else
+            LbRingPoint *pPoint = m_ring.newObj();
+            if (!pPoint)
+                return;
+            len = snprintf(achKey, sizeof(achKey), "%s#%d",
+                           pMember->m_pWorker->getName(), i);
+            if (len >= (int)sizeof(achKey))
+                len = sizeof(achKey) - 1;
+            pPoint->m_iHash = XXH32(achKey, len, 0);
+            pPoint->m_iMember = n;
+        }
+    }
+    qsort(m_ring.getArray(), m_ring.size(), sizeof(LbRingPoint),
+          compareRingPoint);
+}
+
+
+/**
+ * Consistent hashing, points are keyed by worker name so that adding or
+ * removing a member only moves that member's share of the keys.  If the
+ * owner is down or already tried, the next distinct member on the ring
+ * takes over.
+ */
+int LoadBalancer::selectHash(HttpSession *pSession, ExtRequest *pExtReq)
+{
+    const char *pKey = NULL;
+    int keyLen = 0;
+    HttpReq *pReq = pSession->getReq();
+
+    switch (m_iHashKey)
+    {
+    case LB_KEY_IP:
+        pKey = pSession->getPeerAddrString();
+        keyLen = pSession->getPeerAddrStrLen();
+        break;
+    case LB_KEY_URI:
+        pKey = pReq->getURI();
+        keyLen = pReq->getURILen();
+        break;
+    case LB_KEY_COOKIE:
+        {
+            cookieval_t *pCookie = pReq->getCookie(m_sHashCookie.c_str(),
+                                                   m_sHashCookie.len());
+            if (pCookie && pCookie->valLen > 0)
             {
-                pWorker = m_workers[n];
-                if (workerLoadCompare(pWorker, pSelected) < 0)
-                {
-                    pSelected = pWorker;
-                    select = n;
-                }
+                pKey = pReq->getHeaderBuf().getp(pCookie->valOff);
+                keyLen = pCookie->valLen;
             }
         }
-        ++n;
+        break;
+    }
+    if (!pKey || keyLen <= 0)
+        return selectLeastLoad(pExtReq);
+
+    if (m_ring.size() == 0)
+        buildRing();
+    int points = m_ring.size();
+    if (points == 0)
+        return selectLeastLoad(pExtReq);
+
+    uint32_t hash = XXH32(pKey, keyLen, 0);
+    const LbRingPoint *pRing = m_ring.getArray();
+    int lo = 0, hi = points;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) >> 1;
+        if (pRing[mid].m_iHash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    if (pSelected)
-        pExtReq->addWorkerTrack(select);
-    return pSelected;
+    for (int i = 0; i < points; ++i)
+    {
+        int n = pRing[(lo + i) % points].m_iMember;
+        if (isAvail(pExtReq, n))
+            return n;
+    }
+    return selectLeastLoad(pExtReq);
 }
 
 
+ExtWorker *LoadBalancer::selectWorker(HttpSession *pSession,
+                                      ExtRequest *pExtReq)
+{
+    int select;
+    if (m_members.size() == 0)
+        return NULL;
+    switch (m_iStrategy)
+    {
+    case LB_LATENCY:
+        select = selectLatency(pExtReq);
+        break;
+    case LB_WRR:
+        select = selectWrr(pExtReq);
+        break;
+    case LB_HASH:
+        select = selectHash(pSession, pExtReq);
+        break;
+    default:
+        select = selectLeastLoad(pExtReq);
+        break;
+    }
+    if (select < 0)
+        return NULL;
+    pExtReq->addWorkerTrack(select);
+    return m_members.getObj(select)->m_pWorker;
+}
 
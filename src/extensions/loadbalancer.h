@@ -20,14 +20,56 @@
 
 #include <lsdef.h>
 #include <extensions/extworker.h>
+#include <util/autostr.h>
+#include <util/objarray.h>
 
 class HttpSession;
 
+struct LbMember
+{
+    ExtWorker  *m_pWorker;
+    int         m_iWeight;
+    int         m_iCurWeight;   // smooth weighted round-robin state
+};
+
+struct LbRingPoint
+{
+    uint32_t    m_iHash;
+    int         m_iMember;
+};
+
 class LoadBalancer: public ExtWorker
 {
+public:
+    enum
+    {
+        LB_LEAST_LOAD,      // shortest queue, then lowest utilization
+        LB_LATENCY,         // power of two choices on latency EWMA
+        LB_WRR,             // smooth weighted round-robin
+        LB_HASH,            // consistent hashing on a request key
+    };
+
+    enum
+    {
+        LB_KEY_IP,
+        LB_KEY_URI,
+        LB_KEY_COOKIE,
+    };
+
 private:
-    TPointerList<ExtWorker>     m_workers;
+    TObjArray<LbMember>         m_members;
+    TObjArray<LbRingPoint>      m_ring;
     int                         m_lastWorker;
+    short                       m_iStrategy;
+    short                       m_iHashKey;
+    AutoStr2                    m_sHashCookie;
+
+    bool isAvail(ExtRequest *pExtReq, int n) const;
+    int selectLeastLoad(ExtRequest *pExtReq);
+    int selectLatency(ExtRequest *pExtReq);
+    int selectWrr(ExtRequest *pExtReq);
+    int selectHash(HttpSession *pSession, ExtRequest *pExtReq);
+    void buildRing();
 
 protected:
     virtual ExtConn *newConn();
@@ -39,9 +81,20 @@ public:
     ~LoadBalancer();
     ExtWorker *selectWorker(HttpSession *pSession, ExtRequest *pExtReq);
 
-    int getWorkerCount() const      {   return m_workers.size();    }
-    int addWorker(ExtWorker *pWorker);
-    void clearWorkerList()          {   m_workers.clear();          }
+    int getWorkerCount() const      {   return m_members.size();    }
+    int addWorker(ExtWorker *pWorker, int weight = 1);
+    void clearWorkerList()
+    {
+        m_members.clear();
+        m_ring.clear();
+    }
+
+    void setStrategy(int strategy)  {   m_iStrategy = strategy;     }
+    int getStrategy() const         {   return m_iStrategy;         }
+    int setHashKey(const char *pKey);
+
+    static int parseStrategy(const char *pStrategy);
+
     LS_NO_COPY_ASSIGN(LoadBalancer);
 };
 
@@ -1153,6 +1153,8 @@ void LsapiConn::cleanUp()
 
 int LsapiConn::onTimer()
 {
+    // Everything below works in whole seconds.
+    armTimer(TIMER_PRECISION);
     if ((m_respState == LSAPI_CONN_REQ_SENT) && !getCPState()
         && (DateTime::s_curTime - m_lReqSentTime >= 10))
     {
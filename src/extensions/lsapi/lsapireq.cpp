@@ -18,10 +18,12 @@
 #include "lsapireq.h"
 #include <http/httpcontext.h>
 #include <http/httpcgitool.h>
+#include <http/httplistenerlist.h>
 #include <http/httpmethod.h>
 #include <http/httpserverversion.h>
 #include <http/httpsession.h>
 #include <http/httpver.h>
+#include <http/httpvhost.h>
 #include <http/phpconfig.h>
 #include <util/ienv.h>
 #include <util/iovec.h>
@@ -32,8 +34,9 @@
 class LsapiEnv : public IEnv
 {
     AutoBuf *m_pBuf;
+    int      m_iGathered;
 public:
-    LsapiEnv(AutoBuf *pBuf) : m_pBuf(pBuf) {};
+    LsapiEnv(AutoBuf *pBuf) : m_pBuf(pBuf), m_iGathered(0) {};
     ~LsapiEnv() {}
 
     int add(const char *name, size_t nameLen,
@@ -47,7 +50,9 @@ public:
     {   return -1;      }
     void clear() {}
     const char *get() const {  return NULL;   }
-    int bufSize() const      {  return m_pBuf->size();      }
+    // offset in the packet, counting pre-encoded blobs sent by reference
+    int bufSize() const      {  return m_pBuf->size() + m_iGathered;   }
+    void addGathered(int len)   {   m_iGathered += len;     }
     LS_NO_COPY_ASSIGN(LsapiEnv);
 };
 
@@ -89,7 +94,9 @@ int LsapiReq::addEnv(AutoBuf *pAutoBuf, const char *name, size_t nameLen,
 LsapiReq::LsapiReq(IOVec *pVec)
     : m_bufReq(4096)
     , m_pIovec(pVec)
-
+    , m_pSpecialEnv(NULL)
+    , m_pVHostEnv(NULL)
+    , m_pAddrEnv(NULL)
 {
 }
 
@@ -99,11 +106,31 @@ LsapiReq::~LsapiReq()
 }
 
 
+/**
+ * The vhost and listener templates are gathered by reference at the start
+ * of the env list, only per request variables are encoded into m_bufReq.
+ */
 int LsapiReq::appendEnv(LsapiEnv *pEnv, HttpSession *pSession)
 {
     HttpReq *pReq = pSession->getReq();
     int n;
-    int count = HttpCgiTool::buildCommonEnv(pEnv, pSession);
+    int count = 0;
+    m_pVHostEnv = HttpCgiTool::getLsapiVHostEnv(pReq);
+    if (m_pVHostEnv)
+    {
+        pEnv->addGathered(m_pVHostEnv->size());
+        count = pReq->getVHost()->getEnvCount();
+    }
+    const ServerAddrInfo *pAddrInfo = HttpCgiTool::getServerAddrInfo(pSession);
+    m_pAddrEnv = NULL;
+    if (pAddrInfo)
+    {
+        m_pAddrEnv = &pAddrInfo->getLsapiEnv();
+        pEnv->addGathered(m_pAddrEnv->size());
+        count += pAddrInfo->getEnvCount();
+    }
+    count += HttpCgiTool::buildCommonEnv(pEnv, pSession, m_pVHostEnv != NULL,
+                                         m_pAddrEnv != NULL);
     const AutoStr2 *psTemp = pReq->getRealPath();
     if (psTemp)
     {
@@ -126,14 +153,18 @@ int LsapiReq::appendEnv(LsapiEnv *pEnv, HttpSession *pSession)
     n = pReq->getVersion();
     pEnv->add("SERVER_PROTOCOL", 15, HttpVer::getVersionString(n),
               HttpVer::getVersionStringLen(n));
-    pEnv->add("SERVER_SOFTWARE", 15, HttpServerVersion::getVersion(),
-              HttpServerVersion::getVersionLen());
+    if (!m_pAddrEnv)
+    {
+        pEnv->add("SERVER_SOFTWARE", 15, HttpServerVersion::getVersion(),
+                  HttpServerVersion::getVersionLen());
+        ++count;
+    }
     n = pReq->getMethod();
     pEnv->add("REQUEST_METHOD", 14, HttpMethod::get(n),
               HttpMethod::getLen(n));
     ((lsapi_req_header *)m_bufReq.begin())->m_requestMethodOff =
         pEnv->bufSize() - HttpMethod::getLen(n) - 1;
-    count += 5;
+    count += 4;
     ((lsapi_req_header *)m_bufReq.begin())->m_cntEnv = count;
     m_bufReq.append("\0\0\0\0", 4);
     return 0;
@@ -149,12 +180,14 @@ int LsapiReq::appendSpecialEnv(LsapiEnv *pEnv, HttpSession *pSession,
     if (pConfig)
     {
         pHeader->m_cntSpecialEnv = pConfig->getCount();
-        m_bufReq.append(pConfig->getLsapiEnv().begin(),
-                        pConfig->getLsapiEnv().size());
-
+        m_pSpecialEnv = &pConfig->getLsapiEnv();
+        pEnv->addGathered(m_pSpecialEnv->size());
     }
     else
+    {
         pHeader->m_cntSpecialEnv = 0;
+        m_pSpecialEnv = NULL;
+    }
     m_bufReq.append("\0\0\0\0", 4);
     return 0;
 }
@@ -190,16 +223,16 @@ int LsapiReq::buildReq(HttpSession *pSession, int *totalLen)
     ret = appendEnv(&env, pSession);
     if (ret)
         return ret;
-    int pad = (8 - (m_bufReq.size() % 8)) % 8;
+    int pad = (8 - (env.bufSize() % 8)) % 8;
     m_bufReq.append("\0\0\0\0\0\0\0", pad);
-    *totalLen = m_bufReq.size() + sizeof(lsapi_http_header_index)
+    *totalLen = env.bufSize() + sizeof(lsapi_http_header_index)
                 + ((lsapi_req_header *)m_bufReq.begin())->m_cntUnknownHeaders *
                 sizeof(lsapi_header_offset)
                 + ((lsapi_req_header *)m_bufReq.begin())->m_httpHeaderLen;
     buildPacketHeader(&((lsapi_req_header *)m_bufReq.begin())->m_pktHeader,
                       LSAPI_BEGIN_REQUEST,
                       *totalLen);
-    m_pIovec->append(m_bufReq.begin(), m_bufReq.size());
+    gatherEnv();
 
     ret = appendHttpHeaderIndex(pReq,
                                 ((lsapi_req_header *)m_bufReq.begin())->m_cntUnknownHeaders);
@@ -213,6 +246,35 @@ int LsapiReq::buildReq(HttpSession *pSession, int *totalLen)
 }
 
 
+/**
+ * Packet layout: header, PHP config env, terminator, vhost env template,
+ * listener env template, per request env, terminator and padding.  The
+ * templates are only referenced, m_bufReq holds everything else.
+ */
+void LsapiReq::gatherEnv()
+{
+    const char *p = m_bufReq.begin();
+    const char *pEnd = m_bufReq.end();
+    const char *pSplit = p + sizeof(lsapi_req_header);
+    m_pIovec->append(p, pSplit - p);
+    if (m_pSpecialEnv && m_pSpecialEnv->size() > 0)
+        m_pIovec->append(m_pSpecialEnv->begin(), m_pSpecialEnv->size());
+    p = pSplit;
+    pSplit += 4;
+    if ((m_pVHostEnv && m_pVHostEnv->size() > 0)
+        || (m_pAddrEnv && m_pAddrEnv->size() > 0))
+    {
+        m_pIovec->append(p, pSplit - p);
+        if (m_pVHostEnv && m_pVHostEnv->size() > 0)
+            m_pIovec->append(m_pVHostEnv->begin(), m_pVHostEnv->size());
+        if (m_pAddrEnv && m_pAddrEnv->size() > 0)
+            m_pIovec->append(m_pAddrEnv->begin(), m_pAddrEnv->size());
+        p = pSplit;
+    }
+    m_pIovec->append(p, pEnd - p);
+}
+
+
 int LsapiReq::dumpReq(char *pFile)
 {
     //test code
@@ -33,11 +33,15 @@ class LsapiReq
 {
     AutoBuf     m_bufReq;
     IOVec      *m_pIovec;
+    const AutoBuf *m_pSpecialEnv;
+    const AutoBuf *m_pVHostEnv;
+    const AutoBuf *m_pAddrEnv;
 
     int appendEnv(LsapiEnv *pEnv, HttpSession *pSession);
     int appendSpecialEnv(LsapiEnv *pEnv, HttpSession *pSession,
                          struct lsapi_req_header *pHeader);
     int appendHttpHeaderIndex(HttpReq *pReq, int cntUnknown);
+    void gatherEnv();
     int dumpReq(char *pFile);
 
 public:
@@ -874,6 +874,8 @@ void ProxyConn::cleanUp()
 
 int ProxyConn::onTimer()
 {
+    // Everything below works in whole seconds.
+    armTimer(TIMER_PRECISION);
 //    if (!( getEvents() & POLLIN ))
 //    {
 //        LS_WARN( this, "Oops! POLLIN is turned off for this proxy connection,"
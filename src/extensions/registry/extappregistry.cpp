@@ -952,6 +952,24 @@ int ExtAppRegistry::configLoadBalacner(const XmlNode *pNode,
         if (pVHost)
             pLB->getConfigPointer()->setVHost(pVHost);
 
+        const char *pValue = pNode->getChildValue("strategy");
+        int strategy = LoadBalancer::parseStrategy(pValue);
+        if (strategy == LS_FAIL)
+        {
+            LS_ERROR(&currentCtx, "invalid load balancer strategy [%s], "
+                     "use 'leastload'.", pValue);
+            strategy = LoadBalancer::LB_LEAST_LOAD;
+        }
+        pLB->setStrategy(strategy);
+
+        pValue = pNode->getChildValue("hashKey");
+        if (pLB->setHashKey(pValue) == LS_FAIL)
+        {
+            LS_ERROR(&currentCtx, "invalid load balancer hashKey [%s], "
+                     "use 'ip'.", pValue);
+            pLB->setHashKey(NULL);
+        }
+
         const char *pWorkers = pNode->getChildValue("workers");
 
         if (pWorkers)
@@ -988,6 +1006,18 @@ int ExtAppRegistry::configLoadBalacner(const XmlNode *pNode,
                 const ExtWorker *pWorker = static_cast<const ExtWorker *>
                                            (HandlerFactory::getHandler(pType, pName));
 
+                // optional weight, "type::name:N"
+                int weight = 1;
+                char *pWeight = strrchr(pName, ':');
+                if (!pWorker && pWeight && pWeight[1]
+                    && strspn(pWeight + 1, "0123456789") == strlen(pWeight + 1))
+                {
+                    weight = atoi(pWeight + 1);
+                    *pWeight = 0;
+                    pWorker = static_cast<const ExtWorker *>
+                              (HandlerFactory::getHandler(pType, pName));
+                }
+
                 if (pWorker)
                 {
                     if (pWorker->getConfigPointer()->getVHost() != pVHost)
@@ -999,7 +1029,7 @@ int ExtAppRegistry::configLoadBalacner(const XmlNode *pNode,
                 }
 
                 if (pWorker)
-                    pLB->addWorker((ExtWorker *) pWorker);
+                    pLB->addWorker((ExtWorker *) pWorker, weight);
             }
         }
     }
@@ -17,6 +17,7 @@
 *****************************************************************************/
 #include "h2connbase.h"
 #include <http/httpheader.h>
+#include <http/httppriority.h>
 #include <http/httprespheaders.h>
 #include <http/httpstatuscode.h>
 #include <http/httpserverconfig.h>
@@ -88,6 +89,7 @@ int H2ConnBase::init()
     m_uiShutdownStreams = 0;
     m_iCurPushStreams = 0;
     m_iCurrentFrameRemain = -H2_FRAME_HEADER_SIZE;
+    m_uiHpackEncGen = 0;
     return 0;
 }
 
@@ -350,6 +352,8 @@ int H2ConnBase::processFrame(H2FrameHeader *pHeader)
         return processContinuationFrame(pHeader);
     case H2_FRAME_PING:
         return processPingFrame(pHeader);
+    case H2_FRAME_PRIORITY_UPDATE:
+        return processPriorityUpdateFrame(pHeader);
     case H2_FRAME_GREASE0:
     case H2_FRAME_GREASE1:
     case H2_FRAME_GREASE2:
@@ -566,6 +570,50 @@ int H2ConnBase::processSettingFrame(H2FrameHeader *pHeader)
 }
 
 
+#define MAX_PRIORITY_FIELD_LEN  128
+int H2ConnBase::processPriorityUpdateFrame(H2FrameHeader *pHeader)
+{
+    unsigned char buf[4 + MAX_PRIORITY_FIELD_LEN];
+    int len = pHeader->getLength();
+    if (len < 4)
+        return H2_ERROR_FRAME_SIZE_ERROR;
+    if (pHeader->getStreamId() != 0)
+    {
+        LS_DBG_L(getLogSession(), "bad PRIORITY_UPDATE frame, stream ID is not zero.");
+        return H2_ERROR_PROTOCOL_ERROR;
+    }
+    if (len > (int)sizeof(buf))
+        len = sizeof(buf);
+    m_bufInput.moveTo((char *)buf, len);
+    m_iCurrentFrameRemain -= len;
+
+    if (++m_iControlFrames > MAX_CONTROL_FRAMES_RATE)
+    {
+        LS_INFO(getLogSession(), "PRIORITY_UPDATE frame abuse detected, close connection.");
+        return LS_FAIL;
+    }
+    uint32_t id = beReadUint32(buf) & 0x7FFFFFFFu;
+    if (id == 0 || !(id & 1))
+        return H2_ERROR_PROTOCOL_ERROR;
+
+    // The field replaces the previous signal, missing parameters are defaults.
+    int urgency = HIO_PRIORITY_DEFAULT;
+    int incremental = 0;
+    HttpPriority::parse((const char *)buf + 4, len - 4, &urgency, &incremental);
+    LS_DBG_L(getLogSession()->getLogger(),
+             "[%s-%d] PRIORITY_UPDATE urgency: %d, incremental: %d",
+             getLogSession()->getLogId(), id, urgency, incremental);
+
+    H2StreamBase *stream = findStream(id);
+    if (stream)
+    {
+        stream->setFlag(HIO_FLAG_PRI_SIGNAL, 1);
+        stream->updatePriority(urgency, incremental);
+    }
+    return 0;
+}
+
+
 int H2ConnBase::sendSettingsFrame(bool disable_push)
 {
     if (m_h2flag & H2_CONN_FLAG_SETTING_SENT)
@@ -577,11 +625,12 @@ int H2ConnBase::sendSettingsFrame(bool disable_push)
         {0x00, H2_SETTINGS_MAX_CONCURRENT_STREAMS,  0x00, 0x00, 0x00, 0x64 },
         {0x00, H2_SETTINGS_INITIAL_WINDOW_SIZE,     0x00, 0x04, 0x00, 0x00 },
         {0x00, H2_SETTINGS_MAX_FRAME_SIZE,          0x00, 0x00, 0x40, 0x00 },
+        {0x00, H2_SETTINGS_NO_RFC7540_PRIORITIES,   0x00, 0x00, 0x00, 0x01 },
         {0x00, H2_SETTINGS_ENABLE_PUSH,             0x00, 0x00, 0x00, 0x00 },
         //{0x00, H2_SETTINGS_MAX_HEADER_LIST_SIZE,  0x00, 0x00, 0x40, 0x00 },
     };
-    char buf[27 + 13 + 6];
-    int settings_payload_size = 18;
+    char buf[27 + 13 + 12];
+    int settings_payload_size = 24;
     if (disable_push)
         settings_payload_size += 6;
     new (buf) H2FrameHeader(settings_payload_size, H2_FRAME_SETTINGS, 0, 0);
@@ -1095,7 +1144,9 @@ int H2ConnBase::processPriority(uint32_t id)
         }
         else
             stream->setFlag(HIO_FLAG_PRI_SET, 1);
-        stream->apply_priority(&m_priority);
+        // RFC 9218 signals take precedence over the RFC 7540 tree.
+        if (!stream->getFlag(HIO_FLAG_PRI_SIGNAL))
+            stream->apply_priority(&m_priority);
     }
     return 0;
 }
@@ -1150,6 +1201,11 @@ void H2ConnBase::recycleStream(uint32_t uiStreamID)
 }
 
 
+/**
+ * Divides the write batch: a more urgent stream waiting gets the line
+ * back quickly, a non-incremental stream keeps it, incremental streams
+ * of the same urgency share it round robin.
+ */
 int H2ConnBase::getWeightedPriority(H2StreamBase* s)
 {
     int pri = s->getPriority();
@@ -1159,6 +1215,8 @@ int H2ConnBase::getWeightedPriority(H2StreamBase* s)
         if (m_priQue[i].size() > 0)
             return 16;
     }
+    if (!s->getFlag(HIO_FLAG_PRI_INCREMENTAL))
+        return 1;
     ret = m_priQue[pri].size() + 1;
     if (ret > 16)
         ret = 16;
@@ -1442,7 +1500,7 @@ int H2ConnBase::encodeReqHeaders(unsigned char *buf, unsigned char *buf_end,
         if (hdr->buf)
         {
             DUMP_LSXPACK(getLogSession(), hdr, "HPACK encode reqHeader");
-            cur = lshpack_enc_encode(&m_hpack_enc, cur, buf_end, hdr);
+            cur = hpackEncode(cur, buf_end, hdr);
         }
         ++hdr;
     }
@@ -1497,6 +1555,28 @@ void H2ConnBase::removePriQue(H2StreamBase *stream)
 }
 
 
+/**
+ * Non-incremental streams are served one at a time in stream ID order
+ * ahead of the incremental ones, which rotate at the tail (RFC 9218
+ * section 10).
+ */
+void H2ConnBase::insertPriQue(H2StreamBase *stream)
+{
+    TDLinkQueue<H2StreamBase> *pQue = &m_priQue[stream->getPriority()];
+    if (stream->getFlag(HIO_FLAG_PRI_INCREMENTAL))
+    {
+        pQue->append(stream);
+        return;
+    }
+    H2StreamBase *pos = pQue->begin();
+    while (pos != pQue->end()
+           && !pos->getFlag(HIO_FLAG_PRI_INCREMENTAL)
+           && pos->getStreamID() < stream->getStreamID())
+        pos = pQue->next(pos);
+    pQue->insert(pos, stream);
+}
+
+
 void H2ConnBase::add2PriorityQue(H2StreamBase *stream)
 {
     if (stream->next())
@@ -1504,7 +1584,7 @@ void H2ConnBase::add2PriorityQue(H2StreamBase *stream)
     LS_DBG_H(stream, "add to priority queue: %d",
              stream->getPriority());
 
-    m_priQue[stream->getPriority()].append(stream);
+    insertPriQue(stream);
     set_h2flag(H2_CONN_FLAG_WAIT_PROCESS);
     if ((m_h2flag & H2_CONN_FLAG_IN_EVENT) == 0 && m_iCurDataOutWindow > 0)
         continueWrite();
@@ -1538,11 +1618,64 @@ int H2ConnBase::bufferOutput(const char *data, int size)
 }
 
 
+/**
+ * Writes the buffered frames and the payload with a single writev(), the
+ * payload is copied into the buffer only for the part the socket did not
+ * take.
+ */
+int H2ConnBase::writevOutput(IOVec *pIov, int size)
+{
+    IOVec iov;
+    struct iovec *p = pIov->begin();
+    int remain = size;
+    int len;
+    int ret;
+
+    while (remain > 0)
+    {
+        if (iov.avail() <= 0)
+            return 0;
+        len = ((int)p->iov_len > remain) ? remain : (int)p->iov_len;
+        iov.append(p->iov_base, len);
+        remain -= len;
+        ++p;
+    }
+    ret = writevEx(iov, 0);
+    LS_DBG_H(getLogSession(), "[H2] writevOutput(%d) return %d, "
+             "total buffer size = %d", size, ret, getBuf()->size());
+    if (ret < size)
+        return LS_FAIL;
+
+    remain = size;
+    p = pIov->begin();
+    while (remain > 0)
+    {
+        if ((int)p->iov_len > remain)
+        {
+            p->iov_base = (char *)p->iov_base + remain;
+            p->iov_len -= remain;
+            break;
+        }
+        remain -= p->iov_len;
+        pIov->pop_front(1);
+        ++p;
+    }
+    return size;
+}
+
+
 int H2ConnBase::appendOutput(const char *data, int size)
 {
     int ret;
     int remain = size;
     closePendingOut();
+    if (isZeroCopyOutput(size))
+    {
+        IOVec iov(data, size);
+        ret = writevOutput(&iov, size);
+        if (ret != 0)
+            return ret;
+    }
     if (getBuf()->size() == 0 && isDirectBuffer())
     {
         ret = directBuffer(data, size);
@@ -1569,6 +1702,12 @@ int H2ConnBase::appendOutput(IOVec *pIov, int size)
     size_t remain = size;
     int write_through = (getBuf()->size() == 0 && isDirectBuffer());
     closePendingOut();
+    if (isZeroCopyOutput(size))
+    {
+        int rc = writevOutput(pIov, size);
+        if (rc != 0)
+            return rc;
+    }
     struct iovec *iov = pIov->begin();
     while(remain > 0)
     {
@@ -1698,7 +1837,7 @@ int H2ConnBase::processPendingStreams()
                 if (stream->isWantWrite() && (stream->getWindowOut() > 0))
                 {
                     if (!stream->next())
-                        m_priQue[stream->getPriority()].append(stream);
+                        insertPriQue(stream);
                 }
             }
             else
@@ -1763,7 +1902,7 @@ int H2ConnBase::processQueue()
             {
                 ++wantWrite;
                 if (!stream->next())
-                    m_priQue[stream->getPriority()].append(stream);
+                    insertPriQue(stream);
             }
 
             if (stream->getState() != HIOS_CONNECTED)
@@ -50,6 +50,7 @@ enum h2flag
     H2_CONN_FLAG_DIRECT_BUF     = (1<<12),
     H2_CONN_FLAG_AUTO_RECYCLE   = (1<<13),
     H2_CONN_FLAG_PENDING_STREAM = (1<<14),
+    H2_CONN_FLAG_ZERO_COPY      = (1<<15),
 };
 
 inline enum h2flag operator|(enum h2flag a, enum h2flag b)
@@ -64,6 +65,9 @@ inline enum h2flag operator~(enum h2flag a)
 
 #define H2_STREAM_PRIORITYS         (8)
 
+//Smaller payloads are copied and batched, larger ones are written in place
+#define H2_ZERO_COPY_MIN            (4096)
+
 class H2StreamBase;
 class InputStream;
 class UnpackedHeaders;
@@ -170,6 +174,7 @@ public:
 
     void add2PriorityQue(H2StreamBase *streamBase);
     void removePriQue(H2StreamBase *streamBase);
+    void insertPriQue(H2StreamBase *streamBase);
 
     int appendOutput(const char *data, int size);
     int appendOutput(IOVec *pIov, int size);
@@ -263,6 +268,7 @@ protected:
     int parseHeaders(char *pHeader, int ilength, int &NVPairCnt);
 
     int processPriorityFrame(H2FrameHeader *pHeader);
+    int processPriorityUpdateFrame(H2FrameHeader *pHeader);
     int processSettingFrame(H2FrameHeader *pHeader);
     int processHeadersFrame(H2FrameHeader *pHeader);
     int processHeaderFrame(H2FrameHeader *pHeader);
@@ -299,6 +305,20 @@ protected:
     int processInput();
     int encodeReqHeaders(unsigned char* buf, unsigned char* buf_end, const UnpackedHeaders* hdrs);
 
+    /**
+     * Every HPACK encode goes through here, m_uiHpackEncGen is bumped when
+     * the emitted representation may change the dynamic table.
+     */
+    unsigned char *hpackEncode(unsigned char *cur, unsigned char *end,
+                               lsxpack_header *hdr)
+    {
+        unsigned char *p = lshpack_enc_encode(&m_hpack_enc, cur, end, hdr);
+        //01xxxxxx: literal with incremental indexing, 001xxxxx: size update
+        if (p > cur && ((*cur & 0xc0) == 0x40 || (*cur & 0xe0) == 0x20))
+            ++m_uiHpackEncGen;
+        return p;
+    }
+
     int processQueue();
     int processPendingStreams();
 
@@ -311,6 +331,13 @@ protected:
 
 private:
     int bufferOutput(const char *data, int size);
+    int writevOutput(IOVec *pIov, int size);
+    bool isZeroCopyOutput(int size) const
+    {
+        return size >= H2_ZERO_COPY_MIN
+            && getBuf()->size() < H2_ZERO_COPY_MIN
+            && (m_h2flag & H2_CONN_FLAG_ZERO_COPY);
+    }
     int tryReadFrameHeader();
 
 protected:
@@ -345,6 +372,7 @@ protected:
     int32_t         m_tmIdleBegin;
 
     uint32_t        m_pendingStreamId;
+    uint32_t        m_uiHpackEncGen;
     enum h2flag     m_h2flag;
     uint16_t        m_pendingOutSize;
     uint16_t        m_pendingUsed;
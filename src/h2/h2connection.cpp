@@ -18,6 +18,7 @@
 #include "h2connection.h"
 #include <http/hiohandlerfactory.h>
 #include <http/httpheader.h>
+#include <http/httppriority.h>
 #include <http/httprespheaders.h>
 #include <http/httpstatuscode.h>
 #include <http/httpserverconfig.h>
@@ -61,6 +62,7 @@ static inline void appendNbo4Bytes(char *pBuf, uint32_t val)
 
 H2Connection::H2Connection()
 {
+    memset(m_hdrTmpl, 0, sizeof(m_hdrTmpl));
 }
 
 
@@ -80,6 +82,9 @@ int H2Connection::onInitConnected()
 {
     if (getStream()->isWriteBuffer())
         set_h2flag(H2_CONN_FLAG_DIRECT_BUF);
+    //plain text or kTLS, the payload can go to the socket as is
+    else if (getStream()->isSendfileAvail())
+        set_h2flag(H2_CONN_FLAG_ZERO_COPY);
     setOS(getStream());
     getStream()->continueRead();
     return 0;
@@ -139,6 +144,14 @@ int H2Connection::decodeHeaders(uint32_t id, unsigned char *pSrc, int length,
                  headers->getBuf()->begin() + 4);
     }
 
+    int urgency = HIO_PRIORITY_DEFAULT;
+    int incremental = 0;
+    if (HttpPriority::parseReqHeaders(headers, &urgency, &incremental) == LS_OK)
+    {
+        pStream->setFlag(HIO_FLAG_PRI_SIGNAL, 1);
+        pStream->updatePriority(urgency, incremental);
+    }
+
     pStream->setFlag(HIO_FLAG_INIT_SESS, 1);
     add2PriorityQue(pStream);
     set_h2flag(H2_CONN_FLAG_PENDING_STREAM);
@@ -206,7 +219,9 @@ H2StreamBase *H2Connection::getNewStream(uint8_t ubH2_Flags)
     if (m_tmIdleBegin)
         m_tmIdleBegin = 0;
     enum stream_flag flag = (enum stream_flag)(ubH2_Flags & H2_CTRL_FLAG_FIN)
-            | HIO_FLAG_FLOWCTRL | HIO_FLAG_SENDFILE | HIO_FLAG_WRITE_BUFFER;
+            | HIO_FLAG_FLOWCTRL | HIO_FLAG_WRITE_BUFFER;
+    if (getStream()->isSendfileAvail())
+        flag = flag | HIO_FLAG_SENDFILE;
     if (!(m_h2flag & H2_CONN_FLAG_NO_PUSH))
         flag = flag | HIO_FLAG_PUSH_CAPABLE;
     if (getStream()->getFlag(HIO_FLAG_ALTSVC_SENT))
@@ -336,23 +351,65 @@ int H2Connection::doGoAway(H2ErrorCode status)
 }
 
 
-#define H2_TMP_HDR_BUFF_SIZE 65536
-
 int H2Connection::encodeRespHeaders(H2Stream* stream, HttpRespHeaders* hdrs,
                                     unsigned char* buf, int maxSize)
 {
     unsigned char *pCur = buf;
     unsigned char *pBufEnd = pCur + maxSize;
+    unsigned char *pBegin, *p;
+    H2HdrTemplate *pTmpl;
+    uint64_t hash;
+    int count;
+    bool indexed = true;
 
     lsxpack_header_t *hdr;
 
     hdrs->prepareSendHpack();
-    for(hdr = hdrs->begin(); hdr < hdrs->end(); ++hdr)
+    hdr = hdrs->begin();
+    DUMP_LSXPACK(stream, hdr, "HPACK encode");
+    pCur = hpackEncode(pCur, pBufEnd, hdr);
+
+    //Stable headers go first, volatile ones are encoded after them
+    hash = hdrs->getStableHpackHash(&count);
+    pTmpl = &m_hdrTmpl[hash % H2_HDR_TMPL_SLOTS];
+    if (count > 0 && pTmpl->m_hash == hash && pTmpl->m_iCount == count
+        && pTmpl->m_uiEncGen == m_uiHpackEncGen
+        && pTmpl->m_iLen <= pBufEnd - pCur)
+    {
+        LS_DBG_H(stream, "HPACK reuse header template, %d headers, %d bytes.",
+                 count, (int)pTmpl->m_iLen);
+        memcpy(pCur, pTmpl->m_achBlock, pTmpl->m_iLen);
+        pCur += pTmpl->m_iLen;
+    }
+    else
+    {
+        pBegin = pCur;
+        for(++hdr; hdr < hdrs->end(); ++hdr)
+        {
+            if (!hdr->buf || HttpRespHeaders::isVolatileHpack(hdr))
+                continue;
+            DUMP_LSXPACK(stream, hdr, "HPACK encode");
+            p = pCur;
+            pCur = hpackEncode(pCur, pBufEnd, hdr);
+            if (pCur == p || !(*p & 0x80))
+                indexed = false;
+        }
+        if (count > 0 && indexed && pCur - pBegin <= H2_HDR_TMPL_MAX_LEN)
+        {
+            pTmpl->m_hash = hash;
+            pTmpl->m_uiEncGen = m_uiHpackEncGen;
+            pTmpl->m_iCount = count;
+            pTmpl->m_iLen = pCur - pBegin;
+            memcpy(pTmpl->m_achBlock, pBegin, pCur - pBegin);
+        }
+    }
+
+    for(hdr = hdrs->begin() + 1; hdr < hdrs->end(); ++hdr)
     {
-        if (hdr->buf)
+        if (hdr->buf && HttpRespHeaders::isVolatileHpack(hdr))
         {
             DUMP_LSXPACK(stream, hdr, "HPACK encode");
-            pCur = lshpack_enc_encode(&m_hpack_enc, pCur, pBufEnd, hdr);
+            pCur = hpackEncode(pCur, pBufEnd, hdr);
         }
     }
 
@@ -360,6 +417,8 @@ int H2Connection::encodeRespHeaders(H2Stream* stream, HttpRespHeaders* hdrs,
 }
 
 
+#define H2_TMP_HDR_BUFF_SIZE 65536
+
 int H2Connection::sendRespHeaders(H2Stream *stream, HttpRespHeaders *hdrs,
                                   uint8_t flag)
 {
@@ -517,6 +576,11 @@ int H2Connection::appendSendfileOutput(int fd, off_t off, int size)
 {
     int ret;
     int remain = size;
+    //The frame header is in the buffer, push it out so the payload can
+    //follow with sendfile() instead of being copied.
+    if (getBuf()->size() > 0 && getBuf()->size() < H2_ZERO_COPY_MIN
+        && (m_h2flag & H2_CONN_FLAG_ZERO_COPY))
+        BufferedOS::flush();
     if (getBuf()->size() == 0 && getStream()->isSendfileAvail())
     {
         ret = getStream()->sendfile(fd, off, size, 0);
@@ -40,8 +40,35 @@ class H2StreamBase;
 class H2Stream;
 class UpkdHdrBuilder;
 
+#ifdef RUN_TEST
+namespace SuiteH2Connection
+{
+class TestHpackTemplate;
+};
+#endif
+
+#define H2_HDR_TMPL_SLOTS       4
+#define H2_HDR_TMPL_MAX_LEN     64
+
+/**
+ * HPACK block of the stable headers of a response, kept only when every
+ * header was encoded as an indexed field, so it is valid as long as the
+ * encoder dynamic table has not changed since.
+ */
+struct H2HdrTemplate
+{
+    uint64_t        m_hash;
+    uint32_t        m_uiEncGen;
+    uint16_t        m_iCount;
+    uint16_t        m_iLen;
+    unsigned char   m_achBlock[H2_HDR_TMPL_MAX_LEN];
+};
+
 class H2Connection: public HioHandler, public H2ConnBase
 {
+#ifdef RUN_TEST
+    friend class SuiteH2Connection::TestHpackTemplate;
+#endif
 public:
     H2Connection();
     virtual ~H2Connection();
@@ -110,6 +137,7 @@ private:
                                    UnpackedHeaders *headers);
 
 private:
+    H2HdrTemplate   m_hdrTmpl[H2_HDR_TMPL_SLOTS];
 
     LS_NO_COPY_ASSIGN(H2Connection);
 };
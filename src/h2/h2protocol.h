@@ -46,6 +46,7 @@ enum H2FrameType
     H2_FRAME_GREASE5 = H2_FRAME_GREASE4 + 0x1f,
     H2_FRAME_GREASE6 = H2_FRAME_GREASE5 + 0x1f,
     H2_FRAME_GREASE7 = H2_FRAME_GREASE6 + 0x1f,
+    H2_FRAME_PRIORITY_UPDATE = 0x10,    // RFC 9218
 };
 // Flags on data packets.
 enum H2DataFlags
@@ -91,6 +92,8 @@ enum H2SettingsIds
     H2_SETTINGS_MAX_FRAME_SIZE          = 0x5,
     // Downstream byte retransmission rate in percentage.
     H2_SETTINGS_MAX_HEADER_LIST_SIZE    = 0x6,
+    // RFC 9218, peer does not use the RFC 7540 priority tree.
+    H2_SETTINGS_NO_RFC7540_PRIORITIES   = 0x9,
 };
 
 // Status codes for RST_STREAM frames.
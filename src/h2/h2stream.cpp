@@ -21,6 +21,8 @@
 #include "unpackedheaders.h"
 
 #include <http/hiohandlerfactory.h>
+#include <http/httppriority.h>
+#include <http/httprespheaders.h>
 
 #include <util/datetime.h>
 #include <log4cxx/logger.h>
@@ -149,6 +151,16 @@ int H2Stream::sendRespHeaders(HttpRespHeaders *pHeaders, int isNoBody)
 //         if (next() == NULL)
 //             m_pH2Conn->add2PriorityQue(this);
 //     }
+    if (!isNoBody && !getFlag(HIO_FLAG_PRI_SIGNAL | HIO_FLAG_PRI_SET
+                               | HIO_FLAG_IS_PUSH))
+    {
+        int len, incremental;
+        const char *pType = pHeaders->getHeader(HttpRespHeaders::H_CONTENT_TYPE,
+                                                &len);
+        int urgency = HttpPriority::getMimeUrgency(pType, len, &incremental);
+        if (urgency != -1)
+            updatePriority(urgency, incremental);
+    }
     int ret = ((H2Connection *)m_pH2Conn)->sendRespHeaders(this, pHeaders, flag);
     if (isNoBody)
         m_pH2Conn->wantFlush();
@@ -58,7 +58,12 @@ int H2StreamBase::init(H2ConnBase *pH2Conn, Priority_st *pPriority)
     m_pH2Conn = pH2Conn;
     m_iWindowOut = pH2Conn->getStreamOutInitWindowSize();
 
-    apply_priority(pPriority);
+    setPriority(HIO_PRIORITY_DEFAULT);
+    if (pPriority && pPriority->m_weight)
+    {
+        setFlag(HIO_FLAG_PRI_SET, 1);
+        apply_priority(pPriority);
+    }
 
     LS_DBG_L(this, "H2Stream::init(), id: %d, priority: %d, flag: %d. ",
              getStreamID(), getPriority(), (int)getFlag());
@@ -75,21 +80,31 @@ void H2StreamBase::apply_priority(Priority_st *pPriority)
             pri = (32 - pPriority->m_weight) >> 2;
         else
             pri = (256 - pPriority->m_weight) >> 5;
-        if (pri > HIO_PRIORITY_LOWEST)
-            pri = HIO_PRIORITY_LOWEST;
-        else if (pri < HIO_PRIORITY_HIGHEST)
-            pri = HIO_PRIORITY_HIGHEST;
     }
-    if (pri != getPriority())
+    updatePriority(pri, 0);
+}
+
+
+void H2StreamBase::updatePriority(int urgency, int incremental)
+{
+    if (urgency > HIO_PRIORITY_LOWEST)
+        urgency = HIO_PRIORITY_LOWEST;
+    else if (urgency < HIO_PRIORITY_HIGHEST)
+        urgency = HIO_PRIORITY_HIGHEST;
+    if (urgency == getPriority()
+        && !incremental == !getFlag(HIO_FLAG_PRI_INCREMENTAL))
+        return;
+    if (next())
     {
-        if (next())
-        {
-            m_pH2Conn->removePriQue(this);
-            setPriority(pri);
-            m_pH2Conn->add2PriorityQue(this);
-        }
-        else
-            setPriority(pri);
+        m_pH2Conn->removePriQue(this);
+        setPriority(urgency);
+        setFlag(HIO_FLAG_PRI_INCREMENTAL, incremental);
+        m_pH2Conn->add2PriorityQue(this);
+    }
+    else
+    {
+        setPriority(urgency);
+        setFlag(HIO_FLAG_PRI_INCREMENTAL, incremental);
     }
 }
 
@@ -101,6 +101,7 @@ public:
     int getDataFrameSize(int wanted);
 
     void apply_priority(Priority_st *priority);
+    void updatePriority(int urgency, int incremental);
 
     void adjWindowToUpdate(int32_t n)   {   m_iWindowToUpdate += n;     }
     int32_t getWindowToUpdate() const   {   return m_iWindowToUpdate;   }
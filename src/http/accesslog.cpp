@@ -17,6 +17,7 @@
 *****************************************************************************/
 #include "accesslog.h"
 
+#include <http/accesslogring.h>
 #include <http/httpreq.h>
 #include <http/httpresp.h>
 #include <http/httpsession.h>
@@ -399,6 +400,7 @@ void AccessLog::appendStrNoQuote(int escape, const char *pStr, int len)
     {
         flush();
         m_pAppender->append(pStr, len);
+        m_iSpilled = 1;
     }
     else
         m_buf.append_unsafe(pStr, len);
@@ -508,11 +510,7 @@ void AccessLog::customLog(HttpSession *pSession, CustomFormat *pLogFmt, bool doF
     m_buf.append('\n');
 
     if(doFlush)
-    {
-        if ((m_buf.available() < MAX_LOG_LINE_LEN)
-            || !asyncAccessLog())
-            flush();
-    }
+        checkFlush();
 }
 
 
@@ -540,6 +538,81 @@ int AccessLog::setCustomLog(const char *pFmt)
 }
 
 
+struct AccessLogId
+{
+    AutoStr2    m_sPath;
+    AccessLog  *m_pLog;
+};
+
+
+static TPointerList<AccessLogId> &logList()
+{
+    static TPointerList<AccessLogId> s_logList;
+    return s_logList;
+}
+
+
+/**
+ * A log id stands for the log file path, the main process hands out the
+ * same id to the same path across reconfigurations.  Logs are set up
+ * before any fork, so an id taken from the ring names the same file in
+ * the logger process as in a worker, old or new.
+ */
+void AccessLog::regLog(const char *pPath)
+{
+    TPointerList<AccessLogId>::iterator iter;
+    unregLog();
+    for (iter = logList().begin(); iter != logList().end(); ++iter)
+    {
+        if (strcmp((*iter)->m_sPath.c_str(), pPath) == 0)
+        {
+            m_iId = iter - logList().begin();
+            (*iter)->m_pLog = this;
+            return;
+        }
+    }
+    if (logList().size() > 65535)
+        return;
+    AccessLogId *pId = new AccessLogId();
+    pId->m_sPath.setStr(pPath);
+    pId->m_pLog = this;
+    m_iId = logList().size();
+    logList().push_back(pId);
+}
+
+
+void AccessLog::unregLog()
+{
+    if ((m_iId >= 0) && (logList()[m_iId]->m_pLog == this))
+        logList()[m_iId]->m_pLog = NULL;
+    m_iId = -1;
+}
+
+
+AccessLog *AccessLog::getLog(int id)
+{
+    if ((id < 0) || (id >= (int)logList().size()))
+        return NULL;
+    return logList()[id]->m_pLog;
+}
+
+
+void AccessLog::flushAll(int reopen)
+{
+    TPointerList<AccessLogId>::iterator iter;
+    AccessLog *pLog;
+    for (iter = logList().begin(); iter != logList().end(); ++iter)
+    {
+        pLog = (*iter)->m_pLog;
+        if (!pLog || pLog->isPipedLog() || !pLog->getAppender())
+            continue;
+        if (reopen)
+            pLog->reopenExist();
+        pLog->flush();
+    }
+}
+
+
 AccessLog::AccessLog()
     : m_pAppender(NULL)
     , m_pManager(NULL)
@@ -547,6 +620,9 @@ AccessLog::AccessLog()
     , m_iAsync(1)
     , m_iPipedLog(0)
     , m_iAccessLogHeader(LOG_REFERER | LOG_USERAGENT)
+    , m_iId(-1)
+    , m_iBinary(0)
+    , m_iSpilled(0)
     , m_buf(LOG_BUF_SIZE)
 {
 }
@@ -559,6 +635,9 @@ AccessLog::AccessLog(const char *pPath)
     , m_iAsync(1)
     , m_iPipedLog(0)
     , m_iAccessLogHeader(LOG_REFERER | LOG_USERAGENT)
+    , m_iId(-1)
+    , m_iBinary(0)
+    , m_iSpilled(0)
     , m_buf(LOG_BUF_SIZE)
 {
     m_pAppender = LOG4CXX_NS::Appender::getAppender(pPath);
@@ -567,6 +646,7 @@ AccessLog::AccessLog(const char *pPath)
 
 AccessLog::~AccessLog()
 {
+    unregLog();
     flush();
     if (m_pManager)
     {
@@ -585,6 +665,7 @@ int AccessLog::init(const char *pName, int pipe)
 
     if (pipe)
     {
+        unregLog();
         setAsyncAccessLog(0);
         m_pManager = new LOG4CXX_NS::AppenderManager();
         FcgiApp *pApp = (FcgiApp *)ExtAppRegistry::getApp(EA_LOGGER, pName);
@@ -621,12 +702,16 @@ int AccessLog::init(const char *pName, int pipe)
                 //m_pAppender->setName( pName );
             }
             else
+            {
+                regLog(m_pAppender->getName());
                 return 0;
+            }
         }
         m_pAppender = LOG4CXX_NS::Appender::getAppender(pName);
         if (!m_pAppender)
             return LS_FAIL;
         ret = m_pAppender->open();
+        regLog(m_pAppender->getName());
     }
     return ret;
 }
@@ -651,6 +736,8 @@ int AccessLog::reopenExist()
 
 void AccessLog::log(const char *pVHostName, int len, HttpSession *pSession)
 {
+    if (useRecord() && logToRing(pVHostName, len, pSession) == LS_OK)
+        return;
     if (pVHostName)
     {
         m_buf.append_unsafe('[');
@@ -658,11 +745,19 @@ void AccessLog::log(const char *pVHostName, int len, HttpSession *pSession)
         m_buf.append_unsafe(']');
         m_buf.append_unsafe(' ');
     }
-    log(pSession);
+    logText(pSession);
 }
 
 
 void AccessLog::log(HttpSession *pSession)
+{
+    if (useRecord() && logToRing(NULL, 0, pSession) == LS_OK)
+        return;
+    logText(pSession);
+}
+
+
+void AccessLog::logText(HttpSession *pSession)
 {
     int  n;
     HttpReq  *pReq  = pSession->getReq();
@@ -736,12 +831,187 @@ void AccessLog::log(HttpSession *pSession)
                   pReq->getHeaderLen(HttpHeader::H_HOST));
     }
     m_buf.append_unsafe('\n');
+    checkFlush();
+}
+
+
+void AccessLog::checkFlush()
+{
     if ((m_buf.available() < MAX_LOG_LINE_LEN)
         || !asyncAccessLog())
         flush();
 }
 
 
+bool AccessLog::useRecord() const
+{
+    return !m_iPipedLog && (m_iId >= 0)
+           && (m_iBinary || AccessLogRing::getInstance().isEnabled());
+}
+
+
+/**
+ * Captures the entry into an AccessLogRec and hands it to the logger
+ * process.  A custom format needs the live session, so it is rendered
+ * here and only the write moves off the event loop.  Returns LS_FAIL
+ * when the caller should log the entry inline as text instead.
+ */
+int AccessLog::logToRing(const char *pVHostName, int len,
+                         HttpSession *pSession)
+{
+    AccessLogRing &ring = AccessLogRing::getInstance();
+    HttpReq *pReq = pSession->getReq();
+    const char *pUser = pReq->getAuthUser();
+    char achRec[ALR_SLOT_SIZE];
+    AccessLogRec *pRec = (AccessLogRec *)achRec;
+    char achTemp[100];
+    char *pAddr = achTemp;
+    int n;
+
+    pSession->setAccessLogOff();
+    if (pReq->getOrgReqLineLen() == 0)
+        return LS_OK;
+
+    if (m_pCustomFormat && !m_iBinary)
+    {
+        flush();
+        m_iSpilled = 0;
+        if (pVHostName)
+        {
+            m_buf.append_unsafe('[');
+            appendStr(pVHostName, len);
+            m_buf.append_unsafe("] ", 2);
+        }
+        customLog(pSession, m_pCustomFormat, false);
+        if (!m_iSpilled
+            && ring.pushText(m_iId, m_buf.begin(), m_buf.size()) == LS_OK)
+            m_buf.clear();
+        else
+            checkFlush();
+        return LS_OK;
+    }
+
+    //A text log takes an entry too large for a slot inline, a binary log
+    //keeps it with the long fields cut short and ALR_TRUNCATED set.
+    int truncate = m_iBinary;
+    int ret = LS_OK;
+    pRec->init(m_iId, ALR_COMBINED);
+    pRec->m_iFlags = m_iAccessLogHeader;
+    pRec->m_iStatus = HttpStatusCode::getInstance().indexToCode(
+                          pReq->getStatusCode());
+    pRec->m_lReqTime = pSession->getReqTime();
+    pRec->m_lBytes = pSession->getResp()->getBodySent();
+    if (pVHostName)
+        ret |= pRec->append(ALR_VHOST, pVHostName, len, truncate);
+    n = RequestVars::getReqVar(pSession, REF_REMOTE_HOST, pAddr,
+                               sizeof(achTemp));
+    ret |= pRec->append(ALR_ADDR, pAddr, n, truncate);
+    if (pUser)
+        ret |= pRec->append(ALR_USER, pUser, strlen(pUser), truncate);
+    char *pOrgReqLine = (char *)pReq->getOrgReqLine();
+    n = fixHttpVer(pSession, pOrgReqLine, pReq->getOrgReqLineLen());
+    ret |= pRec->append(ALR_REQLINE, pOrgReqLine, n, truncate);
+    if (m_iAccessLogHeader & LOG_REFERER)
+        ret |= pRec->append(ALR_REFERER,
+                            pReq->getHeader(HttpHeader::H_REFERER),
+                            pReq->getHeaderLen(HttpHeader::H_REFERER),
+                            truncate);
+    if (m_iAccessLogHeader & LOG_USERAGENT)
+        ret |= pRec->append(ALR_USERAGENT,
+                            pReq->getHeader(HttpHeader::H_USERAGENT),
+                            pReq->getHeaderLen(HttpHeader::H_USERAGENT),
+                            truncate);
+    if (m_iAccessLogHeader & LOG_VHOST)
+        ret |= pRec->append(ALR_HOST, pReq->getHeader(HttpHeader::H_HOST),
+                            pReq->getHeaderLen(HttpHeader::H_HOST),
+                            truncate);
+    if (ret != LS_OK)
+        return LS_FAIL;
+
+    if (ring.isEnabled() && ring.push(pRec) == LS_OK)
+        return LS_OK;
+    if (!m_iBinary)
+        return LS_FAIL;
+    logRecord(pRec);
+    return LS_OK;
+}
+
+
+/**
+ * Writes one record taken off the ring, or captured inline for a binary
+ * log.  Produces the same line as log() for the combined format.
+ */
+void AccessLog::logRecord(const AccessLogRec *pRec)
+{
+    const char *pStr[ALR_STR_MAX];
+    const char *p;
+    int i, n;
+
+    if (m_iBinary)
+    {
+        if (m_buf.available() < (int)pRec->m_iLen)
+            flush();
+        m_buf.append_unsafe((const char *)pRec, pRec->m_iLen);
+        checkFlush();
+        return;
+    }
+    if (pRec->m_iType == ALR_TEXT)
+    {
+        appendStrNoQuote(0, pRec->getStr(0), pRec->m_iStrLen[0]);
+        checkFlush();
+        return;
+    }
+
+    p = pRec->getStr(0);
+    for (i = 0; i < ALR_STR_MAX; ++i)
+    {
+        pStr[i] = pRec->m_iStrLen[i] ? p : "";
+        p += pRec->m_iStrLen[i];
+    }
+    if (m_buf.available() < MAX_LOG_LINE_LEN)
+        flush();
+    if (pRec->m_iStrLen[ALR_VHOST])
+    {
+        m_buf.append_unsafe('[');
+        appendStr(pStr[ALR_VHOST], pRec->m_iStrLen[ALR_VHOST]);
+        m_buf.append_unsafe("] ", 2);
+    }
+    m_buf.append_unsafe(pStr[ALR_ADDR], pRec->m_iStrLen[ALR_ADDR]);
+    if (!pRec->m_iStrLen[ALR_USER])
+        m_buf.append_unsafe(" - - ", 5);
+    else
+    {
+        n = ls_snprintf(m_buf.end(), 70, " - \"%.*s\" ",
+                        (int)pRec->m_iStrLen[ALR_USER], pStr[ALR_USER]);
+        m_buf.used(n);
+    }
+    DateTime::getLogTime(pRec->m_lReqTime, m_buf.end());
+    m_buf.used(30);
+    appendEscape(pStr[ALR_REQLINE], pRec->m_iStrLen[ALR_REQLINE]);
+    m_buf.append_unsafe('"');
+    m_buf.append_unsafe(' ');
+    n = ls_snprintf(m_buf.end(), 8, "%03u ", (unsigned)pRec->m_iStatus);
+    m_buf.used(n);
+    if (pRec->m_lBytes == 0)
+        m_buf.append_unsafe('-');
+    else
+    {
+        n = StringTool::offsetToStr(m_buf.end(), 30, pRec->m_lBytes);
+        m_buf.used(n);
+    }
+    // LOG_REFERER, LOG_USERAGENT and LOG_VHOST follow the ALR_* order
+    for (i = ALR_REFERER; i <= ALR_HOST; ++i)
+    {
+        if (!(pRec->m_iFlags & (1 << (i - ALR_REFERER))))
+            continue;
+        m_buf.append_unsafe(' ');
+        appendStr(pStr[i], pRec->m_iStrLen[i]);
+    }
+    m_buf.append_unsafe('\n');
+    checkFlush();
+}
+
+
 int AccessLog::appendStr(const char *pStr, int len)
 {
     if (m_buf.available() < len + 3)
@@ -41,6 +41,7 @@ END_LOG4CXX_NS
 
 class HttpSession;
 class CustomFormat;
+struct AccessLogRec;
 class AccessLog
 {
     LOG4CXX_NS::Appender         *m_pAppender;
@@ -50,11 +51,20 @@ class AccessLog
     short   m_iAsync;
     short   m_iPipedLog;
     int     m_iAccessLogHeader;
+    int     m_iId;
+    short   m_iBinary;
+    short   m_iSpilled;
     AutoBuf m_buf;
 
     int appendStr(const char *pStr, int len);
     void appendStrNoQuote(int escape, const char *pSrc, int srcLen);
     void customLog(HttpSession *pSession, CustomFormat *pLogFmt, bool doFlush = true);
+    void regLog(const char *pPath);
+    void unregLog();
+    bool useRecord() const;
+    int  logToRing(const char *pVHostName, int len, HttpSession *pSession);
+    void logText(HttpSession *pSession);
+    void checkFlush();
 
 public:
     explicit AccessLog(const char *pPath);
@@ -66,6 +76,11 @@ public:
     void log(HttpSession *pSession);
     void log(const char *pVHostName, int len, HttpSession *pSession);
     void flush();
+    void logRecord(const AccessLogRec *pRec);
+
+    int  getId() const                      {   return m_iId;              }
+    static AccessLog *getLog(int id);
+    static void flushAll(int reopen);
 
     void accessLogReferer(int referer);
     void accessLogAgent(int agent);
@@ -78,6 +93,9 @@ public:
     void setPipedLog(short pipe)          {   m_iPipedLog = pipe;         }
     short isPipedLog()  const               {   return m_iPipedLog;        }
 
+    void setBinaryLog(int binary)         {   m_iBinary = binary;         }
+    int  isBinaryLog() const                {   return m_iBinary;          }
+
     LOG4CXX_NS::Appender *getAppender() const      {   return m_pAppender; }
     void setAppender(LOG4CXX_NS::Appender *p)    {   m_pAppender = p;    }
 
@@ -0,0 +1,326 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "accesslogring.h"
+
+#include <http/accesslog.h>
+#include <log4cxx/logger.h>
+#include <lsr/ls_atomic.h>
+#include <util/datetime.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+LS_SINGLETON(AccessLogRing);
+
+#define ALR_MAGIC           0x414c5231
+#define ALR_IDLE_USEC       10000
+#define ALR_STALL_SEC       5
+
+// set in a slot sequence while its producer copies the record in
+#define ALR_SEQ_BUSY        (1ULL << 63)
+
+struct AlrShmHeader
+{
+    uint32_t            m_iMagic;
+    uint32_t            m_iSlots;
+    volatile uint64_t   m_iFull;
+    volatile uint32_t   m_iGen;
+    char                m_pad1[44];
+    volatile uint64_t   m_iEnqueue;
+    char                m_pad2[56];
+    volatile uint64_t   m_iDequeue;
+    char                m_pad3[56];
+};
+
+struct AlrSlot
+{
+    volatile uint64_t   m_iSeq;
+    uint32_t            m_iLen;
+    pid_t               m_iPid;
+};
+
+
+void AccessLogRec::init(int id, int type)
+{
+    memset(this, 0, sizeof(*this));
+    m_iLen = sizeof(*this);
+    m_iLogId = id;
+    m_iType = type;
+}
+
+
+/**
+ * Fails if the string does not fit in the record, unless \a truncate is
+ * set, in which case it is cut short and ALR_TRUNCATED is flagged.
+ */
+int AccessLogRec::append(int idx, const char *p, int len, int truncate)
+{
+    int max = ALR_MAX_REC_LEN - (int)m_iLen;
+    if (max > 65535)
+        max = 65535;
+    if (len > max)
+    {
+        if (!truncate)
+            return LS_FAIL;
+        len = max;
+        m_iFlags |= ALR_TRUNCATED;
+    }
+    if (len <= 0)
+        return LS_OK;
+    memmove((char *)this + m_iLen, p, len);
+    m_iStrLen[idx] = len;
+    m_iLen += len;
+    return LS_OK;
+}
+
+
+const char *AccessLogRec::getStr(int idx) const
+{
+    const char *p = (const char *)(this + 1);
+    for (int i = 0; i < idx; ++i)
+        p += m_iStrLen[i];
+    return p;
+}
+
+
+AccessLogRing::AccessLogRing()
+    : m_pHeader(NULL)
+    , m_pSlots(NULL)
+    , m_lSize(0)
+    , m_iConsumeGen(0)
+{
+}
+
+
+AccessLogRing::~AccessLogRing()
+{
+    release();
+}
+
+
+int AccessLogRing::init()
+{
+    if (m_pHeader || m_lSize <= 0)
+        return LS_OK;
+    uint32_t slots = ALR_MIN_SLOTS;
+    while ((long)slots * 2 * ALR_SLOT_SIZE <= m_lSize)
+        slots <<= 1;
+    size_t size = sizeof(AlrShmHeader) + (size_t)slots * ALR_SLOT_SIZE;
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_ANON | MAP_SHARED, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        LS_ERROR("[AccessLogRing] failed to map %zd bytes: %s", size,
+                 strerror(errno));
+        return LS_FAIL;
+    }
+    m_pHeader = (AlrShmHeader *)p;
+    m_pSlots = (char *)p + sizeof(AlrShmHeader);
+    m_pHeader->m_iMagic = ALR_MAGIC;
+    m_pHeader->m_iSlots = slots;
+    for (uint32_t i = 0; i < slots; ++i)
+        ((AlrSlot *)getSlot(i))->m_iSeq = i;
+    LS_INFO("[AccessLogRing] %u slots of %d bytes.", slots, ALR_SLOT_SIZE);
+    return LS_OK;
+}
+
+
+void AccessLogRing::release()
+{
+    if (!m_pHeader)
+        return;
+    munmap(m_pHeader, sizeof(AlrShmHeader)
+           + (size_t)m_pHeader->m_iSlots * ALR_SLOT_SIZE);
+    m_pHeader = NULL;
+    m_pSlots = NULL;
+}
+
+
+char *AccessLogRing::getSlot(uint64_t pos) const
+{
+    return m_pSlots + (pos & (m_pHeader->m_iSlots - 1)) * ALR_SLOT_SIZE;
+}
+
+
+int AccessLogRing::push(const AccessLogRec *pRec)
+{
+    AlrSlot *pSlot;
+    uint64_t pos, seq, busy;
+    if (!m_pHeader || pRec->m_iLen > ALR_MAX_REC_LEN)
+        return LS_FAIL;
+    ls_atomic_load(pos, &m_pHeader->m_iEnqueue);
+    while (1)
+    {
+        pSlot = (AlrSlot *)getSlot(pos);
+        ls_atomic_load(seq, &pSlot->m_iSeq);
+        //a busy slot is still being written; one lap behind the ring is
+        //full, otherwise another producer has claimed it already
+        busy = seq & ALR_SEQ_BUSY;
+        seq &= ~ALR_SEQ_BUSY;
+        if (seq == pos && !busy)
+        {
+            if (ls_atomic_cas64(&m_pHeader->m_iEnqueue, pos, pos + 1))
+                break;
+            ls_atomic_load(pos, &m_pHeader->m_iEnqueue);
+        }
+        else if ((int64_t)(seq - pos) < 0)
+        {
+            ls_atomic_fetch_add(&m_pHeader->m_iFull, 1);
+            return LS_FAIL;
+        }
+        else
+            ls_atomic_load(pos, &m_pHeader->m_iEnqueue);
+    }
+    //Mark the slot busy first; if the logger already gave up on it as
+    //abandoned the CAS fails and the entry is logged inline instead.
+    pSlot->m_iPid = getpid();
+    if (!ls_atomic_cas64(&pSlot->m_iSeq, pos, pos | ALR_SEQ_BUSY))
+    {
+        ls_atomic_fetch_add(&m_pHeader->m_iFull, 1);
+        return LS_FAIL;
+    }
+    pSlot->m_iLen = pRec->m_iLen;
+    memcpy(pSlot + 1, pRec, pRec->m_iLen);
+    if (!ls_atomic_cas64(&pSlot->m_iSeq, pos | ALR_SEQ_BUSY, pos + 1))
+        return LS_FAIL;
+    return LS_OK;
+}
+
+
+int AccessLogRing::pushText(int id, const char *pText, int len)
+{
+    char achBuf[ALR_SLOT_SIZE];
+    AccessLogRec *pRec = (AccessLogRec *)achBuf;
+    if (len > ALR_MAX_REC_LEN - (int)sizeof(AccessLogRec))
+        return LS_FAIL;
+    pRec->init(id, ALR_TEXT);
+    if (pRec->append(0, pText, len) != LS_OK)
+        return LS_FAIL;
+    return push(pRec);
+}
+
+
+/**
+ * Single consumer, so the dequeue position needs no CAS.  A slot that
+ * stays unpublished for ALR_STALL_SEC after later ones were claimed,
+ * and whose producer is not alive anymore, is skipped so that one crash
+ * does not stall the whole ring.  The skip is a CAS against the claimed
+ * or busy sequence, so a late producer cannot overwrite it, and a late
+ * producer that has not marked the slot busy yet fails its own CAS.
+ */
+int AccessLogRing::drain()
+{
+    int count = 0;
+    time_t tmStall = 0;
+    uint64_t pos = m_pHeader->m_iDequeue;
+    uint64_t seq, head;
+    AlrSlot *pSlot;
+    while (1)
+    {
+        pSlot = (AlrSlot *)getSlot(pos);
+        ls_atomic_load(seq, &pSlot->m_iSeq);
+        if (seq != pos + 1)
+        {
+            ls_atomic_load(head, &m_pHeader->m_iEnqueue);
+            if (head == pos)
+                break;
+            if (!tmStall)
+                tmStall = time(NULL) + ALR_STALL_SEC;
+            if (time(NULL) < tmStall)
+            {
+                usleep(100);
+                continue;
+            }
+            if (pSlot->m_iPid > 0
+                && (kill(pSlot->m_iPid, 0) == 0 || errno == EPERM))
+            {
+                tmStall = 0;
+                continue;
+            }
+            if (!ls_atomic_cas64(&pSlot->m_iSeq, seq,
+                                 pos + m_pHeader->m_iSlots))
+                continue;
+            tmStall = 0;
+            m_pHeader->m_iDequeue = ++pos;
+            LS_WARN("[AccessLogRing] skip slot %" PRIu64
+                    " abandoned by a dead worker.", pos - 1);
+            continue;
+        }
+        const AccessLogRec *pRec = (const AccessLogRec *)(pSlot + 1);
+        AccessLog *pLog = AccessLog::getLog(pRec->m_iLogId);
+        //A log added by a reconfiguration is left to the next logger.
+        if (!pLog && m_pHeader->m_iGen != m_iConsumeGen)
+            break;
+        if (pLog)
+            pLog->logRecord(pRec);
+        ++count;
+        tmStall = 0;
+        pSlot->m_iPid = 0;
+        ls_atomic_store(&pSlot->m_iSeq, pos + m_pHeader->m_iSlots);
+        m_pHeader->m_iDequeue = ++pos;
+    }
+    return count;
+}
+
+
+/**
+ * Drains the ring until the main process is gone or retire() is called,
+ * with \a ppid 0 it returns as soon as the ring is empty.
+ */
+void AccessLogRing::consume(pid_t ppid)
+{
+    time_t tmLast = 0;
+    ls_atomic_load(m_iConsumeGen, &m_pHeader->m_iGen);
+    while (1)
+    {
+        int n = drain();
+        DateTime::s_curTime = time(NULL);
+        if (DateTime::s_curTime != tmLast)
+        {
+            tmLast = DateTime::s_curTime;
+            AccessLog::flushAll(1);
+        }
+        else if (n == 0)
+            AccessLog::flushAll(0);
+        if (n > 0)
+            continue;
+        if (getppid() != ppid || m_pHeader->m_iGen != m_iConsumeGen)
+            break;
+        usleep(ALR_IDLE_USEC);
+    }
+    drain();
+    AccessLog::flushAll(0);
+    if (m_pHeader->m_iFull)
+        LS_NOTICE("[AccessLogRing] %" PRIu64 " entries were logged inline"
+                  " because the ring was full.", m_pHeader->m_iFull);
+}
+
+
+/**
+ * Tells the running logger process to drain what is left and exit, so
+ * that a new one can be forked with the current set of access logs.
+ */
+void AccessLogRing::retire()
+{
+    if (m_pHeader)
+        ls_atomic_fetch_add(&m_pHeader->m_iGen, 1);
+}
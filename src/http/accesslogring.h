@@ -0,0 +1,119 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#ifndef ACCESSLOGRING_H
+#define ACCESSLOGRING_H
+
+#include <lsdef.h>
+#include <util/tsingleton.h>
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#define ALR_SLOT_SIZE       4096
+#define ALR_MIN_SLOTS       64
+
+enum
+{
+    ALR_COMBINED = 1,
+    ALR_TEXT,
+};
+
+enum
+{
+    ALR_VHOST,
+    ALR_ADDR,
+    ALR_USER,
+    ALR_REQLINE,
+    ALR_REFERER,
+    ALR_USERAGENT,
+    ALR_HOST,
+    ALR_STR_MAX
+};
+
+/**
+ * One access log entry in fixed binary layout.  The strings follow the
+ * header back to back in ALR_* order, not NUL terminated.  An ALR_TEXT
+ * record carries an already formatted line in the first string.
+ * This is also the on-disk layout of a "logBinary" access log.
+ */
+struct AccessLogRec
+{
+    uint32_t    m_iLen;         // header plus strings
+    uint16_t    m_iLogId;
+    uint8_t     m_iType;
+    uint8_t     m_iFlags;       // LOG_REFERER, LOG_USERAGENT, LOG_VHOST,
+                                // ALR_TRUNCATED
+    uint16_t    m_iStatus;      // numeric HTTP status, e.g. 200
+    uint16_t    m_iStrLen[ALR_STR_MAX];
+    int64_t     m_lReqTime;
+    int64_t     m_lBytes;
+
+    void init(int id, int type);
+    int  append(int idx, const char *p, int len, int truncate = 0);
+    const char *getStr(int idx) const;
+};
+
+#define ALR_MAX_REC_LEN     (ALR_SLOT_SIZE - 16)
+
+// set in m_iFlags when append() had to cut a field short
+#define ALR_TRUNCATED       0x80
+
+struct AlrShmHeader;
+
+/**
+ * Bounded MPMC ring of AccessLogRec slots in an anonymous shared mapping.
+ * The parent maps it before forking, workers push records from the event
+ * loop, and a dedicated logger process formats and writes them.  Each
+ * slot carries a sequence number, so producers never wait on each other
+ * and a full ring is reported to the caller instead of blocking it.
+ */
+class AccessLogRing : public TSingleton<AccessLogRing>
+{
+    friend class TSingleton<AccessLogRing>;
+
+public:
+    void setSize(long size)         {   m_lSize = size;             }
+    long getSize() const            {   return m_lSize;             }
+    bool isEnabled() const          {   return m_pHeader != NULL;   }
+
+    int  init();
+    void release();
+
+    int  push(const AccessLogRec *pRec);
+    int  pushText(int id, const char *pText, int len);
+
+    void consume(pid_t ppid);
+    void retire();
+
+private:
+    AccessLogRing();
+    ~AccessLogRing();
+
+    char *getSlot(uint64_t pos) const;
+    int   drain();
+
+    AlrShmHeader   *m_pHeader;
+    char           *m_pSlots;
+    long            m_lSize;
+    uint32_t        m_iConsumeGen;
+
+    LS_NO_COPY_ASSIGN(AccessLogRing);
+};
+
+#endif // ACCESSLOGRING_H
@@ -201,6 +201,7 @@ void ClientCache::clean()
 {
     clean(&m_v4);
     clean(&m_v6);
+    ClientInfo::trimShm();
 }
 
 
@@ -285,7 +286,7 @@ static int resetQuotas(const void *pKey, void *pData)
                 pInfo->setAccess(AC_ALLOW);
             }
         }
-        else if (((int)pInfo->getConns() <=
+        else if (((int)pInfo->getTotalConns() <=
                   (ClientInfo::getPerClientSoftLimit() >> 1)) &&
                  (DateTime::s_curTime - tm < ClientInfo::getOverLimitGracePeriod()))
             pInfo->setOverLimitTime(0);
@@ -20,6 +20,8 @@
 #include <http/ip2geo.h>
 #include <http/iptoloc.h>
 #include <log4cxx/logger.h>
+#include <lsr/ls_atomic.h>
+#include <shm/lsshmhash.h>
 #include <util/accessdef.h>
 #include <util/datetime.h>
 
@@ -30,9 +32,8 @@
 #include <arpa/inet.h>
 #include <limits.h>
 
-#define ShmClientMagic  0x20140601
-#define ShmClientInfo   "ClientInfo"
-#define ShmClientHash   "ClientHash"
+#define SHM_CLIENT_IDLE 300
+#define SHM_CLIENT_TTL  3600
 
 
 int ClientInfo::s_iSoftLimitPC = INT_MAX;
@@ -40,36 +41,54 @@ int ClientInfo::s_iHardLimitPC = 100;
 int ClientInfo::s_iOverLimitGracePeriod = 10;
 int ClientInfo::s_iBanPeriod = 60;
 uint16_t ClientInfo::s_iMaxAllowedBotHits = 3;
+LsShmHash *ClientInfo::s_pShmTable = NULL;
+int ClientInfo::s_iShareAcrossWorkers = 0;
 
-#if 0
-TShmClientPool *ClientInfo::s_base = NULL;
 
-int ClientInfo::shmData_init(lsShm_hCacheData_t *p, void *pUParam)
+int ClientInfo::initShm(int uid, int gid)
 {
-    TShmClient *pObj = (TShmClient *)p;
-    ClientInfo *pInfo = (ClientInfo *)pObj;
-
-    // Sample code for init...
-    pObj->x_ctlThrottle = pInfo->m_ctlThrottle;
-    pObj->x_iConns = pInfo->m_iConns;
-    pObj->x_tmOverLimit = pInfo->m_tmOverLimit;
-    pObj->x_sslNewConn = pInfo->m_sslNewConn;
-    pObj->x_iHits = pInfo->m_iHits;
-    pObj->x_lastConnect = pInfo->m_lastConnect;
-    pObj->x_iAccess = pInfo->m_iAccess;
+    if (!s_iShareAcrossWorkers || s_pShmTable)
+        return 0;
+    s_pShmTable = LsShmHash::open("client_info", "ClientInfo", 1000,
+                                  LSSHM_FLAG_LRU);
+    if (!s_pShmTable)
+    {
+        LS_WARN("Failed to open SHM for per client limits, "
+                "limits are enforced per worker.");
+        return LS_FAIL;
+    }
+    s_pShmTable->getPool()->getShm()->chperm(uid, gid, 0600);
+    s_pShmTable->disableAutoLock();
     return 0;
 }
 
-int ClientInfo::shmData_remove(lsShm_hCacheData_t *p, void *pUParam)
+
+static int trimShmClient(LsShmHash::iterator iter, void *arg)
 {
-    // TShmClient * pObj = (TShmClient*)p;
-    // Need to do something here...
-    // ClientInfo * pInfo = (ClientInfo *)pObj;
+    lsShmClientInfo_t *pShm = (lsShmClientInfo_t *)iter->getVal();
+    time_t now = *(time_t *)arg;
+    if (pShm->x_tmBlocked
+        && now - pShm->x_tmBlocked < ClientInfo::getBanPeriod())
+        return 0;
+    if (now - pShm->x_lastConnect < SHM_CLIENT_IDLE)
+        return 0;
+    //Counters of a crashed worker are never released, do not keep them forever
+    if (pShm->x_iConns > 0
+        && now - pShm->x_lastConnect < SHM_CLIENT_TTL)
+        return 0;
+    return 1;
+}
 
-    // Sample code for remove...
-    return 0;
+
+void ClientInfo::trimShm()
+{
+    if (!s_pShmTable)
+        return;
+    time_t now = DateTime::s_curTime;
+    s_pShmTable->lock();
+    s_pShmTable->trim(now - SHM_CLIENT_IDLE, trimShmClient, &now);
+    s_pShmTable->unlock();
 }
-#endif
 
 
 ClientInfo::ClientInfo()
@@ -86,32 +105,8 @@ ClientInfo::ClientInfo()
     , m_iHits(0)
     , m_lastConnect(0)
     , m_iAccess(0)
+    , m_iShmOffset(0)
 {
-#if 0
-    m_pShmClient = NULL;
-    m_clientOffset = 0;
-    // Only need to do this once!
-    if (!s_base)
-    {
-        // s_base = new TShmClientPool
-        s_base = new TShmClientPool(ShmClientMagic
-                                    , ShmClientInfo
-                                    , ShmClientHash
-                                    , 101
-                                    , sizeof(TShmClient)
-                                    , LsShmHash::hashBuf
-                                    , memcmp
-                                    , shmData_init
-                                    , shmData_remove
-                                   );
-        if (s_base && (s_base->status() != LSSHM_READY))
-        {
-            delete s_base;
-            s_base = NULL;
-        }
-    }
-#endif
-    ;
 }
 
 
@@ -156,30 +151,6 @@ void ClientInfo::setAddr(const struct sockaddr *pAddr)
         strLen = 41;
     }
 
-#if 0
-    if (s_base)
-    {
-        // remove the old one
-        if (m_clientOffset)
-        {
-            // uhmmm probably not to remove...
-            s_base->removeObj((lsShm_hCacheData_t *) s_base->offset2ptr(
-                                  m_clientOffset));
-        }
-
-        m_pShmClient = (TShmClient *)s_base->getObj(pAddr, len, NULL ,
-                       sizeof(TShmClient));
-        // initialize the data here...
-        if (m_pShmClient)
-        {
-            // track it
-            s_base->push((lsShm_hCacheData_t *)m_pShmClient);
-            m_clientOffset = s_base->ptr2offset(m_pShmClient);
-        }
-        else
-            m_clientOffset = 0;
-    }
-#endif
     memmove(m_achSockAddr, pAddr, len);
     m_sAddr.prealloc(strLen);
     if (m_sAddr.buf())
@@ -190,6 +161,192 @@ void ClientInfo::setAddr(const struct sockaddr *pAddr)
     }
     memset(&m_iConns, 0, (char *)(&m_lastConnect + 1) - (char *)&m_iConns);
     m_iAccess = 1;
+    m_iShmOffset = 0;
+    if (s_pShmTable)
+        attachShm();
+}
+
+
+static inline int getAddrKey(const struct sockaddr *pAddr, const uint8_t **pKey)
+{
+    if (AF_INET == pAddr->sa_family)
+    {
+        *pKey = (const uint8_t *)&((const struct sockaddr_in *)pAddr)->sin_addr;
+        return 4;
+    }
+    *pKey = (const uint8_t *)&((const struct sockaddr_in6 *)pAddr)->sin6_addr;
+    return 16;
+}
+
+
+void ClientInfo::attachShm()
+{
+    const uint8_t *pKey;
+    int keyLen = getAddrKey(getAddr(), &pKey);
+    int valLen = sizeof(lsShmClientInfo_t);
+    int flag = LSSHM_VAL_INIT;
+    s_pShmTable->lock();
+    LsShmOffset_t offset = s_pShmTable->get(pKey, keyLen, &valLen, &flag);
+    if (offset && valLen >= (int)sizeof(lsShmClientInfo_t))
+    {
+        lsShmClientInfo_t *pShm =
+            (lsShmClientInfo_t *)s_pShmTable->offset2ptr(offset);
+        if (flag == LSSHM_VAL_CREATED)
+            memmove(pShm->x_addr, pKey, keyLen);
+        m_iShmOffset = offset;
+    }
+    s_pShmTable->unlock();
+}
+
+
+/**
+ * The entry may have been trimmed and its memory reused by another client
+ * since it was attached, verify the address before touching it.
+ */
+lsShmClientInfo_t *ClientInfo::getShmInfo()
+{
+    const uint8_t *pKey;
+    int keyLen = getAddrKey(getAddr(), &pKey);
+    lsShmClientInfo_t *pShm =
+        (lsShmClientInfo_t *)s_pShmTable->offset2ptr(m_iShmOffset);
+    if (memcmp(pShm->x_addr, pKey, keyLen) == 0)
+        return pShm;
+    m_iShmOffset = 0;
+    attachShm();
+    if (!m_iShmOffset)
+        return NULL;
+    pShm = (lsShmClientInfo_t *)s_pShmTable->offset2ptr(m_iShmOffset);
+    ls_atomic_add(&pShm->x_iConns, m_iConns);
+    return pShm;
+}
+
+
+void ClientInfo::updateShmConns(int delta)
+{
+    lsShmClientInfo_t *pShm = getShmInfo();
+    if (pShm)
+        ls_atomic_add(&pShm->x_iConns, delta);
+}
+
+
+void ClientInfo::updateShmHit(time_t t)
+{
+    lsShmClientInfo_t *pShm = getShmInfo();
+    if (pShm)
+        pShm->x_lastConnect = (uint32_t)t;
+}
+
+
+int32_t ClientInfo::getTotalConns()
+{
+    if (m_iShmOffset)
+    {
+        lsShmClientInfo_t *pShm = getShmInfo();
+        if (pShm)
+        {
+            int32_t n = ls_atomic_fetch_add(&pShm->x_iConns, 0);
+            return (n > m_iConns) ? n : m_iConns;
+        }
+    }
+    return m_iConns;
+}
+
+
+/**
+ * The per second request and SSL handshake counters are reset by whichever
+ * worker first sees a new second.
+ */
+lsShmClientInfo_t *ClientInfo::rollShmQuota()
+{
+    lsShmClientInfo_t *pShm = getShmInfo();
+    if (!pShm)
+        return NULL;
+    uint32_t now = (uint32_t)DateTime::s_curTime;
+    uint32_t tm = pShm->x_tmQuota;
+    if (tm != now && ls_atomic_cas32((int32_t *)&pShm->x_tmQuota,
+                                     (int32_t)tm, (int32_t)now))
+    {
+        pShm->x_iReqs[0] = 0;
+        pShm->x_iReqs[1] = 0;
+        pShm->x_iSslNewConn = 0;
+    }
+    return pShm;
+}
+
+
+bool ClientInfo::allowProcess(int dyn)
+{
+    if (!m_ctlThrottle.allowProcess(dyn))
+        return false;
+    const ThrottleUnit *pTU = m_ctlThrottle.getThrottleUnit(dyn);
+    if (!m_iShmOffset || pTU->isUnlimited())
+        return true;
+    lsShmClientInfo_t *pShm = rollShmQuota();
+    return (!pShm || pShm->x_iReqs[dyn] < pTU->getLimit());
+}
+
+
+void ClientInfo::incReqProcessed(int dyn)
+{
+    m_ctlThrottle.incReqProcessed(dyn);
+    if (m_iShmOffset)
+    {
+        lsShmClientInfo_t *pShm = rollShmQuota();
+        if (pShm)
+            ls_atomic_add(&pShm->x_iReqs[dyn], 1);
+    }
+}
+
+
+short ClientInfo::incSslNewConn()
+{
+    ++m_sslNewConn;
+    if (m_iShmOffset)
+    {
+        lsShmClientInfo_t *pShm = rollShmQuota();
+        if (pShm)
+            return ls_atomic_add_fetch(&pShm->x_iSslNewConn, 1);
+    }
+    return m_sslNewConn;
+}
+
+
+void ClientInfo::publishBlock(enum BOT_REASON reason)
+{
+    lsShmClientInfo_t *pShm = getShmInfo();
+    if (pShm)
+    {
+        pShm->x_iBotReason = reason;
+        pShm->x_tmBlocked = (uint32_t)DateTime::s_curTime;
+    }
+}
+
+
+/**
+ * Adopt a block placed on this client by another worker.
+ */
+int ClientInfo::checkShmBlock()
+{
+    lsShmClientInfo_t *pShm = getShmInfo();
+    if (!pShm || !pShm->x_tmBlocked
+        || DateTime::s_curTime - pShm->x_tmBlocked >= getBanPeriod())
+        return 0;
+    if (getFlag(CIF_LOCAL_ADDR))
+        return 0;
+    setOverLimitTime(pShm->x_tmBlocked);
+    setAccess(AC_BLOCK);
+    setBotReason((enum BOT_REASON)pShm->x_iBotReason);
+    LS_DBG_L("[%s] blocked by another worker.", getAddrString());
+    return 1;
+}
+
+
+void ClientInfo::block()
+{
+    setOverLimitTime(DateTime::s_curTime);
+    setAccess(AC_BLOCK);
+    if (m_iShmOffset)
+        publishBlock(getBotReason());
 }
 
 bool ClientInfo::isFromLocalAddr(const sockaddr* server_addr) const
@@ -200,6 +357,8 @@ bool ClientInfo::isFromLocalAddr(const sockaddr* server_addr) const
 int ClientInfo::checkAccess()
 {
     int iSoftLimit = ClientInfo::getPerClientSoftLimit();
+    if (m_iShmOffset && m_iAccess == AC_ALLOW && checkShmBlock())
+        return 1;
     switch (m_iAccess)
     {
     case AC_BLOCK:
@@ -221,15 +380,16 @@ int ClientInfo::checkAccess()
             else
             {
                 LS_DBG_L("[%s] %d connections established, limit: %d.",
-                         getAddrString(), (int)getConns(), iSoftLimit);
+                         getAddrString(), (int)getTotalConns(), iSoftLimit);
             }
         }
-        else if ((int)getConns() >= iSoftLimit)
+        else if ((int)getTotalConns() >= iSoftLimit)
             setOverLimitTime(DateTime::s_curTime);
-        if ((int)getConns() >= ClientInfo::getPerClientHardLimit())
+        if ((int)getTotalConns() >= ClientInfo::getPerClientHardLimit())
         {
             LS_NOTICE("[%s] Reached per client hard connection limit: %d, current: %d, close connection!",
-                      getAddrString(), ClientInfo::getPerClientHardLimit(), getConns());
+                      getAddrString(), ClientInfo::getPerClientHardLimit(),
+                      (int)getTotalConns());
             markAsBot( "N/A", BOT_OVER_HARD );
             return 1;
         }
@@ -272,11 +432,10 @@ int ClientInfo::markAsBot(const char *pVhostName, enum BOT_REASON code)
         return -1;
     }
 
-    setOverLimitTime(DateTime::s_curTime);
-    //if ( code != BOT_TOO_MANY_BAD_REQ )
-    setAccess(AC_BLOCK);
     setBotReason(code);
     //m_bot_reason = code;
+    //if ( code != BOT_TOO_MANY_BAD_REQ )
+    block();
     return 0;
 }
 
@@ -50,31 +50,27 @@ enum BOT_REASON
 #define CIF_TEST_LOCAL_ADDR (1<<6)
 #define CIF_LOCAL_ADDR      (1<<7)
 
-#if 0
-#include <shm/lsshmcache.h>
+#include <shm/lsshmtypes.h>
 
 //
-//  Data in the SHM
+//  Per client counters shared by all worker processes, stored in the
+//  "client_info" SHM hash and keyed by the raw IP address bytes.
 //
-// NOT READY - will continue later
 typedef struct lsShmClientInfo_s
 {
-    lsShm_hCacheData_t  x_cache;
-    size_t              x_iConns;
-    time_t              x_tmOverLimit;
-    short               x_sslNewConn;
-    int                 x_iHits;
-    time_t              x_lastConnect;
-    int                 x_iAccess;
-    ThrottleControl     x_ctlThrottle;
-} lsShmClientInfo_t ;
-
-typedef struct lsShmClientInfo_s    TShmClient;
-typedef LsShmCache                  TShmClientPool;
-#endif
+    uint8_t             x_addr[16];
+    int32_t             x_iConns;
+    int32_t             x_iSslNewConn;
+    int32_t             x_iReqs[2];
+    uint32_t            x_tmQuota;
+    uint32_t            x_tmBlocked;
+    uint32_t            x_lastConnect;
+    int32_t             x_iBotReason;
+} lsShmClientInfo_t;
 
 struct sockaddr;
 class LocInfo;
+class LsShmHash;
 class ClientInfo
 {
     char        m_achSockAddr[24];
@@ -114,14 +110,17 @@ class ClientInfo
     //int       m_iBytesSent;
     //int       m_iExcessiveConnAttempts;
 
-#if 0
-    // NOT READY
-    static TShmClientPool *s_base;
-    TShmClient *m_pShmClient;
-    LsShmOffset_t m_clientOffset;
-    static int shmData_init(lsShm_hCacheData_t *, void *pUParam);
-    static int shmData_remove(lsShm_hCacheData_t *, void *pUParam);
-#endif
+    LsShmOffset_t       m_iShmOffset;
+    static LsShmHash   *s_pShmTable;
+    static int          s_iShareAcrossWorkers;
+
+    void attachShm();
+    lsShmClientInfo_t *getShmInfo();
+    void updateShmConns(int delta);
+    void updateShmHit(time_t t);
+    void publishBlock(enum BOT_REASON reason);
+    int  checkShmBlock();
+    lsShmClientInfo_t *rollShmQuota();
 
 public:
     ClientInfo();
@@ -159,9 +158,20 @@ public:
     const char *getHostName() const     {   return m_sHostName.c_str(); }
     int getHostNameLen() const          {   return m_sHostName.len();   }
 
-    int32_t incConn()                   {   return ++m_iConns;          }
-    int32_t decConn()                   {   return --m_iConns;          }
+    int32_t incConn()
+    {
+        if (m_iShmOffset)
+            updateShmConns(1);
+        return ++m_iConns;
+    }
+    int32_t decConn()
+    {
+        if (m_iShmOffset)
+            updateShmConns(-1);
+        return --m_iConns;
+    }
     int32_t getConns() const            {   return m_iConns;            }
+    int32_t getTotalConns();
 
     void incCaptchaTries()              {   ++m_iCaptchaTries;          }
     uint16_t getCaptchaTries() const    {   return m_iCaptchaTries;     }
@@ -173,7 +183,13 @@ public:
     bool isReachBotLimit() const
     {   return (getAllowedBotHits() >= getMaxAllowedBotHits());         }
 
-    void hit(time_t t)                  {   ++m_iHits; m_lastConnect = t;    }
+    void hit(time_t t)
+    {
+        ++m_iHits;
+        m_lastConnect = t;
+        if (m_iShmOffset)
+            updateShmHit(t);
+    }
     void resetHits()                    {   m_iHits = 0;                }
     int  getHits() const                {   return m_iHits;             }
 
@@ -187,13 +203,17 @@ public:
     int getAccess() const               {   return m_iAccess;           }
 
     int checkAccess();
+    void block();
 
     ThrottleControl &getThrottleCtrl()  {   return m_ctlThrottle;       }
 
     bool allowRead() const      {   return m_ctlThrottle.allowRead();   }
     bool allowWrite() const     {   return m_ctlThrottle.allowWrite();  }
 
-    short incSslNewConn()               {   return ++m_sslNewConn;      }
+    bool allowProcess(int dyn);
+    void incReqProcessed(int dyn);
+
+    short incSslNewConn();
     short getSslNewConn()               {   return m_sslNewConn;        }
     void  setSslNewConn(int n)          {   m_sslNewConn = n;           }
     void  setGeoInfo(GeoInfo *geoInfo)  {
@@ -241,13 +261,13 @@ public:
     static uint16_t getMaxAllowedBotHits()
     {   return s_iMaxAllowedBotHits;    }
 
-#if 0
-    TShmClient *getShmClientInfo()
-    {
-        return (TShmClient *)
-               (s_base ? s_base->offset2ptr(m_clientOffset) : NULL);
-    }
-#endif
+    static void setShareAcrossWorkers(int val)
+    {   s_iShareAcrossWorkers = val;    }
+    static int isShareAcrossWorkers()
+    {   return s_iShareAcrossWorkers;   }
+    static int initShm(int uid, int gid);
+    static void trimShm();
+
     LS_NO_COPY_ASSIGN(ClientInfo);
 };
 
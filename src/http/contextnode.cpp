@@ -123,6 +123,30 @@ void ContextNode::contextInherit(const HttpContext *pRootContext)
 }
 
 
+/**
+ * Re-point contexts that inherited pOld by pointer, stop at contexts
+ * which have rules of their own.
+ */
+void ContextNode::replaceRewriteRules(const RewriteRuleList *pOld,
+                                      RewriteRuleList *pNew)
+{
+    if (!m_pChildren)
+        return;
+    ChildNodeList::iterator iter = m_pChildren->begin();
+    while (iter != m_pChildren->end())
+    {
+        HttpContext *pContext = iter.second()->getContext();
+        if (!pContext || !(pContext->getConfigBits() & BIT_REWRITE_RULE))
+        {
+            if (pContext && pContext->getRewriteRules() == pOld)
+                pContext->setInheritedRewriteRules(pNew);
+            iter.second()->replaceRewriteRules(pOld, pNew);
+        }
+        iter = m_pChildren->next(iter);
+    }
+}
+
+
 HttpContext *ContextNode::getParentContext()
 {
     if (m_pParentNode != NULL)
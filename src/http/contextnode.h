@@ -29,6 +29,7 @@ class ContextList;
 class AutoStr2;
 class StringList;
 class HttpHandler;
+class RewriteRuleList;
 class ContextNode;
 
 class ChildNodeList : public HashStringMap< ContextNode * >
@@ -72,6 +73,8 @@ public:
     void setLabel(const char *l);
 
     void contextInherit(const HttpContext *pRootContext);
+    void replaceRewriteRules(const RewriteRuleList *pOld,
+                             RewriteRuleList *pNew);
 
     void setRelease(char r)                 {   m_iRelease = r;         }
     char getRelease() const                 {   return m_iRelease;      }
@@ -227,6 +227,17 @@ ContextNode *ContextTree::findNode(const char *pPath)
 }
 
 
+ContextNode *ContextTree::findUriNode(const char *pURI)
+{
+    const char *pPrefix;
+    int iPrefixLen;
+    pPrefix = getPrefix(iPrefixLen);
+    if (strncmp(pURI, pPrefix, iPrefixLen) != 0)
+        return NULL;
+    return m_pRootNode->find(pURI + iPrefixLen);
+}
+
+
 ContextNode *ContextTree::addNode(const char *pPrefix, int iPrefixLen,
                                   ContextNode *pCurNode, char *pURI,
                                   long lastCheck)
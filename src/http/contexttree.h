@@ -48,6 +48,7 @@ public:
     ContextNode *getRootNode() const           {   return m_pRootNode;     }
 
     ContextNode *findNode(const char *pPrefix);
+    ContextNode *findUriNode(const char *pURI);
 
     ContextNode *addNode(const char *pPrefix, int len,
                          ContextNode *pCurNode,
@@ -0,0 +1,185 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "headerscanner.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HEADERSCANNER_X86
+#endif
+
+
+const unsigned char HeaderScanner::s_tokenChar[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,     //  !"#$%&'()*+,-./
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,     // 0-9 :;<=>?
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // @A-O
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,     // P-Z [\]^_
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // `a-o
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0,     // p-z {|}~ DEL
+};
+
+
+static const char *findLineScalar(const char *p, const char *pEnd,
+                                  const char **pColon)
+{
+    const char *pLineEnd = (const char *)memchr(p, '\n', pEnd - p);
+    if (pLineEnd)
+        *pColon = (const char *)memchr(p, ':', pLineEnd - p);
+    else
+        *pColon = NULL;
+    return pLineEnd;
+}
+
+
+#ifdef HEADERSCANNER_X86
+
+static inline const char *findLineTail(const char *p, const char *pEnd,
+                                       const char *pFound,
+                                       const char **pColon)
+{
+    for (; p < pEnd; ++p)
+    {
+        if (*p == '\n')
+        {
+            *pColon = pFound;
+            return p;
+        }
+        if (*p == ':' && !pFound)
+            pFound = p;
+    }
+    *pColon = NULL;
+    return NULL;
+}
+
+
+/**
+ * Each block yields one mask per delimiter; colons behind the first
+ * '\n' of the block belong to the next line and are masked off.
+ */
+static const char *findLineSse2(const char *p, const char *pEnd,
+                                const char **pColon)
+{
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i colon = _mm_set1_epi8(':');
+    const char *pFound = NULL;
+    unsigned int lfMask, colonMask;
+    while (pEnd - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        lfMask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+        if (!pFound)
+        {
+            colonMask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, colon));
+            if (lfMask)
+                colonMask &= (lfMask & -lfMask) - 1;
+            if (colonMask)
+                pFound = p + __builtin_ctz(colonMask);
+        }
+        if (lfMask)
+        {
+            *pColon = pFound;
+            return p + __builtin_ctz(lfMask);
+        }
+        p += 16;
+    }
+    return findLineTail(p, pEnd, pFound, pColon);
+}
+
+
+__attribute__((target("avx2")))
+static const char *findLineAvx2(const char *p, const char *pEnd,
+                                const char **pColon)
+{
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const char *pFound = NULL;
+    unsigned int lfMask, colonMask;
+    while (pEnd - p >= 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        lfMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf));
+        if (!pFound)
+        {
+            colonMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, colon));
+            if (lfMask)
+                colonMask &= (lfMask & -lfMask) - 1;
+            if (colonMask)
+                pFound = p + __builtin_ctz(colonMask);
+        }
+        if (lfMask)
+        {
+            *pColon = pFound;
+            return p + __builtin_ctz(lfMask);
+        }
+        p += 32;
+    }
+    return findLineTail(p, pEnd, pFound, pColon);
+}
+
+#endif // HEADERSCANNER_X86
+
+
+static HeaderScanner::FindLineFn selectFindLine()
+{
+#ifdef HEADERSCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return findLineAvx2;
+    return findLineSse2;
+#else
+    return findLineScalar;
+#endif
+}
+
+
+HeaderScanner::FindLineFn HeaderScanner::s_findLine = HeaderScanner::resolve;
+
+
+const char *HeaderScanner::resolve(const char *p, const char *pEnd,
+                                   const char **pColon)
+{
+    s_findLine = selectFindLine();
+    return s_findLine(p, pEnd, pColon);
+}
+
+
+void HeaderScanner::useScalar(bool scalar)
+{
+    s_findLine = scalar ? findLineScalar : selectFindLine();
+}
+
+
+const char *HeaderScanner::getImplName()
+{
+    if (s_findLine == resolve)
+        s_findLine = selectFindLine();
+    if (s_findLine == findLineScalar)
+        return "scalar";
+#ifdef HEADERSCANNER_X86
+    if (s_findLine == findLineAvx2)
+        return "avx2";
+    if (s_findLine == findLineSse2)
+        return "sse2";
+#endif
+    return "unknown";
+}
+
@@ -0,0 +1,66 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef HEADERSCANNER_H
+#define HEADERSCANNER_H
+
+
+/**
+ * Vectorised helpers for HttpReq::processHeaderLines().  The line scanner
+ * is picked once at run time: AVX2 when the CPU has it, 16-byte SSE2 on
+ * any other x86-64, plain memchr() elsewhere.
+ */
+class HeaderScanner
+{
+public:
+    typedef const char *(*FindLineFn)(const char *p, const char *pEnd,
+                                      const char **pColon);
+
+    /**
+     * Returns the next '\n' in [p, pEnd) or NULL.  On success *pColon is
+     * set to the first ':' before that '\n', NULL if the line has none.
+     * Both are found in the same pass over the buffer.
+     */
+    static const char *findLine(const char *p, const char *pEnd,
+                                const char **pColon)
+    {   return s_findLine(p, pEnd, pColon);     }
+
+    /** Non-zero if [p, pEnd) is a non-empty RFC 9110 token. */
+    static int isToken(const char *p, const char *pEnd)
+    {
+        if (p >= pEnd)
+            return 0;
+        for (; p < pEnd; ++p)
+            if (!s_tokenChar[(unsigned char)*p])
+                return 0;
+        return 1;
+    }
+
+    static const char *getImplName();
+
+    // Switch between the portable and the CPU specific path, for tests.
+    static void useScalar(bool scalar);
+
+private:
+    static const char *resolve(const char *p, const char *pEnd,
+                               const char **pColon);
+
+    static FindLineFn           s_findLine;
+    static const unsigned char  s_tokenChar[256];
+};
+
+#endif // HEADERSCANNER_H
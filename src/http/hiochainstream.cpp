@@ -18,6 +18,7 @@
 
 #include "hiochainstream.h"
 #include <http/httpsession.h>
+#include <ssi/ssifragcache.h>
 
 #include <stdio.h>
 #include <sys/uio.h>
@@ -27,13 +28,15 @@ HioChainStream::HioChainStream()
     , m_iDepth(0)
     , m_iSequence(0)
     , m_pRespHeaders(NULL)
+    , m_pFragment(NULL)
 {
 
 }
 
 HioChainStream::~HioChainStream()
 {
-
+    if (m_pFragment)
+        delete m_pFragment;
 }
 
 
@@ -166,7 +169,12 @@ int HioChainStream::write(const char *pBuf, int size)
     //if (getState()!=HIOS_CONNECTED)
     //    return -1;
     if (m_pParentSession)
-        return m_pParentSession->appendDynBody(pBuf, size);
+    {
+        int ret = m_pParentSession->appendDynBody(pBuf, size);
+        if (m_pFragment && ret > 0)
+            m_pFragment->append(pBuf, ret);
+        return ret;
+    }
     if (!getFlag(HIO_FLAG_BLACK_HOLE))
         return 0;
     else
@@ -179,7 +187,13 @@ int HioChainStream::sendfile(int fdSrc, off_t off, size_t size, int flag)
     //if (getState()!=HIOS_CONNECTED)
     //    return -1;
     if (m_pParentSession)
-        return m_pParentSession->writeRespBodySendFile(fdSrc, off, size, flag);
+    {
+        int ret = m_pParentSession->writeRespBodySendFile(fdSrc, off, size,
+                                                          flag);
+        if (m_pFragment && ret > 0)
+            m_pFragment->appendFile(fdSrc, off, ret);
+        return ret;
+    }
     if (!getFlag(HIO_FLAG_BLACK_HOLE))
         return 0;
     else
@@ -21,6 +21,7 @@
 #include <http/hiostream.h>
 
 class HttpSession;
+class SsiFragment;
 
 class HioChainStream :  public HioStream
 {
@@ -64,6 +65,10 @@ public:
     HttpRespHeaders *getRespHeaders() const
     {   return m_pRespHeaders;  }
 
+    // body passed to the parent is also copied into the fragment
+    void setFragment(SsiFragment *p)    {   m_pFragment = p;        }
+    SsiFragment *getFragment() const    {   return m_pFragment;     }
+
 
 private:
     HioChainStream(const HioChainStream &other);
@@ -76,6 +81,7 @@ private:
     int           m_iDepth: 8;
     int           m_iSequence: 24;
     HttpRespHeaders *m_pRespHeaders;
+    SsiFragment     *m_pFragment;
 };
 
 #endif // CHAINHIOSTREAM_H
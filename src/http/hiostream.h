@@ -69,12 +69,15 @@ class UnpackedHeaders;
 #define HIO_FLAG_ALTSVC_SENT        SS_FLAG_ALTSVC_SENT
 #define HIO_FLAG_PASS_SETCOOKIE     SS_FLAG_PASS_SETCOOKIE
 #define HIO_FLAG_RESP_HEADER_SENT   SS_FLAG_RESP_HEADER_SENT
+#define HIO_FLAG_PRI_INCREMENTAL    SS_FLAG_PRI_INCREMENTAL
+#define HIO_FLAG_PRI_SIGNAL         SS_FLAG_PRI_SIGNAL
 
 
 #define HIO_EOR                     1
 
 #define HIO_PRIORITY_HIGHEST        (0)
 #define HIO_PRIORITY_LOWEST         (7)
+#define HIO_PRIORITY_DEFAULT        (3)     // RFC 9218 default urgency
 #define HIO_PRIORITY_HTML           (2)
 #define HIO_PRIORITY_CSS            (HIO_PRIORITY_HTML + 1)
 #define HIO_PRIORITY_JS             (HIO_PRIORITY_CSS + 1)
@@ -293,6 +296,9 @@ public:
     virtual int onCloseEx() = 0;
     virtual int onTimerEx() = 0;
 
+    // Seconds until onTimerEx() may have something to do again.
+    virtual int getTimerDelay()         {   return 1;   }
+
     virtual void recycle() = 0;
 
     virtual int h2cUpgrade(HioHandler *pOld, const char * pBuf, int size);
@@ -0,0 +1,559 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "htaccesscache.h"
+
+#include <edio/multiplexer.h>
+#include <http/contextnode.h>
+#include <http/contexttree.h>
+#include <http/httpcontext.h>
+#include <http/httplog.h>
+#include <http/httpvhost.h>
+#include <http/rewriteengine.h>
+#include <http/rewriterule.h>
+#include <http/rewriterulelist.h>
+#include <log4cxx/logger.h>
+#include <log4cxx/tmplogid.h>
+#include <lsr/xxhash.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(linux) || defined(__linux) || defined(__linux__) || defined(__gnu_linux__)
+#include <sys/inotify.h>
+#define LS_HTA_INOTIFY
+#define HTA_WATCH_MASK  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM \
+                         | IN_DELETE | IN_ONLYDIR)
+#endif
+
+
+LS_SINGLETON(HtAccessCache);
+
+enum
+{
+    HTAC_NONE,      // no such file
+    HTAC_FOUND,
+    HTAC_UNSHARED,  // uses RewriteFile
+    HTAC_ERROR,     // cannot be read or parsed
+};
+
+
+static hash_key_t hfFileKey(const void *pKey)
+{
+    return XXH(pKey, sizeof(HtaFileKey), 0);
+}
+
+
+static int cmpFileKey(const void *pVal1, const void *pVal2)
+{
+    return memcmp(pVal1, pVal2, sizeof(HtaFileKey));
+}
+
+
+static hash_key_t hfContentKey(const void *pKey)
+{
+    return ((const HtaContentKey *)pKey)->m_iHash;
+}
+
+
+static int cmpContentKey(const void *pVal1, const void *pVal2)
+{
+    const HtaContentKey *p1 = (const HtaContentKey *)pVal1;
+    const HtaContentKey *p2 = (const HtaContentKey *)pVal2;
+    if ((p1->m_iHash != p2->m_iHash) || (p1->m_iLen != p2->m_iLen))
+        return 1;
+    return memcmp(p1->m_pData, p2->m_pData, p1->m_iLen);
+}
+
+
+static void *wdKey(int wd)
+{
+    return (void *)(long)wd;
+}
+
+
+HtAccessCache::HtAccessCache()
+    : m_byFile(64, hfFileKey, cmpFileKey)
+    , m_byContent(64, hfContentKey, cmpContentKey)
+    , m_byContext(64, NULL, NULL)
+    , m_byWd(64, NULL, NULL)
+{
+}
+
+
+HtAccessCache::~HtAccessCache()
+{
+    if (getfd() != -1)
+        close(getfd());
+}
+
+
+/**
+ * pBuf is modified by the rule parser, pContent is pointed at the entry's
+ * own copy of the content.
+ */
+HtaEntry *HtAccessCache::parse(char *pBuf, int len, const HtaFileKey *pKey,
+                               HtaContentKey *pContent)
+{
+    // RewriteBase and RewriteEngine land on the context, parse against a
+    // scratch one so they can be replayed on every user of the entry.
+    HttpContext scratch;
+    RewriteRuleList *pList = new RewriteRuleList();
+    if (!pList)
+        return NULL;
+    HtaEntry *pEntry = new HtaEntry;
+    pEntry->m_sContent.setStr(pBuf, len);
+    RewriteRule::setLogger(NULL, TmpLogId::getLogId());
+    char *p = pBuf;
+    if (RewriteEngine::parseRules(p, pList, NULL, &scratch) != 0)
+    {
+        delete pList;
+        delete pEntry;
+        return NULL;
+    }
+
+    pContent->m_pData = pEntry->m_sContent.c_str();
+    pEntry->m_file = *pKey;
+    pEntry->m_content = *pContent;
+    pEntry->m_pList = pList;
+    pEntry->m_iEngine = -1;
+    if (scratch.getConfigBits() & BIT_REWRITE_ENGINE)
+        pEntry->m_iEngine = (scratch.rewriteEnabled() != 0);
+    const AutoStr2 *pBase = scratch.getRewriteBase();
+    if (pBase->len() > 0)
+        pEntry->m_sBase.setStr(pBase->c_str(), pBase->len());
+    pEntry->m_iRef = 0;
+    m_byContent.insert(&pEntry->m_content, pEntry);
+    if (m_byFile.find(&pEntry->m_file) == NULL)
+        m_byFile.insert(&pEntry->m_file, pEntry);
+    return pEntry;
+}
+
+
+/**
+ * Returns the entry for the file at pPath, parsing it only if neither the
+ * same file nor the same content has been seen.  The returned entry is not
+ * referenced yet.  *pStatus tells why there is none.
+ */
+HtaEntry *HtAccessCache::getEntry(const char *pPath, HtaFileKey *pKey,
+                                  int *pStatus)
+{
+    struct stat st;
+    memset(pKey, 0, sizeof(*pKey));
+    *pStatus = HTAC_NONE;
+    int fd = open(pPath, O_RDONLY);
+    if (fd == -1)
+    {
+        if (errno != ENOENT && errno != ENOTDIR)
+            *pStatus = HTAC_ERROR;
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return NULL;
+    }
+    pKey->m_dev = st.st_dev;
+    pKey->m_ino = st.st_ino;
+    pKey->m_mtime = st.st_mtime;
+    pKey->m_ctime = st.st_ctime;
+    pKey->m_size = st.st_size;
+
+    THash<HtaEntry *>::iterator iter = m_byFile.find(pKey);
+    if (iter != NULL)
+    {
+        close(fd);
+        *pStatus = HTAC_FOUND;
+        return iter.second();
+    }
+
+    char *pBuf = new char[st.st_size + 1];
+    int len = 0, ret = 0;
+    while (len < st.st_size
+           && (ret = read(fd, pBuf + len, st.st_size - len)) > 0)
+        len += ret;
+    close(fd);
+    if (ret == -1)
+    {
+        delete []pBuf;
+        *pStatus = HTAC_ERROR;
+        return NULL;
+    }
+    pBuf[len] = 0;
+
+    HtaEntry *pEntry = NULL;
+    if (strcasestr(pBuf, "RewriteFile") != NULL)
+        *pStatus = HTAC_UNSHARED;
+    else
+    {
+        HtaContentKey content;
+        content.m_iHash = XXH64(pBuf, len, 0);
+        content.m_iLen = len;
+        content.m_pData = pBuf;
+        iter = m_byContent.find(&content);
+        if (iter != NULL)
+            pEntry = iter.second();
+        else
+            pEntry = parse(pBuf, len, pKey, &content);
+        *pStatus = pEntry ? HTAC_FOUND : HTAC_ERROR;
+    }
+    delete []pBuf;
+    return pEntry;
+}
+
+
+void HtAccessCache::releaseEntry(HtaEntry *pEntry)
+{
+    if (--pEntry->m_iRef > 0)
+        return;
+    m_byContent.erase(m_byContent.find(&pEntry->m_content));
+    THash<HtaEntry *>::iterator iter = m_byFile.find(&pEntry->m_file);
+    if (iter != NULL && iter.second() == pEntry)
+        m_byFile.erase(iter);
+    delete pEntry->m_pList;
+    delete pEntry;
+}
+
+
+/**
+ * Point the context at pEntry.  Contexts below it that inherited the old
+ * list by pointer are switched over before the old entry is released.
+ */
+void HtAccessCache::applyEntry(HtaUser *pUser, HtaEntry *pEntry)
+{
+    HttpContext *pContext = pUser->m_pContext;
+    HtaEntry *pOld = pUser->m_pEntry;
+    RewriteRuleList *pOldList = pContext->getRewriteRules();
+
+    // settings the file no longer has fall back to the context's own
+    int engine = pUser->m_iOrigEngine;
+    const char *pBase = pUser->m_sOrigBase.c_str();
+    if (pEntry)
+    {
+        ++pEntry->m_iRef;
+        if (pEntry->m_iEngine != -1)
+            engine = pEntry->m_iEngine;
+        if (pEntry->m_sBase.len() > 0)
+            pBase = pEntry->m_sBase.c_str();
+    }
+    pContext->setHtAccessRules(pEntry ? pEntry->m_pList : NULL, engine,
+                               pBase);
+    pUser->m_pEntry = pEntry;
+
+    if (pOldList && pOldList != pContext->getRewriteRules())
+    {
+        ContextNode *pNode = pUser->m_pVHost->getContextTree()->findUriNode(
+                                 pContext->getURI());
+        if (pNode && pNode->getContext() == pContext)
+            pNode->replaceRewriteRules(pOldList, pContext->getRewriteRules());
+    }
+    if (pOld)
+        releaseEntry(pOld);
+}
+
+
+int HtAccessCache::attach(HttpVHost *pVHost, HttpContext *pContext,
+                          const char *pPath)
+{
+    HtaFileKey key;
+    int status;
+    THash<HtaUser *>::iterator iter = m_byContext.find(pContext);
+    if (iter != NULL)
+    {
+        HtaUser *pUser = iter.second();
+        if (strcmp(pUser->m_sPath.c_str(), pPath) == 0)
+        {
+            reload(pUser);
+            return pUser->m_pEntry ? 1 : 0;
+        }
+        // back to the context's own settings before the list goes away
+        applyEntry(pUser, NULL);
+        detach(pContext);
+    }
+    HtaEntry *pEntry = getEntry(pPath, &key, &status);
+    if (!pEntry)
+        return (status == HTAC_NONE) ? 0 : LS_FAIL;
+
+    HtaUser *pUser = new HtaUser;
+    pUser->m_pVHost = pVHost;
+    pUser->m_pContext = pContext;
+    pUser->m_pEntry = NULL;
+    pUser->m_file = key;
+    pUser->m_sPath.setStr(pPath);
+    pUser->m_iOrigEngine = -1;
+    if (pContext->getConfigBits() & BIT_REWRITE_ENGINE)
+        pUser->m_iOrigEngine = (pContext->rewriteEnabled() != 0);
+    if (pContext->hasRewriteBase())
+        pUser->m_sOrigBase.setStr(pContext->getRewriteBase()->c_str());
+    pUser->m_iWd = -1;
+    pUser->m_pNext = NULL;
+    m_byContext.insert(pContext, pUser);
+    applyEntry(pUser, pEntry);
+    addWatch(pUser);
+    LS_DBG_L("[%s] .htaccess %s attached to context %s, %d users, "
+             "%d distinct.", TmpLogId::getLogId(), pPath,
+             pContext->getURI(), pEntry->m_iRef, (int)m_byContent.size());
+    return 1;
+}
+
+
+void HtAccessCache::detach(HttpContext *pContext)
+{
+    THash<HtaUser *>::iterator iter = m_byContext.find(pContext);
+    if (iter == NULL)
+        return;
+    HtaUser *pUser = iter.second();
+    m_byContext.erase(iter);
+    removeWatch(pUser);
+    if (pUser->m_pEntry)
+        releaseEntry(pUser->m_pEntry);
+    delete pUser;
+}
+
+
+void HtAccessCache::addWatch(HtaUser *pUser)
+{
+#ifdef LS_HTA_INOTIFY
+    if (getfd() == -1)
+        return;
+    const char *pPath = pUser->m_sPath.c_str();
+    const char *pSlash = strrchr(pPath, '/');
+    if (!pSlash)
+        return;
+    AutoStr2 dir(pPath, (pSlash == pPath) ? 1 : pSlash - pPath);
+    int wd = inotify_add_watch(getfd(), dir.c_str(), HTA_WATCH_MASK);
+    if (wd == -1)
+    {
+        LS_WARN("[%s] inotify_add_watch(%s) failed: %s, check %s for "
+                "changes every 10 seconds instead.", TmpLogId::getLogId(),
+                dir.c_str(), strerror(errno), pPath);
+        return;
+    }
+    pUser->m_iWd = wd;
+    THash<HtaUser *>::iterator iter = m_byWd.find(wdKey(wd));
+    if (iter != NULL)
+    {
+        pUser->m_pNext = iter.second()->m_pNext;
+        iter.second()->m_pNext = pUser;
+    }
+    else
+    {
+        pUser->m_pNext = NULL;
+        m_byWd.insert(wdKey(wd), pUser);
+    }
+#endif
+}
+
+
+void HtAccessCache::removeWatch(HtaUser *pUser)
+{
+    if (pUser->m_iWd == -1)
+        return;
+    THash<HtaUser *>::iterator iter = m_byWd.find(wdKey(pUser->m_iWd));
+    if (iter == NULL)
+        return;
+    HtaUser *pHead = iter.second();
+    if (pHead == pUser)
+    {
+        if (pUser->m_pNext)
+            m_byWd.update(wdKey(pUser->m_iWd), pUser->m_pNext);
+        else
+        {
+            m_byWd.erase(iter);
+#ifdef LS_HTA_INOTIFY
+            inotify_rm_watch(getfd(), pUser->m_iWd);
+#endif
+        }
+    }
+    else
+    {
+        while (pHead->m_pNext && pHead->m_pNext != pUser)
+            pHead = pHead->m_pNext;
+        if (pHead->m_pNext)
+            pHead->m_pNext = pUser->m_pNext;
+    }
+    pUser->m_iWd = -1;
+    pUser->m_pNext = NULL;
+}
+
+
+void HtAccessCache::dropWatch(int wd)
+{
+    THash<HtaUser *>::iterator iter = m_byWd.find(wdKey(wd));
+    if (iter == NULL)
+        return;
+    HtaUser *pUser = iter.second();
+    m_byWd.erase(iter);
+    while (pUser)
+    {
+        HtaUser *pNext = pUser->m_pNext;
+        pUser->m_iWd = -1;
+        pUser->m_pNext = NULL;
+        pUser = pNext;
+    }
+}
+
+
+void HtAccessCache::reload(HtaUser *pUser)
+{
+    HtaFileKey key;
+    int status;
+    HtaEntry *pEntry = getEntry(pUser->m_sPath.c_str(), &key, &status);
+    if (status == HTAC_UNSHARED)
+    {
+        LS_NOTICE("[%s] .htaccess %s now uses RewriteFile, change takes "
+                  "effect after restart.", TmpLogId::getLogId(),
+                  pUser->m_sPath.c_str());
+        return;
+    }
+    if (status == HTAC_ERROR)
+    {
+        LS_ERROR("[%s] failed to reload .htaccess %s, keep the current "
+                 "rewrite rules of context %s.", TmpLogId::getLogId(),
+                 pUser->m_sPath.c_str(), pUser->m_pContext->getURI());
+        return;
+    }
+    pUser->m_file = key;
+    if (pEntry == pUser->m_pEntry)
+        return;
+    LS_INFO("[%s] .htaccess %s %s, reload rewrite rules of context %s.",
+            TmpLogId::getLogId(), pUser->m_sPath.c_str(),
+            pEntry ? "changed" : "removed", pUser->m_pContext->getURI());
+    applyEntry(pUser, pEntry);
+}
+
+
+void HtAccessCache::onChange(int wd)
+{
+    THash<HtaUser *>::iterator iter = m_byWd.find(wdKey(wd));
+    if (iter == NULL)
+        return;
+    HtaUser *pUser = iter.second();
+    while (pUser)
+    {
+        reload(pUser);
+        pUser = pUser->m_pNext;
+    }
+}
+
+
+static int isSameFile(const HtaFileKey *pKey, const struct stat *pSt)
+{
+    return (pKey->m_dev == pSt->st_dev) && (pKey->m_ino == pSt->st_ino)
+           && (pKey->m_mtime == pSt->st_mtime)
+           && (pKey->m_ctime == pSt->st_ctime)
+           && (pKey->m_size == pSt->st_size);
+}
+
+
+/**
+ * Contexts whose directory could not be watched, or whose watch went away
+ * with the directory, fall back to comparing the file with what was
+ * loaded.
+ */
+void HtAccessCache::recheckUnwatched()
+{
+    struct stat st;
+    THash<HtaUser *>::iterator iter;
+    for (iter = m_byContext.begin(); iter != m_byContext.end();
+         iter = m_byContext.next(iter))
+    {
+        HtaUser *pUser = iter.second();
+        if (pUser->m_iWd != -1)
+            continue;
+        if (stat(pUser->m_sPath.c_str(), &st) == -1)
+        {
+            if (pUser->m_pEntry)
+                reload(pUser);
+        }
+        else if (!isSameFile(&pUser->m_file, &st))
+            reload(pUser);
+    }
+}
+
+
+void HtAccessCache::recheckAll()
+{
+    THash<HtaUser *>::iterator iter;
+    for (iter = m_byContext.begin(); iter != m_byContext.end();
+         iter = m_byContext.next(iter))
+        reload(iter.second());
+}
+
+
+int HtAccessCache::initWatcher(Multiplexer *pMultiplexer)
+{
+#ifdef LS_HTA_INOTIFY
+    if (getfd() != -1)
+        return LS_OK;
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1)
+    {
+        LS_NOTICE("inotify_init1() failed: %s, .htaccess files are "
+                  "checked for changes every 10 seconds.", strerror(errno));
+        return LS_FAIL;
+    }
+    setfd(fd);
+    pMultiplexer->add(this, POLLIN | POLLHUP | POLLERR);
+
+    // contexts configured before fork
+    m_byWd.clear();
+    THash<HtaUser *>::iterator iter;
+    for (iter = m_byContext.begin(); iter != m_byContext.end();
+         iter = m_byContext.next(iter))
+    {
+        iter.second()->m_iWd = -1;
+        addWatch(iter.second());
+    }
+    return LS_OK;
+#else
+    return LS_FAIL;
+#endif
+}
+
+
+int HtAccessCache::handleEvents(short event)
+{
+#ifdef LS_HTA_INOTIFY
+    char achBuf[4096]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+    int len;
+    if (!(event & POLLIN))
+        return LS_OK;
+    while ((len = read(getfd(), achBuf, sizeof(achBuf))) > 0)
+    {
+        const char *p = achBuf;
+        while (p < achBuf + len)
+        {
+            const struct inotify_event *pEvent =
+                (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + pEvent->len;
+            if (pEvent->mask & IN_Q_OVERFLOW)
+                recheckAll();
+            else if (pEvent->mask & IN_IGNORED)
+                dropWatch(pEvent->wd);
+            else if (pEvent->len && strcmp(pEvent->name, ".htaccess") == 0)
+                onChange(pEvent->wd);
+        }
+    }
+#endif
+    return LS_OK;
+}
+
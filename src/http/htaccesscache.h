@@ -0,0 +1,148 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef HTACCESSCACHE_H
+#define HTACCESSCACHE_H
+
+
+#include <lsdef.h>
+#include <edio/eventreactor.h>
+#include <util/autostr.h>
+#include <util/ghash.h>
+#include <util/tsingleton.h>
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+class HttpContext;
+class HttpVHost;
+class Multiplexer;
+class RewriteRuleList;
+
+struct HtaFileKey
+{
+    dev_t       m_dev;
+    ino_t       m_ino;
+    time_t      m_mtime;
+    time_t      m_ctime;
+    off_t       m_size;
+};
+
+struct HtaContentKey
+{
+    uint64_t    m_iHash;
+    int         m_iLen;
+    const char *m_pData;
+};
+
+/**
+ * A parsed .htaccess, shared by every context whose file has the same
+ * content, no matter which vhost it belongs to.
+ */
+struct HtaEntry
+{
+    HtaFileKey          m_file;     // file it was first read from
+    HtaContentKey       m_content;
+    AutoStr2            m_sContent; // file content m_content points to
+    RewriteRuleList    *m_pList;
+    AutoStr2            m_sBase;    // RewriteBase, empty if not given
+    short               m_iEngine;  // RewriteEngine, -1 if not given
+    int                 m_iRef;
+};
+
+/**
+ * A context that got its rules from the cache, chained per watched
+ * directory.
+ */
+struct HtaUser
+{
+    HttpVHost          *m_pVHost;
+    HttpContext        *m_pContext;
+    HtaEntry           *m_pEntry;
+    HtaFileKey          m_file;
+    AutoStr2            m_sPath;
+    AutoStr2            m_sOrigBase;    // context's own RewriteBase
+    short               m_iOrigEngine;  // context's own RewriteEngine
+    int                 m_iWd;
+    HtaUser            *m_pNext;
+};
+
+
+#ifdef RUN_TEST
+namespace SuiteHtAccessCache {
+    class TestReload;
+};
+#endif
+
+class HtAccessCache : public EventReactor, public TSingleton<HtAccessCache>
+{
+    friend class TSingleton<HtAccessCache>;
+#ifdef RUN_TEST
+    friend class SuiteHtAccessCache::TestReload;
+#endif
+
+    THash<HtaEntry *>   m_byFile;
+    THash<HtaEntry *>   m_byContent;
+    THash<HtaUser *>    m_byContext;
+    THash<HtaUser *>    m_byWd;
+
+    HtAccessCache();
+
+    HtaEntry *getEntry(const char *pPath, HtaFileKey *pKey, int *pStatus);
+    HtaEntry *parse(char *pBuf, int len, const HtaFileKey *pKey,
+                    HtaContentKey *pContent);
+    void releaseEntry(HtaEntry *pEntry);
+    void applyEntry(HtaUser *pUser, HtaEntry *pEntry);
+    void addWatch(HtaUser *pUser);
+    void removeWatch(HtaUser *pUser);
+    void dropWatch(int wd);
+    void onChange(int wd);
+    void recheckAll();
+    void reload(HtaUser *pUser);
+
+public:
+    ~HtAccessCache();
+
+    /**
+     * Load the .htaccess at pPath into pContext.  Returns 1 if rules were
+     * attached, 0 if there is no such file, LS_FAIL if the caller should
+     * parse it on its own, which it also does when the file cannot be read
+     * or parsed here, so errors are reported as before.
+     */
+    int attach(HttpVHost *pVHost, HttpContext *pContext, const char *pPath);
+    void detach(HttpContext *pContext);
+
+    /**
+     * Start the inotify watcher, must be called in each worker after fork.
+     */
+    int initWatcher(Multiplexer *pMultiplexer);
+    virtual int handleEvents(short event);
+
+    /**
+     * Called every 10 seconds, stats the files nothing watches.
+     */
+    void recheckUnwatched();
+
+    int getEntryCount() const   {   return m_byContent.size();  }
+    int getUserCount() const    {   return m_byContext.size();  }
+
+    LS_NO_COPY_ASSIGN(HtAccessCache);
+};
+
+LS_SINGLETON_DECL(HtAccessCache);
+
+#endif // HTACCESSCACHE_H
@@ -28,6 +28,7 @@
 #include <http/httpsession.h>
 #include <http/httpstatuscode.h>
 #include <http/httpver.h>
+#include <http/httpvhost.h>
 #include <http/ip2geo.h>
 #include <http/iptoloc.h>
 #include <http/clientinfo.h>
@@ -461,7 +462,45 @@ void HttpCgiTool::buildServerEnv()
 }
 
 
-int HttpCgiTool::buildFcgiEnv(FcgiEnv *pEnv, HttpSession *pSession)
+const char *HttpCgiTool::getFcgiServerEnv(int *len)
+{
+    *len = GISS_ENV_LEN;
+    return GISS_ENV;
+}
+
+
+/**
+ * Python apps do not get DOCUMENT_ROOT, they build the env the old way.
+ */
+const AutoBuf *HttpCgiTool::getLsapiVHostEnv(HttpReq *pReq)
+{
+    if (pReq->isPythonContext())
+        return NULL;
+    return &pReq->getVHost()->getLsapiEnv();
+}
+
+
+const AutoBuf *HttpCgiTool::getFcgiVHostEnv(HttpReq *pReq)
+{
+    if (pReq->isPythonContext())
+        return NULL;
+    return &pReq->getVHost()->getFcgiEnv();
+}
+
+
+const ServerAddrInfo *HttpCgiTool::getServerAddrInfo(HttpSession *pSession)
+{
+    return pSession->getStream()->getConnInfo()->m_pServerAddrInfo;
+}
+
+
+/**
+ * GATEWAY_INTERFACE, SERVER_SOFTWARE and, with vhostEnv or addrEnv set,
+ * the vhost or listener template are not added here, the caller sends
+ * the pre-encoded blobs.
+ */
+int HttpCgiTool::buildFcgiEnv(FcgiEnv *pEnv, HttpSession *pSession,
+                              int vhostEnv, int addrEnv)
 {
     static const char *SP_ENVs[] =
     {
@@ -491,7 +530,6 @@ int HttpCgiTool::buildFcgiEnv(FcgiEnv *pEnv, HttpSession *pSession)
     HttpReq *pReq = pSession->getReq();
     int n;
 
-    pEnv->add(GISS_ENV, GISS_ENV_LEN);
     n = pReq->getVersion();
     pEnv->add(SP_ENVs[n], 25);
     n = pReq->getMethod();
@@ -502,7 +540,7 @@ int HttpCgiTool::buildFcgiEnv(FcgiEnv *pEnv, HttpSession *pSession)
                   HttpMethod::getLen(n));
 
     addSpecialEnv(pEnv, pReq);
-    buildCommonEnv(pEnv, pSession);
+    buildCommonEnv(pEnv, pSession, vhostEnv, addrEnv);
     addHttpHeaderEnv(pEnv, pReq);
     return 0;
 }
@@ -532,7 +570,8 @@ static int addEnv(void *pObj, void *pUData, const char *pKey, int iKeyLen)
 }
 
 
-int HttpCgiTool::buildCommonEnv(IEnv *pEnv, HttpSession *pSession)
+int HttpCgiTool::buildCommonEnv(IEnv *pEnv, HttpSession *pSession,
+                                int vhostEnv, int addrEnv)
 {
     int count = 0;
     HttpReq *pReq = pSession->getReq();
@@ -553,7 +592,7 @@ int HttpCgiTool::buildCommonEnv(IEnv *pEnv, HttpSession *pSession)
     //ADD_ENV("REMOTE_IDENT", "" )        //TODO: not supported yet
     //extensions of CGI/1.1
     const AutoStr2 *pStr = pReq->getDocRoot();
-    if (!isPython)
+    if (!isPython && !vhostEnv)
         pEnv->add("DOCUMENT_ROOT", 13,
                   pStr->c_str(), pStr->len() - 1);
 
@@ -564,15 +603,18 @@ int HttpCgiTool::buildCommonEnv(IEnv *pEnv, HttpSession *pSession)
     n = ls_snprintf(buf, 10, "%hu", pSession->getRemotePort());
     pEnv->add("REMOTE_PORT", 11, buf, n);
 
-    n = pSession->getServerAddrStr(buf, 128);
-
-    pEnv->add("SERVER_ADDR", 11, buf, n);
+    if (!addrEnv)
+    {
+        n = pSession->getServerAddrStr(buf, 128);
+        pEnv->add("SERVER_ADDR", 11, buf, n);
+        ++count;
+    }
 
     pEnv->add("SERVER_NAME", 11, pReq->getHostStr(),  pReq->getHostStrLen());
-    count += 5 - isPython;
+    count += 3 + (!isPython && !vhostEnv);
 
     pStr = pReq->getVHost()->getAdminEmails();
-    if (pStr->c_str())
+    if (!vhostEnv && pStr->c_str())
     {
         pEnv->add("SERVER_ADMIN", 12, pStr->c_str(), pStr->len());
         ++count;
@@ -580,12 +622,16 @@ int HttpCgiTool::buildCommonEnv(IEnv *pEnv, HttpSession *pSession)
 
 
     char *pBuf = buf;
-    n = RequestVars::getReqVar(pSession, REF_SERVER_PORT, pBuf, 128);
-    pEnv->add("SERVER_PORT", 11, pBuf, n);
+    if (!addrEnv)
+    {
+        n = RequestVars::getReqVar(pSession, REF_SERVER_PORT, pBuf, 128);
+        pEnv->add("SERVER_PORT", 11, pBuf, n);
+        ++count;
+    }
 
     pEnv->add("REQUEST_URI", 11, pReq->getOrgReqURL(),
               pReq->getOrgReqURLLen());
-    count += 2;
+    ++count;
 
     n = pReq->getPathInfoLen();
     if (n > 0)
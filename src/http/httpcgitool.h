@@ -19,6 +19,7 @@
 #define HTTPCGITOOL_H
 
 
+class AutoBuf;
 class HttpResp;
 class HttpReq;
 class HttpSession;
@@ -26,6 +27,7 @@ class HttpExtConnector;
 class FcgiEnv;
 class Env;
 class IEnv;
+class ServerAddrInfo;
 
 class HttpCgiTool
 {
@@ -53,9 +55,18 @@ public:
     static int parseRespHeader(HttpExtConnector *pExtConn,
                                const char *pBuf, int size);
     static int buildEnv(IEnv *pEnv, HttpSession *pSession);
-    static int buildFcgiEnv(FcgiEnv *pEnv, HttpSession *pSession);
+    static int buildFcgiEnv(FcgiEnv *pEnv, HttpSession *pSession,
+                            int vhostEnv, int addrEnv);
     static void buildServerEnv();
-    static int buildCommonEnv(IEnv *pEnv, HttpSession *pSession);
+    static const char *getFcgiServerEnv(int *len);
+    static int buildCommonEnv(IEnv *pEnv, HttpSession *pSession,
+                              int vhostEnv = 0, int addrEnv = 0);
+
+    // The per vhost env template, NULL if the request cannot use it
+    static const AutoBuf *getLsapiVHostEnv(HttpReq *pReq);
+    static const AutoBuf *getFcgiVHostEnv(HttpReq *pReq);
+    // Owner of the listener env template, NULL if the session has none
+    static const ServerAddrInfo *getServerAddrInfo(HttpSession *pSession);
 
 };
 
@@ -21,6 +21,7 @@
 #include <http/contextlist.h>
 #include <http/handlerfactory.h>
 #include <http/handlertype.h>
+#include <http/htaccesscache.h>
 #include <http/htauth.h>
 #include <http/httplog.h>
 #include <http/httpmime.h>
@@ -155,7 +156,9 @@ int HttpContext::setHeaderOps(const char *pLogId, const char *pHeaders,
 
 void HttpContext::releaseHTAConf()
 {
-    if ((m_pRewriteRules) && (m_iConfigBits & BIT_REWRITE_RULE))
+    if (m_iConfigBits2 & BIT2_HTA_CACHED)
+        HtAccessCache::getInstance().detach(this);
+    else if ((m_pRewriteRules) && (m_iConfigBits & BIT_REWRITE_RULE))
         delete m_pRewriteRules;
     if ((m_iConfigBits & BIT_CTXINT))
     {
@@ -1313,6 +1316,43 @@ int HttpContext::configRewriteRule(const RewriteMapList *pMapList,
 }
 
 
+/**
+ * Rules from the shared .htaccess cache, the list is owned by the cache.
+ * A NULL list means the file is gone, fall back to the inherited rules.
+ * An engine of -1 or an empty base are inherited as if never set.
+ */
+void HttpContext::setHtAccessRules(RewriteRuleList *pList, int engine,
+                                   const char *pBase)
+{
+    m_iConfigBits2 |= BIT2_HTA_CACHED;
+    if (engine != -1)
+        enableRewrite(engine);
+    else
+    {
+        m_iConfigBits &= ~BIT_REWRITE_ENGINE;
+        if (m_pParent)
+            m_iRewriteEtag = (m_iRewriteEtag & ~REWRITE_MASK)
+                | ((m_pParent->m_iRewriteEtag | REWRITE_INHERIT) & REWRITE_MASK);
+    }
+    if (pBase && *pBase)
+        setRewriteBase(pBase);
+    else if (m_pRewriteBase)
+    {
+        delete m_pRewriteBase;
+        m_pRewriteBase = NULL;
+    }
+    if (pList)
+        setRewriteRules(pList);
+    else
+    {
+        m_iConfigBits &= ~BIT_REWRITE_RULE;
+        m_pRewriteRules = NULL;
+        if ((m_iConfigBits & BIT_REWRITE_INHERIT) && m_pParent)
+            m_pRewriteRules = getValidRewriteRules(m_pParent);
+    }
+}
+
+
 int HttpContext::configMime(const XmlNode *pContextNode)
 {
     const char *pValue = pContextNode->getChildValue("addMIMEType");
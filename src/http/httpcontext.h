@@ -139,6 +139,7 @@ class HttpHeaderOps;
 #define BIT2_OPTIONS_SET        (1<<7)
 
 #define BIT2_URI_CACHEABLE      (1<<8)
+#define BIT2_HTA_CACHED         (1<<9)
 #define BIT2_IS_FILESMATCH_CTX  (1<<11)
 #define BIT2_FILES_ETAG         (1<<12)
 
@@ -409,6 +410,7 @@ public:
 
     const AutoStr2 *getRewriteBase() const
     {   return (m_pRewriteBase) ? m_pRewriteBase : &m_sContextURI;  }
+    bool hasRewriteBase() const     {   return m_pRewriteBase != NULL;  }
     void setRewriteBase(const char *p);
 
     void enableRewrite(int a)
@@ -430,6 +432,10 @@ public:
         m_pRewriteRules = pList;
         m_iConfigBits |= BIT_REWRITE_RULE;
     }
+    void setInheritedRewriteRules(RewriteRuleList *pList)
+    {   m_pRewriteRules = pList;                    }
+    void setHtAccessRules(RewriteRuleList *pList, int engine,
+                          const char *pBase);
 
     PHPConfig *getPHPConfig() const
     {   return m_pInternal->m_pPHPConfig;    }
@@ -28,6 +28,7 @@
 #include <http/httpstatuscode.h>
 #include <http/stderrlogger.h>
 #include <log4cxx/logger.h>
+#include <util/datetime.h>
 #include <util/gzipbuf.h>
 #include <util/vmembuf.h>
 
@@ -180,6 +181,12 @@ int HttpExtConnector::parseHeader(const char *&pBuf, int &len, int proxy)
 
 int  HttpExtConnector::respHeaderDone()
 {
+    if (m_pWorker && getAssignTime())
+    {
+        m_pWorker->addLatencySample(DateTime::getCurTimeInUs()
+                                    - getAssignTime());
+        setAssignTime(0);
+    }
     m_pSession->testContentType();
     int ret = m_pSession->respHeaderDone();
     if (m_iRespState & HEC_RESP_AUTHORIZED)
@@ -434,6 +441,7 @@ int HttpExtConnector::process(HttpSession *pSession,
         setWorker((ExtWorker *)pHandler);
     }
     m_iState = HEC_BEGIN_REQUEST;
+    setAssignTime(DateTime::getCurTimeInUs());
 
     if (getWorker() == NULL)
     {
@@ -501,6 +509,7 @@ int  HttpExtConnector::tryRecover()
             }
             if (m_pWorker)
             {
+                setAssignTime(DateTime::getCurTimeInUs());
                 int ret = m_pWorker->processRequest(this, 1);
                 if ((ret == 0) || (ret == 1))
                     return 0;
@@ -287,10 +287,45 @@ size_t HttpHeader::getIndex2(const char *pHeader)
 }
 
 
+/**
+ * Perfect hash over the request headers getIndex() knows about:
+ * ((first | 0x20) + (last | 0x20) * 3 + len * 18) & 63 is collision free
+ * for them, so a lookup is one table read plus one strncasecmp().
+ * 0xff marks an empty slot.
+ */
+static const unsigned char s_reqHeaderHash[64] =
+{
+    0xff, 0xff, 0xff, 0xff, 0xff,   13,   12, 0xff,
+    0xff, 0xff,   15,   17,   10, 0xff,   20,   23,
+    0xff,   14, 0xff, 0xff, 0xff,    4, 0xff,    7,
+    0xff, 0xff, 0xff,   24,   22, 0xff,    3, 0xff,
+    0xff,    5, 0xff, 0xff,    2, 0xff, 0xff, 0xff,
+      18,    0,    6, 0xff, 0xff, 0xff,   19, 0xff,
+    0xff,   16, 0xff, 0xff, 0xff, 0xff, 0xff,    9,
+    0xff,    1, 0xff,   21, 0xff, 0xff,    8,   11,
+};
+
+
+static const char *const s_pReqHeaderNames[HttpHeader::H_TE] =
+{
+    "accept", "accept-charset", "accept-encoding", "accept-language",
+    "authorization", "connection", "content-type", "content-length",
+    "cookie", "cookie2", "host", "pragma", "referer", "user-agent",
+    "cache-control", "if-modified-since", "if-match", "if-none-match",
+    "if-range", "if-unmodified-since", "keep-alive", "range",
+    "x-forwarded-for", "via", "transfer-encoding",
+};
+
+
 size_t HttpHeader::getIndex(const char *pHeader, int len)
 {
-    size_t idx = getIndex(pHeader);
-    if (idx < H_HEADER_END && getHeaderStringLen(idx) == len)
+    if (len < 3 || len > 19)
+        return H_HEADER_END;
+    size_t idx = s_reqHeaderHash[((*pHeader | 0x20)
+                                  + (pHeader[len - 1] | 0x20) * 3
+                                  + len * 18) & 63];
+    if (idx < H_TE && s_iHeaderLen[idx] == len
+        && strncasecmp(pHeader, s_pReqHeaderNames[idx], len) == 0)
         return idx;
     return H_HEADER_END;
 }
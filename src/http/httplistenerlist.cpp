@@ -16,7 +16,10 @@
 *    along with this program. If not, see http://www.gnu.org/licenses/.      *
 *****************************************************************************/
 #include "httplistenerlist.h"
+#include <extensions/fcgi/fcgienv.h>
+#include <extensions/lsapi/lsapireq.h>
 #include <http/httplistener.h>
+#include <http/httpserverversion.h>
 #include <http/vhostmap.h>
 #include <log4cxx/logger.h>
 
@@ -400,10 +403,35 @@ int ServerAddrInfo::init(const struct sockaddr *pAddr)
     memmove(m_serverAddr, pAddr, (pAddr->sa_family == PF_INET) ? 16 : 28);
     GSockAddr::ntop(pAddr, (char *)achBuf, 128);
     m_serverAddrStr.setStr(achBuf);
+    buildEnvTemplate();
     return 0;
 }
 
 
+/**
+ * The local address and port never change for a given ServerAddrInfo,
+ * FastCGI gets SERVER_SOFTWARE from the static server env instead.
+ */
+void ServerAddrInfo::buildEnvTemplate()
+{
+    char achPort[20];
+    int portLen = snprintf(achPort, sizeof(achPort), "%u",
+                           (unsigned)GSockAddr::getPort(getAddr()));
+    m_lsapiEnv.clear();
+    m_fcgiEnv.clear();
+    LsapiReq::addEnv(&m_lsapiEnv, "SERVER_SOFTWARE", 15,
+                     HttpServerVersion::getVersion(),
+                     HttpServerVersion::getVersionLen());
+    LsapiReq::addEnv(&m_lsapiEnv, "SERVER_ADDR", 11,
+                     m_serverAddrStr.c_str(), m_serverAddrStr.len());
+    FcgiEnv::addEnv(&m_fcgiEnv, "SERVER_ADDR", 11,
+                    m_serverAddrStr.c_str(), m_serverAddrStr.len());
+    LsapiReq::addEnv(&m_lsapiEnv, "SERVER_PORT", 11, achPort, portLen);
+    FcgiEnv::addEnv(&m_fcgiEnv, "SERVER_PORT", 11, achPort, portLen);
+    m_iEnvCount = 3;
+}
+
+
 hash_key_t ServerAddrInfo::hasher(const void *pAddr)
 {
     return XXH64(pAddr,
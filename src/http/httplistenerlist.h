@@ -19,13 +19,13 @@
 #define HTTPLISTENERLIST_H
 
 
+#include <util/autobuf.h>
 #include <util/hashstringmap.h>
 #include <util/gpointerlist.h>
 #include <util/tsingleton.h>
 
 class HttpListener;
 class HttpVHost;
-class AutoBuf;
 //class SocketListener;
 class HttpVHost;
 class GSockAddr;
@@ -66,7 +66,8 @@ class ServerAddrInfo
 {
 public:
     ServerAddrInfo()
-        :m_pVHostMap(NULL)
+        : m_pVHostMap(NULL)
+        , m_iEnvCount(0)
         {}
     ~ServerAddrInfo()       {}
 
@@ -78,6 +79,11 @@ public:
 
     void setVHostMap(const VHostMap *pMap)  {   m_pVHostMap = pMap;     }
 
+    // SERVER_ADDR and SERVER_PORT, plus SERVER_SOFTWARE for LSAPI
+    const AutoBuf &getLsapiEnv() const  {   return m_lsapiEnv;      }
+    const AutoBuf &getFcgiEnv() const   {   return m_fcgiEnv;       }
+    int getEnvCount() const             {   return m_iEnvCount;     }
+
     static hash_key_t hasher(const void *pAddr);
     static int value_cmp(const void *v1, const void *v2);
 
@@ -86,6 +92,13 @@ private:
     AutoStr2            m_serverAddrStr;
     //const HttpListener *m_pListener;
     const VHostMap     *m_pVHostMap;
+    AutoBuf             m_lsapiEnv;
+    AutoBuf             m_fcgiEnv;
+    int                 m_iEnvCount;
+
+    void buildEnvTemplate();
+    ServerAddrInfo(const ServerAddrInfo &rhs);
+    void operator=(const ServerAddrInfo &rhs);
 };
 
 
@@ -174,6 +174,9 @@ int HttpLogSource::initAccessLog(const XmlNode *pNode,
         if (pValue)
             pLog->accessLogAgent(atoi(pValue));
 
+        pLog->setBinaryLog(ConfigCtx::getCurConfigCtx()->getLongValue(pNode,
+                           "logBinary", 0, 1, 0));
+
         pValue = pNode->getChildValue("rollingSize");
 
         if (pValue)
@@ -0,0 +1,177 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "httppriority.h"
+
+#include <h2/unpackedheaders.h>
+#include <http/hiostream.h>
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+
+struct MimePriority
+{
+    const char *m_pType;
+    int         m_iLen;
+    int         m_iUrgency;
+    int         m_iIncremental;
+};
+
+// A type ending with '/' or '-' matches as a prefix.
+static const MimePriority s_mimePriority[] =
+{
+    { "text/html",                  9,  HIO_PRIORITY_HTML,      0 },
+    { "application/xhtml+xml",      21, HIO_PRIORITY_HTML,      0 },
+    { "text/css",                   8,  HIO_PRIORITY_CSS,       0 },
+    { "font/",                      5,  HIO_PRIORITY_CSS,       0 },
+    { "application/font-",          17, HIO_PRIORITY_CSS,       0 },
+    { "text/javascript",            15, HIO_PRIORITY_JS,        0 },
+    { "application/javascript",     22, HIO_PRIORITY_JS,        0 },
+    { "application/x-javascript",   24, HIO_PRIORITY_JS,        0 },
+    { "image/",                     6,  HIO_PRIORITY_IMAGE,     1 },
+    { "video/",                     6,  HIO_PRIORITY_DOWNLOAD,  1 },
+    { "audio/",                     6,  HIO_PRIORITY_DOWNLOAD,  1 },
+    { "application/octet-stream",   24, HIO_PRIORITY_DOWNLOAD,  1 },
+    { "application/zip",            15, HIO_PRIORITY_DOWNLOAD,  1 },
+};
+
+
+static const char *skipOws(const char *p, const char *pEnd)
+{
+    while (p < pEnd && (*p == ' ' || *p == '\t'))
+        ++p;
+    return p;
+}
+
+
+// Skip "=value" of a dictionary member or parameter, honoring quoting.
+static const char *skipValue(const char *p, const char *pEnd)
+{
+    if (p < pEnd && *p == '=')
+        ++p;
+    if (p < pEnd && *p == '"')
+    {
+        for (++p; p < pEnd && *p != '"'; ++p)
+        {
+            if (*p == '\\' && p + 1 < pEnd)
+                ++p;
+        }
+        if (p < pEnd)
+            ++p;
+    }
+    while (p < pEnd && *p != ';' && *p != ',')
+        ++p;
+    return p;
+}
+
+
+int HttpPriority::parse(const char *pValue, int len, int *urgency,
+                        int *incremental)
+{
+    const char *p = pValue;
+    const char *pEnd = pValue + len;
+    const char *pKey;
+    int found = 0;
+    while (p < pEnd)
+    {
+        p = skipOws(p, pEnd);
+        pKey = p;
+        while (p < pEnd && (islower(*p) || isdigit(*p) || *p == '_'
+                            || *p == '-' || *p == '.' || *p == '*'))
+            ++p;
+        if (p - pKey == 1 && *pKey == 'u')
+        {
+            if (pEnd - p >= 2 && *p == '=' && isdigit(p[1])
+                && (pEnd - p == 2 || !isdigit(p[2])))
+            {
+                // Out of range urgency is ignored, RFC 9218 section 4.1.
+                if (p[1] - '0' <= HIO_PRIORITY_LOWEST)
+                {
+                    *urgency = p[1] - '0';
+                    found = 1;
+                }
+            }
+        }
+        else if (p - pKey == 1 && *pKey == 'i')
+        {
+            if (p == pEnd || *p != '=')
+            {
+                *incremental = 1;
+                found = 1;
+            }
+            else if (pEnd - p >= 3 && p[1] == '?'
+                     && (p[2] == '0' || p[2] == '1'))
+            {
+                *incremental = p[2] - '0';
+                found = 1;
+            }
+        }
+        p = skipValue(p, pEnd);
+        while (p < pEnd && *p == ';')
+            p = skipValue(p + 1, pEnd);
+        if (p < pEnd)
+            ++p;
+    }
+    return found ? LS_OK : LS_FAIL;
+}
+
+
+int HttpPriority::parseReqHeaders(const UnpackedHeaders *pHeaders,
+                                  int *urgency, int *incremental)
+{
+    const char *pBuf = pHeaders->getBuf()->begin();
+    const lsxpack_header *p = pHeaders->req_hdr_begin();
+    const lsxpack_header *pEnd = pHeaders->end();
+    int ret = LS_FAIL;
+    for (; p < pEnd; ++p)
+    {
+        // An empty field still means "use the defaults".
+        if (p->name_len == 8
+            && strncasecmp(pBuf + p->name_offset, "priority", 8) == 0)
+        {
+            parse(pBuf + p->val_offset, p->val_len, urgency, incremental);
+            ret = LS_OK;
+        }
+    }
+    return ret;
+}
+
+
+int HttpPriority::getMimeUrgency(const char *pMime, int len,
+                                 int *incremental)
+{
+    const MimePriority *p = s_mimePriority;
+    const MimePriority *pEnd = p + sizeof(s_mimePriority)
+                                   / sizeof(s_mimePriority[0]);
+    if (!pMime)
+        return -1;
+    for (; p < pEnd; ++p)
+    {
+        if (len < p->m_iLen || strncasecmp(pMime, p->m_pType, p->m_iLen) != 0)
+            continue;
+        char last = p->m_pType[p->m_iLen - 1];
+        if (last != '/' && last != '-' && len > p->m_iLen
+            && pMime[p->m_iLen] != ';' && pMime[p->m_iLen] != ' ')
+            continue;
+        *incremental = p->m_iIncremental;
+        return p->m_iUrgency;
+    }
+    return -1;
+}
+
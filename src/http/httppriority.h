@@ -0,0 +1,55 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef HTTPPRIORITY_H
+#define HTTPPRIORITY_H
+
+#include <lsdef.h>
+
+class UnpackedHeaders;
+
+/**
+ * RFC 9218 extensible priorities, shared by HTTP/2 and HTTP/3 streams.
+ * Urgency uses the HIO_PRIORITY_* scale, 0 is the most urgent.
+ */
+class HttpPriority
+{
+    HttpPriority();
+    ~HttpPriority();
+    HttpPriority(const HttpPriority &rhs);
+    void operator=(const HttpPriority &rhs);
+public:
+    /**
+     * Parse a Priority Field Value such as "u=1, i".  Parameters not
+     * present leave *urgency / *incremental unchanged.
+     * Returns LS_OK if any known parameter was found.
+     */
+    static int parse(const char *pValue, int len, int *urgency,
+                     int *incremental);
+
+    // Look for the "priority" request header.
+    static int parseReqHeaders(const UnpackedHeaders *pHeaders,
+                               int *urgency, int *incremental);
+
+    /**
+     * Server side default for a response without a client signal,
+     * returns -1 if the content type should keep the default urgency.
+     */
+    static int getMimeUrgency(const char *pMime, int len, int *incremental);
+};
+
+#endif // HTTPPRIORITY_H
@@ -20,6 +20,7 @@
 #include <http/accesscache.h>
 #include <http/denieddir.h>
 #include <http/handlertype.h>
+#include <http/headerscanner.h>
 #include <http/hotlinkctrl.h>
 #include <http/htauth.h>
 #include <http/httpcontext.h>
@@ -825,16 +826,16 @@ int HttpReq::processHeaderLines()
     const char *pLineBegin  = m_headerBuf.begin() + m_iReqHeaderBufFinished;
     const char *pTemp = NULL;
     const char *pTemp1 = NULL;
+    const char *pNameEnd;
     key_value_pair *pCurHeader = NULL;
     bool headerfinished = false;
     int index;
     int ret = 0;
 
     m_upgradeProto = UPD_PROTO_NONE; //0;
-    while ((pLineEnd  = (const char *)memchr(pLineBegin, '\n',
-                        pBEnd - pLineBegin)) != NULL)
+    while ((pLineEnd = HeaderScanner::findLine(pLineBegin, pBEnd, &pMark))
+           != NULL)
     {
-        pMark = (const char *)memchr(pLineBegin, ':', pLineEnd - pLineBegin);
         if (pMark != NULL)
         {
             while (1)
@@ -867,8 +868,19 @@ int HttpReq::processHeaderLines()
                         "CVE-2014-7169 signature detected in request header!");
                 return SC_400;
             }
-            index = HttpHeader::getIndex2(pLineBegin);
-            if (index < HttpHeader::H_TE)
+            pNameEnd = skipSpace(pMark, pLineBegin);
+            if (HeaderScanner::isToken(pLineBegin, pNameEnd))
+                index = HttpHeader::getIndex(pLineBegin, pNameEnd - pLineBegin);
+            else
+            {
+                LS_DBG_L(getLogSession(), "Ignore request header with "
+                         "invalid name: %.*s", (int)(pMark - pLineBegin),
+                         pLineBegin);
+                index = -1;
+            }
+            if (index < 0)
+                ret = 0;
+            else if (index < HttpHeader::H_TE)
             {
                 m_commonHeaderLen[ index ] = pTemp1 - pTemp;
                 m_commonHeaderOffset[index] = pTemp - m_headerBuf.begin();
@@ -878,7 +890,7 @@ int HttpReq::processHeaderLines()
             {
                 pCurHeader = newUnknownHeader();
                 pCurHeader->keyOff = pLineBegin - m_headerBuf.begin();
-                pCurHeader->keyLen = skipSpace(pMark, pLineBegin) - pLineBegin;
+                pCurHeader->keyLen = pNameEnd - pLineBegin;
                 pCurHeader->valOff = pTemp - m_headerBuf.begin();
                 pCurHeader->valLen = pTemp1 - pTemp;
                 ret = processUnknownHeader(pCurHeader, pLineBegin, pTemp);
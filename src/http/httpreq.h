@@ -257,6 +257,7 @@ private:
 
     unsigned short      m_ver;
     short               m_iRedirects;
+    short               m_iRewriteReplay;
 
     char                m_iReqFlag;
     char                 m_iAcceptGzip;
@@ -729,6 +730,8 @@ public:
     void incRedirects()                     {   ++m_iRedirects;             }
     short getRedirects() const              {   return m_iRedirects;        }
     void clearRedirects()                   {   m_iRedirects = 0;           }
+    void setRewriteReplay(short n)          {   m_iRewriteReplay = n;       }
+    short getRewriteReplay() const          {   return m_iRewriteReplay;    }
 
     void orContextState(int s)            {   m_iContextState |= s;       }
     void clearContextState(int s)         {   m_iContextState &= ~s;      }
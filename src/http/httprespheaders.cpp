@@ -27,6 +27,7 @@
 #include <h2/unpackedheaders.h>
 #include <http/httpcgitool.h>
 #include <lsqpack.h>
+#include <lsr/xxhash.h>
 
 #include <ctype.h>
 
@@ -1713,6 +1714,43 @@ void HttpRespHeaders::prepareSendHpack()
 }
 
 
+bool HttpRespHeaders::isVolatileHpack(const lsxpack_header *hdr)
+{
+    switch(hdr->hpack_index)
+    {
+    case LSHPACK_HDR_AGE:
+    case LSHPACK_HDR_CONTENT_LENGTH:
+    case LSHPACK_HDR_CONTENT_RANGE:
+    case LSHPACK_HDR_DATE:
+    case LSHPACK_HDR_ETAG:
+    case LSHPACK_HDR_EXPIRES:
+    case LSHPACK_HDR_LAST_MODIFIED:
+    case LSHPACK_HDR_SET_COOKIE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+uint64_t HttpRespHeaders::getStableHpackHash(int *count) const
+{
+    uint64_t hash = 0;
+    int n = 0;
+    const lsxpack_header *hdr = begin() + 1;
+    for(; hdr < end(); ++hdr)
+    {
+        if (!hdr->buf || isVolatileHpack(hdr))
+            continue;
+        hash = XXH64(lsxpack_header_get_name(hdr), hdr->name_len, hash);
+        hash = XXH64(lsxpack_header_get_value(hdr), hdr->val_len, hash);
+        ++n;
+    }
+    *count = n;
+    return hash;
+}
+
+
 static const int hpack2appresp[LSHPACK_MAX_INDEX] = {
     UPK_HDR_UNKNOWN,                           //":authority"
     UPK_HDR_METHOD,                            //":method"
@@ -127,6 +127,18 @@ public:
     void prepareSendQpack();
     void prepareSendHpack();
 
+    /**
+     * Volatile headers change from one response of a resource to the next,
+     * Date, ETag, Content-Length and the like. Valid after prepareSendHpack().
+     */
+    static bool isVolatileHpack(const lsxpack_header *hdr);
+
+    /**
+     * Fingerprint of the non-volatile headers except :status, in order,
+     * *count is set to the number of them. Valid after prepareSendHpack().
+     */
+    uint64_t getStableHpackHash(int *count) const;
+
     int add(INDEX headerIndex, const char *pVal, unsigned int valLen,
             int method = LSI_HEADER_SET);
     int add(INDEX headerIndex, const char *pName, unsigned int nameLen,
@@ -1775,6 +1775,8 @@ int HttpSession::processVHostRewrite()
             setProcessState(HSPS_DROP_CONNECTION);
             return 0;
         }
+        if (ret == REWRITE_PENDING)
+            return LSI_SUSPEND;
         if (ret == -3)      //rewrite happens
         {
             m_request.postRewriteProcess(
@@ -2075,6 +2077,8 @@ int HttpSession::processContextRewrite()
         setProcessState(HSPS_DROP_CONNECTION);
         return 0;
     }
+    if (ret == REWRITE_PENDING)
+        return LSI_SUSPEND;
     if (ret == -3)
     {
         ret = 0;
@@ -2394,7 +2398,7 @@ int HttpSession::handlerProcess(const HttpHandler *pHandler)
     ThrottleControl *pTC = &getClientInfo()->getThrottleCtrl();
     if ((getClientInfo()->getAccess() == AC_TRUST)
         || (getVHostAccess() == AC_TRUST)
-        || (pTC->allowProcess(dyn)))
+        || (getClientInfo()->allowProcess(dyn)))
     {
     }
     else
@@ -2431,7 +2435,7 @@ int HttpSession::handlerProcess(const HttpHandler *pHandler)
         return ret;
 
     setState(HSS_PROCESSING);
-    pTC->incReqProcessed( dyn );
+    getClientInfo()->incReqProcessed( dyn );
     ret = m_pHandler->process(this, m_request.getHttpHandler());
 
     if (ret == 1)
@@ -3363,11 +3367,11 @@ int HttpSession::detectKeepAliveTimeout(int delta)
             c = 1;
 
         }
-        else if ((int)getClientInfo()->getConns() >
+        else if ((int)getClientInfo()->getTotalConns() >
                  ClientInfo::getPerClientSoftLimit())
         {
             LS_DBG_M(getLogSession(), "Number of connections: %d is over the soft "
-                     "limit: %d, close conn!", (int)getClientInfo()->getConns(),
+                     "limit: %d, close conn!", (int)getClientInfo()->getTotalConns(),
                      ClientInfo::getPerClientSoftLimit()
                     );
             c = 1;
@@ -3469,6 +3473,28 @@ int HttpSession::detectTimeout()
 }
 
 
+/**
+ * An idle keep-alive connection only needs to wake up for its deadline,
+ * unless it is already a candidate for early close.
+ */
+int HttpSession::getTimerDelay()
+{
+    if (getState() != HSS_WAITING || m_pHandler)
+        return 1;
+    const HttpServerConfig &config = HttpServerConfig::getInstance();
+    int remain = config.getKeepAliveTimeout()
+                 - (DateTime::s_curTime - m_lReqTime);
+    if (remain <= 1)
+        return 1;
+    if ((m_iReqServed != 0)
+        && (ConnLimitCtrl::getInstance().getConnOverflow()
+            || (int)getClientInfo()->getTotalConns() >
+               ClientInfo::getPerClientSoftLimit()))
+        return 1;
+    return remain;
+}
+
+
 int HttpSession::onTimerEx()
 {
     if (getClientInfo())
@@ -5090,7 +5116,11 @@ int HttpSession::sendStaticFileEx(SendFileInfo *pData)
 #if !defined( NO_SENDFILE )
     int fd = pData->getfd();
     int iModeSF = HttpServerConfig::getInstance().getUseSendfile();
-    if (iModeSF && fd != -1 && !isHttps() && !getStream()->isSpdy()
+    if (iModeSF && fd != -1
+        && (!isHttps() || getStream()->isSendfileAvail())
+        && (!getStream()->isSpdy()
+            || (getStream()->isHttp2() && iModeSF == 1
+                && getStream()->isSendfileAvail()))
         && (!getGzipBuf() ||
             (pData->getECache() == pData->getFileData()->getGzip())))
     {
@@ -5101,8 +5131,11 @@ int HttpSession::sendStaticFileEx(SendFileInfo *pData)
         if (remain > SSIZE_MAX)
             remain = SSIZE_MAX;
 
+        //An H2 stream ends the stream on EOR, leave that to shutdown() as
+        //more body may follow, e.g. the next part of a multi-range reply.
         len = writeRespBodySendFile(fd, pData->getCurPos(), remain,
-                                    pData->getRemain() <= remain);
+                                    !getStream()->isSpdy()
+                                    && pData->getRemain() <= remain);
         LS_DBG_M(getLogSession(), "writeRespBodySendFile() write %ld returned %zd.",
                  remain, len);
         if (len > 0)
@@ -5865,6 +5898,11 @@ int HttpSession::resumeProcess(int passCode, int retcode)
         m_curHookRet = retcode;
         smProcessReq();
         break;
+    case HSPS_VHOST_REWRITE:
+    case HSPS_CONTEXT_REWRITE:
+        //a rewrite map answer came in, run the rule set again
+        smProcessReq();
+        break;
     case HSPS_BEGIN_HANDLER_PROCESS:
         break;
 
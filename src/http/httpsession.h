@@ -595,6 +595,7 @@ public:
                      const char *uploadTmpDir, int uploadTmpFilePermission);
 
     int  onTimerEx();
+    int  getTimerDelay();
 
     //void accessGranted()    {   m_accessGranted = 1;  }
     void changeHandler() {    setState(HSS_REDIRECT); };
@@ -24,6 +24,7 @@
 #include <http/handlerfactory.h>
 #include <http/handlertype.h>
 #include <http/hotlinkctrl.h>
+#include <http/htaccesscache.h>
 #include <http/htauth.h>
 #include <http/httplog.h>
 #include <http/httpmime.h>
@@ -55,8 +56,10 @@
 #include <util/daemonize.h>
 #include <util/xmlnode.h>
 
+#include <extensions/fcgi/fcgienv.h>
 #include <extensions/localworker.h>
 #include <extensions/localworkerconfig.h>
+#include <extensions/lsapi/lsapireq.h>
 #include <extensions/registry/extappregistry.h>
 #include <extensions/registry/appconfig.h>
 #include <assert.h>
@@ -262,6 +265,9 @@ HttpVHost::HttpVHost(const char *pHostName)
     , m_pSSITagConfig(NULL)
     , m_pRecaptcha(NULL)
     , m_lastAccessLog(NULL)
+    , m_lsapiEnv(256)
+    , m_fcgiEnv(256)
+    , m_iEnvCount(0)
 {
     char achBuf[10] = "/";
     m_rootContext.set(achBuf, "/nON eXIST",
@@ -315,6 +321,7 @@ int HttpVHost::setDocRoot(const char *psRoot)
     assert(psRoot != NULL);
     assert(*(psRoot + strlen(psRoot) - 1) == '/');
     m_rootContext.setRoot(psRoot);
+    buildEnvTemplate();
     return 0;
 }
 
@@ -431,6 +438,32 @@ void HttpVHost::logBytes(long long bytes)
 void HttpVHost::setAdminEmails(const char *pEmails)
 {
     m_sAdminEmails = pEmails;
+    buildEnvTemplate();
+}
+
+
+void HttpVHost::buildEnvTemplate()
+{
+    m_lsapiEnv.clear();
+    m_fcgiEnv.clear();
+    m_iEnvCount = 0;
+    const AutoStr2 *pRoot = getDocRoot();
+    if (pRoot && pRoot->c_str())
+    {
+        LsapiReq::addEnv(&m_lsapiEnv, "DOCUMENT_ROOT", 13,
+                         pRoot->c_str(), pRoot->len() - 1);
+        FcgiEnv::addEnv(&m_fcgiEnv, "DOCUMENT_ROOT", 13,
+                        pRoot->c_str(), pRoot->len() - 1);
+        ++m_iEnvCount;
+    }
+    if (m_sAdminEmails.c_str())
+    {
+        LsapiReq::addEnv(&m_lsapiEnv, "SERVER_ADMIN", 12,
+                         m_sAdminEmails.c_str(), m_sAdminEmails.len());
+        FcgiEnv::addEnv(&m_fcgiEnv, "SERVER_ADMIN", 12,
+                        m_sAdminEmails.c_str(), m_sAdminEmails.len());
+        ++m_iEnvCount;
+    }
 }
 
 
@@ -524,7 +557,7 @@ void HttpVHost::addRewriteMap(const char *pName, const char *pLocation)
     if (ret)
     {
         delete pMap;
-        if (ret == 2)
+        if (ret == -2)
             LS_ERROR("unknown or unsupported rewrite map type!");
         if (ret == -1)
             ERR_NO_MEM("parseType_Source()");
@@ -724,7 +757,7 @@ HttpContext *HttpVHost::bestMatch(const char *pURI, size_t iUriLen)
         {
             //If have .htaccess in this DIR, load it
             lstrncat(achRealPath, ".htaccess", sizeof(achRealPath));
-            pContext->configRewriteRule(NULL, NULL, achRealPath);
+            loadHtAccess(pContext, achRealPath);
         }
     }
 
@@ -732,6 +765,20 @@ HttpContext *HttpVHost::bestMatch(const char *pURI, size_t iUriLen)
 }
 
 
+/**
+ * Parsed .htaccess files are shared through HtAccessCache and reloaded when
+ * the file changes; paths with variables or files pulling in RewriteFile go
+ * the old way.
+ */
+void HttpVHost::loadHtAccess(HttpContext *pContext, const char *pPath)
+{
+    if (strchr(pPath, '$') == NULL
+        && HtAccessCache::getInstance().attach(this, pContext, pPath) != LS_FAIL)
+        return;
+    pContext->configRewriteRule(NULL, NULL, pPath);
+}
+
+
 const HttpContext *HttpVHost::matchLocation(const char *pURI,
         size_t iUriLen,
         int regex) const
@@ -2816,7 +2863,7 @@ int HttpVHost::configVHContextList(const XmlNode *pVhConfNode,
         htaccessPath.setStr(pSlashContext->getLocation(),
                             pSlashContext->getLocationLen());
         htaccessPath.append(".htaccess", 9);
-        pSlashContext->configRewriteRule(NULL, NULL, htaccessPath.c_str());
+        loadHtAccess(pSlashContext, htaccessPath.c_str());
     }
 
     /***
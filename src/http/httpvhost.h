@@ -27,6 +27,7 @@
 #include <http/reqparserparam.h>
 #include <log4cxx/nsdefs.h>
 #include <lsiapi/lsimoduledata.h>
+#include <util/autobuf.h>
 
 #include <util/hashstringmap.h>
 #include <util/refcounter.h>
@@ -211,6 +212,10 @@ private:
 
     UrlIdHash          *m_pUrlIdHash;
 
+    AutoBuf             m_lsapiEnv;
+    AutoBuf             m_fcgiEnv;
+    int                 m_iEnvCount;
+
     HttpVHost(const HttpVHost &rhs);
     void operator=(const HttpVHost &rhs);
 
@@ -263,12 +268,19 @@ public:
     const AutoStr2 *getAdminEmails() const {   return &m_sAdminEmails;  }
     void setAdminEmails(const char *pEmails);
 
+    //Pre-encoded DOCUMENT_ROOT and SERVER_ADMIN, rebuilt when either changes
+    void buildEnvTemplate();
+    const AutoBuf &getLsapiEnv() const  {   return m_lsapiEnv;      }
+    const AutoBuf &getFcgiEnv() const   {   return m_fcgiEnv;       }
+    int getEnvCount() const             {   return m_iEnvCount;     }
+
     int addContext(HttpContext *pContext)
     {   return m_contexts.add(pContext);          }
 
     bool dirMatch(HttpContext * &pContext, const char *pURI, size_t iUriLen,
                   AutoStr2 *missingDir, AutoStr2 *missLoc) const;
     HttpContext *bestMatch(const char *pURI, size_t iUriLen);
+    void loadHtAccess(HttpContext *pContext, const char *pPath);
 
     const HttpContext *matchLocation(const char *pURI, size_t iUriLen,
                                      int regex = 0) const;
@@ -54,6 +54,7 @@ private:
 
     void recycle();
     int onTimerEx()         {   return 0;   }
+    int getTimerDelay()     {   return 15;  }
     int onCloseEx()         {   return 0;   }
     int onWriteEx();
     int onInitConnected()   {   return 0;   };
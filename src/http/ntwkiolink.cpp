@@ -25,6 +25,7 @@
 #include <http/connlimitctrl.h>
 #include <http/hiohandlerfactory.h>
 #include <http/httpaiosendfile.h>
+#include <http/httpdefs.h>
 #include <http/httpresourcemanager.h>
 #include <http/httprespheaders.h>
 #include <http/httplistener.h>
@@ -60,6 +61,8 @@
 #define IO_THROTTLE_WRITE   16
 #define IO_COUNTED          32
 
+#define MAX_TIMER_DELAY     60
+
 //#define HTTP2_PLAIN_DEV
 
 //#define SPDY_PLAIN_DEV
@@ -351,6 +354,7 @@ int NtwkIOLink::setLink(HttpListener *pListener,  int fd, ConnInfo *pInfo)
     else
     {
         setNoSSL();
+        setFlag(HIO_FLAG_SENDFILE, 1);
         setupHandler(HIOS_PROTO_HTTP);
     }
 
@@ -407,6 +411,8 @@ int NtwkIOLink::handleEvents(short evt)
         return 0;
     }
     m_iInProcess = 1;
+    if (m_iTimerDelay > 1)
+        scheduleTimer(1);
     if (event & POLLIN)
     {
         //NOTE: force to allow flush output if unexpected POLLIN happens,
@@ -596,6 +602,8 @@ int NtwkIOLink::writevExSSL(LsiSession *pOS, const iovec *vector,
                             int count)
 {
     NtwkIOLink *pThis = static_cast<NtwkIOLink *>(pOS);
+    if (pThis->m_ssl.isKtlsTx())
+        return writevEx(pOS, vector, count);
     int ret = 0;
 
     const struct iovec *vect;
@@ -848,6 +856,7 @@ int NtwkIOLink::onReadSSL(NtwkIOLink *pThis)
 int NtwkIOLink::shutdownSsl()
 {
     LS_DBG_L(this, "Shutting down SSL ...");
+    m_ssl.cancelAsyncFetchCert(onAsyncCertDone, this);
     m_ssl.shutdown(0);
     m_ssl.release();
     ConnLimitCtrl::getInstance().decSSLConn();
@@ -940,8 +949,10 @@ void NtwkIOLink::closeSocket()
         m_sessionHooks.runCallbackNoParam(LSI_HKPT_L4_ENDSESSION, this);
 
     MultiplexerFactory::getMultiplexer()->remove(this);
+    cancelTimer();
     if (m_pFpList == s_pCur_fp_list_list->m_pSSL)
     {
+        m_ssl.cancelAsyncFetchCert(onAsyncCertDone, this);
         m_ssl.release();
         ctrl.decSSLConn();
         setNoSSL();
@@ -1043,11 +1054,46 @@ int NtwkIOLink::onTimer()
                 return 1;
             }
         }
+        scheduleTimer(getTimerDelay());
     }
+    else
+        scheduleTimer(1);
     return 0;
 }
 
 
+/**
+ * Only a plain, idle link may sleep past the next second; anything with
+ * pending output, AIO, an SSL handshake or throttling is checked on its
+ * token every second as before.
+ */
+int NtwkIOLink::getTimerDelay()
+{
+    int delay;
+    if (m_pFpList->m_onTimer_fp != onTimer_ || hasBufferedData()
+        || m_aioSFQ.size() || getState() != HIOS_CONNECTED || !getHandler()
+        || (m_ssl.getSSL() && m_ssl.getStatus() != SslConnection::CONNECTED))
+        return 1;
+    delay = getHandler()->getTimerDelay();
+    if (delay < 1)
+        return 1;
+    if (delay > MAX_TIMER_DELAY)
+        return MAX_TIMER_DELAY;
+    return delay;
+}
+
+
+// Next onTimer() lands on this link's token, delay seconds from now.
+void NtwkIOLink::scheduleTimer(int delay)
+{
+    int ticks = (m_tmToken - getToken() + TIMER_PRECISION) % TIMER_PRECISION;
+    if (ticks == 0)
+        ticks = TIMER_PRECISION;
+    m_iTimerDelay = delay;
+    armTimer(ticks + (delay - 1) * TIMER_PRECISION);
+}
+
+
 void NtwkIOLink::onTimer_(NtwkIOLink *pThis)
 {
     if (pThis->getHandler())
@@ -1285,7 +1331,10 @@ int NtwkIOLink::checkWriteRet(int len)
     if (len > 0)
     {
         bytesSent(len);
-        HttpStats::incBytesWritten(len);
+        if (m_ssl.isKtlsTx())
+            HttpStats::incSSLBytesWritten(len);
+        else
+            HttpStats::incBytesWritten(len);
         setActiveTime(DateTime::s_curTime);
     }
     else if (len == -1)
@@ -1715,13 +1764,36 @@ void NtwkIOLink::handle_acceptSSL_EIO_Err()
 
 void NtwkIOLink::enableTlsAccel()
 {
+    if (m_ssl.enableKtlsTx() == LS_OK)
+    {
+        // Records are built by the kernel, so sendfile() works over TLS.
+        setFlag(HIO_FLAG_SENDFILE, 1);
+        return;
+    }
     m_ssl.setWriteBuffering(1);
 }
 
 
+int NtwkIOLink::onAsyncCertDone(void *arg, const char *pDomain)
+{
+    NtwkIOLink *pThis = (NtwkIOLink *)arg;
+    LS_DBG_L(pThis, "[SSL] Async cert lookup for %s done.", pDomain);
+    pThis->m_ssl.updateOnGotCert();
+    pThis->SSLAgain();
+    return 0;
+}
+
+
 int NtwkIOLink::acceptSSL()
 {
     int ret = m_ssl.accept();
+    if (ret == 0 && m_ssl.wantCert() && !m_ssl.isWaitingAsyncCert())
+    {
+        if (m_ssl.asyncFetchCert(onAsyncCertDone, this) == 1)
+            return 0;
+        //Lookup is already over, carry on with what is available now.
+        ret = m_ssl.accept();
+    }
     if (ret == 1)
     {
         LS_DBG_L(this, "[SSL] accepted!");
@@ -1733,8 +1805,7 @@ int NtwkIOLink::acceptSSL()
             LS_WARN(this, "[SSL] Too many new SSL connections: %d, "
                     "possible SSL negociation based attack, block!",
                     getClientInfo()->getSslNewConn());
-            getClientInfo()->setOverLimitTime(DateTime::s_curTime);
-            getClientInfo()->setAccess(AC_BLOCK);
+            getClientInfo()->block();
         }
         else
         {
@@ -1844,6 +1915,8 @@ int NtwkIOLink::writevExSSL_T(LsiSession *pOS, const iovec *vector,
                               int count)
 {
     NtwkIOLink *pThis = static_cast<NtwkIOLink *>(pOS);
+    if (pThis->m_ssl.isKtlsTx())
+        return writevExT(pOS, vector, count);
     ThrottleControl *pCtrl = pThis->getThrottleCtrl();
     int Quota = pCtrl->getOSQuota();
     if (Quota <= pThis->m_iSslLastWrite / 2)
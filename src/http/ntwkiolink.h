@@ -107,6 +107,7 @@ private:
 
     char                m_iInProcess;
     char                m_iPeerShutdown;
+    short               m_iTimerDelay;
     int                 m_tmToken;
     int                 m_iSslLastWrite;
     int                 m_iHeaderToSend;
@@ -252,6 +253,8 @@ public:
     int close();
     int  shutdown();
     int  detectClose();
+    int  getTimerDelay();
+    void scheduleTimer(int delay);
     int  detectCloseNow();
 
 public:
@@ -300,6 +303,7 @@ public:
 
     int SSLAgain();
     int acceptSSL();
+    static int onAsyncCertDone(void *arg, const char *pDomain);
     void handle_acceptSSL_EIO_Err();
 
     int get_url_from_reqheader(char *buf, int length, char **puri,
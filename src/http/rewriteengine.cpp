@@ -79,11 +79,16 @@ RewriteEngine::RewriteEngine()
     , m_pLastTestStr(NULL)
     , m_lastTestStrLen(0)
     , m_noStat(0)
+    , m_iPending(0)
+    , m_iCookies(0)
+    , m_iCookieSkip(0)
     , m_stripLen(0)
+    , m_pFilterList(NULL)
 {
     memset(&m_st, 0, sizeof(m_st));
     memset(m_ruleVec, 0, sizeof(m_ruleVec));
     memset(m_condVec, 0, sizeof(m_condVec));
+    memset(m_litHits, 0, sizeof(m_litHits));
     memset(m_rewriteBuf, 0, sizeof(m_rewriteBuf));
     memset(m_qsBuf, 0, sizeof(m_qsBuf));
 }
@@ -171,6 +176,7 @@ int RewriteEngine::parseRules(char *&pRules, RewriteRuleList *pRuleList,
             if (ret)
             {
                 delete pRule;
+                pRuleList->buildFilter();
                 return 0;
             }
             pLast->addNext(pRule);
@@ -254,6 +260,7 @@ int RewriteEngine::parseRules(char *&pRules, RewriteRuleList *pRuleList,
             pRules = pLineEnd + 1;
         }
     }
+    pRuleList->buildFilter();
     return 0;
 }
 
@@ -410,7 +417,13 @@ int RewriteEngine::getSubstValue(const RewriteSubstItem *pItem,
             char achBuf[1024];
             if (buildString(pRef->getKeyFormat(), pSession, achBuf, len) == NULL)
                 return 0;
-            if ((len = pRef->getMap()->lookup(achBuf, len, pValue, bufLen)) == -1)
+            len = pRef->getMap()->lookup(achBuf, len, pValue, bufLen, pSession);
+            if (len == RWMAP_PENDING)
+            {
+                m_iPending = 1;
+                return 0;
+            }
+            if (len == -1)
             {
                 if (pRef->getDefaultFormat())
                 {
@@ -605,7 +618,7 @@ int RewriteEngine::processCond(const RewriteCond *pCond,
         m_noStat = 1;
     }
     int ret = 0;
-    if (!pTest)
+    if (!pTest || m_iPending)
         return LS_FAIL;
     int condVec[ MAX_REWRITE_MATCH * 3 ];
     int condMatches = 0;
@@ -714,11 +727,40 @@ int RewriteEngine::processCond(const RewriteCond *pCond,
 }
 
 
+/**
+ * Checks the rule's required literal against the hits of a single
+ * Aho-Corasick pass over the current URL, shared by all rules of a list.
+ */
+int RewriteEngine::mayMatch(const RewriteRule *pRule)
+{
+    const RewriteRuleList *pList = pRule->getRuleList();
+    int id = pRule->getLiteralId();
+    if (!pList || (id < 0))
+        return 1;
+    if (pList != m_pFilterList)
+    {
+        pList->scanLiterals(m_pSourceURL, m_sourceURLLen, m_litHits);
+        m_pFilterList = pList;
+    }
+    return m_litHits[id >> 3] & (1 << (id & 7));
+}
+
+
 int RewriteEngine::processRule(const RewriteRule *pRule,
                                HttpSession *pSession, AutoStr2 &cacheCtlStr)
 {
+    int ret;
     m_ruleMatches = 0;
-    int ret = pRule->getRegex()->exec(m_pSourceURL, m_sourceURLLen, 0,
+    if (!mayMatch(pRule))
+    {
+        ret = PCRE_ERROR_NOMATCH;
+        if (m_logLevel > 1)
+            LS_INFO(pSession->getLogSession(),
+                    "[REWRITE] Rule: '%s' lacks literal '%s' of pattern '%s', skip.",
+                    m_pSourceURL, pRule->getLiteral(), pRule->getPattern());
+    }
+    else
+        ret = pRule->getRegex()->exec(m_pSourceURL, m_sourceURLLen, 0,
                                       0, m_ruleVec, MAX_REWRITE_MATCH * 3);
     if (m_logLevel > 1)
         LS_INFO(pSession->getLogSession(),
@@ -745,6 +787,8 @@ int RewriteEngine::processRule(const RewriteRule *pRule,
     {
         if (processCond(pCond, pSession))
         {
+            if (m_iPending)
+                return LS_FAIL;
             if (!((pCond->getFlag() & COND_FLAG_OR)
                 //&& pCond->next()
                 ))
@@ -906,6 +950,9 @@ int RewriteEngine::setCookie(char *pBuf, int len, HttpSession *pSession)
                     || (strncasecmp("HttpOnly", p, 8) == 0));
     }
     pSession->getReq()->setCookie(pName, strlen(pName), pVal, strlen(pVal));
+    //added already by the pass that got suspended for a map answer
+    if (++m_iCookies <= m_iCookieSkip)
+        return 0;
     MtSessData * psd = pSession->getMtSessData();
     if (psd)
         ls_mutex_lock(&psd->m_respHeaderLock);
@@ -939,6 +986,8 @@ int RewriteEngine::expandEnv(const RewriteRule *pRule,
     {
         len = REWRITE_BUF_SIZE - 1;
         buildString(pEnv, pSession, achBuf, len);
+        if (m_iPending)
+            return 0;
         if (pEnv->isCookie())
         {
             //TODO: enable it later
@@ -1054,6 +1103,8 @@ int RewriteEngine::processRewrite(const RewriteRule *pRule,
     int flag = pRule->getFlag();
     int eef_flags = 0;
     expandEnv(pRule, pSession, cacheCtlStr, &eef_flags);
+    if (m_iPending)
+        return LS_FAIL;
     m_rewritten |= 1;
     if (eef_flags & EEF_CACHE_KEY_MOD)
         // This environment variable is only used by the callback set in the
@@ -1067,6 +1118,8 @@ int RewriteEngine::processRewrite(const RewriteRule *pRule,
         m_pFreeBuf = pBuf;
         m_flag = flag;
         pBuf = buildString(pRule->getTargetFmt(), pSession, m_pDestURL, len, 1, 1);
+        if (m_iPending)
+            return LS_FAIL;
         // log rewrite result here
         if (!pBuf)
         {
@@ -1097,6 +1150,7 @@ int RewriteEngine::processRewrite(const RewriteRule *pRule,
         m_pOrgSourceURL = m_pSourceURL;
         m_orgSourceURLLen = m_sourceURLLen;
         m_pSourceURL = pBuf;
+        m_pFilterList = NULL;
         m_sourceURLLen = len;
         m_iScriptLen = -1;
         m_iPathInfoLen = 0;
@@ -1184,6 +1238,10 @@ int RewriteEngine::processRuleSet(const RewriteRuleList *pRuleList,
     const AutoStr2 *pBase = NULL;
     AutoStr2    sStrip;
     m_rewritten = 0;
+    m_iPending = 0;
+    m_iCookies = 0;
+    m_iCookieSkip = pReq->getRewriteReplay();
+    pReq->setRewriteReplay(0);
     //initialize rewrite engine
     //strip prefix aka. RewriteBase
     m_logLevel = pReq->getRewriteLogLevel();
@@ -1255,7 +1313,7 @@ int RewriteEngine::processRuleSet(const RewriteRuleList *pRuleList,
     m_flag     = 0;
     m_statusCode = 0;
     AutoStr2 cacheCtlStr = "";
-
+    m_pFilterList = NULL;
 
     while (pRule)
     {
@@ -1266,6 +1324,14 @@ int RewriteEngine::processRuleSet(const RewriteRuleList *pRuleList,
         ret = processRule(pRule, pSession, cacheCtlStr);
         if (pSession->isDropConnection())
             return SC_403;
+        if (m_iPending)
+        {
+            if (m_logLevel > 4)
+                LS_INFO(pSession->getLogSession(),
+                        "[REWRITE] wait for map answer, rerun rules when it comes.");
+            pReq->setRewriteReplay(m_iCookies);
+            return REWRITE_PENDING;
+        }
         if (ret)
         {
             pRule = getNextRule(pRule, pContext, pRootContext);
@@ -1367,6 +1433,7 @@ NEXT_RULE:
                     memmove(pBuf + baseLen, m_pSourceURL, m_sourceURLLen);
                     m_pFreeBuf = (char *)m_pSourceURL;
                     m_pSourceURL = pBuf;
+                    m_pFilterList = NULL;
                     m_sourceURLLen += baseLen;
                     pBuf[m_sourceURLLen] = 0;
                     if ((m_logLevel > 4) && (m_pBase))
@@ -1408,6 +1475,7 @@ NEXT_RULE:
                             m_pSourceURL);
                     m_rewritten = m_statusCode = 0;
                     m_pSourceURL = m_pOrgSourceURL;
+                    m_pFilterList = NULL;
                     m_sourceURLLen = m_orgSourceURLLen ;
 
                     goto NEXT_RULE;
@@ -22,17 +22,19 @@
 
 #include <lsdef.h>
 #include <http/httpdefs.h>
+#include <http/rewriterulelist.h>
 #include <util/tsingleton.h>
 
 #include <sys/stat.h>
 
 #define MAX_REWRITE_MATCH   10
 #define REWRITE_BUF_SIZE    MAX_BUF_SIZE
+//processRuleSet() result, rerun the rule set when the session resumes
+#define REWRITE_PENDING     (-5)
 
 class AutoStr2;
 class RewriteCond;
 class RewriteRule;
-class RewriteRuleList;
 class RewriteMapList;
 class RewriteSubstItem;
 class RewriteSubstFormat;
@@ -71,12 +73,18 @@ class RewriteEngine : public TSingleton<RewriteEngine>
     char           *m_pLastTestStr;
     int             m_lastTestStrLen;
     int             m_noStat;
+    int             m_iPending;
+    int             m_iCookies;
+    int             m_iCookieSkip;
     struct stat     m_st;
 
     int             m_stripLen;
     int             m_ruleVec[ MAX_REWRITE_MATCH * 3 ];
     int             m_condVec[ MAX_REWRITE_MATCH * 3 ];
 
+    const RewriteRuleList *m_pFilterList;
+    unsigned char   m_litHits[ REWRITE_MAX_LITERALS / 8 ];
+
     char            m_rewriteBuf[3][REWRITE_BUF_SIZE];
     char            m_qsBuf[REWRITE_BUF_SIZE];
 
@@ -91,6 +99,7 @@ class RewriteEngine : public TSingleton<RewriteEngine>
     char *buildString(const RewriteSubstFormat *pFormat, HttpSession *pSession,
                       char *pBuf, int &len, int esc_uri = 0, int noDupSlash = 0);
     int processCond(const RewriteCond *pCond, HttpSession *pSession);
+    int mayMatch(const RewriteRule *pRule);
     int processRule(const RewriteRule *pRule, HttpSession *pSession,
                     AutoStr2 &cacheCtlStr);
     int processRewrite(const RewriteRule *pRule, HttpSession *pSession,
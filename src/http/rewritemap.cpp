@@ -16,10 +16,13 @@
 *    along with this program. If not, see http://www.gnu.org/licenses/.      *
 *****************************************************************************/
 #include "rewritemap.h"
+#include <http/rewritemapdb.h>
+#include <http/rewritemapprg.h>
 #include <util/stringtool.h>
 #include <util/httputil.h>
 #include <log4cxx/logger.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -70,12 +73,18 @@ RewriteMap::RewriteMap()
     : m_type(0)
     , m_loadTime(0)
     , m_pStore(NULL)
+    , m_pDb(NULL)
+    , m_pPrg(NULL)
 {
 }
 RewriteMap::~RewriteMap()
 {
     if (m_pStore)
         delete m_pStore;
+    if (m_pDb)
+        delete m_pDb;
+    if (m_pPrg)
+        delete m_pPrg;
     release_objects();
 }
 
@@ -93,7 +102,7 @@ int RewriteMap::parseType_Source(const char *pSource)
         if (strncasecmp(s_types[i], pSource, s_type_len[i]) == 0)
             break;
     }
-    if (i >= TYPE_DBM)
+    if (i > TYPE_PRG)
     {
         //error unknow or unsupported map type
         return -2;
@@ -107,10 +116,58 @@ int RewriteMap::parseType_Source(const char *pSource)
             m_pStore->setDataStoreURI(pSource);
         else
             return LS_FAIL;
+        attachDb(pSource);
+    }
+    else if (m_type == TYPE_DBM)
+    {
+        if (attachDb(pSource) != LS_OK)
+        {
+            LS_ERROR("[RewriteMap] %s: failed to load dbm:%s.", getName(),
+                     pSource);
+            return -3;
+        }
+    }
+    else if (m_type == TYPE_PRG)
+    {
+        m_pPrg = new RewriteMapPrg();
+        if (!m_pPrg)
+            return LS_FAIL;
+        m_pPrg->setCommand(pSource);
     }
     return 0;
 }
 
+
+/**
+ * txt:, rnd: and dbm: maps are served from a compiled, mmapped index
+ * next to a text source; txt: and rnd: fall back to the in-memory hash
+ * when it cannot be written. A dbm: source already in compiled form is
+ * used as is.
+ */
+int RewriteMap::attachDb(const char *pSource)
+{
+    char achDb[4096];
+    const char *pSrc = pSource;
+    m_pDb = new RewriteMapDb();
+    if (!m_pDb)
+        return LS_FAIL;
+    if (RewriteMapDb::isDbFile(pSource))
+        pSrc = NULL;
+    else if (snprintf(achDb, sizeof(achDb), "%s%s", pSource,
+                      RWMAP_DB_SUFFIX) < (int)sizeof(achDb))
+        pSource = achDb;
+    else
+        pSource = NULL;
+    if (!pSource || (m_pDb->attach(pSource, pSrc) != LS_OK))
+    {
+        delete m_pDb;
+        m_pDb = NULL;
+        return LS_FAIL;
+    }
+    return LS_OK;
+}
+
+
 int RewriteMap::reloadFromStore()
 {
     release_objects();
@@ -139,18 +196,37 @@ static void initRand()
 }
 
 
+int RewriteMap::getStoreValue(const char *pKey, int keyLen,
+                              const char *&pTxt)
+{
+    if (m_pDb)
+    {
+        if ((m_pDb->refresh() == LS_OK) || !m_pStore)
+            return m_pDb->lookup(pKey, keyLen, pTxt);
+        LS_NOTICE("[RewriteMap] %s: cannot update %s, load %s into memory.",
+                  getName(), m_pDb->getDbPath(), m_pStore->getDataStoreURI());
+        delete m_pDb;
+        m_pDb = NULL;
+    }
+    if (m_pStore->isStoreChanged(m_loadTime))
+        reloadFromStore();
+    RewriteMapData *pData = (RewriteMapData *)getData(pKey);
+    if (!pData)
+        return LS_FAIL;
+    pTxt = pData->getValue()->c_str();
+    return pData->getValue()->len();
+}
+
+
 int RewriteMap::lookup(const char *pKey, int keyLen, char *pValue,
-                       int valLen)
+                       int valLen, HttpSession *pSession)
 {
-    if (m_type <= TYPE_RND)
+    if ((m_type <= TYPE_RND) || (m_type == TYPE_DBM))
     {
-        if (m_pStore->isStoreChanged(m_loadTime))
-            reloadFromStore();
-        RewriteMapData *pData = (RewriteMapData *)getData(pKey);
-        if (!pData)
+        const char *pTxt;
+        int len = getStoreValue(pKey, keyLen, pTxt);
+        if (len == LS_FAIL)
             return LS_FAIL;
-        const char *pTxt = pData->getValue()->c_str();
-        int len = pData->getValue()->len();
         if (m_type == TYPE_RND)
         {
             const char *part_begin[257];
@@ -184,6 +260,8 @@ int RewriteMap::lookup(const char *pKey, int keyLen, char *pValue,
         memmove(pValue, pTxt, len);
         valLen = len;
     }
+    else if (m_type == TYPE_PRG)
+        valLen = m_pPrg->lookup(pKey, keyLen, pValue, valLen, pSession);
     else
     {
         switch (m_type)
@@ -202,8 +280,6 @@ int RewriteMap::lookup(const char *pKey, int keyLen, char *pValue,
         case TYPE_INT_UNESC:
             valLen = HttpUtil::unescape(pKey, keyLen, pValue, valLen);
             break;
-        case TYPE_DBM:
-        case TYPE_PRG:
         default:
             valLen = 0;
             break;
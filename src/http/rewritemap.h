@@ -25,6 +25,13 @@
 #include <util/hashstringmap.h>
 #include <util/keydata.h>
 
+//lookup() result, the session waits for a prg: map answer
+#define RWMAP_PENDING   (-2)
+
+class HttpSession;
+class RewriteMapDb;
+class RewriteMapPrg;
+
 class RewriteMapData : public KeyData
 {
     AutoStr2    m_value;
@@ -61,8 +68,12 @@ class RewriteMap : public HashDataCache
     int                 m_type;
     long                m_loadTime;
     RewriteMapFile     *m_pStore;
+    RewriteMapDb       *m_pDb;
+    RewriteMapPrg      *m_pPrg;
 
     int reloadFromStore();
+    int attachDb(const char *pSource);
+    int getStoreValue(const char *pKey, int keyLen, const char *&pTxt);
 
 public:
 
@@ -85,7 +96,8 @@ public:
     const char *getName() const        {   return m_sName.c_str();     }
 
     int parseType_Source(const char *pSource);
-    int lookup(const char *pKey, int keyLen, char *pValue, int valLen);
+    int lookup(const char *pKey, int keyLen, char *pValue, int valLen,
+               HttpSession *pSession = NULL);
     LS_NO_COPY_ASSIGN(RewriteMap);
 };
 
@@ -0,0 +1,605 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "rewritemapdb.h"
+
+#include <log4cxx/logger.h>
+#include <lsr/ls_fileio.h>
+#include <lsr/ls_offload.h>
+#include <lsr/xxhash.h>
+#include <util/datetime.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#define RWMAP_DB_MAX_KEY    0xffff
+
+static struct Offloader *s_pCompileOffloader = NULL;
+
+struct RewriteMapDbSlot
+{
+    uint32_t    m_iHash;
+    uint32_t    m_iOff;         //0 for empty slot
+};
+
+struct RewriteMapDbEntry
+{
+    uint16_t    m_iKeyLen;
+    uint16_t    m_iValLen;
+    char        m_data[4];      //key '\0' value '\0'
+};
+
+struct RewriteMapDbTask
+{
+    ls_offload_t    m_header;
+    RewriteMapDb   *m_pDb;
+    AutoStr2        m_sSrcPath;
+    AutoStr2        m_sDbPath;
+    int             m_iResult;
+};
+
+struct RewriteMapSrcLine
+{
+    const char *m_pKey;
+    const char *m_pVal;
+    uint32_t    m_iHash;
+    int         m_iKeyLen;
+    int         m_iValLen;
+};
+
+
+static inline uint32_t entrySize(int keyLen, int valLen)
+{
+    return (offsetof(RewriteMapDbEntry, m_data) + keyLen + valLen + 2 + 3)
+           & ~3;
+}
+
+
+/**
+ * Same rules as RewriteMapFile::parseLine(): comment and indented lines
+ * are skipped, the value ends at the first blank or '#'.
+ */
+static int parseSrcLine(const char *p, const char *pLineEnd,
+                        RewriteMapSrcLine *pLine)
+{
+    const char *pKeyEnd;
+    if ((p >= pLineEnd) || (*p == '#') || (*p == ' ') || (*p == '\t')
+        || (*p == '\r'))
+        return LS_FAIL;
+    pKeyEnd = p;
+    while ((pKeyEnd < pLineEnd) && !isspace(*pKeyEnd))
+        ++pKeyEnd;
+    pLine->m_pKey = p;
+    pLine->m_iKeyLen = pKeyEnd - p;
+    if (pLine->m_iKeyLen > RWMAP_DB_MAX_KEY)
+        return LS_FAIL;
+    p = pKeyEnd;
+    while ((p < pLineEnd) && isspace(*p))
+        ++p;
+    pLine->m_pVal = p;
+    if ((p < pLineEnd) && (*p == '#'))
+        pLine->m_iValLen = 0;
+    else
+    {
+        while ((p < pLineEnd) && !isspace(*p) && (*p != '#'))
+            ++p;
+        pLine->m_iValLen = p - pLine->m_pVal;
+        if (pLine->m_iValLen > RWMAP_DB_MAX_KEY)
+            return LS_FAIL;
+    }
+    pLine->m_iHash = XXH32(pLine->m_pKey, pLine->m_iKeyLen, 0);
+    return LS_OK;
+}
+
+
+/**
+ * The main process compiles maps at config load while it still runs as
+ * root, so it only writes into a directory no other user can change.
+ */
+static int isSafeDir(const char *pDbPath)
+{
+    char achDir[4096];
+    struct stat st;
+    const char *p;
+    int len;
+    if (geteuid() != 0)
+        return 1;
+    p = strrchr(pDbPath, '/');
+    if (!p)
+        len = snprintf(achDir, sizeof(achDir), ".");
+    else if (p == pDbPath)
+        len = snprintf(achDir, sizeof(achDir), "/");
+    else
+        len = snprintf(achDir, sizeof(achDir), "%.*s", (int)(p - pDbPath),
+                       pDbPath);
+    if ((len >= (int)sizeof(achDir)) || (lstat(achDir, &st) == -1)
+        || !S_ISDIR(st.st_mode))
+        return 0;
+    return (st.st_uid == 0)
+           && (!(st.st_mode & (S_IWGRP | S_IWOTH)) || (st.st_mode & S_ISVTX));
+}
+
+
+static int writeDb(const char *pDbPath, const char *pBuf, size_t size)
+{
+    char achTmp[4096];
+    int fd;
+    ssize_t ret;
+    if ((size_t)snprintf(achTmp, sizeof(achTmp), "%s.XXXXXX", pDbPath)
+        >= sizeof(achTmp))
+        return LS_FAIL;
+    //O_EXCL, a planted symlink is never followed
+    fd = mkstemp(achTmp);
+    if (fd == -1)
+        return LS_FAIL;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fchmod(fd, 0644);
+    while (size > 0)
+    {
+        ret = ls_fio_write(fd, pBuf, size);
+        if (ret <= 0)
+        {
+            if ((ret == -1) && (errno == EINTR))
+                continue;
+            close(fd);
+            unlink(achTmp);
+            return LS_FAIL;
+        }
+        pBuf += ret;
+        size -= ret;
+    }
+    close(fd);
+    if (rename(achTmp, pDbPath) == -1)
+    {
+        unlink(achTmp);
+        return LS_FAIL;
+    }
+    return LS_OK;
+}
+
+
+int RewriteMapDb::compile(const char *pSrcPath, const char *pDbPath)
+{
+    struct stat st;
+    RewriteMapSrcLine *pLines = NULL;
+    int32_t *pSlots = NULL;
+    char *pOut = NULL;
+    const char *pSrc = NULL;
+    const char *p, *pEnd, *pLineEnd;
+    int lines = 0, capacity = 0, entries = 0, i;
+    uint32_t buckets, mask, n, off;
+    uint64_t size;
+    int ret = LS_FAIL;
+
+    if (!isSafeDir(pDbPath))
+    {
+        LS_ERROR("[RewriteMap] will not write %s as root, its directory is "
+                 "writable by other users.", pDbPath);
+        return LS_FAIL;
+    }
+    int fd = ls_fio_open(pSrcPath, O_RDONLY, 0);
+    if (fd == -1)
+        return LS_FAIL;
+    if ((fstat(fd, &st) == -1) || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return LS_FAIL;
+    }
+    if (st.st_size > 0)
+    {
+        pSrc = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                                  fd, 0);
+        if (pSrc == MAP_FAILED)
+        {
+            close(fd);
+            return LS_FAIL;
+        }
+    }
+    close(fd);
+
+    p = pSrc;
+    pEnd = pSrc + st.st_size;
+    while (p < pEnd)
+    {
+        pLineEnd = (const char *)memchr(p, '\n', pEnd - p);
+        if (!pLineEnd)
+            pLineEnd = pEnd;
+        if (lines == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            RewriteMapSrcLine *pNew = (RewriteMapSrcLine *)realloc(pLines,
+                                      capacity * sizeof(RewriteMapSrcLine));
+            if (!pNew)
+                goto OUT;
+            pLines = pNew;
+        }
+        if (parseSrcLine(p, pLineEnd, &pLines[lines]) == LS_OK)
+            ++lines;
+        p = pLineEnd + 1;
+    }
+
+    buckets = 8;
+    while (buckets < (uint32_t)lines * 2)
+        buckets <<= 1;
+    mask = buckets - 1;
+    pSlots = (int32_t *)malloc(buckets * sizeof(int32_t));
+    if (!pSlots)
+        goto OUT;
+    memset(pSlots, 0xff, buckets * sizeof(int32_t));
+
+    size = sizeof(RewriteMapDbHeader) + buckets * sizeof(RewriteMapDbSlot);
+    for (i = 0; i < lines; ++i)
+    {
+        RewriteMapSrcLine *pLine = &pLines[i];
+        for (n = pLine->m_iHash & mask; pSlots[n] != -1; n = (n + 1) & mask)
+        {
+            RewriteMapSrcLine *pOld = &pLines[pSlots[n]];
+            if ((pOld->m_iHash == pLine->m_iHash)
+                && (pOld->m_iKeyLen == pLine->m_iKeyLen)
+                && (memcmp(pOld->m_pKey, pLine->m_pKey, pLine->m_iKeyLen) == 0))
+                break;
+        }
+        if (pSlots[n] != -1)
+            continue;   //first one wins, same as the hash cache
+        pSlots[n] = i;
+        ++entries;
+        size += entrySize(pLine->m_iKeyLen, pLine->m_iValLen);
+    }
+    if (size > 0xffffffffULL)
+    {
+        LS_ERROR("[RewriteMap] %s is too large to compile.", pSrcPath);
+        goto OUT;
+    }
+
+    pOut = (char *)calloc(1, size);
+    if (!pOut)
+        goto OUT;
+    {
+        RewriteMapDbHeader *pHeader = (RewriteMapDbHeader *)pOut;
+        RewriteMapDbSlot *pTable = (RewriteMapDbSlot *)(pHeader + 1);
+        memmove(pHeader->m_magic, RWMAP_DB_MAGIC, sizeof(pHeader->m_magic));
+        pHeader->m_iBuckets = buckets;
+        pHeader->m_iEntries = entries;
+        pHeader->m_iTableOff = sizeof(RewriteMapDbHeader);
+        pHeader->m_iDataOff = pHeader->m_iTableOff
+                              + buckets * sizeof(RewriteMapDbSlot);
+        pHeader->m_iSize = size;
+        pHeader->m_iSrcMtime = st.st_mtime;
+        pHeader->m_iSrcSize = st.st_size;
+        off = pHeader->m_iDataOff;
+        for (n = 0; n < buckets; ++n)
+        {
+            if (pSlots[n] == -1)
+                continue;
+            RewriteMapSrcLine *pLine = &pLines[pSlots[n]];
+            RewriteMapDbEntry *pEntry = (RewriteMapDbEntry *)(pOut + off);
+            pEntry->m_iKeyLen = pLine->m_iKeyLen;
+            pEntry->m_iValLen = pLine->m_iValLen;
+            memmove(pEntry->m_data, pLine->m_pKey, pLine->m_iKeyLen);
+            memmove(pEntry->m_data + pLine->m_iKeyLen + 1, pLine->m_pVal,
+                    pLine->m_iValLen);
+            pTable[n].m_iHash = pLine->m_iHash;
+            pTable[n].m_iOff = off;
+            off += entrySize(pLine->m_iKeyLen, pLine->m_iValLen);
+        }
+    }
+    ret = writeDb(pDbPath, pOut, size);
+    if (ret == LS_OK)
+        LS_INFO("[RewriteMap] compiled %d entries from %s into %s.",
+                entries, pSrcPath, pDbPath);
+    else
+        LS_ERROR("[RewriteMap] failed to write %s: %s", pDbPath,
+                 strerror(errno));
+OUT:
+    if (pOut)
+        free(pOut);
+    if (pSlots)
+        free(pSlots);
+    if (pLines)
+        free(pLines);
+    if (pSrc)
+        munmap((void *)pSrc, st.st_size);
+    return ret;
+}
+
+
+int RewriteMapDb::isDbFile(const char *pPath)
+{
+    char achMagic[8];
+    int fd = ls_fio_open(pPath, O_RDONLY, 0);
+    if (fd == -1)
+        return 0;
+    int ret = (ls_fio_read(fd, achMagic, sizeof(achMagic)) == sizeof(achMagic))
+              && (memcmp(achMagic, RWMAP_DB_MAGIC, sizeof(achMagic)) == 0);
+    close(fd);
+    return ret;
+}
+
+
+RewriteMapDb::RewriteMapDb()
+    : m_pMap(NULL)
+    , m_iMapSize(0)
+    , m_ino(0)
+    , m_mtime(0)
+    , m_lastCheck(0)
+    , m_pTask(NULL)
+    , m_iCompileFailed(0)
+{
+}
+
+
+RewriteMapDb::~RewriteMapDb()
+{
+    //a compile in flight finishes on its own
+    if (m_pTask)
+        m_pTask->m_pDb = NULL;
+    unmap();
+}
+
+
+void RewriteMapDb::unmap()
+{
+    if (m_pMap)
+    {
+        munmap(m_pMap, m_iMapSize);
+        m_pMap = NULL;
+        m_iMapSize = 0;
+    }
+}
+
+
+int RewriteMapDb::map()
+{
+    struct stat st;
+    const RewriteMapDbHeader *pHeader;
+    int fd = ls_fio_open(m_sDbPath.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        return LS_FAIL;
+    if ((fstat(fd, &st) == -1)
+        || (st.st_size < (off_t)sizeof(RewriteMapDbHeader)))
+    {
+        close(fd);
+        return LS_FAIL;
+    }
+    char *pMap = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pMap == MAP_FAILED)
+        return LS_FAIL;
+    pHeader = (const RewriteMapDbHeader *)pMap;
+    if ((memcmp(pHeader->m_magic, RWMAP_DB_MAGIC, sizeof(pHeader->m_magic)) != 0)
+        || (pHeader->m_iSize != (uint64_t)st.st_size)
+        || (pHeader->m_iBuckets == 0)
+        || (pHeader->m_iBuckets & (pHeader->m_iBuckets - 1))
+        || ((uint64_t)pHeader->m_iTableOff
+            + (uint64_t)pHeader->m_iBuckets * sizeof(RewriteMapDbSlot)
+            > (uint64_t)st.st_size))
+    {
+        LS_ERROR("[RewriteMap] %s is not a valid compiled rewrite map.",
+                 m_sDbPath.c_str());
+        munmap(pMap, st.st_size);
+        return LS_FAIL;
+    }
+    unmap();
+    m_pMap = pMap;
+    m_iMapSize = st.st_size;
+    m_ino = st.st_ino;
+    m_mtime = st.st_mtime;
+    return LS_OK;
+}
+
+
+int RewriteMapDb::isSrcNewer() const
+{
+    struct stat st;
+    const RewriteMapDbHeader *pHeader = (const RewriteMapDbHeader *)m_pMap;
+    if (m_sSrcPath.len() == 0)
+        return 0;
+    if (ls_fio_stat(m_sSrcPath.c_str(), &st) == -1)
+        return 0;
+    return (!pHeader || (pHeader->m_iSrcMtime != (int64_t)st.st_mtime)
+            || (pHeader->m_iSrcSize != (int64_t)st.st_size));
+}
+
+
+/**
+ * pSrcPath is the text source to compile from, NULL if pDbPath is used
+ * as is.
+ */
+int RewriteMapDb::attach(const char *pDbPath, const char *pSrcPath)
+{
+    m_sDbPath.setStr(pDbPath);
+    if (pSrcPath)
+        m_sSrcPath.setStr(pSrcPath);
+    map();
+    if (isSrcNewer()
+        && (compile(m_sSrcPath.c_str(), m_sDbPath.c_str()) == LS_OK))
+        map();
+    m_lastCheck = DateTime::s_curTime;
+    if (isSrcNewer())
+        return LS_FAIL;
+    return m_pMap ? LS_OK : LS_FAIL;
+}
+
+
+/**
+ * Holds a lock on the source while compiling, so only one worker rebuilds
+ * it; the others find the index current or skip, and remap the new file
+ * once it is renamed into place.
+ */
+static int compileOnce(const char *pSrcPath, const char *pDbPath)
+{
+    RewriteMapDbHeader header;
+    struct stat st;
+    int ret = LS_OK;
+    int fd = ls_fio_open(pSrcPath, O_RDONLY, 0);
+    if (fd == -1)
+        return LS_FAIL;
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1)
+    {
+        close(fd);
+        return (errno == EWOULDBLOCK) ? LS_OK : LS_FAIL;
+    }
+    int fdDb = ls_fio_open(pDbPath, O_RDONLY, 0);
+    int current = (fdDb != -1) && (fstat(fd, &st) == 0)
+                  && (pread(fdDb, &header, sizeof(header), 0)
+                      == sizeof(header))
+                  && (header.m_iSrcMtime == (int64_t)st.st_mtime)
+                  && (header.m_iSrcSize == (int64_t)st.st_size);
+    if (fdDb != -1)
+        close(fdDb);
+    if (!current)
+        ret = RewriteMapDb::compile(pSrcPath, pDbPath);
+    close(fd);
+    return ret;
+}
+
+
+static int rwmap_compile_perform(ls_offload *item)
+{
+    RewriteMapDbTask *pTask = (RewriteMapDbTask *)item;
+    pTask->m_iResult = compileOnce(pTask->m_sSrcPath.c_str(),
+                                   pTask->m_sDbPath.c_str());
+    return 0;
+}
+
+
+static void rwmap_compile_release(ls_offload *item)
+{
+    RewriteMapDbTask *pTask = (RewriteMapDbTask *)item;
+    if (--pTask->m_header.ref_cnt > 0)
+        return;
+    delete pTask;
+}
+
+
+static void rwmap_compile_done(void *param)
+{
+    RewriteMapDbTask *pTask = (RewriteMapDbTask *)param;
+    if (pTask->m_pDb)
+        pTask->m_pDb->onCompiled(pTask);
+}
+
+
+static struct ls_offload_api s_compileApi =
+{
+    rwmap_compile_perform,
+    rwmap_compile_release,
+    rwmap_compile_done
+};
+
+
+int RewriteMapDb::compileAsync()
+{
+    if (!s_pCompileOffloader)
+    {
+        s_pCompileOffloader = offloader_new2("REWRITE_MAP_DB", 1, 1, 10, 5);
+        if (!s_pCompileOffloader)
+            return LS_FAIL;
+    }
+    RewriteMapDbTask *pTask = new RewriteMapDbTask();
+    memset(&pTask->m_header, 0, sizeof(pTask->m_header));
+    pTask->m_header.api = &s_compileApi;
+    pTask->m_header.param_task_done = pTask;
+    pTask->m_pDb = this;
+    pTask->m_sSrcPath.setStr(m_sSrcPath.c_str(), m_sSrcPath.len());
+    pTask->m_sDbPath.setStr(m_sDbPath.c_str(), m_sDbPath.len());
+    pTask->m_iResult = LS_FAIL;
+    LS_DBG_L("[RewriteMap] %s changed, rebuild %s.", m_sSrcPath.c_str(),
+             m_sDbPath.c_str());
+    //offloader_enqueue() releases the task by itself on failure.
+    if (offloader_enqueue(s_pCompileOffloader, &pTask->m_header) != LS_OK)
+        return LS_FAIL;
+    m_pTask = pTask;
+    return LS_OK;
+}
+
+
+void RewriteMapDb::onCompiled(RewriteMapDbTask *pTask)
+{
+    m_pTask = NULL;
+    if (pTask->m_iResult != LS_OK)
+    {
+        m_iCompileFailed = 1;
+        return;
+    }
+    map();
+}
+
+
+/**
+ * At most once a second: remap the compiled file when it has been swapped,
+ * and have a changed text source rebuilt off the event loop, the current
+ * index is served until the new one is in place. Fails only when the
+ * source changed and the index cannot be rebuilt.
+ */
+int RewriteMapDb::refresh()
+{
+    struct stat st;
+    if (m_iCompileFailed)
+        return LS_FAIL;
+    if (m_lastCheck == DateTime::s_curTime)
+        return LS_OK;
+    m_lastCheck = DateTime::s_curTime;
+    if ((ls_fio_stat(m_sDbPath.c_str(), &st) == 0)
+        && ((st.st_ino != m_ino) || (st.st_mtime != m_mtime)))
+        map();
+    if (!m_pTask && isSrcNewer() && (compileAsync() != LS_OK))
+        return LS_FAIL;
+    return LS_OK;
+}
+
+
+int RewriteMapDb::lookup(const char *pKey, int keyLen, const char *&pValue)
+{
+    const RewriteMapDbHeader *pHeader = (const RewriteMapDbHeader *)m_pMap;
+    const RewriteMapDbSlot *pTable;
+    const RewriteMapDbEntry *pEntry;
+    uint32_t hash, mask, n, i;
+    if (!pHeader)
+        return LS_FAIL;
+    pTable = (const RewriteMapDbSlot *)(m_pMap + pHeader->m_iTableOff);
+    hash = XXH32(pKey, keyLen, 0);
+    mask = pHeader->m_iBuckets - 1;
+    for (i = 0, n = hash & mask; i < pHeader->m_iBuckets;
+         ++i, n = (n + 1) & mask)
+    {
+        if (pTable[n].m_iOff == 0)
+            break;
+        if ((pTable[n].m_iHash != hash)
+            || (pTable[n].m_iOff > m_iMapSize - sizeof(RewriteMapDbEntry)))
+            continue;
+        pEntry = (const RewriteMapDbEntry *)(m_pMap + pTable[n].m_iOff);
+        if ((pEntry->m_iKeyLen != keyLen)
+            || (pTable[n].m_iOff + entrySize(pEntry->m_iKeyLen,
+                                             pEntry->m_iValLen) > m_iMapSize)
+            || (memcmp(pEntry->m_data, pKey, keyLen) != 0))
+            continue;
+        pValue = pEntry->m_data + keyLen + 1;
+        return pEntry->m_iValLen;
+    }
+    return LS_FAIL;
+}
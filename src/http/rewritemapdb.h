@@ -0,0 +1,87 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#ifndef REWRITEMAPDB_H
+#define REWRITEMAPDB_H
+
+
+#include <lsdef.h>
+#include <util/autostr.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define RWMAP_DB_MAGIC      "LSRWMAP\1"
+#define RWMAP_DB_SUFFIX     ".lsmap"
+
+/**
+ * Compiled RewriteMap: a read-only open addressing hash table stored in a
+ * single file, mmapped by every worker. A rebuild writes a temporary file
+ * and rename()s it over the old one, readers pick up the new inode on
+ * their next check. Workers rebuild a changed source on an offloader
+ * thread, one at a time, and keep serving the old index meanwhile.
+ */
+struct RewriteMapDbHeader
+{
+    char        m_magic[8];
+    uint32_t    m_iBuckets;     //power of 2
+    uint32_t    m_iEntries;
+    uint32_t    m_iTableOff;
+    uint32_t    m_iDataOff;
+    uint64_t    m_iSize;
+    int64_t     m_iSrcMtime;
+    int64_t     m_iSrcSize;
+};
+
+
+struct RewriteMapDbTask;
+
+class RewriteMapDb
+{
+    AutoStr2        m_sDbPath;
+    AutoStr2        m_sSrcPath;
+    char           *m_pMap;
+    size_t          m_iMapSize;
+    ino_t           m_ino;
+    time_t          m_mtime;
+    time_t          m_lastCheck;
+    RewriteMapDbTask *m_pTask;
+    int             m_iCompileFailed;
+
+    int  map();
+    void unmap();
+    int  isSrcNewer() const;
+    int  compileAsync();
+
+public:
+    RewriteMapDb();
+    ~RewriteMapDb();
+
+    int  attach(const char *pDbPath, const char *pSrcPath);
+    int  refresh();
+    int  lookup(const char *pKey, int keyLen, const char *&pValue);
+    const char *getDbPath() const   {   return m_sDbPath.c_str();   }
+    void onCompiled(RewriteMapDbTask *pTask);
+
+    static int isDbFile(const char *pPath);
+    static int compile(const char *pSrcPath, const char *pDbPath);
+
+    LS_NO_COPY_ASSIGN(RewriteMapDb);
+};
+
+#endif
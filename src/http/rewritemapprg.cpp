@@ -0,0 +1,533 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "rewritemapprg.h"
+
+#include <edio/evtcbque.h>
+#include <http/httpsession.h>
+#include <http/rewritemap.h>
+#include <log4cxx/logger.h>
+#include <lsr/ls_fileio.h>
+#include <lsr/ls_offload.h>
+#include <util/datetime.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+//how long an answer is reused, keeps it for the sessions it resumes
+static int s_iAnswerTtl = 1;
+static int s_iPrgWorkers = 2;
+static struct Offloader *s_pPrgOffloader = NULL;
+
+
+struct PrgAnswer
+{
+    AutoStr2    m_key;
+    AutoStr2    m_value;
+    time_t      m_tmAnswered;       //0 while queued or in flight
+    int         m_iHasValue;
+    TPointerList<evtcbnode_s> m_waiters;
+};
+
+
+struct RewriteMapPrgTask
+{
+    ls_offload_t        m_header;
+    RewriteMapPrg      *m_pPrg;
+    PrgProcess         *m_pProc;
+    int                 m_iCount;
+    int                 m_iAnswered;
+    PrgAnswer          *m_pAnswers[RWMAP_PRG_MAX_BATCH];
+    AutoStr2            m_keys[RWMAP_PRG_MAX_BATCH];
+    AutoStr2            m_values[RWMAP_PRG_MAX_BATCH];
+    char                m_found[RWMAP_PRG_MAX_BATCH];
+};
+
+
+/**
+ * The co-process, only touched by the offloader thread running a batch.
+ */
+class PrgProcess
+{
+public:
+    AutoStr2    m_sCommand;
+    int         m_fd;
+    pid_t       m_pid;
+    time_t      m_lastStart;
+
+    PrgProcess()
+        : m_fd(-1)
+        , m_pid(-1)
+        , m_lastStart(-1)
+    {}
+    ~PrgProcess()   {   stop();     }
+
+    int  start();
+    void stop();
+    int  waitFd(short events, long long deadline);
+    int  exchange(RewriteMapPrgTask *pTask);
+
+    LS_NO_COPY_ASSIGN(PrgProcess);
+};
+
+
+static long long nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/**
+ * Runs in the forked child, leaves nothing but stdio to the program.
+ */
+static void closeInheritedFds(int from)
+{
+    struct rlimit rl;
+    long max = 65536;
+#if defined(SYS_close_range)
+    if (syscall(SYS_close_range, from, ~0U, 0) == 0)
+        return;
+#endif
+    if ((getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur != RLIM_INFINITY))
+        max = rl.rlim_cur;
+    for (long fd = from; fd < max; ++fd)
+        close(fd);
+}
+
+
+int PrgProcess::start()
+{
+    int fds[2];
+    //do not respawn a crashing program more than once a second
+    if (m_lastStart == DateTime::s_curTime)
+        return LS_FAIL;
+    m_lastStart = DateTime::s_curTime;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+    {
+        LS_ERROR("[RewriteMap] socketpair() failed: %s", strerror(errno));
+        return LS_FAIL;
+    }
+    m_pid = fork();
+    if (m_pid == 0)
+    {
+        dup2(fds[1], STDIN_FILENO);
+        dup2(fds[1], STDOUT_FILENO);
+        closeInheritedFds(STDERR_FILENO + 1);
+        execl("/bin/sh", "sh", "-c", m_sCommand.c_str(), (char *)NULL);
+        _exit(1);
+    }
+    close(fds[1]);
+    if (m_pid == -1)
+    {
+        LS_ERROR("[RewriteMap] fork() failed for prg:%s: %s",
+                 m_sCommand.c_str(), strerror(errno));
+        close(fds[0]);
+        return LS_FAIL;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    m_fd = fds[0];
+    LS_INFO("[RewriteMap] started prg:%s, pid: %d.", m_sCommand.c_str(),
+            (int)m_pid);
+    return LS_OK;
+}
+
+
+/**
+ * The worker reaps the child in its SIGCHLD handler.
+ */
+void PrgProcess::stop()
+{
+    if (m_fd != -1)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+    if (m_pid > 0)
+    {
+        kill(m_pid, SIGTERM);
+        m_pid = -1;
+    }
+}
+
+
+int PrgProcess::waitFd(short events, long long deadline)
+{
+    struct pollfd pfd;
+    int timeout, ret;
+    pfd.fd = m_fd;
+    pfd.events = events;
+    while ((timeout = deadline - nowMs()) > 0)
+    {
+        ret = poll(&pfd, 1, timeout);
+        if (ret > 0)
+            return (pfd.revents & (events | POLLHUP | POLLERR)) ? LS_OK : LS_FAIL;
+        if ((ret == -1) && (errno != EINTR))
+            return LS_FAIL;
+    }
+    return LS_FAIL;
+}
+
+
+static void setResult(RewriteMapPrgTask *pTask, const char *pLine,
+                      const char *pLineEnd)
+{
+    int idx = pTask->m_iAnswered++;
+    if ((pLineEnd > pLine) && (*(pLineEnd - 1) == '\r'))
+        --pLineEnd;
+    pTask->m_found[idx] = !((pLineEnd - pLine == 4)
+                            && (memcmp(pLine, "NULL", 4) == 0));
+    if (pTask->m_found[idx])
+        pTask->m_values[idx].setStr(pLine, pLineEnd - pLine);
+}
+
+
+/**
+ * Writes the whole batch while reading answers as they come, answers are
+ * matched to keys by order; a late, extra or oversized answer would be
+ * taken for a later key, so any protocol error restarts the program.
+ */
+int PrgProcess::exchange(RewriteMapPrgTask *pTask)
+{
+    char achBuf[4096];
+    AutoStr2 sOut;
+    const char *pBegin, *pEnd;
+    int len = 0, sent = 0, ret;
+    long long deadline;
+
+    if ((m_fd == -1) && (start() != LS_OK))
+        return LS_FAIL;
+    for (int i = 0; i < pTask->m_iCount; ++i)
+    {
+        sOut.append(pTask->m_keys[i].c_str(), pTask->m_keys[i].len());
+        sOut.append("\n", 1);
+    }
+
+    deadline = nowMs() + RWMAP_PRG_TIMEOUT_MS;
+    while (pTask->m_iAnswered < pTask->m_iCount)
+    {
+        if (sent < (int)sOut.len())
+        {
+            ret = write(m_fd, sOut.c_str() + sent, sOut.len() - sent);
+            if (ret > 0)
+            {
+                sent += ret;
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EINTR))
+                goto ERROR;
+        }
+        ret = ls_fio_read(m_fd, achBuf + len, sizeof(achBuf) - len);
+        if (ret > 0)
+        {
+            len += ret;
+            pBegin = achBuf;
+            while ((pEnd = (const char *)memchr(pBegin, '\n',
+                                                achBuf + len - pBegin)) != NULL)
+            {
+                if (pTask->m_iAnswered >= pTask->m_iCount)
+                    goto ERROR;
+                setResult(pTask, pBegin, pEnd);
+                pBegin = pEnd + 1;
+            }
+            len -= pBegin - achBuf;
+            if (len >= (int)sizeof(achBuf))
+                goto ERROR;
+            memmove(achBuf, pBegin, len);
+            continue;
+        }
+        if ((ret == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+            goto ERROR;
+        if ((errno == EAGAIN)
+            && (waitFd(POLLIN | ((sent < (int)sOut.len()) ? POLLOUT : 0),
+                       deadline) != LS_OK))
+            goto ERROR;
+    }
+    if (len == 0)
+        return LS_OK;
+
+ERROR:
+    LS_WARN("[RewriteMap] prg:%s answered %d of %d keys, restart.",
+            m_sCommand.c_str(), pTask->m_iAnswered, pTask->m_iCount);
+    stop();
+    return LS_FAIL;
+}
+
+
+static int prg_batch_perform(ls_offload *item)
+{
+    RewriteMapPrgTask *pTask = (RewriteMapPrgTask *)item;
+    pTask->m_pProc->exchange(pTask);
+    return 0;
+}
+
+
+static void prg_batch_release(ls_offload *item)
+{
+    RewriteMapPrgTask *pTask = (RewriteMapPrgTask *)item;
+    if (--pTask->m_header.ref_cnt > 0)
+        return;
+    //the map went away while the batch was in flight
+    if (!pTask->m_pPrg)
+        delete pTask->m_pProc;
+    delete pTask;
+}
+
+
+static void prg_batch_done(void *param)
+{
+    RewriteMapPrgTask *pTask = (RewriteMapPrgTask *)param;
+    if (pTask->m_pPrg)
+        pTask->m_pPrg->onBatchDone(pTask);
+}
+
+
+static struct ls_offload_api s_prgApi =
+{
+    prg_batch_perform,
+    prg_batch_release,
+    prg_batch_done
+};
+
+
+static struct Offloader *getPrgOffloader()
+{
+    if (!s_pPrgOffloader && s_iPrgWorkers > 0)
+    {
+        s_pPrgOffloader = offloader_new2("REWRITE_MAP", s_iPrgWorkers,
+                                         1, 10, 5);
+        if (!s_pPrgOffloader)
+            s_iPrgWorkers = 0;
+    }
+    return s_pPrgOffloader;
+}
+
+
+/**
+ * Drops a waiter without resuming it, the session may still hold a back
+ * reference to the node.
+ */
+static void cancelWaiter(evtcbnode_s *pNode)
+{
+    evtcbhead_t *pHead = *EvtcbQue::getSessionRefPtr(pNode);
+    if (pHead)
+        ((HttpSession *)(LsiSession *)pHead)->cancelEvent(pNode);
+    else
+        EvtcbQue::getInstance().recycle(pNode);
+}
+
+
+static int deleteAnswer(const void *pKey, void *pData)
+{
+    PrgAnswer *pAnswer = (PrgAnswer *)pData;
+    for (int i = 0; i < pAnswer->m_waiters.size(); ++i)
+        cancelWaiter(pAnswer->m_waiters[i]);
+    delete pAnswer;
+    return 0;
+}
+
+
+RewriteMapPrg::RewriteMapPrg()
+    : m_pProc(new PrgProcess())
+    , m_pTask(NULL)
+{
+}
+
+
+RewriteMapPrg::~RewriteMapPrg()
+{
+    //a batch in flight still uses the process, it frees it when done
+    if (m_pTask)
+        m_pTask->m_pPrg = NULL;
+    else
+        delete m_pProc;
+    m_answers.for_each0(m_answers.begin(), m_answers.end(), deleteAnswer);
+    m_answers.clear();
+}
+
+
+void RewriteMapPrg::setCommand(const char *pCmd)
+{
+    m_pProc->m_sCommand.setStr(pCmd);
+}
+
+
+const char *RewriteMapPrg::getCommand() const
+{
+    return m_pProc->m_sCommand.c_str();
+}
+
+
+/**
+ * Drops answers past their ttl that nobody waits for.
+ */
+void RewriteMapPrg::purgeAnswers()
+{
+    TPointerList<PrgAnswer> stale;
+    GHash::iterator iter;
+    for (iter = m_answers.begin(); iter != m_answers.end();
+         iter = m_answers.next(iter))
+    {
+        PrgAnswer *pAnswer = (PrgAnswer *)iter->second();
+        if (pAnswer->m_tmAnswered
+            && (DateTime::s_curTime - pAnswer->m_tmAnswered > s_iAnswerTtl))
+            stale.push_back(pAnswer);
+    }
+    for (int i = 0; i < stale.size(); ++i)
+    {
+        m_answers.remove(stale[i]->m_key.c_str());
+        delete stale[i];
+    }
+}
+
+
+PrgAnswer *RewriteMapPrg::getAnswer(const char *pKey, int keyLen)
+{
+    char achKey[1024];
+    if (keyLen >= (int)sizeof(achKey))
+        return NULL;
+    memmove(achKey, pKey, keyLen);
+    achKey[keyLen] = 0;
+    HashStringMap<PrgAnswer *>::iterator iter = m_answers.find(achKey);
+    if (iter != m_answers.end())
+        return iter.second();
+
+    if ((int)m_answers.size() >= RWMAP_PRG_MAX_ANSWERS)
+        purgeAnswers();
+    PrgAnswer *pAnswer = new PrgAnswer();
+    pAnswer->m_key.setStr(pKey, keyLen);
+    pAnswer->m_tmAnswered = 0;
+    pAnswer->m_iHasValue = 0;
+    m_answers.insert(pAnswer->m_key.c_str(), pAnswer);
+    m_queued.push_back(pAnswer);
+    return pAnswer;
+}
+
+
+/**
+ * Sends the next batch of queued keys, one batch in flight at a time.
+ */
+int RewriteMapPrg::submit()
+{
+    if (m_pTask || m_queued.empty())
+        return LS_OK;
+    RewriteMapPrgTask *pTask = new RewriteMapPrgTask();
+    memset(&pTask->m_header, 0, sizeof(pTask->m_header));
+    pTask->m_header.api = &s_prgApi;
+    pTask->m_header.param_task_done = pTask;
+    pTask->m_pPrg = this;
+    pTask->m_pProc = m_pProc;
+    pTask->m_iAnswered = 0;
+    pTask->m_iCount = m_queued.pop_front((void **)pTask->m_pAnswers,
+                                         RWMAP_PRG_MAX_BATCH);
+    for (int i = 0; i < pTask->m_iCount; ++i)
+        pTask->m_keys[i].setStr(pTask->m_pAnswers[i]->m_key.c_str(),
+                                pTask->m_pAnswers[i]->m_key.len());
+    m_pTask = pTask;
+
+    //keep a reference of our own, offloader_enqueue() releases the task
+    //by itself on failure.
+    pTask->m_header.ref_cnt = 1;
+    struct Offloader *pOffloader = getPrgOffloader();
+    int ret = pOffloader ? offloader_enqueue(pOffloader, &pTask->m_header)
+                         : LS_FAIL;
+    if (ret != LS_OK)
+    {
+        LS_ERROR("[RewriteMap] prg:%s cannot queue lookups.", getCommand());
+        onBatchDone(pTask);
+    }
+    prg_batch_release(&pTask->m_header);
+    return ret;
+}
+
+
+/**
+ * Runs on the event loop, stores the answers and resumes the sessions
+ * waiting for them.
+ */
+void RewriteMapPrg::onBatchDone(RewriteMapPrgTask *pTask)
+{
+    for (int i = 0; i < pTask->m_iCount; ++i)
+    {
+        PrgAnswer *pAnswer = pTask->m_pAnswers[i];
+        pAnswer->m_iHasValue = (i < pTask->m_iAnswered) && pTask->m_found[i];
+        if (pAnswer->m_iHasValue)
+            pAnswer->m_value.setStr(pTask->m_values[i].c_str(),
+                                    pTask->m_values[i].len());
+        pAnswer->m_tmAnswered = DateTime::s_curTime;
+        for (int j = 0; j < pAnswer->m_waiters.size(); ++j)
+            EvtcbQue::getInstance().schedule(pAnswer->m_waiters[j]);
+        pAnswer->m_waiters.clear();
+    }
+    m_pTask = NULL;
+    submit();
+}
+
+
+/**
+ * Returns RWMAP_PENDING when pSession has been queued for an answer that
+ * is not there yet, the caller suspends it and it gets resumed later.
+ */
+int RewriteMapPrg::lookup(const char *pKey, int keyLen, char *pValue,
+                          int valLen, HttpSession *pSession)
+{
+    if (memchr(pKey, '\n', keyLen))
+        return LS_FAIL;
+    PrgAnswer *pAnswer = getAnswer(pKey, keyLen);
+    if (!pAnswer)
+        return LS_FAIL;
+    if (pAnswer->m_tmAnswered
+        && (DateTime::s_curTime - pAnswer->m_tmAnswered > s_iAnswerTtl))
+    {
+        pAnswer->m_tmAnswered = 0;
+        m_queued.push_back(pAnswer);
+    }
+    if (!pAnswer->m_tmAnswered)
+        submit();
+
+    if (pAnswer->m_tmAnswered)
+    {
+        if (!pAnswer->m_iHasValue)
+            return LS_FAIL;
+        int len = pAnswer->m_value.len();
+        if (len > valLen)
+            len = valLen;
+        memmove(pValue, pAnswer->m_value.c_str(), len);
+        return len;
+    }
+    if (!pSession)
+        return LS_FAIL;
+    evtcbnode_s *pNode = EvtcbQue::getInstance().getNodeObj(
+                             HttpSession::hookResumeCallback, pSession,
+                             pSession->getSn(), NULL);
+    if (!pNode)
+        return LS_FAIL;
+    pSession->setBackRefPtr(EvtcbQue::getSessionRefPtr(pNode));
+    pAnswer->m_waiters.push_back(pNode);
+    return RWMAP_PENDING;
+}
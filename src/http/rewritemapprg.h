@@ -0,0 +1,71 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#ifndef REWRITEMAPPRG_H
+#define REWRITEMAPPRG_H
+
+
+#include <lsdef.h>
+#include <util/autostr.h>
+#include <util/gpointerlist.h>
+#include <util/hashstringmap.h>
+
+#define RWMAP_PRG_TIMEOUT_MS    1000
+#define RWMAP_PRG_MAX_BATCH     64
+#define RWMAP_PRG_MAX_ANSWERS   4096
+
+class HttpSession;
+class PrgProcess;
+struct PrgAnswer;
+struct RewriteMapPrgTask;
+
+/**
+ * prg: rewrite map, a long running co-process fed one key per line on
+ * stdin, answering one value per line on stdout ("NULL" for no value).
+ *
+ * The co-process is only talked to from an offloader thread; keys that
+ * miss the short lived answer cache are batched and written back to back,
+ * one batch in flight per map, while the session waiting for the answer
+ * is suspended and resumed once it arrives.
+ */
+class RewriteMapPrg
+{
+    PrgProcess             *m_pProc;
+    HashStringMap<PrgAnswer *> m_answers;
+    TPointerList<PrgAnswer> m_queued;
+    RewriteMapPrgTask      *m_pTask;
+
+    PrgAnswer *getAnswer(const char *pKey, int keyLen);
+    void purgeAnswers();
+    int  submit();
+
+public:
+    RewriteMapPrg();
+    ~RewriteMapPrg();
+
+    void setCommand(const char *pCmd);
+    const char *getCommand() const;
+
+    int lookup(const char *pKey, int keyLen, char *pValue, int valLen,
+               HttpSession *pSession);
+    void onBatchDone(RewriteMapPrgTask *pTask);
+
+    LS_NO_COPY_ASSIGN(RewriteMapPrg);
+};
+
+#endif
@@ -20,6 +20,7 @@
 #include <http/httplog.h>
 #include <http/httpstatuscode.h>
 #include <http/rewritemap.h>
+#include <http/rewriterulelist.h>
 #include <log4cxx/logger.h>
 #include <util/stringtool.h>
 
@@ -564,6 +565,8 @@ RewriteRule::RewriteRule()
     , m_flag(0)
     , m_statusCode(0)
     , m_skipRules(0)
+    , m_pRuleList(NULL)
+    , m_iLiteral(-1)
 {
 }
 
@@ -579,6 +582,9 @@ RewriteRule::RewriteRule(const RewriteRule &rhs)
     , m_skipRules(rhs.m_skipRules)
     , m_env(rhs.m_env)
     , m_pattern(rhs.m_pattern)
+    , m_sLiteral(rhs.m_sLiteral)
+    , m_pRuleList(NULL)
+    , m_iLiteral(-1)
 {
     compilePattern();
 }
@@ -1059,6 +1065,139 @@ int RewriteRule::compilePattern()
 }
 
 
+static int skipClass(const char *&p, const char *pEnd)
+{
+    if ((p < pEnd) && (*p == '^'))
+        ++p;
+    if ((p < pEnd) && (*p == ']'))
+        ++p;
+    while (p < pEnd)
+    {
+        char ch = *p++;
+        if (ch == ']')
+            return 0;
+        if ((ch == '\\') && (p < pEnd))
+            ++p;
+        else if ((ch == '[') && (p < pEnd) && (*p == ':'))
+        {
+            while ((p + 1 < pEnd) && !((*p == ':') && (*(p + 1) == ']')))
+                ++p;
+            p += 2;
+        }
+    }
+    return -1;
+}
+
+
+static int skipGroup(const char *&p, const char *pEnd)
+{
+    int depth = 1;
+    while (p < pEnd)
+    {
+        char ch = *p++;
+        if (ch == '\\')
+        {
+            if (p < pEnd)
+                ++p;
+        }
+        else if (ch == '[')
+        {
+            if (skipClass(p, pEnd) == -1)
+                return -1;
+        }
+        else if (ch == '(')
+            ++depth;
+        else if ((ch == ')') && (--depth == 0))
+            return 0;
+    }
+    return -1;
+}
+
+
+/**
+ * Finds the longest run of plain characters that every match of the
+ * pattern must contain, for the rule list's literal prefilter.  Groups,
+ * classes and anything quantified to zero end a run; a top-level
+ * alternation or \\Q leaves the rule without a literal.  The literal is
+ * kept lower case, the prefilter ignores case.
+ */
+void RewriteRule::extractLiteral()
+{
+    char achRun[256];
+    char achBest[256];
+    int runLen = 0;
+    int bestLen = 0;
+    int lit;
+    const char *p = m_pattern.c_str();
+    const char *pEnd = p + strlen(p);
+
+    m_sLiteral.setStr("", 0);
+    while (1)
+    {
+        lit = -1;
+        if (p < pEnd)
+        {
+            char ch = *p++;
+            switch (ch)
+            {
+            case '|':
+                return;
+            case '\\':
+                if ((p >= pEnd) || (*p == 'Q'))
+                    return;
+                ch = *p++;
+                if (!isalnum(ch) && !(ch & 0x80))
+                    lit = ch;
+                else if (!strchr("dDsSwWbBAzZ", ch))
+                    return;     //escape with arguments, give up
+                break;
+            case '(':
+                if (skipGroup(p, pEnd) == -1)
+                    return;
+                break;
+            case '[':
+                if (skipClass(p, pEnd) == -1)
+                    return;
+                break;
+            case '{':
+                while ((p < pEnd) && (*p++ != '}'))
+                    ;
+                //fall through
+            case '?':
+            case '*':
+                if (runLen > 0)
+                    --runLen;
+                break;
+            case '.':
+            case '^':
+            case '$':
+            case '+':
+                break;
+            default:
+                if (!(ch & 0x80))
+                    lit = ch;
+                break;
+            }
+            if ((lit != -1) && (runLen < (int)sizeof(achRun)))
+            {
+                achRun[runLen++] = tolower(lit);
+                continue;
+            }
+        }
+        if (runLen > bestLen)
+        {
+            memmove(achBest, achRun, runLen);
+            bestLen = runLen;
+        }
+        runLen = 0;
+        if (p >= pEnd)
+            break;
+    }
+    if (bestLen >= REWRITE_MIN_LITERAL)
+        m_sLiteral.setStr(achBest, bestLen);
+}
+
+
 int RewriteRule::parseRule(char *pRule, const char *pEnd,
                            const RewriteMapList *pMaps)
 {
@@ -1103,6 +1242,8 @@ int RewriteRule::parseRule(char *pRule, const char *pEnd,
         HttpLog::parse_error(s_pCurLine,  "failed to parse rewrite pattern");
         return LS_FAIL;
     }
+    if (!(m_flag & RULE_FLAG_NOMATCH))
+        extractLiteral();
     return 0;
 
 }
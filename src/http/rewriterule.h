@@ -81,6 +81,7 @@ END_LOG4CXX_NS
 
 class RewriteMap;
 class RewriteMapList;
+class RewriteRuleList;
 class MapRefItem;
 
 
@@ -191,6 +192,9 @@ class RewriteRule : public LinkedObj
     int                         m_skipRules;
     TLinkList<RewriteSubstFormat> m_env;
     AutoStr                     m_pattern;
+    AutoStr2                    m_sLiteral;
+    const RewriteRuleList      *m_pRuleList;
+    int                         m_iLiteral;
 
 
     int parseRuleSubst(const char *&pRuleStr, const char *pEnd,
@@ -200,6 +204,7 @@ class RewriteRule : public LinkedObj
     int parseOneFlag(const char *&pRuleStr, const char *pEnd,
                      const RewriteMapList *pMaps);
     int compilePattern();
+    void extractLiteral();
     void operator=(const RewriteRule &rhs);
 
 public:
@@ -221,6 +226,14 @@ public:
     const TLinkList<RewriteSubstFormat> *getEnv() const
     {   return &m_env;      }
     const char *getPattern() const {   return m_pattern.c_str();   }
+
+    const char *getLiteral() const  {   return m_sLiteral.c_str();  }
+    int     getLiteralLen() const   {   return m_sLiteral.len();    }
+    int     getLiteralId() const    {   return m_iLiteral;          }
+    const RewriteRuleList *getRuleList() const {   return m_pRuleList; }
+    void    setLiteralId(const RewriteRuleList *pList, int id)
+    {   m_pRuleList = pList;    m_iLiteral = id;    }
+
     int parseCookieAction(const char *pRuleStr, const char *pEnd);
     static void setLogger(LOG4CXX_NS::Logger *pLogger, const char *pId);
     static void error(const char *pError);
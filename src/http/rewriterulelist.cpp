@@ -18,11 +18,114 @@
 #include "rewriterulelist.h"
 #include "rewriterule.h"
 
+#include <string.h>
+
+
 RewriteRuleList::RewriteRuleList()
+    : m_pFilter(NULL)
+    , m_iLiterals(0)
 {}
 
 RewriteRuleList::~RewriteRuleList()
 {
+    if (m_pFilter)
+        ls_aho_delete(m_pFilter);
     release_objects();
 }
 
+
+/**
+ * Numbers the distinct required literals of the rules and loads them into
+ * one case-insensitive Aho-Corasick tree, so a single pass over the URL
+ * tells which rules can possibly match.  ls_aho drops a pattern that has
+ * another pattern as its prefix; such a literal is replaced by its
+ * shortest prefix literal, which is present whenever it is.
+ */
+void RewriteRuleList::buildFilter()
+{
+    const char *aLit[REWRITE_MAX_LITERALS];
+    int aLen[REWRITE_MAX_LITERALS];
+    int aRoot[REWRITE_MAX_LITERALS];
+    RewriteRule *pRule;
+    int i, j, len;
+
+    if (m_pFilter)
+    {
+        ls_aho_delete(m_pFilter);
+        m_pFilter = NULL;
+    }
+    m_iLiterals = 0;
+    for (pRule = begin(); pRule; pRule = (RewriteRule *)pRule->next())
+    {
+        pRule->setLiteralId(NULL, -1);
+        len = pRule->getLiteralLen();
+        if (len < REWRITE_MIN_LITERAL)
+            continue;
+        for (i = 0; i < m_iLiterals; ++i)
+            if ((aLen[i] == len)
+                && (memcmp(aLit[i], pRule->getLiteral(), len) == 0))
+                break;
+        if (i == m_iLiterals)
+        {
+            if (m_iLiterals == REWRITE_MAX_LITERALS)
+                continue;
+            aLit[i] = pRule->getLiteral();
+            aLen[i] = len;
+            ++m_iLiterals;
+        }
+        pRule->setLiteralId(this, i);
+    }
+    if (m_iLiterals == 0)
+        return;
+
+    for (i = 0; i < m_iLiterals; ++i)
+    {
+        aRoot[i] = i;
+        for (j = 0; j < m_iLiterals; ++j)
+            if ((aLen[j] < aLen[aRoot[i]])
+                && (memcmp(aLit[j], aLit[i], aLen[j]) == 0))
+                aRoot[i] = j;
+    }
+    m_pFilter = ls_aho_new(0);
+    for (i = 0; m_pFilter && i < m_iLiterals; ++i)
+    {
+        if ((aRoot[i] == i)
+            && !ls_aho_addpattern(m_pFilter, aLit[i], aLen[i], (void *)(long)i))
+        {
+            ls_aho_delete(m_pFilter);
+            m_pFilter = NULL;
+        }
+    }
+    if (m_pFilter && !ls_aho_maketree(m_pFilter, 1))
+    {
+        ls_aho_delete(m_pFilter);
+        m_pFilter = NULL;
+    }
+    for (pRule = begin(); pRule; pRule = (RewriteRule *)pRule->next())
+    {
+        if (pRule->getLiteralId() < 0)
+            continue;
+        if (m_pFilter)
+            pRule->setLiteralId(this, aRoot[pRule->getLiteralId()]);
+        else
+            pRule->setLiteralId(NULL, -1);
+    }
+}
+
+
+static int markLiteral(void *pCtx, void *pArg)
+{
+    long id = (long)pCtx;
+    ((unsigned char *)pArg)[id >> 3] |= 1 << (id & 7);
+    return 0;
+}
+
+
+void RewriteRuleList::scanLiterals(const char *pSubject, int len,
+                                   unsigned char *pHits) const
+{
+    memset(pHits, 0, (m_iLiterals + 7) >> 3);
+    if (m_pFilter)
+        ls_aho_search_all(m_pFilter, pSubject, len, markLiteral, pHits);
+}
+
@@ -20,14 +20,25 @@
 
 
 
+#include <lsr/ls_aho.h>
 #include <util/tlinklist.h>
 
+#define REWRITE_MAX_LITERALS    1024
+#define REWRITE_MIN_LITERAL     3
+
 class RewriteRule;
 class RewriteRuleList : public TLinkList< RewriteRule >
 {
+    ls_aho_t   *m_pFilter;
+    int         m_iLiterals;
+
 public:
     RewriteRuleList();
     ~RewriteRuleList();
+
+    void buildFilter();
+    void scanLiterals(const char *pSubject, int len,
+                      unsigned char *pHits) const;
 };
 
 #endif
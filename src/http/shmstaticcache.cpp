@@ -0,0 +1,366 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#include <http/shmstaticcache.h>
+
+#include <log4cxx/logger.h>
+#include <lsr/ls_atomic.h>
+#include <shm/lsshmhash.h>
+#include <util/datetime.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SHM_STATIC_INFO_MAGIC   0x53464301
+#define SHM_STATIC_MAX_KEY      4096
+#define SHM_STATIC_PIN_TTL      3600    // pins of a crashed worker expire
+#define SHM_STATIC_MAX_VICTIMS  32
+#define SHM_STATIC_WINDOW       60      // recency window for frequency ties
+
+// count-min sketch, one row of 8-bit counters per hash seed
+#define SKETCH_DEPTH            4
+#define SKETCH_MIN_WIDTH        1024
+#define SKETCH_MAX_WIDTH        (1024 * 1024)
+
+
+typedef struct
+{
+    uint64_t            x_iIno;
+    int64_t             x_iSize;
+    int64_t             x_iMtime;
+} StaticKeyHdr;
+
+
+typedef struct
+{
+    uint32_t            x_iMagic;
+    uint32_t            x_iWidthMask;
+    uint64_t            x_iUsed;
+    uint64_t            x_iMax;
+    uint32_t            x_iSamples;
+    uint32_t            x_iPad;
+    uint8_t             x_sketch[0];
+} ShmStaticInfo;
+
+
+static const uint32_t s_sketchSeeds[SKETCH_DEPTH] =
+{   0x9E3779B1, 0x85EBCA77, 0xC2B2AE3D, 0x27D4EB2F  };
+
+
+LsShmHash *ShmStaticCache::s_pShmTable = NULL;
+LsShmOffset_t ShmStaticCache::s_iInfoOff = 0;
+size_t ShmStaticCache::s_iMaxSize = 0;
+
+
+static inline uint8_t *sketchCounter(ShmStaticInfo *pInfo, int row,
+                                     uint32_t hkey)
+{
+    uint32_t h = hkey * s_sketchSeeds[row];
+    h ^= h >> 15;
+    return &pInfo->x_sketch[row * (pInfo->x_iWidthMask + 1)
+                            + (h & pInfo->x_iWidthMask)];
+}
+
+
+static int sketchEstimate(ShmStaticInfo *pInfo, uint32_t hkey)
+{
+    int freq = 255;
+    for (int i = 0; i < SKETCH_DEPTH; ++i)
+    {
+        int c = *sketchCounter(pInfo, i, hkey);
+        if (c < freq)
+            freq = c;
+    }
+    return freq;
+}
+
+
+/**
+ * Conservative update: only the counters holding the current estimate are
+ * bumped.  Every 10 x width samples all counters are halved so that the
+ * history of files no longer requested fades out.
+ */
+static void sketchIncrement(ShmStaticInfo *pInfo, uint32_t hkey)
+{
+    int freq = sketchEstimate(pInfo, hkey);
+    if (freq < 255)
+    {
+        for (int i = 0; i < SKETCH_DEPTH; ++i)
+        {
+            uint8_t *p = sketchCounter(pInfo, i, hkey);
+            if (*p == freq)
+                ++*p;
+        }
+    }
+    if (++pInfo->x_iSamples >= (pInfo->x_iWidthMask + 1) * 10)
+    {
+        uint8_t *p = pInfo->x_sketch;
+        uint8_t *pEnd = p + SKETCH_DEPTH * (pInfo->x_iWidthMask + 1);
+        for (; p < pEnd; ++p)
+            *p >>= 1;
+        pInfo->x_iSamples >>= 1;
+    }
+}
+
+
+static int buildKey(char *pBuf, const char *pPath, ino_t inode, off_t size,
+                    time_t lastMod)
+{
+    int len = strlen(pPath);
+    if (len > SHM_STATIC_MAX_KEY)
+        return LS_FAIL;
+    StaticKeyHdr *pHdr = (StaticKeyHdr *)pBuf;
+    pHdr->x_iIno = inode;
+    pHdr->x_iSize = size;
+    pHdr->x_iMtime = lastMod;
+    memmove(pBuf + sizeof(StaticKeyHdr), pPath, len);
+    return sizeof(StaticKeyHdr) + len;
+}
+
+
+int ShmStaticCache::initShm(int uid, int gid)
+{
+    if (!s_iMaxSize || s_pShmTable)
+        return 0;
+    s_pShmTable = LsShmHash::open("static_file", "StaticFile", 1000,
+                                  LSSHM_FLAG_LRU);
+    if (!s_pShmTable)
+    {
+        LS_WARN("Failed to open SHM for static file cache, "
+                "static files are cached per worker.");
+        return LS_FAIL;
+    }
+    s_pShmTable->getPool()->getShm()->chperm(uid, gid, 0600);
+    s_pShmTable->disableAutoLock();
+
+    uint32_t width = SKETCH_MIN_WIDTH;
+    while (width < SKETCH_MAX_WIDTH && width < s_iMaxSize / 2048)
+        width <<= 1;
+
+    s_pShmTable->lock();
+    LsShm *pShm = s_pShmTable->getPool()->getShm();
+    ShmStaticInfo *pInfo = NULL;
+    LsShmReg *pReg = pShm->findReg("STATICINFO");
+    if (pReg)
+    {
+        pInfo = (ShmStaticInfo *)s_pShmTable->offset2ptr(pReg->x_iValue);
+        if (pInfo->x_iMagic != SHM_STATIC_INFO_MAGIC)
+            pInfo = NULL;
+    }
+    if (!pInfo)
+    {
+        LsShmOffset_t off = s_pShmTable->alloc2(sizeof(ShmStaticInfo)
+                                                + SKETCH_DEPTH * width);
+        if (off && (pReg = pShm->addReg("STATICINFO")) != NULL)
+        {
+            pInfo = (ShmStaticInfo *)s_pShmTable->offset2ptr(off);
+            memset(pInfo, 0, sizeof(ShmStaticInfo) + SKETCH_DEPTH * width);
+            pInfo->x_iMagic = SHM_STATIC_INFO_MAGIC;
+            pInfo->x_iWidthMask = width - 1;
+            pReg->x_iValue = off;
+        }
+    }
+    if (pInfo)
+    {
+        pInfo->x_iMax = s_iMaxSize;
+        s_iInfoOff = s_pShmTable->ptr2offset(pInfo);
+    }
+    s_pShmTable->unlock();
+    if (!pInfo)
+    {
+        LS_WARN("Failed to initialize SHM static file cache.");
+        s_pShmTable->close();
+        s_pShmTable = NULL;
+        return LS_FAIL;
+    }
+    return 0;
+}
+
+
+static const char *pinEntry(LsShmHash *pTable, LsShmHash::iteroffset iterOff,
+                            LsShmOffset_t *pEntry)
+{
+    lsShmStaticEntry_t *pStatic =
+        (lsShmStaticEntry_t *)pTable->offset2iteratorData(iterOff);
+    ls_atomic_add(&pStatic->x_iRef, 1);
+    pStatic->x_tmAccess = DateTime::s_curTime;
+    pTable->touchLru(iterOff);
+    *pEntry = pTable->ptr2offset(pStatic);
+    return (const char *)pTable->offset2ptr(pStatic->x_iBody);
+}
+
+
+const char *ShmStaticCache::lookup(const char *pPath, ino_t inode,
+                                   off_t size, time_t lastMod,
+                                   LsShmOffset_t *pEntry)
+{
+    char achKey[sizeof(StaticKeyHdr) + SHM_STATIC_MAX_KEY];
+    int keyLen = buildKey(achKey, pPath, inode, size, lastMod);
+    if (keyLen == LS_FAIL)
+        return NULL;
+
+    const char *pBody = NULL;
+    ls_strpair_t parms;
+    LsShmHash::setParms(&parms, achKey, keyLen, NULL, 0);
+    s_pShmTable->lock();
+    ShmStaticInfo *pInfo =
+        (ShmStaticInfo *)s_pShmTable->offset2ptr(s_iInfoOff);
+    sketchIncrement(pInfo, LsShmHash::hashXXH32(achKey, keyLen));
+    LsShmHash::iteroffset iterOff = s_pShmTable->findIterator(&parms);
+    if (iterOff.m_iOffset != 0)
+        pBody = pinEntry(s_pShmTable, iterOff, pEntry);
+    s_pShmTable->unlock();
+    return pBody;
+}
+
+
+/**
+ * TinyLFU admission: room is made by evicting from the LRU end, but only
+ * if the new file has been requested more often than every victim it
+ * would displace.  On a tie the victim loses only if it has not been used
+ * within the recency window, so a burst of new files can still get in.
+ * Entries pinned by a live worker are skipped.
+ * Must be called with the lock held.
+ */
+static int makeRoom(LsShmHash *pTable, ShmStaticInfo *pInfo, int freq,
+                    off_t size)
+{
+    LsShmHash::iteroffset victims[SHM_STATIC_MAX_VICTIMS];
+    int count = 0;
+    uint64_t freed = 0;
+    uint64_t need = pInfo->x_iUsed + size - pInfo->x_iMax;
+    time_t now = DateTime::s_curTime;
+    LsShmHash::iteroffset iterOff = pTable->getLruOldest();
+    int scanned = 0;
+    while (freed < need)
+    {
+        if (iterOff.m_iOffset == 0 || count >= SHM_STATIC_MAX_VICTIMS
+            || ++scanned > SHM_STATIC_MAX_VICTIMS * 4)
+            return LS_FAIL;
+        LsShmHash::iterator iter = pTable->offset2iterator(iterOff);
+        lsShmStaticEntry_t *pStatic = (lsShmStaticEntry_t *)iter->getVal();
+        if (pStatic->x_iRef <= 0
+            || now - (time_t)pStatic->x_tmAccess >= SHM_STATIC_PIN_TTL)
+        {
+            int victimFreq = sketchEstimate(pInfo, LsShmHash::hashXXH32(
+                                     iter->getKey(), iter->getKeyLen()));
+            if (victimFreq > freq || (victimFreq == freq
+                && now - (time_t)pStatic->x_tmAccess < SHM_STATIC_WINDOW))
+                return LS_FAIL;
+            victims[count++] = iterOff;
+            freed += pStatic->x_iSize;
+        }
+        iterOff = iter->getLruLinkNext();
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        lsShmStaticEntry_t *pStatic = (lsShmStaticEntry_t *)
+                                      pTable->offset2iteratorData(victims[i]);
+        pTable->release2(pStatic->x_iBody, pStatic->x_iSize);
+        pInfo->x_iUsed -= pStatic->x_iSize;
+        pTable->eraseIterator(victims[i]);
+    }
+    return LS_OK;
+}
+
+
+const char *ShmStaticCache::add(const char *pPath, ino_t inode, off_t size,
+                                time_t lastMod, int fd,
+                                LsShmOffset_t *pEntry)
+{
+    if (size <= 0 || (size_t)size > s_iMaxSize / 8)
+        return NULL;
+    char achKey[sizeof(StaticKeyHdr) + SHM_STATIC_MAX_KEY];
+    int keyLen = buildKey(achKey, pPath, inode, size, lastMod);
+    if (keyLen == LS_FAIL)
+        return NULL;
+
+    const char *pBody = NULL;
+    LsShmOffset_t offBody = 0;
+    ls_strpair_t parms;
+    LsShmHash::setParms(&parms, achKey, keyLen, NULL, 0);
+    s_pShmTable->lock();
+    ShmStaticInfo *pInfo =
+        (ShmStaticInfo *)s_pShmTable->offset2ptr(s_iInfoOff);
+    LsShmHash::iteroffset iterOff = s_pShmTable->findIterator(&parms);
+    if (iterOff.m_iOffset != 0)
+        pBody = pinEntry(s_pShmTable, iterOff, pEntry);
+    else if (pInfo->x_iUsed + size <= pInfo->x_iMax
+             || makeRoom(s_pShmTable, pInfo,
+                         sketchEstimate(pInfo, LsShmHash::hashXXH32(achKey,
+                                        keyLen)), size) == LS_OK)
+    {
+        offBody = s_pShmTable->alloc2(size);
+        if (offBody)
+            pInfo->x_iUsed += size;
+    }
+    s_pShmTable->unlock();
+    if (pBody || !offBody)
+        return pBody;
+
+    // The file is read without the lock, space has been accounted for.
+    char *pBuf = (char *)s_pShmTable->offset2ptr(offBody);
+    int ok = (pread(fd, pBuf, size, 0) == size);
+
+    s_pShmTable->lock();
+    pInfo = (ShmStaticInfo *)s_pShmTable->offset2ptr(s_iInfoOff);
+    iterOff = s_pShmTable->findIterator(&parms);
+    if (ok && iterOff.m_iOffset == 0)
+    {
+        lsShmStaticEntry_t entry;
+        entry.x_iRef = 0;
+        entry.x_iSize = size;
+        entry.x_iBody = offBody;
+        entry.x_tmAccess = DateTime::s_curTime;
+        LsShmHash::setParms(&parms, achKey, keyLen, &entry, sizeof(entry));
+        iterOff = s_pShmTable->insertIterator(&parms);
+        if (iterOff.m_iOffset != 0)
+        {
+            offBody = 0;
+            pBody = pinEntry(s_pShmTable, iterOff, pEntry);
+        }
+    }
+    else if (iterOff.m_iOffset != 0)
+        pBody = pinEntry(s_pShmTable, iterOff, pEntry);
+    if (offBody)
+    {
+        s_pShmTable->release2(offBody, size);
+        pInfo->x_iUsed -= size;
+    }
+    s_pShmTable->unlock();
+    if (pBody)
+        LS_DBG_H("[SHMSTATIC] Cached %lld bytes of file: %s",
+                 (long long)size, pPath);
+    return pBody;
+}
+
+
+/**
+ * The entry may have been reclaimed as a leaked pin and its memory reused
+ * since it was pinned, verify the body offset before touching it.
+ */
+void ShmStaticCache::release(LsShmOffset_t entry, const char *pBody)
+{
+    lsShmStaticEntry_t *pStatic =
+        (lsShmStaticEntry_t *)s_pShmTable->offset2ptr(entry);
+    if (pStatic && pStatic->x_iBody == s_pShmTable->ptr2offset(pBody))
+        ls_atomic_add(&pStatic->x_iRef, -1);
+}
+
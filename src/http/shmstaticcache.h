@@ -0,0 +1,70 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#ifndef SHMSTATICCACHE_H
+#define SHMSTATICCACHE_H
+
+#include <lsdef.h>
+#include <shm/lsshmtypes.h>
+
+#include <sys/types.h>
+#include <time.h>
+
+//
+//  Static file bodies shared by all worker processes, stored in the
+//  "static_file" SHM hash.  The key is the file identity (inode, size,
+//  mtime) followed by the path, so a changed file simply misses and the
+//  stale copy ages out.  Compressed variants are cached under the path of
+//  the .lsz/.lsb file, just like the per process cache does.
+//
+typedef struct lsShmStaticEntry_s
+{
+    int32_t             x_iRef;         // workers serving from the body
+    int32_t             x_iSize;
+    LsShmOffset_t       x_iBody;
+    uint32_t            x_tmAccess;
+} lsShmStaticEntry_t;
+
+class LsShmHash;
+class ShmStaticCache
+{
+public:
+    static int  initShm(int uid, int gid);
+    static bool isEnabled()             {   return s_pShmTable != NULL; }
+
+    static void setMaxSize(size_t size) {   s_iMaxSize = size;          }
+    static size_t getMaxSize()          {   return s_iMaxSize;          }
+
+    static const char *lookup(const char *pPath, ino_t inode, off_t size,
+                              time_t lastMod, LsShmOffset_t *pEntry);
+    static const char *add(const char *pPath, ino_t inode, off_t size,
+                           time_t lastMod, int fd, LsShmOffset_t *pEntry);
+    static void release(LsShmOffset_t entry, const char *pBody);
+
+private:
+    ShmStaticCache();
+    ~ShmStaticCache();
+
+    static LsShmHash   *s_pShmTable;
+    static LsShmOffset_t s_iInfoOff;
+    static size_t       s_iMaxSize;
+
+    LS_NO_COPY_ASSIGN(ShmStaticCache);
+};
+
+#endif // SHMSTATICCACHE_H
@@ -22,9 +22,11 @@
 #include <http/httpmime.h>
 #include <http/httpreq.h>
 #include <http/httpstatuscode.h>
+#include <http/shmstaticcache.h>
 #include <log4cxx/logger.h>
 #include <lsiapi/lsiapi.h>
 #include <lsr/ls_fileio.h>
+#include <lsr/ls_offload.h>
 #include <lsr/ls_strtool.h>
 #include <ssi/ssiscript.h>
 #include <util/datetime.h>
@@ -40,7 +42,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
-#include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -66,6 +67,10 @@ static int      s_iBrCompressLevel    = 6;
 
 static const char *s_compressCachePath = DEFAULT_TMP_DIR;
 
+static struct Offloader *s_pCompressOffloader = NULL;
+static int      s_iCompressWorkers      = 2;
+static int      s_iMaxInlineCompressSize = 400 * 1024;
+
 
 
 
@@ -177,6 +182,10 @@ void FileCacheDataEx::release()
             free(m_pCache);
         }
         break;
+    case SHARED:
+        if (m_pCache)
+            ShmStaticCache::release(m_iShmEntry, m_pCache);
+        break;
     }
     closefd();
     memset(&m_iStatus, 0,
@@ -194,9 +203,37 @@ void FileCacheDataEx::closefd()
 }
 
 
+/**
+ * Serve the body from the cache shared by all workers, the file is only
+ * opened and read by the first worker asking for it.
+ */
+int FileCacheDataEx::attachShared(const char *pPath)
+{
+    m_pCache = (char *)ShmStaticCache::lookup(pPath, m_inode, m_lSize,
+                                              m_lastMod, &m_iShmEntry);
+    if (!m_pCache)
+    {
+        int ret;
+        if (m_fd == -1 && (ret = openFile(pPath, m_fd)) != 0)
+            return ret;
+        m_pCache = (char *)ShmStaticCache::add(pPath, m_inode, m_lSize,
+                                               m_lastMod, m_fd, &m_iShmEntry);
+        if (!m_pCache)
+            return LS_FAIL;
+    }
+    setStatus(SHARED);
+    closefd();
+    return 0;
+}
+
+
 int FileCacheDataEx::readyData(const char *pPath)
 {
     int ret;
+    if (ShmStaticCache::isEnabled() && m_lSize > 0
+        && (size_t)m_lSize <= s_iMaxMMapCacheSize
+        && (ret = attachShared(pPath)) != LS_FAIL)
+        return ret;
     if (m_fd == -1)
     {
         ret = openFile(pPath, m_fd);
@@ -534,6 +571,208 @@ static int createLockFile(const char *pReal, char *p)
 }
 
 
+static int compressToFile(const char *pSrc, off_t fileSize,
+                          time_t lastMod, const char *pDest,
+                          char useBrotli, int iCompressLevel)
+{
+    int ret;
+    GzipBuf gzBuf;
+    Compressor *pCompressor = &gzBuf;
+    VMemBuf compressBuf;
+
+#ifdef USE_BROTLI
+    BrotliBuf brBuf;
+    if (useBrotli)
+        pCompressor = &brBuf;
+#endif
+
+    if (0 != pCompressor->init(Compressor::COMPRESSOR_COMPRESS, iCompressLevel))
+        return LS_FAIL;
+
+    int srcFd = ls_fio_open(pSrc, O_RDONLY, 0);
+    if (srcFd == -1)
+        return LS_FAIL;
+    struct stat st;
+    if ((fstat(srcFd, &st) == -1) || (st.st_size != fileSize)
+        || (st.st_mtime != lastMod))
+    {
+        close(srcFd);
+        return LS_FAIL;
+    }
+
+    if (compressBuf.set(VMBUF_ANON_MAP, 8192) == LS_FAIL)
+    {
+        close(srcFd);
+        return LS_FAIL;
+    }
+
+    char achFileName[4096];
+    snprintf(achFileName, 4096, "%s.XXXXXX", pDest);
+    int fd = mkstemp(achFileName);
+    if (fd == -1)
+    {
+        close(srcFd);
+        return LS_FAIL;
+    }
+
+    pCompressor->setCompressCache(&compressBuf);
+    if (pCompressor->beginStream())
+    {
+        close(srcFd);
+        close(fd);
+        unlink(achFileName);
+        return LS_FAIL;
+    }
+    off_t offset = 0;
+    int len;
+    char achBuf[8192];
+    ret = 0;
+    while (ret == 0)
+    {
+        if (fileSize - offset <= 0)
+            break;
+        len = pread(srcFd, achBuf, sizeof(achBuf), offset);
+        if (len <= 0)
+            ret = LS_FAIL;
+        else if (pCompressor->write(achBuf, len) == LS_FAIL)
+            ret = LS_FAIL;
+        offset += len;
+        if (compressBuf.getCurWOffset() >= 8192)
+        {
+            if (compressBuf.writeToFile(fd) == LS_FAIL)
+                ret = LS_FAIL;
+            pCompressor->resetCompressCache();
+        }
+    }
+    close(srcFd);
+    if (ret == 0 && 0 == pCompressor->endStream())
+    {
+        off_t size;
+        if (compressBuf.writeToFile(fd) == 0)
+        {
+            size = lseek(fd, (size_t)0, SEEK_CUR);
+            close(fd);
+            unlink(pDest);
+            rename(achFileName, pDest);
+
+            struct utimbuf utmbuf;
+            utmbuf.actime = lastMod;
+            utmbuf.modtime = lastMod;
+            utime(pDest, &utmbuf);
+
+            return size;
+        }
+    }
+    close(fd);
+    unlink(achFileName);
+    return LS_FAIL;
+}
+
+
+/**
+ * A compression job handed to the offloader threads. It carries copies of
+ * everything it needs, the StaticFileCacheData may be gone before it runs.
+ */
+struct StaticCompressTask
+{
+    ls_offload_t    m_header;
+    AutoStr2        m_src;
+    AutoStr2        m_dest;
+    AutoStr2        m_lock;
+    off_t           m_lSize;
+    time_t          m_lastMod;
+    int             m_iLevel;
+    char            m_isBrotli;
+    long            m_lResult;
+};
+
+
+static int static_compress_perform(ls_offload *item)
+{
+    StaticCompressTask *pTask = (StaticCompressTask *)item;
+    pTask->m_lResult = compressToFile(pTask->m_src.c_str(), pTask->m_lSize,
+                                      pTask->m_lastMod, pTask->m_dest.c_str(),
+                                      pTask->m_isBrotli, pTask->m_iLevel);
+    //remove the "*.lszl"/"*.lsbl" lock file, the result is now visible.
+    unlink(pTask->m_lock.c_str());
+    return 0;
+}
+
+
+static void static_compress_release(ls_offload *item)
+{
+    StaticCompressTask *pTask = (StaticCompressTask *)item;
+    if (--pTask->m_header.ref_cnt > 0)
+        return;
+    delete pTask;
+}
+
+
+static void static_compress_done(void *param)
+{
+    StaticCompressTask *pTask = (StaticCompressTask *)param;
+    if (pTask->m_lResult == -1)
+        LS_WARN("Failed to compress file %s, file size %ld!",
+                pTask->m_src.c_str(), (long)pTask->m_lSize);
+    else
+        LS_DBG_H("Compressed file %s to %s in background, size %ld.",
+                 pTask->m_src.c_str(), pTask->m_dest.c_str(),
+                 pTask->m_lResult);
+}
+
+
+static struct ls_offload_api s_compressApi =
+{
+    static_compress_perform,
+    static_compress_release,
+    static_compress_done
+};
+
+
+static struct Offloader *getCompressOffloader()
+{
+    if (!s_pCompressOffloader && s_iCompressWorkers > 0)
+    {
+        s_pCompressOffloader = offloader_new2("STATIC_COMPRESS",
+                                              s_iCompressWorkers, 1, 10, 5);
+        if (!s_pCompressOffloader)
+            s_iCompressWorkers = 0;
+    }
+    return s_pCompressOffloader;
+}
+
+
+int StaticFileCacheData::queueCompressTask(char useBrotli)
+{
+    struct Offloader *pOffloader = getCompressOffloader();
+    if (!pOffloader)
+        return LS_FAIL;
+    AutoStr2 *pPath = useBrotli ? &m_bredPath : &m_gzippedPath;
+    StaticCompressTask *pTask = new StaticCompressTask();
+    memset(&pTask->m_header, 0, sizeof(pTask->m_header));
+    pTask->m_header.api = &s_compressApi;
+    pTask->m_header.param_task_done = pTask;
+    pTask->m_src.setStr(m_real.c_str(), m_real.len());
+    //len() stops before the ".lsz"/".lsb" suffix, copy the full name.
+    pTask->m_dest.setStr(pPath->c_str());
+    pTask->m_lock.setStr(pPath->c_str());
+    pTask->m_lock.append("l", 1);
+    if (!pTask->m_src.c_str() || !pTask->m_dest.c_str()
+        || (pTask->m_lock.len() != pTask->m_dest.len() + 1))
+    {
+        delete pTask;
+        return LS_FAIL;
+    }
+    pTask->m_lSize = getFileSize();
+    pTask->m_lastMod = getLastMod();
+    pTask->m_iLevel = useBrotli ? s_iBrCompressLevel : s_iGzipCompressLevel;
+    pTask->m_isBrotli = useBrotli;
+    pTask->m_lResult = LS_FAIL;
+    //offloader_enqueue() releases the task by itself on failure.
+    return offloader_enqueue(pOffloader, &pTask->m_header);
+}
+
+
 int StaticFileCacheData::tryCreateCompressed(char useBrotli)
 {
     AutoStr2 *pPath;
@@ -559,41 +798,33 @@ int StaticFileCacheData::tryCreateCompressed(char useBrotli)
         return LS_FAIL;
     }
     close(fd);
-    if (size < 409600)
-    {
-        long ret = compressFile(useBrotli);
-        if (ret == -1)
-            LS_WARN("Failed to compress file %s, file size %ld!",
-                    m_real.c_str(), (long)size);
-        *p = 'l';
-        unlink(pPath->buf());
-        *p = 0;
-        return ret;
-    }
-    else
-    {
-        //IMPROVE: move this to a standalone process,
-        //          fork() is too expensive.
 
-        LS_DBG_H("To compressed file %s in another process.",
+    //Serve the identity body until the worker thread publishes the
+    //compressed file, the lock file is removed by the task.
+    if (queueCompressTask(useBrotli) == LS_OK)
+    {
+        LS_DBG_H("To compress file %s in background thread.",
                  m_real.c_str());
-        int forkResult;
-        forkResult = fork();
-        if (forkResult)   //error or parent process
-            return LS_FAIL;
-        //child process
-        setpriority(PRIO_PROCESS, 0, 5);
+        return LS_FAIL;
+    }
 
-        long ret = compressFile(useBrotli);
+    //Without compress threads only small files are compressed inline,
+    //a larger one would stall the event loop, its identity body is served.
+    long ret = LS_FAIL;
+    if (size < s_iMaxInlineCompressSize)
+    {
+        ret = compressFile(useBrotli);
         if (ret == -1)
             LS_WARN("Failed to compress file %s, file size %ld!",
                     m_real.c_str(), (long)size);
-
-        *p = 'l';
-        unlink(pPath->buf());
-        *p = 0;
-        _exit(1);
     }
+    else
+        LS_DBG_H("Skip compressing large file %s without compress threads.",
+                 m_real.c_str());
+    *p = 'l';
+    unlink(pPath->buf());
+    *p = 0;
+    return ret;
 }
 
 
@@ -630,105 +861,17 @@ int StaticFileCacheData::detectTrancate()
 
 int StaticFileCacheData::compressFile(char useBrotli)
 {
-    int ret;
-    AutoStr2 *pPath;
-
-    GzipBuf gzBuf;
-    Compressor *pCompressor;
-    VMemBuf compressBuf;
-    int iCompressLevel;
-
+    AutoStr2 *pPath = &m_gzippedPath;
+    int iCompressLevel = s_iGzipCompressLevel;
 #ifdef USE_BROTLI
-    BrotliBuf brBuf;
     if (useBrotli)
     {
-        pCompressor = &brBuf;
         pPath = &m_bredPath;
         iCompressLevel = s_iBrCompressLevel;
     }
-    else
-    {
-#endif
-        pCompressor = &gzBuf;
-        pPath = &m_gzippedPath;
-        iCompressLevel = s_iGzipCompressLevel;
-#ifdef USE_BROTLI
-    }
 #endif
-
-    if (    //detectTrancate() ||
-        (0 != pCompressor->init(Compressor::COMPRESSOR_COMPRESS, iCompressLevel)))
-        return LS_FAIL;
-    if ((!m_fileData.isCached() &&
-         (m_fileData.getfd() == -1)))
-    {
-        if (m_fileData.readyData(m_real.c_str()) != 0)
-            return LS_FAIL;
-    }
-
-    if (compressBuf.set(VMBUF_ANON_MAP, 8192) == LS_FAIL)
-        return LS_FAIL;
-
-    char achFileName[4096];
-    snprintf(achFileName, 4096, "%s.XXXXXX", pPath->c_str());
-    int fd = mkstemp(achFileName);
-    if (fd == -1)
-        return LS_FAIL;
-
-    pCompressor->setCompressCache(&compressBuf);
-    if (pCompressor->beginStream())
-    {
-        close(fd);
-        return LS_FAIL;
-    }
-    off_t offset = 0;
-    int len;
-    off_t wanted;
-    const char *pData;
-    char achBuf[8192];
-    ret = 0;
-    while (ret == 0)
-    {
-        wanted = getFileSize() - offset;
-        if (wanted <= 0)
-            break;
-        if (wanted < 8192)
-            len = wanted;
-        else
-            len = 8192;
-        pData = m_fileData.getCacheData(offset, wanted, achBuf, len);
-        if (wanted <= 0)
-            ret = LS_FAIL;
-        else if (pCompressor->write(pData, wanted) == LS_FAIL)
-            ret = LS_FAIL;
-        offset += wanted;
-        if (compressBuf.getCurWOffset() >= 8192)
-        {
-            if (compressBuf.writeToFile(fd) == LS_FAIL)
-                ret = LS_FAIL;
-            pCompressor->resetCompressCache();
-        }
-    }
-    if (ret == 0 && 0 == pCompressor->endStream())
-    {
-        off_t size;
-        if (compressBuf.writeToFile(fd) == 0)
-        {
-            size = lseek(fd, (size_t)0, SEEK_CUR);
-            close(fd);
-            unlink(pPath->buf());
-            rename(achFileName, pPath->buf());
-
-            struct utimbuf utmbuf;
-            utmbuf.actime = m_fileData.getLastMod();
-            utmbuf.modtime = m_fileData.getLastMod();
-            utime(pPath->buf(), &utmbuf);
-
-            return size;
-        }
-    }
-    close(fd);
-    return LS_FAIL;
+    return compressToFile(m_real.c_str(), getFileSize(), getLastMod(),
+                          pPath->buf(), useBrotli, iCompressLevel);
 }
 
 
@@ -954,3 +1097,9 @@ void StaticFileCacheData::setStaticBrOptions(int level)
 {
     s_iBrCompressLevel = level;
 }
+
+
+void StaticFileCacheData::setCompressWorkers(int workers)
+{
+    s_iCompressWorkers = workers;
+}
@@ -23,6 +23,7 @@
 #include <http/cacheelement.h>
 #include <util/autostr.h>
 #include <lsiapi/lsimoduledata.h>
+#include <shm/lsshmtypes.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -48,6 +49,7 @@ class FileCacheDataEx : public RefCounter
     ino_t           m_inode;
     time_t          m_lastMod;
     int8_t          m_iStatus;
+    LsShmOffset_t   m_iShmEntry;
     char           *m_pCache;
 
     FileCacheDataEx(const FileCacheDataEx &rhs);
@@ -56,6 +58,7 @@ protected:
     FileCacheDataEx();
     ~FileCacheDataEx();
     int  allocateCache(size_t size);
+    int  attachShared(const char *pPath);
 
     void setCache(char *pCache)  {   m_pCache = pCache;  }
     const char *getCache() const   {   return m_pCache;    }
@@ -70,8 +73,8 @@ public:
     {
         NONE,
         MMAPED,
-        CACHED
-
+        CACHED,
+        SHARED
     };
 
     const AutoStr2 &getCLHeader() const  {   return m_sCLHeader; }
@@ -150,6 +153,7 @@ class StaticFileCacheData : public CacheElement
     int buildFixedHeaders(int etag);
     int buildCompressedCache(FileCacheDataEx *&pData, const struct stat &st);
     int tryCreateCompressed(char useBrotli);
+    int queueCompressTask(char useBrotli);
 
     int buildCompressedPaths();
     int detectTrancate();
@@ -225,6 +229,7 @@ public:
     static void setCompressCachePath(const char *pPath);
 
     static void setStaticBrOptions(int level);
+    static void setCompressWorkers(int workers);
 };
 
 #endif
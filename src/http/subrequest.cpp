@@ -22,6 +22,7 @@
 #include <http/httpresourcemanager.h>
 #include <http/httpvhost.h>
 #include <http/httpstatuscode.h>
+#include <ssi/ssifragcache.h>
 #include <ssi/ssiruntime.h>
 
 #include <log4cxx/logger.h>
@@ -379,6 +380,13 @@ int HttpSession::closeSubSession(HttpSession *pSubSess)
     LS_DBG_M(getLogSession(), "Close SUB SESSION: %d",
              ((HioChainStream *)pSubSess->getStream())->getSequence());
 
+    HioChainStream *pChain = (HioChainStream *)pSubSess->getStream();
+    if (pChain && pChain->getFragment())
+    {
+        SsiFragCache::getInstance().endCapture(pSubSess,
+                                               pChain->getFragment());
+        pChain->setFragment(NULL);
+    }
     pSubSess->setSsiRuntime(NULL);
     pSubSess->closeSession();
     if (pSubSess == m_pCurSubSession)
@@ -397,6 +405,13 @@ int HttpSession::cancelSubSession(HttpSession *pSubSess)
 {
     LS_DBG_M(getLogSession(), "Cancel SUB SESSION: %d",
              ((HioChainStream *)pSubSess->getStream())->getSequence());
+    //a cancelled response is never complete, do not cache it
+    HioChainStream *pChain = (HioChainStream *)pSubSess->getStream();
+    if (pChain->getFragment())
+    {
+        delete pChain->getFragment();
+        pChain->setFragment(NULL);
+    }
     if (pSubSess->getFlag(HSF_NO_ABORT) & HSF_NO_ABORT)
     {
         // if sub session can not be interrupted, detach it, add it to global lingering session list
@@ -22,6 +22,7 @@
 #include <http/httpvhostlist.h>
 #include <log4cxx/logger.h>
 #include <lsr/ls_strtool.h>
+#include <lsr/xxhash.h>
 #include <main/zconfmanager.h>
 #include <socket/gsockaddr.h>
 #include <sslpp/sslcontext.h>
@@ -68,10 +69,33 @@ public:
 };
 
 
+#define VHOST_NEG_CACHE_SIZE    64
+#define VHOST_NEG_NAME_LEN      64
+
+/**
+ * Host names that matched no wildcard pattern, so repeated probes for
+ * unknown names skip the wildcard lookup. Created lazily, hence per
+ * worker, and dropped whenever the wildcard patterns change.
+ */
+struct VHostNegCache
+{
+    struct Entry
+    {
+        int     m_iLen;
+        char    m_achName[VHOST_NEG_NAME_LEN];
+    };
+    Entry   m_entries[VHOST_NEG_CACHE_SIZE];
+};
+
+
 VHostMap::VHostMap()
     : m_pCatchAll(NULL)
     , m_pDedicated(NULL)
     , m_pWildMatches(NULL)
+    , m_pWildSuffixes(NULL)
+    , m_pWildOthers(NULL)
+    , m_pNegCache(NULL)
+    , m_iWildDirty(0)
     , m_pSslContext(NULL)
     , m_pQuicListener(NULL)
     , m_port(0)
@@ -91,14 +115,126 @@ VHostMap::~VHostMap()
 }
 
 
-HttpVHost *VHostMap::wildMatch(const char *pHost, const char *pEnd) const
+static inline int isSuffixPattern(const char *pPattern)
+{
+    return (pPattern[0] == '*') && (pPattern[1] == '.') && pPattern[2]
+           && (strpbrk(pPattern + 2, "*?") == NULL);
+}
+
+
+void VHostMap::releaseWildIndex()
+{
+    if (m_pWildSuffixes)
+    {
+        delete m_pWildSuffixes;
+        m_pWildSuffixes = NULL;
+    }
+    if (m_pWildOthers)
+    {
+        delete m_pWildOthers;
+        m_pWildOthers = NULL;
+    }
+    if (m_pNegCache)
+    {
+        delete m_pNegCache;
+        m_pNegCache = NULL;
+    }
+}
+
+
+/**
+ * Earlier patterns keep precedence over later duplicates, same as the
+ * list order used to give.
+ */
+void VHostMap::buildWildIndex()
 {
     WildMatchList::iterator iter;
+    const char *pPattern;
+    m_iWildDirty = 0;
+    releaseWildIndex();
+    if (!m_pWildMatches)
+        return;
+    m_pWildSuffixes = new DomainTrie();
+    m_pWildOthers = new WildMatchList();
+    if (!m_pWildSuffixes || !m_pWildOthers)
+    {
+        releaseWildIndex();
+        return;
+    }
     for (iter = m_pWildMatches->begin(); iter != m_pWildMatches->end(); ++iter)
+    {
+        pPattern = (*iter)->getPattern();
+        if (isSuffixPattern(pPattern))
+            m_pWildSuffixes->add(pPattern + 2, strlen(pPattern + 2), *iter);
+        else
+            m_pWildOthers->push_back(*iter);
+    }
+    LS_DBG_L("[VHostMap] [%s] %d suffix wildcards, %d other wildcards.",
+             m_sAddr.c_str(), m_pWildSuffixes->size(),
+             (int)m_pWildOthers->size());
+}
+
+
+int VHostMap::isNegCached(const char *pHost, int len) const
+{
+    if (!m_pNegCache || (len >= VHOST_NEG_NAME_LEN))
+        return 0;
+    const VHostNegCache::Entry *pEntry = &m_pNegCache->m_entries[
+            XXH32(pHost, len, 0) & (VHOST_NEG_CACHE_SIZE - 1)];
+    return (pEntry->m_iLen == len)
+           && (memcmp(pEntry->m_achName, pHost, len) == 0);
+}
+
+
+void VHostMap::addNegCache(const char *pHost, int len)
+{
+    if (len >= VHOST_NEG_NAME_LEN)
+        return;
+    if (!m_pNegCache)
+    {
+        m_pNegCache = new VHostNegCache;
+        if (!m_pNegCache)
+            return;
+        memset(m_pNegCache, 0, sizeof(VHostNegCache));
+    }
+    VHostNegCache::Entry *pEntry = &m_pNegCache->m_entries[
+            XXH32(pHost, len, 0) & (VHOST_NEG_CACHE_SIZE - 1)];
+    memmove(pEntry->m_achName, pHost, len);
+    pEntry->m_iLen = len;
+}
+
+
+/**
+ * "*.<suffix>" patterns are resolved through the label trie, the most
+ * specific suffix wins; other patterns are tried in list order after.
+ */
+HttpVHost *VHostMap::wildMatch(const char *pHost, const char *pEnd) const
+{
+    WildMatchList::iterator iter;
+    WildMatch *pMatch;
+    int len = pEnd - pHost;
+    if (m_iWildDirty)
+        ((VHostMap *)this)->buildWildIndex();
+    if (!m_pWildSuffixes)
+    {
+        for (iter = m_pWildMatches->begin(); iter != m_pWildMatches->end(); ++iter)
+        {
+            if ((*iter)->match(pHost, pEnd) == 0)
+                return (*iter)->getVHost();
+        }
+        return m_pCatchAll;
+    }
+    if (isNegCached(pHost, len))
+        return m_pCatchAll;
+    pMatch = (WildMatch *)m_pWildSuffixes->match(pHost, len);
+    if (pMatch)
+        return pMatch->getVHost();
+    for (iter = m_pWildOthers->begin(); iter != m_pWildOthers->end(); ++iter)
     {
         if ((*iter)->match(pHost, pEnd) == 0)
             return (*iter)->getVHost();
     }
+    ((VHostMap *)this)->addNegCache(pHost, len);
     return m_pCatchAll;
 }
 
@@ -140,6 +276,7 @@ int VHostMap::addWildMatch(const char *pchKey, HttpVHost *pHost)
         delete pMatch;
         return LS_FAIL;
     }
+    m_iWildDirty = 1;
     HttpVHostMap::incRef(pHost);
     return 0;
 }
@@ -151,6 +288,7 @@ void VHostMap::removeWildMatch(WildMatchList::iterator iter)
     HttpVHostMap::decRef(pMatch->getVHost());
     m_pWildMatches->erase(iter);
     delete pMatch;
+    m_iWildDirty = 1;
 }
 
 
@@ -267,6 +405,8 @@ void VHostMap::removeMapping(const char *pName)
 
 void VHostMap::findDedicated()
 {
+    if (m_iWildDirty)
+        buildWildIndex();
     if (m_pCatchAll)
     {
         const_iterator iter, iterEnd = end();
@@ -318,6 +458,8 @@ void VHostMap::clear()
         delete m_pWildMatches;
         m_pWildMatches = NULL;
     }
+    releaseWildIndex();
+    m_iWildDirty = 0;
 
 }
 
@@ -21,6 +21,7 @@
 
 #include <quic/udplistener.h>
 #include <util/autostr.h>
+#include <util/domaintrie.h>
 #include <util/gpointerlist.h>
 #include <util/hashstringmap.h>
 #include <util/refcounter.h>
@@ -32,6 +33,7 @@ class HttpVHost;
 class HttpVHostMap;
 class WildMatch;
 class SslContext;
+struct VHostNegCache;
 
 class VHostMap : private HashStringMap< HttpVHost * >, public RefCounter
 {
@@ -39,6 +41,10 @@ class VHostMap : private HashStringMap< HttpVHost * >, public RefCounter
     HttpVHost        *m_pCatchAll;
     HttpVHost        *m_pDedicated;
     WildMatchList    *m_pWildMatches;
+    DomainTrie       *m_pWildSuffixes;  //"*.<suffix>" patterns of m_pWildMatches
+    WildMatchList    *m_pWildOthers;    //the rest, matched one by one
+    VHostNegCache    *m_pNegCache;
+    short             m_iWildDirty;
     SslContext       *m_pSslContext;
     UdpListener      *m_pQuicListener;
     AutoStr2          m_sAddr;
@@ -55,6 +61,10 @@ class VHostMap : private HashStringMap< HttpVHost * >, public RefCounter
     int removeWildMatch(const char *pName);
     HttpVHost *wildMatch(const char *pHost, const char *pEnd) const;
     void removeWildMatch(WildMatchList::iterator iter);
+    void buildWildIndex();
+    void releaseWildIndex();
+    int  isNegCached(const char *pHost, int len) const;
+    void addNegCache(const char *pHost, int len);
 
     void zconfAppendWildMatchList(GHash *pHash);
 public:
@@ -379,6 +379,49 @@ unsigned int ls_aho_search(ls_aho_t *pThis, ls_aho_state_t *start_state,
 }
 
 
+int ls_aho_search_all(ls_aho_t *pThis, const char *string, size_t size,
+                      int (*cb)(void *pattern_ctx, void *arg), void *arg)
+{
+    ls_aho_state_t *pZero = pThis->zero_state;
+    ls_aho_state_t *pState = pZero;
+    ls_aho_state_t *pOut;
+    unsigned char uc;
+    unsigned int i;
+    size_t iter;
+    int count = 0;
+
+    for (iter = 0; iter < size; ++iter)
+    {
+        uc = *(const unsigned char *)(string + iter);
+        while (1)
+        {
+            for (i = 0; i < pState->goto_size; ++i)
+            {
+                if (pState->children_labels[i] == uc)
+                    break;
+            }
+            if (i < pState->goto_size)
+            {
+                pState = pState->children_states[i];
+                break;
+            }
+            if (pState == pZero)
+                break;
+            pState = pState->fail;
+        }
+        for (pOut = pState; pOut != pZero; pOut = pOut->fail)
+        {
+            if (pOut->output == 0)
+                continue;
+            ++count;
+            if (cb(pOut->ctx, arg) != 0)
+                return count;
+        }
+    }
+    return count;
+}
+
+
 ls_aho_state_t *ls_aho_initstate()
 {
     ls_aho_state_t *pThis =
@@ -387,6 +430,7 @@ ls_aho_state_t *ls_aho_initstate()
         return NULL;
     pThis->id = 0;
     pThis->output = 0;
+    pThis->ctx = NULL;
     pThis->fail = NULL;
     pThis->next = NULL;
     pThis->first = NULL;
@@ -229,17 +229,22 @@ int ls_pcreres_getsubstr(const ls_pcreres_t *pThis, int i, char **pValue)
 
 #ifdef _USE_PCRE_JIT_
 #if !defined(__sparc__) && !defined(__sparc64__)
-static int s_jit_key_inited = 0;
+static pthread_once_t s_jit_key_once = PTHREAD_ONCE_INIT;
 static pthread_key_t s_jit_stack_key;
 
 
-void ls_pcre_init_jit_stack()
+static void ls_pcre_create_jit_key()
 {
-    s_jit_key_inited = 1;
     pthread_key_create(&s_jit_stack_key, ls_pcre_release_jit_stack);
 }
 
 
+void ls_pcre_init_jit_stack()
+{
+    pthread_once(&s_jit_key_once, ls_pcre_create_jit_key);
+}
+
+
 void ls_pcre_release_jit_stack(void *pValue)
 {
     pcre_jit_stack_free((pcre_jit_stack *) pValue);
@@ -250,8 +255,7 @@ pcre_jit_stack *ls_pcre_get_jit_stack()
 {
     pcre_jit_stack *jit_stack;
 
-    if (s_jit_key_inited == 0)
-        ls_pcre_init_jit_stack();
+    ls_pcre_init_jit_stack();
     jit_stack = (pcre_jit_stack *)pthread_getspecific(s_jit_stack_key);
     if (jit_stack == NULL)
     {
@@ -260,6 +264,15 @@ pcre_jit_stack *ls_pcre_get_jit_stack()
     }
     return jit_stack;
 }
+
+
+/* Compiled patterns are shared between threads, so each thread gets its
+ * own JIT stack through this callback rather than through the extra.
+ */
+static pcre_jit_stack *ls_pcre_jit_stack_cb(void *pArg)
+{
+    return ls_pcre_get_jit_stack();
+}
 #endif
 #endif
 
@@ -337,12 +350,23 @@ int ls_pcre_compile(ls_pcre_t *pThis, const char *regex, int options,
         return LS_FAIL;
     pThis->pattern = ls_pdupstr(regex);
     pThis->extra = pcre_study(pThis->regex,
-#if defined( _USE_PCRE_JIT_)&&!defined(__sparc__) && !defined(__sparc64__) && defined( PCRE_CONFIG_JIT )
+#ifdef _USE_PCRE_JIT_
                               PCRE_STUDY_JIT_COMPILE,
 #else
                               0,
 #endif
                               & error);
+#ifdef _USE_PCRE_JIT_
+    if (pThis->extra != NULL)
+        pcre_assign_jit_stack(pThis->extra, ls_pcre_jit_stack_cb, NULL);
+#endif
+    if ((pThis->extra == NULL) && (matchLimit > 0 || recursionLimit > 0))
+    {
+        pThis->extra = (pcre_extra *)pcre_malloc(sizeof(pcre_extra));
+        if (pThis->extra == NULL)
+            return LS_FAIL;
+        memset(pThis->extra, 0, sizeof(pcre_extra));
+    }
     if (matchLimit > 0)
     {
         pThis->extra->match_limit = matchLimit;
@@ -366,8 +390,8 @@ void ls_pcre_release(ls_pcre_t *pThis)
     {
         if (pThis->extra != NULL)
         {
-#if defined( _USE_PCRE_JIT_)&&!defined(__sparc__) && !defined(__sparc64__) && defined( PCRE_CONFIG_JIT )
-            pcre_free_study(pThis->m_extra);
+#ifdef _USE_PCRE_JIT_
+            pcre_free_study(pThis->extra);
 #else
             pcre_free(pThis->extra);
 #endif
@@ -37,6 +37,7 @@
 #include <extensions/registry/appconfig.h>
 
 #include <http/accesslog.h>
+#include <http/accesslogring.h>
 #include <http/clientcache.h>
 #include <http/connlimitctrl.h>
 #include <http/contextlist.h>
@@ -44,6 +45,7 @@
 #include <http/eventdispatcher.h>
 #include <http/handlerfactory.h>
 #include <http/handlertype.h>
+#include <http/htaccesscache.h>
 #include <http/httpaiosendfile.h>
 #include <http/httpcgitool.h>
 #include <http/httpcontext.h>
@@ -67,6 +69,7 @@
 #include <http/platforms.h>
 #include <http/recaptcha.h>
 #include <http/serverprocessconfig.h>
+#include <http/shmstaticcache.h>
 #include <http/staticfilecache.h>
 #include <http/staticfilecachedata.h>
 #include <http/stderrlogger.h>
@@ -89,9 +92,12 @@
 #include <quic/udplistener.h>
 
 #include <shm/lsshm.h>
+#include <ssi/ssifragcache.h>
+#include <sslpp/sslcertstore.h>
 #include <sslpp/sslcontext.h>
 #include <sslpp/sslcontextconfig.h>
 #include <sslpp/sslengine.h>
+#include <sslpp/sslktls.h>
 #include <sslpp/sslocspstapling.h>
 #include <sslpp/sslsesscache.h>
 #include <sslpp/sslticket.h>
@@ -974,6 +980,7 @@ void HttpServerImpl::onTimer10Secs()
 {
     ExtAppRegistry::onTimer();
     HttpResourceManager::getInstance().onTimer();
+    HtAccessCache::getInstance().recheckUnwatched();
     static int s_timeOut = 3;
     s_timeOut --;
     if (!s_timeOut)
@@ -1011,6 +1018,7 @@ void HttpServerImpl::onTimer30Secs()
     }
     HttpStats::set503Errors(0);
     SslTicket::onTimer();
+    SslCertStore::getInstance().onTimer();
 }
 
 
@@ -1547,6 +1555,10 @@ int HttpServerImpl::reinitMultiplexer()
     ServerInfo::getServerInfo()->setAdnsOp(1);
     initAdns();
     ServerInfo::getServerInfo()->setAdnsOp(0);
+    ClientInfo::initShm(ServerProcessConfig::getInstance().getUid(),
+                        ServerProcessConfig::getInstance().getGid());
+    ShmStaticCache::initShm(ServerProcessConfig::getInstance().getUid(),
+                            ServerProcessConfig::getInstance().getGid());
     return 0;
 }
 
@@ -2487,6 +2499,17 @@ int HttpServerImpl::configTuning(const XmlNode *pRoot)
     FileCacheDataEx::setMaxMMapCacheSize(currentCtx.getLongValue(pNode,
                                          "maxMMapFileSize",
                                          0, LONG_MAX, 256 * 1024));
+    ShmStaticCache::setMaxSize(currentCtx.getLongValue(pNode,
+                               "sharedStaticCacheSize", 0, LSSHM_MAXSIZE, 0));
+    SsiFragCache &ssiCache = SsiFragCache::getInstance();
+    ssiCache.setMaxSize(currentCtx.getLongValue(pNode, "ssiFragmentCacheSize",
+                        0, LONG_MAX, 0));
+    ssiCache.setFileTtl(currentCtx.getLongValue(pNode,
+                        "ssiFragmentCacheFileTTL", 0, INT_MAX, 300));
+    ssiCache.setDynTtl(currentCtx.getLongValue(pNode, "ssiFragmentCacheTTL",
+                       0, INT_MAX, 0));
+    AccessLogRing::getInstance().setSize(currentCtx.getLongValue(pNode,
+                                         "accessLogRingSize", 0, LONG_MAX, 0));
     int etag = currentCtx.getLongValue(pNode, "fileETag", 0, 4 + 8 + 16,
                                        4 + 8 + 16);
     HttpServer::getInstance().getServerContext().setFileEtag(etag);
@@ -2507,6 +2530,7 @@ int HttpServerImpl::configTuning(const XmlNode *pRoot)
 
     SslContext::setUseStrongDH(currentCtx.getLongValue(pNode, "SSLStrongDhKey",
                                0, 1, 1));
+    SslKtls::setEnabled(currentCtx.getLongValue(pNode, "sslKtls", 0, 1, 0));
 
     // GZIP compression
     config.setGzipCompress(currentCtx.getLongValue(pNode, "enableGzipCompress",
@@ -2538,6 +2562,9 @@ int HttpServerImpl::configTuning(const XmlNode *pRoot)
     StaticFileCacheData::setStaticBrOptions(
         currentCtx.getLongValue(pNode, "brStaticCompressLevel", 0, 11, 6)
     );
+    StaticFileCacheData::setCompressWorkers(
+        currentCtx.getLongValue(pNode, "staticCompressThreads", 0, 16, 2)
+    );
 
 
     pValue = pNode->getChildValue("gzipCacheDir");
@@ -2612,7 +2639,9 @@ int HttpServerImpl::configTuning(const XmlNode *pRoot)
 
     const char *pTKFile;
     char achTKFile[MAX_PATH_LEN];
-    if (currentCtx.getLongValue(pNode, "sslSessionTickets", 0, 1, 1) == 1)
+    int iEnableTicket = currentCtx.getLongValue(pNode, "sslSessionTickets",
+                                                0, 1, 1);
+    if (iEnableTicket == 1)
     {
         if ((pTKFile = pNode->getChildValue("sslSessionTicketKeyFile")) != NULL)
         {
@@ -2625,6 +2654,19 @@ int HttpServerImpl::configTuning(const XmlNode *pRoot)
         SslTicket::init(pTKFile, iTicketLifetime, getuid(), getgid());
     }
 
+    const char *pCertStoreDir;
+    char achCertStoreDir[MAX_PATH_LEN];
+    if ((pCertStoreDir = pNode->getChildValue("sslCertStoreDir")) != NULL
+        && currentCtx.getValidPath(achCertStoreDir, pCertStoreDir,
+                                   "SSL certificate store") == 0)
+    {
+        int iCertStoreSize = currentCtx.getLongValue(pNode,
+                             "sslCertStoreCacheSize", 10, INT_MAX,
+                             SSLCERTSTORE_DEFAULT_SIZE);
+        SslCertStore::getInstance().init(achCertStoreDir, iCertStoreSize,
+                                         iEnableTicket, getuid(), getgid());
+    }
+
     const char *pOcspProxy;
     if ((pOcspProxy = pNode->getChildValue("sslOcspProxy")) != NULL)
     {
@@ -2909,6 +2951,8 @@ int HttpServerImpl::configSecurity(const XmlNode *pRoot)
                                                 10));
             ClientInfo::setBanPeriod(currentCtx.getLongValue(pNode1,
                                      "banPeriod", 1, INT_MAX, 60));
+            ClientInfo::setShareAcrossWorkers(currentCtx.getLongValue(pNode1,
+                                     "shareAcrossWorkers", 0, 1, 0));
         }
 
         const int iAllowExtAppSetuid = currentCtx.getLongValue(pNode,
@@ -3211,6 +3255,13 @@ int HttpServerImpl::configMultiplexer(const XmlNode *pNode)
                  "Failed to initialize I/O event dispatcher type: %s, error: %s",
                  pType, strerror(errno));
 
+        if (pType && (strcasecmp(pType, "io_uring") == 0))
+        {
+            LS_NOTICE(ConfigCtx::getCurConfigCtx(),
+                      "Fall back to I/O event dispatcher type: best");
+            if (m_dispatcher.init("best") == 0)
+                return 0;
+        }
         if (pType && (strcasecmp(pType, "poll") != 0))
         {
             LS_NOTICE(ConfigCtx::getCurConfigCtx(),
@@ -5536,6 +5587,8 @@ void HttpServer::startServing()
     QuicEngine::setpid(pid);
 
     reinitMultiplexer();
+    HtAccessCache::getInstance().initWatcher(
+        MultiplexerFactory::getMultiplexer());
 
 //     ExtAppRegistry::markDaemonAppsRemote();
 //     EvtcbQue::getInstance().initNotifier();
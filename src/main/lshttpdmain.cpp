@@ -18,6 +18,7 @@
 #include "lshttpdmain.h"
 
 #include <adns/adns.h>
+#include <http/accesslogring.h>
 #include <http/httpaiosendfile.h>
 #include <http/httplog.h>
 #include <http/httpserverconfig.h>
@@ -106,6 +107,7 @@ LshttpdMain::LshttpdMain()
     , m_curChildren(0)
     , m_fdAdmin(-1)
     , m_fdCmd(-1)
+    , m_pidLogger(-1)
 {
     m_pServer = &HttpServer::getInstance();
 
@@ -731,6 +733,7 @@ int LshttpdMain::reconfig()
     }
     else
         LS_NOTICE("Reconfiguration succeed! ");
+    restartAccessLogger();
     m_pServer->generateStatusReport();
     return 0;
 }
@@ -1351,6 +1354,15 @@ void LshttpdMain::waitChildren()
     //printf( "waitpid()\n" );
     while ((rpid = ::waitpid(-1, &stat, WNOHANG)) > 0)
     {
+        if (rpid == m_pidLogger)
+        {
+            LS_NOTICE("[AccessLogRing] logger process with pid=%d is gone.",
+                      rpid);
+            m_pidLogger = -1;
+            if (s_iRunning > 0)
+                startAccessLogger();
+            continue;
+        }
         if (WIFEXITED(stat))
         {
             ret = WEXITSTATUS(stat);
@@ -1593,6 +1605,74 @@ static void startTimer()
 }
 
 
+/**
+ * Forks the process that drains the access log ring.  It does not take a
+ * worker slot; it drops privileges like a worker does and runs until the
+ * main process is gone, then writes out whatever is left in the ring.
+ */
+int LshttpdMain::startAccessLogger()
+{
+    AccessLogRing &ring = AccessLogRing::getInstance();
+    if (ring.getSize() <= 0 || ring.init() != LS_OK)
+        return LS_OK;
+    pid_t ppid = getpid();
+    m_pidLogger = fork();
+    if (m_pidLogger == -1)
+    {
+        LS_ERROR("[AccessLogRing] failed to fork logger process: %s",
+                 strerror(errno));
+        return LS_FAIL;
+    }
+    if (m_pidLogger > 0)
+    {
+        LS_NOTICE("[AccessLogRing] logger process with pid=%d is forked!",
+                  m_pidLogger);
+        return LS_OK;
+    }
+
+    setpgid(0, 0);
+    signal(SIGTERM, SIG_IGN);
+    signal(SIGINT, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+    signal(SIGUSR1, SIG_IGN);
+    signal(SIGUSR2, SIG_IGN);
+    signal(SIGCHLD, SIG_DFL);
+    if (m_fdAdmin != -1)
+        close(m_fdAdmin);
+    if (m_fdCmd != -1)
+        close(m_fdCmd);
+#ifdef IS_LSCPD
+    snprintf(argv0, 80, "lscpd (lscpd - logger)");
+#else
+    snprintf(argv0, 80, "openlitespeed (lshttpd - logger)");
+#endif
+    if (getuid() == 0)
+    {
+        if (m_pServer->changeUserChroot() == -1)
+            _exit(1);
+        if (ServerProcessConfig::getInstance().getChroot() != NULL)
+            m_pServer->offsetChroot();
+    }
+    ring.consume(ppid);
+    _exit(0);
+}
+
+
+/**
+ * The logger process resolves log ids against the access logs it was
+ * forked with, so after a reconfiguration the running one is retired and
+ * waitChildren() forks a new one once it has drained and exited.
+ */
+void LshttpdMain::restartAccessLogger()
+{
+    AccessLogRing &ring = AccessLogRing::getInstance();
+    if (m_pidLogger > 0)
+        ring.retire();
+    else if (!m_noCrashGuard)
+        startAccessLogger();
+}
+
+
 int LshttpdMain::guardCrash()
 {
     long lLastForkTime  = DateTime::s_curTime = time(NULL);
@@ -1601,6 +1681,7 @@ int LshttpdMain::guardCrash()
     int  iNumChildren = HttpServerConfig::getInstance().getChildren();
     struct pollfd   pfds[3] = {{-1, 0, 0}, {-1, 0, 0}, {-1, 0, 0}};
     HttpSignals::init(sigchild);
+    startAccessLogger();
     if (iNumChildren >= 32)
     {
         m_pProcState = (int *)malloc(((iNumChildren >> 5) + 1) * sizeof(
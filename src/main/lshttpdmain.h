@@ -78,6 +78,7 @@ class LshttpdMain
     int                 m_curChildren;
     int                 m_fdAdmin;
     int                 m_fdCmd;
+    pid_t               m_pidLogger;
 
     int     getFullPath(const char *pRelativePath, char *pBuf, int bufLen);
     int     execute(const char *pExecCmd, const char *pParam);
@@ -136,6 +137,8 @@ class LshttpdMain
     int             getFirstAvailSlot();
     void            setChildSlot(int num, int val);
     int             guardCrash();
+    int             startAccessLogger();
+    void            restartAccessLogger();
     int             cleanUp(int pid, char *pBB);
 
     int             startAdminSocket();
@@ -54,6 +54,7 @@ plainconfKeywords plainconf::sKeywords[] =
     {"accesscontrol",                            NULL},
     {"accessdenydir",                            NULL},
     {"accesslog",                                NULL},
+    {"accesslogringsize",                        NULL},
     {"add",                                      NULL},
     {"adddefaultcharset",                        NULL},
     {"addmimetype",                              NULL},
@@ -177,6 +178,7 @@ plainconfKeywords plainconf::sKeywords[] =
     {"gzipstaticcompresslevel",                  NULL},
     {"handler",                                  NULL},
     {"hardlimit",                                NULL},
+    {"hashkey",                                  NULL},
     {"hotlinkctrl",                              NULL},
     {"htaccess",                                 NULL},
     {"httpdworkers",                             NULL},
@@ -204,6 +206,7 @@ plainconfKeywords plainconf::sKeywords[] =
     {"listeners",                                NULL},
     {"location",                                 NULL},
     {"log",                                      NULL},//!!
+    {"logbinary",                                NULL},
     {"logformat",                                NULL},
     {"logging",                                  NULL},  //!!
     {"logheaders",                               NULL},
@@ -253,6 +256,8 @@ plainconfKeywords plainconf::sKeywords[] =
     {"priority",                                 NULL},
     {"prochardlimit",                            NULL},
     {"procsoftlimit",                            NULL},
+    {"queuetarget",                              NULL},
+    {"queuetimeout",                             NULL},
     {"railsdefaults",                            NULL},
     {"wsgiDefaults",                            NULL},
     {"nodeDefaults",                            NULL},
@@ -280,10 +285,16 @@ plainconfKeywords plainconf::sKeywords[] =
     {"security",                                 NULL},
     {"servername",                               NULL},
     {"sitekey",                                  NULL},
+    {"ssifragmentcachefilettl",                  NULL},
+    {"ssifragmentcachesize",                     NULL},
+    {"ssifragmentcachettl",                      NULL},
+    {"sslcertstorecachesize",                    NULL},
+    {"sslcertstoredir",                          NULL},
     {"sslconnlimit",                             NULL},
     {"ssldefaultcafile",                         NULL},
     {"ssldefaultcapath",                         NULL},
     {"sslenablemulticerts",                      NULL},
+    {"sslktls",                                  NULL},
     {"sslsessioncache",                          NULL},
     {"sslsessioncachesize",                      NULL},
     {"sslsessioncachetimeout",                   NULL},
@@ -292,6 +303,8 @@ plainconfKeywords plainconf::sKeywords[] =
     {"sslsessionticketlifetime",                 NULL},
     {"sslstrongdhkey",                           NULL},
     {"setuidmode",                               NULL},
+    {"shareacrossworkers",                       NULL},
+    {"sharedstaticcachesize",                    NULL},
     {"showversionnumber",                        NULL},
     {"shmdefaultdir",                            NULL},
     {"sitealiases",                              NULL},
@@ -303,8 +316,10 @@ plainconfKeywords plainconf::sKeywords[] =
     {"sslcryptodevice",                          NULL},
     {"sslprotocol",                              NULL},
     {"statdir",                                  NULL},
+    {"staticcompressthreads",                    NULL},
     {"staticreqpersec",                          NULL},
     {"statuscode",                               NULL},
+    {"strategy",                                 NULL},
     {"suffix",                                   NULL},
     {"suffixes",                                 NULL},
     {"swappingdir",                              NULL},
@@ -19,6 +19,8 @@
 #include "cachectrl.h"
 #include "cacheentry.h"
 #include "cachehash.h"
+#include "cachememtier.h"
+#include "cachevariant.h"
 #include "dirhashcachestore.h"
 
 #include <limits.h>
@@ -188,6 +190,7 @@ struct MyMData
     uint8_t         hkptIndex;
     uint8_t         hasCacheFrontend;
     uint8_t         reqCompressType; //0, no, 1: gzip, 2:br
+    uint8_t         reqAcceptEncoding; //bit (1 << compress type) the client accepts
     uint8_t         saveFailed;
     XXH64_state_t   contentState;
     z_stream       *zstream;
@@ -230,6 +233,8 @@ static lsi_config_key_t paramArray[] =
     {"purgeUri",                18, 0},
     {"reqHeaderVary",           19, 0},
     {"CacheKeyModify",          20, 0},
+    {"memCacheSize",            21, 0},
+    {"memCacheMaxObjSize",      22, 0},
 
     {NULL, 0, 0} //Must have NULL in the last item
 };
@@ -416,6 +421,26 @@ void parseNoCacheUrlFinal(CacheConfig *pConfig)
 }
 
 
+static void parseMemTier(int param_id, const char *val, int level,
+                         const char *name)
+{
+    if (level != LSI_CFG_SERVER)
+    {
+        g_api->log(NULL, LSI_LOG_INFO,
+                   "[%s][%s] Only SERVER level can have '%s' parameter.\n",
+                   ModuleNameStr, name, paramArray[param_id].config_key);
+        return;
+    }
+    long value = strtol(val, NULL, 10);
+    if (value < 0)
+        value = 0;
+    if (param_id == 21)
+        CacheMemTier::getInstance().setMaxSize(value);
+    else
+        CacheMemTier::getInstance().setMaxObjSize(value);
+}
+
+
 // Parses the key and value given.  If key is storagepath, returns 1, otherwise returns 0
 static int parseLine(CacheConfig *pConfig, int param_id,
                      const char *val, int valLen)
@@ -486,6 +511,8 @@ static int parseLine(CacheConfig *pConfig, int param_id,
     case 18:
     case 19:
     case 20:
+    case 21:
+    case 22:
         return i; //return the index for next step parsing
 
     case 16:
@@ -677,6 +704,8 @@ static void *ParseConfig(module_param_info_t *param, int param_count,
             setVaryList(pConfig, param[i].val, param[i].val_len);
         else if (ret == 20)
             pConfig->parseCacheKeyMod(param[i].val, param[i].val_len);
+        else if (ret == 21 || ret == 22)
+            parseMemTier(ret, param[i].val, level, name);
 
     }
 
@@ -872,17 +901,6 @@ static int isUrlExclude(const lsi_session_t *session, CacheConfig *pConfig,
 }
 
 
-static int uninitZstream(z_stream *zstream, bool compress)
-{
-    if (compress)
-        deflateEnd(zstream);
-    else
-        inflateEnd(zstream);
-    delete zstream;
-    return 0;
-}
-
-
 /**
  * return 0 for OK, -1 for error
  */
@@ -913,38 +931,6 @@ static int initZstream(z_stream *zstream, bool compress)
 }
 
 
-static int compressbuf(z_stream *zstream, bool compress, unsigned char *buff,
-                    int buffLen, int fd, int eof)
-{
-    unsigned char buf[Z_BUF_SIZE];
-    zstream->next_in = buff;
-    zstream->avail_in = buffLen;
-    int ret = 0;
-    int z_ret;
-
-    do
-    {
-        zstream->next_out = buf;
-        zstream->avail_out = Z_BUF_SIZE;
-
-        if (compress)
-            z_ret = deflate(zstream, eof ? Z_FINISH : Z_SYNC_FLUSH);
-        else
-            z_ret = inflate(zstream, eof ? Z_FINISH : Z_PARTIAL_FLUSH);
-
-        if (z_ret == Z_STREAM_ERROR)
-            return LS_FAIL;
-
-        if (z_ret == Z_BUF_ERROR)
-            z_ret = Z_OK;
-
-        if (z_ret >= Z_OK)
-            ret += write(fd, buf, Z_BUF_SIZE - zstream->avail_out);
-    } while (z_ret != Z_STREAM_END);
-
-    return ret;
-}
-
 static int isDomainExclude(const lsi_session_t *session, CacheConfig *pConfig)
 {
     if (pConfig->getVHostMapExclude())
@@ -1500,21 +1486,6 @@ static void dumpCacheHash(const lsi_session_t *session, const char *desc,
 }
 
 
-off_t getEntryContentLength(MyMData *myData)
-{
-    int part1offset = myData->pEntry->getPart1Offset();
-    int part2offset = myData->pEntry->getPart2Offset();
-    if (part2offset - part1offset > 0)
-    {
-        off_t length = myData->pEntry->getContentTotalLen() -
-                       (part2offset - part1offset);
-        return length;
-    }
-    else
-        return -1;
-}
-
-
 static void setCacheEntry(MyMData *data, CacheEntry *pEntry)
 {
     if (!data || pEntry == data->pEntry)
@@ -1824,6 +1795,15 @@ static int deflateBufAndWriteToFile(MyMData *myData, unsigned char *pBuf,
 }
 
 
+static int queueVariant(CacheConfig *pConfig, CacheEntry *pEntry, int type)
+{
+    char achPath[4096];
+    int len = sizeof(achPath);
+    pConfig->getStore()->getEntryFilePath(pEntry, achPath, len);
+    return CacheVariant::build(pEntry, achPath, type);
+}
+
+
 static int endCache(lsi_param_t *rec)
 {
     MyMData *myData = (MyMData *)g_api->get_module_data(rec->session, &MNAME,
@@ -1862,7 +1842,11 @@ static int endCache(lsi_param_t *rec)
 
 
                 lseek(fd, 0, SEEK_END);
-                deflateBufAndWriteToFile(myData, NULL, 0, 1, fd);
+                //count the gzip trailer, a variant is decoded from the body
+                int tail = deflateBufAndWriteToFile(myData, NULL, 0, 1, fd);
+                if (tail > 0)
+                    myData->pEntry->setPart2Len(myData->pEntry->getPart2Len()
+                                                + tail);
 
                 if (myData->pConfig->getAddEtagType() == 2)
                 {
@@ -1881,6 +1865,14 @@ static int endCache(lsi_param_t *rec)
 
                 myData->pConfig->getStore()->publish(myData->pEntry);
                 myData->pConfig->getStore()->getManager()->addTracking(myData->pEntry);
+#ifdef USE_BROTLI
+                //most clients take br, have it ready before the first hit
+                if (myData->pEntry->isCompressible()
+                    && myData->pEntry->getCompressType() != LSI_BR_COMPRESS
+                    && myData->pEntry->getPart2Len() >= CE_VARIANT_MIN_SIZE)
+                    queueVariant(myData->pConfig, myData->pEntry,
+                                 LSI_BR_COMPRESS);
+#endif
                 myData->iCacheState = CE_STATE_CACHED;  //Succeed
                 g_api->log(NULL, LSI_LOG_DEBUG,
                            "[%s] published %s, content length %ld.\n",
@@ -2283,24 +2275,13 @@ int cacheHeader(lsi_param_t *rec, MyMData *myData)
     myData->pEntry->setPart2Len(0);
 
     /**
-     * If already gzipped, no need to gzip
-     */
-    int needGzip = (g_api->get_resp_buffer_compress_method(rec->session) == 0);
-
-    /**
-     * If the response not gzipped, and check if req need gzip,
-     * if not needed, do not gzip it.
+     * If already compressed, it is compressible and no need to gzip.
+     * Otherwise check if it is not compressible or too small, the other
+     * encoding variants are only built for compressible bodies.
      */
-    if (needGzip)
-    {
-        needGzip = (myData->reqCompressType == 1);
-    }
-
-    /**
-     * If need to gzip but it is a small static file, no need
-     * Or it is not compressible, no need
-     */
-    if (needGzip)
+    int compress_method = g_api->get_resp_buffer_compress_method(rec->session);
+    int compressible = 1;
+    if (compress_method == 0)
     {
         int contentTypelen;
         char *pContentType = NULL;
@@ -2311,23 +2292,21 @@ int cacheHeader(lsi_param_t *rec, MyMData *myData)
         {
             char ch = pContentType[contentTypelen];
             pContentType[contentTypelen] = 0;
-            char compressible = HttpMime::getMime()->compressible(pContentType);
+            compressible = HttpMime::getMime()->compressible(pContentType);
             pContentType[contentTypelen] = ch;
-            if (!compressible)
-                needGzip = false;
         }
     }
 
     const char *phandlerType = g_api->get_req_handler_type(rec->session);
-    if (needGzip && phandlerType && strlen(phandlerType) == 6 &&
-        memcmp("static", phandlerType, 6) == 0 &&
-        sb.st_size > 0 && sb.st_size < 200)
-        needGzip = false;
+    if (compressible && compress_method == 0 && phandlerType
+        && strlen(phandlerType) == 6 && memcmp("static", phandlerType, 6) == 0
+        && sb.st_size > 0 && sb.st_size < 200)
+        compressible = false;
 
     /***
      * if it isn't a static file but has small size, no need to gzip
      */
-    if (needGzip)
+    if (compressible && compress_method == 0)
     {
         char *pVal = NULL;
         int valLen;
@@ -2337,10 +2316,16 @@ int cacheHeader(lsi_param_t *rec, MyMData *myData)
             int len = 0;
             len = atoi(pVal);
             if (len >= 0 && len < 200)
-                needGzip = false;
+                compressible = false;
         }
     }
 
+    /**
+     * If the response not gzipped, and check if req need gzip,
+     * if not needed, do not gzip it.
+     */
+    int needGzip = (compressible && compress_method == 0
+                    && myData->reqCompressType == LSI_GZIP_COMPRESS);
     if (needGzip)
     {
         myData->zstream = new z_stream;
@@ -2357,10 +2342,10 @@ int cacheHeader(lsi_param_t *rec, MyMData *myData)
             needGzip = false;
     }
 
-    int compress_method = g_api->get_resp_buffer_compress_method(rec->session);
     if (compress_method == 0 && needGzip)
         compress_method  = 1;
     myData->pEntry->markReady(compress_method);
+    myData->pEntry->setCompressible(compressible);
 
     myData->pEntry->saveCeHeader();
 
@@ -2714,10 +2699,18 @@ static void checkFileUpdateWithCache(lsi_param_t *rec, MyMData *myData)
         return ;
 
     char path[4096] = {0};
-    int fd = myData->pEntry->getFdStore();
-    int ret = lseek(fd, myData->pEntry->getPart1Offset() + CeHeader.m_lenETag, 0);
-    if (ret != -1)
-        ret = read(fd, path, CeHeader.m_lenStxFilePath);
+    int ret = 0;
+    CacheMemObj *pMemObj = myData->pEntry->getMemObj();
+    if (pMemObj && CeHeader.m_lenStxFilePath < (int)sizeof(path))
+        memcpy(path, pMemObj->m_pBuf + CeHeader.m_lenETag,
+               CeHeader.m_lenStxFilePath);
+    else
+    {
+        int fd = myData->pEntry->getFdStore();
+        ret = lseek(fd, myData->pEntry->getPart1Offset() + CeHeader.m_lenETag, 0);
+        if (ret != -1)
+            ret = read(fd, path, CeHeader.m_lenStxFilePath);
+    }
     if (ret != -1)
     {
         struct stat sb;
@@ -2930,6 +2923,7 @@ static int checkAssignHandler(lsi_param_t *rec)
     char *encoding = (char *)g_api->get_req_header_by_id(rec->session,
                                                        LSI_HDR_ACC_ENCODING,
                                                        &encodingLen);
+    myData->reqAcceptEncoding = (1 << LSI_NO_COMPRESS);
     if (!encoding)
         myData->reqCompressType = LSI_NO_COMPRESS;
     else
@@ -2937,9 +2931,14 @@ static int checkAssignHandler(lsi_param_t *rec)
         char orgChar = encoding[encodingLen];
         encoding[encodingLen] = 0;
         myData->reqCompressType = (encodingLen >= 4 && strcasestr(encoding, "gzip"));
-        if (myData->reqCompressType == LSI_NO_COMPRESS &&
-            encodingLen >= 2 && strcasestr(encoding, "br"))
-            myData->reqCompressType = LSI_BR_COMPRESS;
+        if (myData->reqCompressType == LSI_GZIP_COMPRESS)
+            myData->reqAcceptEncoding |= (1 << LSI_GZIP_COMPRESS);
+        if (encodingLen >= 2 && strcasestr(encoding, "br"))
+        {
+            myData->reqAcceptEncoding |= (1 << LSI_BR_COMPRESS);
+            if (myData->reqCompressType == LSI_NO_COMPRESS)
+                myData->reqCompressType = LSI_BR_COMPRESS;
+        }
         encoding[encodingLen] = orgChar;
     }
 
@@ -3359,174 +3358,27 @@ static void processPurge(const lsi_session_t *session, const char *pValue,
 }
 
 
-static void updateCacheEntry(CacheConfig *pConfig, CacheEntry *pEntry, int tmpfd,
-                             char *tmppath, int compressType, off_t length)
-{
-    //length change
-    pEntry->setPart2Len(length);
-
-    //Update compressType
-    pEntry->markReady(compressType);
-
-    //Update fd
-    close(pEntry->getFdStore());
-    pEntry->setFdStore(tmpfd);
-
-    //since the filepath is org path + .tmp, so just publish it to use it
-    pConfig->getStore()->publish(pEntry);
-}
-
-static void closeTmpFile(int fd, const char *path)
-{
-    close(fd);
-    unlink(path);
-}
-
-static void toggleGzipState(MyMData *myData, int needCompressType)
+/**
+ * Switches *pFd, *pOffset and *pLength to the variant file when a variant
+ * of the stored body is served. Returns the compress type served.
+ */
+static int selectVariant(MyMData *myData, int *pFd, off_t *pOffset,
+                         off_t *pLength)
 {
-    if (needCompressType != LSI_NO_COMPRESS &&
-        needCompressType != LSI_GZIP_COMPRESS)
-        return ;
-
-    /**
-     * Too small content needn't to be compressed
-     */
-    if (needCompressType == LSI_GZIP_COMPRESS &&
-        getEntryContentLength(myData) < 200)
-        return ;
-
-    /***
-     * Because in child process, mydata maybe can not be accessed when it is
-     * released, so save the config and entry now.
-     */
-    CacheConfig *pConfig = myData->pConfig;
     CacheEntry *pEntry = myData->pEntry;
-
-    /***
-     * Should not block the current processing
-     */
-    pid_t pid = fork();
-    if (pid < 0)
-    {
-        g_api->log(NULL, LSI_LOG_ERROR, "[%s] toggleGzipState fork failed.\n",
-               ModuleNameStr);
-        return ;
-    }
-
-    if (pid > 0)
+    int stored = pEntry->getCompressType();
+    char achPath[4096];
+    int len = sizeof(achPath);
+    myData->pConfig->getStore()->getEntryFilePath(pEntry, achPath, len);
+    int type = CacheVariant::select(pEntry, achPath,
+                                    myData->reqAcceptEncoding, *pLength);
+    if (type != stored)
     {
-        g_api->log(NULL, LSI_LOG_DEBUG,
-               "[%s] toggleGzipState fork pid %d to processing.\n",
-               ModuleNameStr, pid);
-        return;
-    }
-    else //child process
-    {
-        char tmppath[4100] = {0};
-        int len = 4096;
-        pConfig->getStore()->getEntryFilePath(pEntry, tmppath, len);
-        lstrncat(tmppath, ".tmp", sizeof(tmppath));
-
-        /**
-         * If the the file exists more than 10 minutes, should be something wrong
-         * Even the state is updating, try to remove it
-         */
-        struct stat sb;
-        if (stat(tmppath, &sb) != -1)
-        {
-            if((long)DateTime_s_curTime - (long)sb.st_ctime < 360)
-                exit (0);
-            else
-            {
-                g_api->log(NULL, LSI_LOG_DEBUG,
-                           "[%s] toggleGzipState processing too long %ld seconds.\n",
-                           ModuleNameStr,
-                           (long)DateTime_s_curTime - (long)sb.st_ctime);
-                unlink(tmppath);
-            }
-        }
-
-        int tmpfd = ::open(tmppath, O_RDWR | O_CREAT | O_TRUNC | O_EXCL, 0760);
-        if (tmpfd == -1)
-        {
-            g_api->log(NULL, LSI_LOG_DEBUG,
-                           "[%s] toggleGzipState can not open file %s.\n",
-                           ModuleNameStr, tmppath);
-            exit (0);
-        }
-
-        ::fcntl(tmpfd, F_SETFD, FD_CLOEXEC);
-
-        z_stream *zstream = new z_stream;
-        if (!zstream)
-        {
-            g_api->log(NULL, LSI_LOG_ERROR, "[%s] toggleGzipState alloc"
-                        " memory for zstream error.\n", ModuleNameStr);
-            closeTmpFile(tmpfd, tmppath);
-            exit (0);
-        }
-
-        bool compress = (needCompressType == LSI_GZIP_COMPRESS);
-        if (initZstream(zstream, compress))
-        {
-            delete zstream;
-            closeTmpFile(tmpfd, tmppath);
-            g_api->log(NULL, LSI_LOG_ERROR, "[%s]toggleGzipState initZstream"
-                        " error.\n", ModuleNameStr);
-            exit (0);
-        }
-
-        int fd = pEntry->getFdStore();
-        int part1offset = pEntry->getPart1Offset();
-        int part2offset = pEntry->getPart2Offset();
-        off_t length = pEntry->getContentTotalLen() -
-                           (part2offset - part1offset);
-
-        unsigned char *buff  = (unsigned char *)mmap((caddr_t)0,
-                                                     part2offset + length,
-                                                     PROT_READ, MAP_SHARED,
-                                                     fd, 0);
-        if (buff == (unsigned char *)(-1))
-        {
-            uninitZstream(zstream, compress);
-            closeTmpFile(tmpfd, tmppath);
-            g_api->log(NULL, LSI_LOG_ERROR, "[%s] toggleGzipState mmap"
-                        " error.\n", ModuleNameStr);
-            exit (0);
-        }
-
-
-
-
-        /**
-         * Now set the updating flag
-         */
-        write(tmpfd, buff, part2offset);
-        buff+= part2offset;
-
-        off_t ret = compressbuf(zstream, compress, buff, length, tmpfd, 1);
-        g_api->log(NULL, LSI_LOG_DEBUG,
-                   "[%s] toggleGzipState write %lld bytes to file %s.\n",
-                   ModuleNameStr, (long long)ret, tmppath);
-
-        if (ret <= 0)
-        {
-            //failed
-            closeTmpFile(tmpfd, tmppath);
-            g_api->log(NULL, LSI_LOG_ERROR, "[%s] toggleGzipState compressbuf"
-                        " error.\n", ModuleNameStr);
-        }
-        else
-        {
-            updateCacheEntry(pConfig, pEntry, tmpfd, tmppath, needCompressType, ret);
-            g_api->log(NULL, LSI_LOG_DEBUG, "[%s] toggleGzipState updated"
-                        " the cache entry.\n", ModuleNameStr);
-        }
-        uninitZstream(zstream, compress);
-
-        munmap((caddr_t)buff, part2offset + length);
-        exit(0);
+        *pFd = pEntry->getVariantFd(type);
+        *pOffset = CacheVariant::getBodyOffset();
+        *pLength = pEntry->getVariantLen(type);
     }
+    return type;
 }
 
 
@@ -3649,6 +3501,14 @@ static int handlerProcess(const lsi_session_t *session)
     char *pBuffOrg = NULL;
     int part1offset = myData->pEntry->getPart1Offset();
     int part2offset = myData->pEntry->getPart2Offset();
+    const char *pMem = CacheMemTier::getInstance().access(myData->pEntry);
+
+    int bodyFd = fd;
+    off_t bodyOffset = part2offset;
+    off_t length = myData->pEntry->getContentTotalLen() -
+                   (part2offset - part1offset);
+    int storedType = compressType;
+    compressType = selectVariant(myData, &bodyFd, &bodyOffset, &length);
     if (part2offset - part1offset > 0)
     {
 #ifdef CACHE_RESP_HEADER
@@ -3656,6 +3516,9 @@ static int handlerProcess(const lsi_session_t *session)
             buff = (char *)(myData->m_pEntry->m_sRespHeader.c_str());
         else
 #endif
+        if (pMem)
+            buff = (char *)pMem;
+        else
         {
             buff  = (char *)mmap((caddr_t)0, part2offset,
                                  PROT_READ, MAP_SHARED, fd, 0);
@@ -3787,29 +3650,14 @@ static int handlerProcess(const lsi_session_t *session)
     int ret  = 0;
     if (myData->iMethod == HTTP_GET)
     {
-        off_t length = myData->pEntry->getContentTotalLen() -
-                       (part2offset - part1offset);
-
-        if (compressType == LSI_NO_COMPRESS)
-        {
-            if (myData->reqCompressType == LSI_GZIP_COMPRESS)
-                myData->pEntry->incHits();
-            else if (myData->reqCompressType == compressType)
-                myData->pEntry->clearHits();
-        }
-        else if (compressType == LSI_GZIP_COMPRESS)
+        myData->pEntry->incHits();
+        if (compressType == LSI_GZIP_COMPRESS)
         {
             g_api->set_resp_header(session, LSI_RSPHDR_CONTENT_ENCODING,
                                    NULL, 0, "gzip", 4, LSI_HEADEROP_SET);
             g_api->log(session, LSI_LOG_DEBUG,
                        "[%s] set_resp_header [Content-Encoding: gzip].\n",
                        ModuleNameStr);
-
-            if (myData->reqCompressType == LSI_NO_COMPRESS)
-                myData->pEntry->incHits();
-            else if (myData->reqCompressType == compressType)
-                myData->pEntry->clearHits();
-
         }
         else if (compressType == LSI_BR_COMPRESS)
         {
@@ -3826,26 +3674,29 @@ static int handlerProcess(const lsi_session_t *session)
         //int fd = myData->pEntry->getFdStore();
 
         g_api->log(session, LSI_LOG_DEBUG,
-                   "[%s] handlerProcess fd %d, offset %d, length %ld\n",
-                   ModuleNameStr, fd, part2offset, length);
-
-        if (g_api->send_file2(session, fd, part2offset, length) == 0)
-            g_api->end_resp(session);
-        else
-            ret = 500;
+                   "[%s] handlerProcess fd %d, offset %ld, length %ld, "
+                   "compressType %d, stored %d\n",
+                   ModuleNameStr, bodyFd, (long)bodyOffset, (long)length,
+                   compressType, storedType);
 
         /**
-         * For testing, disable the code
+         * Serve from memory only when the body will not be compressed on
+         * the fly, otherwise sendfile() is cheaper.
          */
-        if (myData->pEntry->getHits() >= 10)
+        if (pMem && bodyFd == fd && (compressType != LSI_NO_COMPRESS
+                     || myData->reqCompressType == LSI_NO_COMPRESS))
         {
-            g_api->log(session, LSI_LOG_DEBUG,
-                       "[%s] handlerProcess check entry hit %ld times, "
-                       "will change to compressType from %d to %d.\n",
-                       ModuleNameStr, myData->pEntry->getHits(),
-                       compressType, myData->reqCompressType);
-            toggleGzipState(myData, myData->reqCompressType);
+            if (g_api->append_resp_body(session,
+                                        pMem + (part2offset - part1offset),
+                                        length) >= 0)
+                g_api->end_resp(session);
+            else
+                ret = 500;
         }
+        else if (g_api->send_file2(session, bodyFd, bodyOffset, length) == 0)
+            g_api->end_resp(session);
+        else
+            ret = 500;
     }
     else //HEAD
         g_api->end_resp(session);
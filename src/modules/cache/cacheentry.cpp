@@ -16,6 +16,7 @@
 *    along with this program. If not, see http://www.gnu.org/licenses/.      *
 *****************************************************************************/
 #include "cacheentry.h"
+#include "cachememtier.h"
 
 #include <string.h>
 #include <unistd.h>
@@ -33,21 +34,54 @@ CacheEntry::CacheEntry()
     , m_needDelay(0)
     , m_startOffset(0)
     , m_fdStore(-1)
+    , m_iVariantPending(0)
+    , m_iVariantFailed(0)
     , m_iVaryFlag(0)
     , m_pWaitQue(NULL)
+    , m_pMemObj(NULL)
 {
+    for (int i = 0; i < CE_VARIANT_COUNT; ++i)
+    {
+        m_fdVariant[i] = -1;
+        m_lVariantLen[i] = 0;
+    }
 }
 
 
 CacheEntry::~CacheEntry()
 {
+    if (m_pMemObj)
+        CacheMemTier::getInstance().remove(this);
     if (m_fdStore != -1)
         close(m_fdStore);
+    closeVariants();
     if (m_pWaitQue)
         delete m_pWaitQue;
 }
 
 
+void CacheEntry::setVariant(int type, int fd, off_t len)
+{
+    if (m_fdVariant[type] != -1)
+        close(m_fdVariant[type]);
+    m_fdVariant[type] = fd;
+    m_lVariantLen[type] = len;
+}
+
+
+void CacheEntry::closeVariants()
+{
+    for (int i = 0; i < CE_VARIANT_COUNT; ++i)
+    {
+        if (m_fdVariant[i] != -1)
+        {
+            close(m_fdVariant[i]);
+            m_fdVariant[i] = -1;
+        }
+    }
+}
+
+
 void CacheEntry::appendToWaitQ(DLinkedObj *pObj)
 {
     if (!m_pWaitQue)
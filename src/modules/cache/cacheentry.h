@@ -21,6 +21,7 @@
 #include <lsdef.h>
 #include <ceheader.h>
 #include <cachehash.h>
+#include <cachevariant.h>
 #include <util/autostr.h>
 #include <util/refcounter.h>
 
@@ -37,6 +38,7 @@
 #define CE_UPDATING     (1<<0)
 #define CE_STALE        (1<<1)
 
+class CacheMemObj;
 class DLinkedObj;
 class DLinkQueue;
 class HttpRespHeaders;
@@ -90,6 +92,9 @@ public:
     void setFdStore(int fd)         {   m_fdStore = fd;  }
     int getFdStore() const          {   return m_fdStore; }
 
+    void setMemObj(CacheMemObj *p)  {   m_pMemObj = p;      }
+    CacheMemObj *getMemObj() const  {   return m_pMemObj;   }
+
     void setStartOffset(off_t off) {   m_startOffset = off;    }
     off_t getStartOffset() const    {   return m_startOffset;   }
 
@@ -155,6 +160,28 @@ public:
     }
 
 
+    int isCompressible() const
+    {   return m_header.m_flag & CeHeader::CEH_COMPRESSIBLE;    }
+    void setCompressible(int i)
+    {   setFlag(CeHeader::CEH_COMPRESSIBLE, i);  }
+
+    int   getVariantFd(int type) const      {   return m_fdVariant[type];   }
+    off_t getVariantLen(int type) const     {   return m_lVariantLen[type]; }
+    void  setVariant(int type, int fd, off_t len);
+    void  closeVariants();
+
+    int  isVariantPending(int type) const
+    {   return m_iVariantPending & (1 << type);  }
+    void setVariantPending(int type, int v)
+    {
+        m_iVariantPending = (m_iVariantPending & ~(1 << type))
+                            | ((v) ? (1 << type) : 0);
+    }
+    int  isVariantFailed(int type) const
+    {   return m_iVariantFailed & (1 << type);   }
+    void setVariantFailed(int type)
+    {   m_iVariantFailed |= (1 << type);         }
+
     int isUpdating() const
     {   return m_header.m_flag & CeHeader::CEH_UPDATING;    }
     void setUpdating(int i)
@@ -209,7 +236,7 @@ private:
     int         m_iMaxStale;
 
     /**
-     * When this reach 10, then means currrent cache need to change gzip/ungzip
+     * Number of times the entry has been served.
      */
     uint32_t    m_iHits:29;
     uint32_t    m_isDirty:1;
@@ -221,11 +248,16 @@ private:
     off_t       m_startOffset;
     CeHeader    m_header;
     int         m_fdStore;
+    int         m_fdVariant[CE_VARIANT_COUNT];
+    off_t       m_lVariantLen[CE_VARIANT_COUNT];
+    uint8_t     m_iVariantPending;  //each bit indicate a variant being built
+    uint8_t     m_iVariantFailed;
     int32_t     m_iVaryFlag;  //each bit indicate a vary req header
     AutoStr     m_sKey;
 
     AutoStr     m_sTag;
     DLinkQueue *m_pWaitQue;
+    CacheMemObj *m_pMemObj;
     LS_NO_COPY_ASSIGN(CacheEntry);
 };
 
@@ -0,0 +1,209 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "cachememtier.h"
+#include "cacheentry.h"
+#include "cachehash.h"
+
+#include <ls.h>
+#include <util/ni_fio.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MEMTIER_FREQ_MAX    3
+#define MEMTIER_GHOST_MAX   8192
+
+LS_SINGLETON(CacheMemTier);
+
+
+CacheMemTier::CacheMemTier()
+    : m_lMaxSize(32 * 1024 * 1024)
+    , m_lMaxObjSize(512 * 1024)
+    , m_lCurSize(0)
+    , m_lSmallSize(0)
+    , m_ghostIdx(MEMTIER_GHOST_MAX / 4, CacheHash::to_ghash_key,
+                 CacheHash::compare)
+    , m_pGhost(NULL)
+    , m_iGhostMax(MEMTIER_GHOST_MAX)
+    , m_iGhostNext(0)
+{
+}
+
+
+CacheMemTier::~CacheMemTier()
+{
+    DLinkedObj *pObj;
+    while ((pObj = m_small.pop_front()) != NULL)
+        release((CacheMemObj *)pObj);
+    while ((pObj = m_main.pop_front()) != NULL)
+        release((CacheMemObj *)pObj);
+    if (m_pGhost)
+        free(m_pGhost);
+}
+
+
+const char *CacheMemTier::access(CacheEntry *pEntry)
+{
+    CacheMemObj *pObj = pEntry->getMemObj();
+    if (pObj)
+    {
+        if (pObj->m_iFreq < MEMTIER_FREQ_MAX)
+            ++pObj->m_iFreq;
+        return pObj->m_pBuf;
+    }
+    if (m_lMaxSize <= 0 || pEntry->getFdStore() == -1
+        || pEntry->isUnderConstruct() || pEntry->isBuilding())
+        return NULL;
+    int len = pEntry->getContentTotalLen();
+    if (len <= 0 || len > m_lMaxObjSize || len > m_lMaxSize / 4)
+        return NULL;
+    return load(pEntry, len);
+}
+
+
+const char *CacheMemTier::load(CacheEntry *pEntry, int len)
+{
+    char *pBuf = (char *)malloc(len);
+    if (!pBuf)
+        return NULL;
+    if (nio_pread(pEntry->getFdStore(), pBuf, len, pEntry->getPart1Offset())
+        != len)
+    {
+        free(pBuf);
+        return NULL;
+    }
+    CacheMemObj *pObj = new CacheMemObj(pEntry, pBuf, len);
+    pEntry->setMemObj(pObj);
+    if (isGhost(pEntry->getHashKey().getKey()))
+    {
+        pObj->m_iMain = 1;
+        m_main.append(pObj);
+    }
+    else
+    {
+        m_small.append(pObj);
+        m_lSmallSize += len;
+    }
+    m_lCurSize += len;
+    g_api->log(NULL, LSI_LOG_DEBUG, "[CACHE] [%p] loaded %d bytes to memory "
+               "%s queue, total: %ld.\n", pEntry, len,
+               pObj->m_iMain ? "main" : "small", m_lCurSize);
+    if (m_lCurSize > m_lMaxSize)
+        evict();
+    return pEntry->getMemObj() ? pBuf : NULL;
+}
+
+
+void CacheMemTier::remove(CacheEntry *pEntry)
+{
+    CacheMemObj *pObj = pEntry->getMemObj();
+    if (!pObj)
+        return;
+    if (pObj->m_iMain)
+        m_main.remove(pObj);
+    else
+    {
+        m_small.remove(pObj);
+        m_lSmallSize -= pObj->m_iLen;
+    }
+    release(pObj);
+}
+
+
+void CacheMemTier::release(CacheMemObj *pObj)
+{
+    m_lCurSize -= pObj->m_iLen;
+    pObj->m_pEntry->setMemObj(NULL);
+    free(pObj->m_pBuf);
+    delete pObj;
+}
+
+
+void CacheMemTier::evict()
+{
+    while (m_lCurSize > m_lMaxSize)
+    {
+        if ((m_lSmallSize > m_lMaxSize / 10 || m_main.empty())
+            && !m_small.empty())
+            evictSmall();
+        else if (!m_main.empty())
+            evictMain();
+        else
+            break;
+    }
+}
+
+
+void CacheMemTier::evictSmall()
+{
+    CacheMemObj *pObj = (CacheMemObj *)m_small.pop_front();
+    m_lSmallSize -= pObj->m_iLen;
+    if (pObj->m_iFreq > 0)
+    {
+        pObj->m_iFreq = 0;
+        pObj->m_iMain = 1;
+        m_main.append(pObj);
+        return;
+    }
+    addGhost(pObj->m_pEntry->getHashKey().getKey());
+    release(pObj);
+}
+
+
+void CacheMemTier::evictMain()
+{
+    CacheMemObj *pObj = (CacheMemObj *)m_main.pop_front();
+    if (pObj->m_iFreq > 0)
+    {
+        --pObj->m_iFreq;
+        m_main.append(pObj);
+        return;
+    }
+    release(pObj);
+}
+
+
+int CacheMemTier::isGhost(const unsigned char *pKey)
+{
+    return (m_ghostIdx.find(pKey) != NULL);
+}
+
+
+void CacheMemTier::addGhost(const unsigned char *pKey)
+{
+    if (!m_pGhost)
+    {
+        m_pGhost = (uint64_t *)calloc(m_iGhostMax, sizeof(uint64_t));
+        if (!m_pGhost)
+            return;
+    }
+    if (isGhost(pKey))
+        return;
+    uint64_t *pSlot = &m_pGhost[m_iGhostNext];
+    if (*pSlot)
+    {
+        GHash::iterator iter = m_ghostIdx.find(pSlot);
+        if (iter && iter->first() == pSlot)
+            m_ghostIdx.erase(iter);
+    }
+    memcpy(pSlot, pKey, HASH_KEY_LEN);
+    m_ghostIdx.insert(pSlot, NULL);
+    if (++m_iGhostNext >= m_iGhostMax)
+        m_iGhostNext = 0;
+}
@@ -0,0 +1,105 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef CACHEMEMTIER_H
+#define CACHEMEMTIER_H
+
+#include <lsdef.h>
+#include <util/dlinkqueue.h>
+#include <util/ghash.h>
+#include <util/tsingleton.h>
+
+#include <inttypes.h>
+
+class CacheEntry;
+
+/**
+ * In-memory copy of a published cache entry, from the start of the
+ * response headers to the end of the body.
+ */
+class CacheMemObj : public DLinkedObj
+{
+public:
+    CacheMemObj(CacheEntry *pEntry, char *pBuf, int len)
+        : m_pEntry(pEntry)
+        , m_pBuf(pBuf)
+        , m_iLen(len)
+        , m_iFreq(0)
+        , m_iMain(0)
+    {}
+
+    CacheEntry *m_pEntry;
+    char       *m_pBuf;
+    int         m_iLen;
+    uint8_t     m_iFreq;
+    uint8_t     m_iMain;
+
+    LS_NO_COPY_ASSIGN(CacheMemObj);
+};
+
+
+/**
+ * Per worker hot tier in front of the disk cache store, admission and
+ * eviction follow S3-FIFO: new objects enter a small FIFO, the ones hit
+ * again before reaching its head are promoted to the main FIFO, the rest
+ * are evicted and remembered in a ghost FIFO so that a quick return goes
+ * straight to main.
+ */
+class CacheMemTier : public TSingleton<CacheMemTier>
+{
+    friend class TSingleton<CacheMemTier>;
+
+    CacheMemTier();
+    ~CacheMemTier();
+
+public:
+    void setMaxSize(long size)          {   m_lMaxSize = size;      }
+    long getMaxSize() const             {   return m_lMaxSize;      }
+    void setMaxObjSize(long size)       {   m_lMaxObjSize = size;   }
+    long getMaxObjSize() const          {   return m_lMaxObjSize;   }
+    long getCurSize() const             {   return m_lCurSize;      }
+
+    const char *access(CacheEntry *pEntry);
+    void remove(CacheEntry *pEntry);
+
+private:
+    const char *load(CacheEntry *pEntry, int len);
+    void evict();
+    void evictSmall();
+    void evictMain();
+    void release(CacheMemObj *pObj);
+    void addGhost(const unsigned char *pKey);
+    int  isGhost(const unsigned char *pKey);
+
+    DLinkQueue  m_small;
+    DLinkQueue  m_main;
+    long        m_lMaxSize;
+    long        m_lMaxObjSize;
+    long        m_lCurSize;
+    long        m_lSmallSize;
+
+    GHash       m_ghostIdx;
+    uint64_t   *m_pGhost;
+    int         m_iGhostMax;
+    int         m_iGhostNext;
+
+    LS_NO_COPY_ASSIGN(CacheMemTier);
+};
+
+LS_SINGLETON_DECL(CacheMemTier);
+
+#endif
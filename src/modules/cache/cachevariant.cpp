@@ -0,0 +1,415 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "cachevariant.h"
+#include "cacheentry.h"
+
+#include <ls.h>
+#include <util/brotlibuf.h>
+#include <util/gzipbuf.h>
+#include <util/vmembuf.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CE_VARIANT_WORKERS      2
+#define CE_VARIANT_GZIP_LEVEL   9
+#define CE_VARIANT_BR_LEVEL     9
+#define CE_VARIANT_FLUSH_SIZE   8192
+
+static struct Offloader *s_pVariantOffloader = NULL;
+static int s_iVariantWorkers = CE_VARIANT_WORKERS;
+
+
+const char *CacheVariant::getSuffix(int type)
+{
+    static const char *s_suffix[CE_VARIANT_COUNT] = { ".id", ".gz", ".br" };
+    return s_suffix[type];
+}
+
+
+static int isCodecAvailable(int type)
+{
+#ifdef USE_BROTLI
+    return (type >= 0 && type < CE_VARIANT_COUNT);
+#else
+    return (type == LSI_NO_COMPRESS || type == LSI_GZIP_COMPRESS);
+#endif
+}
+
+
+static Compressor *getCoder(int type, GzipBuf *pGzip, Compressor *pBr)
+{
+    if (type == LSI_GZIP_COMPRESS)
+        return pGzip;
+    if (type == LSI_BR_COMPRESS)
+        return pBr;
+    return NULL;
+}
+
+
+static int startCoder(Compressor *pCoder, VMemBuf *pBuf, int type, int level)
+{
+    if ((pCoder->init(type, level) != 0)
+        || (pBuf->set(VMBUF_ANON_MAP, CE_VARIANT_FLUSH_SIZE) == LS_FAIL))
+        return LS_FAIL;
+    pCoder->setCompressCache(pBuf);
+    return pCoder->beginStream();
+}
+
+
+/**
+ * Writes identity bytes out in the target encoding.
+ */
+static int emitVariant(Compressor *pEncoder, const char *pBuf, int len,
+                       int fd, int eof)
+{
+    if (!pEncoder)
+        return (len <= 0 || write(fd, pBuf, len) == len) ? LS_OK : LS_FAIL;
+    if (len > 0 && pEncoder->write(pBuf, len) == LS_FAIL)
+        return LS_FAIL;
+    if (eof && pEncoder->endStream() != 0)
+        return LS_FAIL;
+    VMemBuf *pCache = pEncoder->getCompressCache();
+    if (eof || pCache->getCurWOffset() >= CE_VARIANT_FLUSH_SIZE)
+    {
+        if (pCache->writeToFile(fd) == LS_FAIL)
+            return LS_FAIL;
+        pEncoder->resetCompressCache();
+    }
+    return LS_OK;
+}
+
+
+/**
+ * Decodes a block of the stored body, if it is encoded, and passes it on.
+ */
+static int feedVariant(Compressor *pDecoder, Compressor *pEncoder,
+                       const char *pBuf, int len, int fd, int eof)
+{
+    if (!pDecoder)
+        return emitVariant(pEncoder, pBuf, len, fd, eof);
+    if (len > 0 && pDecoder->write(pBuf, len) == LS_FAIL)
+        return LS_FAIL;
+    if (eof && pDecoder->endStream() != 0)
+        return LS_FAIL;
+
+    VMemBuf *pCache = pDecoder->getCompressCache();
+    char *p;
+    size_t size;
+    while (((p = pCache->getReadBuffer(size)) != NULL) && (size > 0))
+    {
+        if (emitVariant(pEncoder, p, size, fd, 0) == LS_FAIL)
+            return LS_FAIL;
+        pCache->readUsed(size);
+    }
+    pDecoder->resetCompressCache();
+    return (eof ? emitVariant(pEncoder, NULL, 0, fd, 1) : LS_OK);
+}
+
+
+off_t CacheVariant::buildFile(CacheVariantTask *pTask)
+{
+    GzipBuf gzDecoder, gzEncoder;
+#ifdef USE_BROTLI
+    BrotliBuf brDecoder, brEncoder;
+    Compressor *pBrDecoder = &brDecoder, *pBrEncoder = &brEncoder;
+#else
+    Compressor *pBrDecoder = NULL, *pBrEncoder = NULL;
+#endif
+    VMemBuf decodeBuf, encodeBuf;
+    Compressor *pDecoder = getCoder(pTask->m_iSrcType, &gzDecoder, pBrDecoder);
+    Compressor *pEncoder = getCoder(pTask->m_iType, &gzEncoder, pBrEncoder);
+
+    if (pDecoder && startCoder(pDecoder, &decodeBuf,
+                               Compressor::COMPRESSOR_DECOMPRESS, 0) != 0)
+        return LS_FAIL;
+    if (pEncoder && startCoder(pEncoder, &encodeBuf,
+                               Compressor::COMPRESSOR_COMPRESS,
+                               (pTask->m_iType == LSI_BR_COMPRESS)
+                               ? CE_VARIANT_BR_LEVEL
+                               : CE_VARIANT_GZIP_LEVEL) != 0)
+        return LS_FAIL;
+
+    char achTmp[4096];
+    snprintf(achTmp, sizeof(achTmp), "%s.XXXXXX", pTask->m_path.c_str());
+    int fd = mkstemp(achTmp);
+    if (fd == -1)
+        return LS_FAIL;
+    fchmod(fd, 0660);
+
+    int ret = LS_OK;
+    if (write(fd, &pTask->m_varHeader, sizeof(CacheVariantHeader))
+        != (ssize_t)sizeof(CacheVariantHeader))
+        ret = LS_FAIL;
+
+    char achBuf[16384];
+    off_t offset = 0;
+    while ((ret == LS_OK) && (offset < pTask->m_lLength))
+    {
+        int len = sizeof(achBuf);
+        if (pTask->m_lLength - offset < len)
+            len = pTask->m_lLength - offset;
+        len = pread(pTask->m_fdSrc, achBuf, len, pTask->m_lOffset + offset);
+        if (len <= 0)
+            ret = LS_FAIL;
+        else
+        {
+            ret = feedVariant(pDecoder, pEncoder, achBuf, len, fd, 0);
+            offset += len;
+        }
+    }
+    if (ret == LS_OK)
+        ret = feedVariant(pDecoder, pEncoder, NULL, 0, fd, 1);
+
+    off_t size = (ret == LS_OK) ? lseek(fd, 0, SEEK_CUR) : -1;
+    close(fd);
+    if ((size == -1) || (rename(achTmp, pTask->m_path.c_str()) == -1))
+    {
+        unlink(achTmp);
+        return LS_FAIL;
+    }
+    return size - sizeof(CacheVariantHeader);
+}
+
+
+static int cache_variant_perform(ls_offload *item)
+{
+    CacheVariantTask *pTask = (CacheVariantTask *)item;
+    pTask->m_lResult = CacheVariant::buildFile(pTask);
+    return 0;
+}
+
+
+static void cache_variant_release(ls_offload *item)
+{
+    CacheVariantTask *pTask = (CacheVariantTask *)item;
+    if (--pTask->m_header.ref_cnt > 0)
+        return;
+    pTask->m_pEntry->setVariantPending(pTask->m_iType, 0);
+    pTask->m_pEntry->decRef();
+    close(pTask->m_fdSrc);
+    delete pTask;
+}
+
+
+static void cache_variant_done(void *param)
+{
+    CacheVariant::finishBuild((CacheVariantTask *)param);
+}
+
+
+/**
+ * Unlinks pPath if it still holds the variant described by pHeader, a
+ * newer one renamed into place meanwhile is kept.
+ */
+static void unlinkVariant(const char *pPath, const CacheVariantHeader *pHeader)
+{
+    CacheVariantHeader varHeader;
+    int fd = ::open(pPath, O_RDONLY);
+    if (fd == -1)
+        return;
+    int match = ((pread(fd, &varHeader, sizeof(varHeader), 0)
+                  == sizeof(varHeader))
+                 && (memcmp(&varHeader, pHeader, sizeof(varHeader)) == 0));
+    close(fd);
+    if (match)
+        unlink(pPath);
+}
+
+
+void CacheVariant::finishBuild(CacheVariantTask *pTask)
+{
+    CacheEntry *pEntry = pTask->m_pEntry;
+    if (pTask->m_lResult == LS_FAIL)
+    {
+        pEntry->setVariantFailed(pTask->m_iType);
+        g_api->log(NULL, LSI_LOG_INFO,
+                   "[CACHE] failed to build variant %s.\n",
+                   pTask->m_path.c_str());
+        return;
+    }
+
+    //The entry may have been purged, marked stale or replaced by a newer
+    //copy while the variant was built, its removeFiles() has run already.
+    const CeHeader &header = pEntry->getHeader();
+    if (pEntry->isDirty() || pEntry->isStale()
+        || (header.m_tmCreated != pTask->m_varHeader.m_tmCreated)
+        || (header.m_msCreated != pTask->m_varHeader.m_msCreated))
+    {
+        unlinkVariant(pTask->m_path.c_str(), &pTask->m_varHeader);
+        g_api->log(NULL, LSI_LOG_DEBUG,
+                   "[CACHE] entry changed, discard variant %s.\n",
+                   pTask->m_path.c_str());
+        return;
+    }
+    g_api->log(NULL, LSI_LOG_DEBUG,
+               "[CACHE] built variant %s, %ld bytes from %ld.\n",
+               pTask->m_path.c_str(), (long)pTask->m_lResult,
+               (long)pTask->m_lLength);
+}
+
+
+static struct ls_offload_api s_variantApi =
+{
+    cache_variant_perform,
+    cache_variant_release,
+    cache_variant_done
+};
+
+
+static struct Offloader *getVariantOffloader()
+{
+    if (!s_pVariantOffloader && s_iVariantWorkers > 0)
+    {
+        s_pVariantOffloader = offloader_new2("CACHE_VARIANT",
+                                             s_iVariantWorkers, 1, 10, 5);
+        if (!s_pVariantOffloader)
+            s_iVariantWorkers = 0;
+    }
+    return s_pVariantOffloader;
+}
+
+
+static int buildPath(char *pBuf, int len, const char *pEntryPath, int type)
+{
+    return snprintf(pBuf, len, "%s%s", pEntryPath,
+                    CacheVariant::getSuffix(type)) < len ? LS_OK : LS_FAIL;
+}
+
+
+int CacheVariant::open(CacheEntry *pEntry, const char *pEntryPath, int type)
+{
+    int fd = pEntry->getVariantFd(type);
+    if (fd != -1)
+        return fd;
+    if (pEntry->isVariantPending(type) || pEntry->isVariantFailed(type))
+        return -1;
+
+    char achPath[4200];
+    if (buildPath(achPath, sizeof(achPath), pEntryPath, type) == LS_FAIL)
+        return -1;
+    fd = ::open(achPath, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    const CeHeader &header = pEntry->getHeader();
+    CacheVariantHeader varHeader;
+    struct stat st;
+    if ((pread(fd, &varHeader, sizeof(varHeader), 0) != sizeof(varHeader))
+        || (fstat(fd, &st) == -1)
+        || (varHeader.m_iMagic != CE_VARIANT_ID)
+        || (varHeader.m_tmCreated != header.m_tmCreated)
+        || (varHeader.m_msCreated != header.m_msCreated)
+        || (varHeader.m_iSrcLen != header.m_valPart2Len))
+    {
+        //left by an older copy of the entry, it will be rebuilt
+        close(fd);
+        return -1;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    pEntry->setVariant(type, fd, st.st_size - sizeof(varHeader));
+    return fd;
+}
+
+
+int CacheVariant::select(CacheEntry *pEntry, const char *pEntryPath,
+                         int acceptMask, off_t bodyLen)
+{
+    static const int s_order[CE_VARIANT_COUNT] =
+    {   LSI_BR_COMPRESS, LSI_GZIP_COMPRESS, LSI_NO_COMPRESS   };
+    int stored = pEntry->getCompressType();
+    if ((stored == LSI_NO_COMPRESS && !pEntry->isCompressible())
+        || bodyLen < CE_VARIANT_MIN_SIZE)
+        return stored;
+
+    for (int i = 0; i < CE_VARIANT_COUNT; ++i)
+    {
+        int type = s_order[i];
+        if (!(acceptMask & (1 << type)))
+            continue;
+        if (type == stored)
+            return stored;
+        if (open(pEntry, pEntryPath, type) != -1)
+            return type;
+        build(pEntry, pEntryPath, type);
+    }
+    return stored;
+}
+
+
+int CacheVariant::build(CacheEntry *pEntry, const char *pEntryPath, int type)
+{
+    int srcType = pEntry->getCompressType();
+    if ((type == srcType) || pEntry->isVariantPending(type)
+        || pEntry->isVariantFailed(type) || pEntry->getFdStore() == -1
+        || !isCodecAvailable(type) || !isCodecAvailable(srcType))
+        return LS_FAIL;
+
+    struct Offloader *pOffloader = getVariantOffloader();
+    if (!pOffloader)
+        return LS_FAIL;
+
+    char achPath[4200];
+    if (buildPath(achPath, sizeof(achPath), pEntryPath, type) == LS_FAIL)
+        return LS_FAIL;
+    int fdSrc = dup(pEntry->getFdStore());
+    if (fdSrc == -1)
+        return LS_FAIL;
+    ::fcntl(fdSrc, F_SETFD, FD_CLOEXEC);
+
+    CacheVariantTask *pTask = new CacheVariantTask();
+    memset(&pTask->m_header, 0, sizeof(pTask->m_header));
+    pTask->m_header.api = &s_variantApi;
+    pTask->m_header.param_task_done = pTask;
+    pTask->m_path.setStr(achPath);
+
+    const CeHeader &header = pEntry->getHeader();
+    pTask->m_pEntry = pEntry;
+    pTask->m_fdSrc = fdSrc;
+    pTask->m_iType = type;
+    pTask->m_iSrcType = srcType;
+    pTask->m_lOffset = pEntry->getPart2Offset();
+    pTask->m_lLength = pEntry->getPart2Len();
+    pTask->m_varHeader.m_iMagic = CE_VARIANT_ID;
+    pTask->m_varHeader.m_tmCreated = header.m_tmCreated;
+    pTask->m_varHeader.m_msCreated = header.m_msCreated;
+    pTask->m_varHeader.m_iSrcLen = header.m_valPart2Len;
+    pTask->m_lResult = LS_FAIL;
+
+    pEntry->incRef();
+    pEntry->setVariantPending(type, 1);
+    g_api->log(NULL, LSI_LOG_DEBUG, "[CACHE] queue variant build %s.\n",
+               pTask->m_path.c_str());
+    //offloader_enqueue() releases the task by itself on failure.
+    return offloader_enqueue(pOffloader, &pTask->m_header);
+}
+
+
+void CacheVariant::removeFiles(const char *pEntryPath)
+{
+    char achPath[4200];
+    for (int type = 0; type < CE_VARIANT_COUNT; ++type)
+    {
+        if (buildPath(achPath, sizeof(achPath), pEntryPath, type) == LS_OK)
+            unlink(achPath);
+    }
+}
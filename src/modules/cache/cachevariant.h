@@ -0,0 +1,113 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef CACHEVARIANT_H
+#define CACHEVARIANT_H
+
+#include <lsdef.h>
+#include <http/platforms.h>
+#include <lsr/ls_offload.h>
+#include <util/autostr.h>
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#define CE_VARIANT_ID           MK_DWORD4( 'L', 'S', 'C', 'V' )
+#define CE_VARIANT_COUNT        3       //indexed by compress type, 0 identity, 1 gzip, 2 br
+#define CE_VARIANT_MIN_SIZE     200     //smaller bodies are not worth a variant
+
+class CacheEntry;
+
+/**
+ * The head of a variant file, it ties the variant to the entry it was
+ * built from. A variant of an older copy of the entry is ignored.
+ */
+struct CacheVariantHeader
+{
+    int32_t m_iMagic;
+    int32_t m_tmCreated;
+    int32_t m_msCreated;
+    int32_t m_iSrcLen;
+};
+
+
+/**
+ * A variant build handed to the offloader threads. The worker only uses
+ * the copies kept here, the entry itself is touched in the event loop.
+ */
+struct CacheVariantTask
+{
+    ls_offload_t    m_header;
+    CacheEntry     *m_pEntry;
+    AutoStr2        m_path;
+    int             m_fdSrc;
+    int             m_iType;
+    int             m_iSrcType;
+    off_t           m_lOffset;
+    off_t           m_lLength;
+    CacheVariantHeader m_varHeader;
+    off_t           m_lResult;
+};
+
+
+/**
+ * Alternative content encodings of a cache entry body. Each variant lives
+ * next to the entry file as "<entry>.gz", "<entry>.br" or "<entry>.id" and
+ * holds only the body, it is built by offloader threads from the stored
+ * body, so no per-hit transcoding is needed once it is there.
+ */
+class CacheVariant
+{
+public:
+    static const char *getSuffix(int type);
+    static off_t getBodyOffset()    {   return sizeof(CacheVariantHeader);  }
+
+    /**
+     * Picks the best encoding in acceptMask that is ready, the stored one
+     * when it is better or nothing else is, and queues builds for the
+     * better ones that are not ready yet. Returns the compress type.
+     */
+    static int  select(CacheEntry *pEntry, const char *pEntryPath,
+                       int acceptMask, off_t bodyLen);
+
+    /**
+     * Returns the fd of a valid variant of pEntry, -1 if it is not ready.
+     */
+    static int  open(CacheEntry *pEntry, const char *pEntryPath, int type);
+
+    /**
+     * Queues a background build of the variant, LS_FAIL if it cannot be
+     * built now.
+     */
+    static int  build(CacheEntry *pEntry, const char *pEntryPath, int type);
+
+    static void removeFiles(const char *pEntryPath);
+
+    /**
+     * Runs in an offloader thread. Returns the variant body size, LS_FAIL
+     * if it cannot be built.
+     */
+    static off_t buildFile(CacheVariantTask *pTask);
+
+    /**
+     * Called in the event loop once the build is over, drops the variant
+     * file if the entry was purged or replaced meanwhile.
+     */
+    static void  finishBuild(CacheVariantTask *pTask);
+};
+
+#endif // CACHEVARIANT_H
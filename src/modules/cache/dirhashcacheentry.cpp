@@ -144,6 +144,7 @@ int DirHashCacheEntry::releaseTmpResource()
         close(fd);
         setFdStore(-1);
     }
+    closeVariants();
     return 0;
 }
 
@@ -19,6 +19,7 @@
 #include "dirhashcachestore.h"
 #include "dirhashcacheentry.h"
 #include "cachehash.h"
+#include "cachevariant.h"
 
 #include <util/datetime.h>
 #include <util/stringtool.h>
@@ -578,6 +579,7 @@ void DirHashCacheStore::removePermEntry(CacheEntry *pEntry)
     buildCacheLocation(achBuf, 4096, pEntry->getHashKey().getKey(),
                        pEntry->isPrivate());
     unlink(achBuf);
+    CacheVariant::removeFiles(achBuf);
 }
 
 void DirHashCacheStore::getEntryFilePath(CacheEntry *pEntry, char *pPath, int &len)
@@ -770,6 +772,7 @@ void DirHashCacheStore::removeEntryByHash(const unsigned char *pKey, int isPriva
 
     g_api->log(NULL, LSI_LOG_DEBUG, "[CACHE] remove cache object [%s].\n", achBuf);
     unlink(achBuf);
+    CacheVariant::removeFiles(achBuf);
 
     pathEnd -= 2 * HASH_KEY_LEN + 1;
     assert(*pathEnd == '/');
@@ -795,4 +798,9 @@ void DirHashCacheStore::removeDeadEntry(CacheEntry *pEntry,
         buildCacheLocation(achBuf, 4096, hash.getKey(), pEntry->isPrivate());
     delete pEntry;
     unlink(achBuf);
+
+    int len = strlen(achBuf);
+    if (len > 2 && strcmp(&achBuf[len - 2], ".S") == 0)
+        achBuf[len - 2] = 0;
+    CacheVariant::removeFiles(achBuf);
 }
@@ -924,7 +924,7 @@ int ShmCacheManager::initCacheInfo(LsShmPool *pPool)
 int ShmCacheManager::initTables(LsShmPool *pPool)
 {
     m_pPublicPurge = pPool->getNamedHash("public", 1000, LsShmHash::hashXXH32,
-                                         memcmp, 0);
+                                         memcmp, LSSHM_FLAG_SEQREAD);
     if (!m_pPublicPurge)
         return -1;
 
@@ -934,7 +934,7 @@ int ShmCacheManager::initTables(LsShmPool *pPool)
         return -1;
 
     m_pStr2IdHash = pPool->getNamedHash("tags", 20, LsShmHash::hashXXH32,
-                                        memcmp,  0);
+                                        memcmp, LSSHM_FLAG_SEQREAD);
     if (!m_pStr2IdHash)
         return -1;
 
@@ -945,7 +945,8 @@ int ShmCacheManager::initTables(LsShmPool *pPool)
     m_pUrlVary->disableAutoLock();
 
     m_pId2VaryStr = pPool->getNamedHash("id2vary", 100,
-                                        LsShmHash::hashXXH32, memcmp, 0);
+                                        LsShmHash::hashXXH32, memcmp,
+                                        LSSHM_FLAG_SEQREAD);
     if (!m_pId2VaryStr)
         return -1;
     
@@ -618,6 +618,8 @@ const char *LsLuaApi::init(const char *pModuleName)
         return "pushlstring";
     if ((LSLUAAPI_DL(pushnil)) == NULL)
         return "pushnil";
+    if ((LSLUAAPI_DL(status)) == NULL)
+        return "status";
     if ((LSLUAAPI_DL(pushnumber)) == NULL)
         return "pushnumber";
     if ((LSLUAAPI_DL(pushstring)) == NULL)
@@ -699,6 +701,8 @@ const char *LsLuaApi::init(const char *pModuleName)
     // Debug Library.
     if ((LSLUAAPI_DL(getinfo)) == NULL)
         return "getinfo";
+    if ((LSLUAAPI_DL(getstack)) == NULL)
+        return "getstack";
     if ((LSLUAAPI_DL(sethook)) == NULL)
         return "sethook";
     if ((LSLUAAPI_DL(setupvalue)) == NULL)
@@ -785,10 +789,12 @@ pf_tointeger            LsLuaApi::tointeger = NULL;
 pf_tointegerx           LsLuaApi::tointegerx = NULL;
 pf_tonumber             LsLuaApi::tonumber = NULL;
 pf_tonumberx            LsLuaApi::tonumberx = NULL;
+pf_status               LsLuaApi::status = NULL;
 pf_yield                LsLuaApi::yield = NULL;
 pf_yieldk               LsLuaApi::yieldk = NULL;
 
 pf_getinfo              LsLuaApi::getinfo = NULL;
+pf_getstack             LsLuaApi::getstack = NULL;
 pf_sethook              LsLuaApi::sethook = NULL;
 pf_setupvalue           LsLuaApi::setupvalue = NULL;
 
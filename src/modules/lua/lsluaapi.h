@@ -149,11 +149,13 @@ typedef int (*pf_tointeger)(lua_State *, int);
 typedef int (*pf_tointegerx)(lua_State *, int, int *);
 typedef double(*pf_tonumber)(lua_State *, int);
 typedef double(*pf_tonumberx)(lua_State *, int, int *);
+typedef int (*pf_status)(lua_State *);
 typedef int (*pf_yield)(lua_State *, int);
 typedef int (*pf_yieldk)(lua_State *, int, int, lua_CFunction);
 
 // DEBUG LIB
 typedef int (*pf_getinfo)(lua_State *, const char *, lua_Debug *);
+typedef int (*pf_getstack)(lua_State *, int, lua_Debug *);
 typedef int (*pf_sethook)(lua_State *, lua_Hook, int, int);
 typedef const char *(*pf_setupvalue)(lua_State *, int, int);
 
@@ -335,10 +337,12 @@ public:
     static pf_resume            resume;
     static pf_tointeger         tointeger;
     static pf_tonumber          tonumber;
+    static pf_status            status;
     static pf_yield             yield;
 
     // Debug library
     static pf_getinfo           getinfo;
+    static pf_getstack          getstack;
     static pf_sethook           sethook;
     static pf_setupvalue        setupvalue;
 
@@ -84,6 +84,9 @@ extern "C" {
 #define F_PAGESIZE    0x2000
 #define TMPBUFSIZE  0x2000
 #define MAX_RESP_HEADERS_NUMBER     50
+#define LSLUA_THREAD_POOL_MAX       256 /* idle session threads kept per worker */
+#define LSLUA_THREAD_POOL_PREWARM   16  /* threads created at engine init */
+#define LSLUA_SCRIPT_CHECK_SEC      1   /* min seconds between script stat() */
 
 #define LSLUA_PRINT_FLAG_DEBUG      1
 #define LSLUA_PRINT_FLAG_VALUE_ONLY 2
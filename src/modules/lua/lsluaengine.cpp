@@ -22,6 +22,7 @@
 #include "lsluasession.h"
 
 #include <lsr/ls_confparser.h>
+#include <lsr/ls_hash.h>
 #include <lsr/ls_loopbuf.h>
 #include <lsr/ls_strtool.h>
 
@@ -67,6 +68,11 @@ const char     *LsLuaEngine::s_pSysLuaPath =
 char            LsLuaEngine::s_aVersion[0x20] =
     "LUA-NOT-READY"; // default LUA_VERSION
 
+int             LsLuaEngine::s_aThreadPool[LSLUA_THREAD_POOL_MAX];
+int             LsLuaEngine::s_iThreadPoolCnt = 0;
+long            LsLuaEngine::s_iThreadNew = 0;
+long            LsLuaEngine::s_iThreadReuse = 0;
+
 LsLuaEngine::LSLUA_TYPE LsLuaEngine::s_type = LSLUA_ENGINE_REGULAR;
 LsLuaEngine::LsLuaEngine()
 {
@@ -137,6 +143,7 @@ int LsLuaEngine::init()
     injectLsiapi(s_pSystemState);
     LsLuaCreateUD(s_pSystemState);
     LsLuaApi::execLuaCmd(getSystemState(), "ls.set_version(_VERSION)");
+    prewarmThreads(LSLUA_THREAD_POOL_PREWARM);
     s_iReady = 1;
     return 0;
 }
@@ -506,12 +513,77 @@ lua_State *LsLuaEngine::newLuaConnection()
 }
 
 
+//
+//  Like lua_newthread(), the returned thread is pushed onto L.
+//
 lua_State *LsLuaEngine::newLuaThread(lua_State *L)
 {
+    lua_State *pThread;
+    int r;
+
+    while ((L == getSystemState()) && (s_iThreadPoolCnt > 0))
+    {
+        r = s_aThreadPool[--s_iThreadPoolCnt];
+        LsLuaApi::rawgeti(L, LSLUA_REGISTRYINDEX, r);
+        LsLuaApi::unref(L, LSLUA_REGISTRYINDEX, r);
+        if ((pThread = LsLuaApi::tothread(L, -1)) != NULL)
+        {
+            ++s_iThreadReuse;
+            return pThread;
+        }
+        LsLuaApi::pop(L, 1);
+    }
+    ++s_iThreadNew;
     return LsLuaApi::newthread(L);
 }
 
 
+void LsLuaEngine::prewarmThreads(int count)
+{
+    lua_State *L = getSystemState();
+
+    while ((count-- > 0) && (s_iThreadPoolCnt < LSLUA_THREAD_POOL_MAX))
+    {
+        if (LsLuaApi::newthread(L) == NULL)
+            break;
+        s_aThreadPool[s_iThreadPoolCnt++] =
+            LsLuaApi::ref(L, LSLUA_REGISTRYINDEX);
+    }
+}
+
+
+//
+//  Only a thread that ran to completion can be resumed again; a yielded,
+//  errored or still running one is left for the GC.  A fresh sandbox is
+//  built by setupLuaEnv() on the next use.
+//
+void LsLuaEngine::recycleThread(LsLuaSession *pSession)
+{
+    lua_State *L = pSession->getLuaState();
+    lua_Debug ar;
+
+    if ((s_iThreadPoolCnt >= LSLUA_THREAD_POOL_MAX)
+        || (pSession->getRef() == LUA_REFNIL)
+        || (LsLuaApi::status(L) != 0)
+        || (LsLuaApi::getstack(L, 0, &ar) != 0))
+        return;
+
+    LsLuaApi::sethook(L, NULL, 0, 0);
+    LsLuaApi::settop(L, 0);
+    if (LsLuaApi::jitMode())
+    {
+        // drop the old sandbox so the next one chains to the real globals
+        LsLuaApi::pushglobaltable(getSystemState());
+        LsLuaApi::xmove(getSystemState(), L, 1);
+        LsLuaApi::replace(L, LSLUA_GLOBALSINDEX);
+    }
+    LsLuaApi::rawgeti(getSystemState(), LSLUA_REGISTRYINDEX,
+                      pSession->getRef());
+    s_aThreadPool[s_iThreadPoolCnt++] =
+        LsLuaApi::ref(getSystemState(), LSLUA_REGISTRYINDEX);
+}
+
+
 lua_State *LsLuaEngine::injectLsiapi(lua_State *L)
 {
     extern int LsLuaCppFuncSetup(lua_State *);
@@ -811,40 +883,50 @@ int LsLuaEngine::testCmd()
 }
 
 
-LsLuaFuncMap *LsLuaFuncMap::s_pMap = {NULL};
+ls_hash_t *LsLuaFuncMap::s_pMap = NULL;
 int LsLuaFuncMap::s_iMapCnt = 0;
+long LsLuaFuncMap::s_iHits = 0;
+long LsLuaFuncMap::s_iMisses = 0;
+long LsLuaFuncMap::s_iReloads = 0;
 
 
 int LsLuaFuncMap::loadLuaScript(const lsi_session_t *session, lua_State *L,
                                 const char *scriptName)
 {
     LsLuaFuncMap *p;
+    ls_hash_iter iter;
 
-    for (p = s_pMap; p != NULL; p = p->m_pNext)
+    if (s_pMap == NULL)
+        s_pMap = ls_hash_new(16, ls_hash_hfstring, ls_hash_cmpstring, NULL);
+    if ((iter = ls_hash_find(s_pMap, scriptName)) != NULL)
     {
-        if (strcmp(scriptName, p->scriptName()) == 0)
+        p = (LsLuaFuncMap *)ls_hash_getdata(iter);
+        time_t now = g_api->get_cur_time(NULL);
+        if (now - p->m_tmChecked < LSLUA_SCRIPT_CHECK_SEC)
         {
-            struct stat scriptStat;
-            if (stat(scriptName, &scriptStat) == 0)
-            {
-                if ((scriptStat.st_mtime == p->m_stat.st_mtime)
-                    && (scriptStat.st_ino == p->m_stat.st_ino)
-                    && (scriptStat.st_size == p->m_stat.st_size))
-                {
-                    p->loadLuaFunc(L);
-                    return 0;
-                }
-                // File was changed, reload new script.
-                p->unloadLuaFunc(L);
-                p->remove();
-                delete p;
+            ++s_iHits;
+            p->loadLuaFunc(L);
+            return 0;
+        }
+        p->m_tmChecked = now;
 
-                return loadLuaScript(session, L, scriptName);
-            }
+        struct stat scriptStat;
+        if ((stat(scriptName, &scriptStat) != 0)
+            || ((scriptStat.st_mtime == p->m_stat.st_mtime)
+                && (scriptStat.st_ino == p->m_stat.st_ino)
+                && (scriptStat.st_size == p->m_stat.st_size)))
+        {
+            ++s_iHits;
             p->loadLuaFunc(L);
             return 0;
         }
+        // File was changed, reload new script.
+        ++s_iReloads;
+        p->unloadLuaFunc(L);
+        p->remove();
+        delete p;
     }
+    ++s_iMisses;
     p = new LsLuaFuncMap(session, L, scriptName);
     if (p->isReady())
     {
@@ -901,6 +983,7 @@ LsLuaFuncMap::LsLuaFuncMap(const lsi_session_t *session, lua_State *L,
     loadData.state = 1;
 
     stat(m_pScriptName, &m_stat);
+    m_tmChecked = g_api->get_cur_time(NULL);
 
     ret = LsLuaApi::load(L, textFileReader, (void *)&loadData,
                          m_pScriptName, NULL);
@@ -966,29 +1049,15 @@ void LsLuaFuncMap::unloadLuaFunc(lua_State *L)
 
 void LsLuaFuncMap::add()
 {
-    m_pNext = s_pMap;
-    s_pMap = this;
+    ls_hash_insert(s_pMap, m_pScriptName, this);
 }
 
 
 void LsLuaFuncMap::remove()
 {
-    LsLuaFuncMap *p;
-
-    if (this == s_pMap)
-    {
-        s_pMap = m_pNext;
-        return;
-    }
-
-    for (p = s_pMap; p->m_pNext; p = p->m_pNext)
-    {
-        if (p->m_pNext == this)
-        {
-            p->m_pNext = m_pNext;
-            return;
-        }
-    }
+    ls_hash_iter iter = ls_hash_find(s_pMap, m_pScriptName);
+    if ((iter != NULL) && (ls_hash_getdata(iter) == this))
+        ls_hash_erase(s_pMap, iter);
 }
 
 
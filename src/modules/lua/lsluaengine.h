@@ -34,6 +34,7 @@ class LsLuaSession;
 class LsLuaFunc;
 class LsLuaUserParam;
 typedef struct ls_xloopbuf_s ls_xloopbuf_t;
+typedef struct ls_hash_s ls_hash_t;
 
 class LsLuaEngine
 {
@@ -77,6 +78,17 @@ public:
 
     static lua_State *injectLsiapi(lua_State *L);
 
+    // Session coroutines come from a per-worker pool of idle threads;
+    // recycleThread() returns one that finished cleanly.
+    static lua_State *newLuaThread(lua_State *L);
+    static void recycleThread(LsLuaSession *pSession);
+
+    static long getThreadNewCount()
+    {   return s_iThreadNew;    }
+
+    static long getThreadReuseCount()
+    {   return s_iThreadReuse;  }
+
     static void *parseParam(module_param_info_t *param  , int param_count,
                             void *initial_config, int level,
                             const char *name);
@@ -113,7 +125,7 @@ private:
     static int setupSandBox(lua_State *L);
     static int execLuaCmd(const char *cmd);
     static lua_State *newLuaConnection();
-    static lua_State *newLuaThread(lua_State *L);
+    static void prewarmThreads(int count);
     static LsLuaSession *prepState(const lsi_session_t *session,
                                    const char *scriptpath,
                                    LsLuaUserParam *pUser,
@@ -149,6 +161,13 @@ private:
     static int          s_iDebugLevel;   // current web server debug level
     static char         s_aLuaName[0x10];// 15 bytes to save the name
     static char         s_aVersion[0x20];// 31 bytes for LUA information
+    //
+    //  idle session thread pool, registry refs of the system state
+    //
+    static int          s_aThreadPool[];
+    static int          s_iThreadPoolCnt;
+    static long         s_iThreadNew;
+    static long         s_iThreadReuse;
 };
 
 //
@@ -159,6 +178,9 @@ private:
 //  @ funcName - LiteSpeed internal name of the script
 //  @ status - 1 good. 0 not ready, -1 syntax error, -2 LUA error
 //
+//  Compiled chunks live in the system state, so one load serves every vhost
+//  in the worker; the file is re-stat()ed at most every LSLUA_SCRIPT_CHECK_SEC.
+//
 class LsLuaFuncMap
 {
 public:
@@ -176,6 +198,13 @@ public:
     int status() const
     {   return m_iStatus;   }
 
+    static long getHitCount()
+    {   return s_iHits;     }
+    static long getMissCount()
+    {   return s_iMisses;   }
+    static long getReloadCount()
+    {   return s_iReloads;  }
+
 private:
     LsLuaFuncMap(const lsi_session_t *session, lua_State *L,
                  const char *scriptName);
@@ -197,11 +226,14 @@ private:
     char                *m_pScriptName;
     char                *m_pFuncName;
     int                  m_iStatus;
-    LsLuaFuncMap        *m_pNext;
     struct stat          m_stat;
+    time_t               m_tmChecked;
 
-    static LsLuaFuncMap *s_pMap;
+    static ls_hash_t    *s_pMap;
     static int           s_iMapCnt;
+    static long          s_iHits;
+    static long          s_iMisses;
+    static long          s_iReloads;
 };
 
 class LsLuaUserParam
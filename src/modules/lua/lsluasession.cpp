@@ -455,7 +455,7 @@ int LsLuaSession::setupLuaEnv(lua_State *L, LsLuaUserParam *pUser)
     if (m_pState)
         return 0;
     // 1. create coroutine for this session,
-    if (!(m_pState = LsLuaApi::newthread(L)))
+    if (!(m_pState = LsLuaEngine::newLuaThread(L)))
         return LS_FAIL;
 
     // 2. Inherit system level injected APIs if in jit mode.
@@ -698,6 +698,21 @@ static int  LsLuaSessDebug(lua_State *L)
             LsLuaApi::pushinteger(L, pSession->getLuaCounter());
             return 1;
         }
+        if (!strncmp(cp, "pool", 4))
+        {
+            LsLuaApi::createtable(L, 0, 5);
+            LsLuaApi::pushinteger(L, LsLuaEngine::getThreadNewCount());
+            LsLuaApi::setfield(L, -2, "thread_new");
+            LsLuaApi::pushinteger(L, LsLuaEngine::getThreadReuseCount());
+            LsLuaApi::setfield(L, -2, "thread_reuse");
+            LsLuaApi::pushinteger(L, LsLuaFuncMap::getHitCount());
+            LsLuaApi::setfield(L, -2, "script_hit");
+            LsLuaApi::pushinteger(L, LsLuaFuncMap::getMissCount());
+            LsLuaApi::setfield(L, -2, "script_miss");
+            LsLuaApi::pushinteger(L, LsLuaFuncMap::getReloadCount());
+            LsLuaApi::setfield(L, -2, "script_reload");
+            return 1;
+        }
         if (!strncmp(cp, "lua", 3))
         {
             const char *cmd = LsLuaApi::tolstring(L, 2, &n);
@@ -781,6 +796,7 @@ static inline void killThisSession(LsLuaSession *pSession)
             && (!LsLuaEngine::loadRef(pSession, pSession->getLuaState())))
         {
             LsLuaClearSession(pSession->getLuaState());
+            LsLuaEngine::recycleThread(pSession);
             LsLuaEngine::unref(pSession);
         }
         pSession->clearState();
@@ -218,7 +218,7 @@ lsquic_conn_ctx_t *QuicEngine::onNewConn(void *stream_if_ctx,
         pClientInfo = ClientCache::getInstance().getClientInfo((sockaddr *)pPeer);
 
     if (!pClientInfo ||
-        (int) pClientInfo->getConns() >= pClientInfo->getPerClientHardLimit())
+        (int) pClientInfo->getTotalConns() >= pClientInfo->getPerClientHardLimit())
     {
         lsquic_conn_abort(c);
         return NULL;
@@ -712,6 +712,7 @@ int QuicEngine::init(Multiplexer * pMplx, const char *pShmDir,
     m_config.es_max_header_list_size = 64 * 1024;
     m_config.es_rw_once = 1;
     m_config.es_send_prst = 1;
+    m_config.es_ext_http_prio = 1;
 
     lsquic_logger_init(&logger_if, log4cxx::Logger::getDefault(),
                                                     LLTS_YYYYMMDD_HHMMSSUS);
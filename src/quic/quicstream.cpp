@@ -24,6 +24,7 @@
 #include <util/datetime.h>
 #include <http/clientinfo.h>
 #include <http/hiohandlerfactory.h>
+#include <http/httppriority.h>
 #include <http/httpstatuscode.h>
 #include <http/httprespheaders.h>
 #include <log4cxx/logger.h>
@@ -64,7 +65,7 @@ int QuicStream::init(lsquic_stream_t *s)
 
     setState(HIOS_CONNECTED);
 
-    int pri = HIO_PRIORITY_HTML;
+    int pri = HIO_PRIORITY_DEFAULT;
 //     if (pPriority)
 //     {
 //         if (pPriority->m_weight <= 32)
@@ -109,6 +110,16 @@ int QuicStream::processUpkdHdrs(UnpackedHeaders *hdrs)
     HioHandler *pHandler = HioHandlerFactory::getHandler(HIOS_PROTO_HTTP);
     if (pHandler)
     {
+        // lsquic schedules by the signal itself, keep a copy for MIME
+        // defaults and logging.
+        int urgency = HIO_PRIORITY_DEFAULT;
+        int incremental = 0;
+        if (HttpPriority::parseReqHeaders(hdrs, &urgency, &incremental) == LS_OK)
+        {
+            setFlag(HIO_FLAG_PRI_SIGNAL, 1);
+            setFlag(HIO_FLAG_PRI_INCREMENTAL, incremental);
+            setPriority(urgency);
+        }
         setActiveTime(DateTime::s_curTime);
         pHandler->attachStream(this);
         setReqHeaders(hdrs);
@@ -199,6 +210,8 @@ int QuicStream::sendRespHeaders(HttpRespHeaders *pRespHeaders, int isNoBody)
 
     if (!m_pStream)
         return -1;
+    if (!isNoBody && !getFlag(HIO_FLAG_PRI_SIGNAL | HIO_FLAG_IS_PUSH))
+        applyMimePriority(pRespHeaders);
     pRespHeaders->prepareSendXpack(getProtocol() == HIOS_PROTO_HTTP3);
     headers.headers = pRespHeaders->begin();
     headers.count = pRespHeaders->end() - pRespHeaders->begin();
@@ -207,6 +220,30 @@ int QuicStream::sendRespHeaders(HttpRespHeaders *pRespHeaders, int isNoBody)
 }
 
 
+void QuicStream::applyMimePriority(HttpRespHeaders *pRespHeaders)
+{
+    int len, incremental;
+    const char *pType = pRespHeaders->getHeader(HttpRespHeaders::H_CONTENT_TYPE,
+                                                &len);
+    int urgency = HttpPriority::getMimeUrgency(pType, len, &incremental);
+    if (urgency == -1)
+        return;
+    setPriority(urgency);
+    setFlag(HIO_FLAG_PRI_INCREMENTAL, incremental);
+    if (getProtocol() == HIOS_PROTO_HTTP3)
+    {
+        struct lsquic_ext_http_prio ehp;
+        ehp.urgency = urgency;
+        ehp.incremental = incremental;
+        lsquic_stream_set_http_prio(m_pStream, &ehp);
+    }
+    else
+        lsquic_stream_set_priority(m_pStream, 1 + urgency * 32);
+    LS_DBG_L(this, "MIME default priority, urgency: %d, incremental: %d",
+             urgency, incremental);
+}
+
+
 int QuicStream::sendfile(int fdSrc, off_t off, size_t size, int flag)
 {
     return 0;
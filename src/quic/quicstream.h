@@ -74,6 +74,7 @@ public:
 
 private:
     int checkReadRet(int ret);
+    void applyMimePriority(HttpRespHeaders *pRespHeaders);
 
     LS_NO_COPY_ASSIGN(QuicStream);
 };
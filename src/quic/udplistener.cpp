@@ -53,6 +53,28 @@
 #   define BATCH_SIZE   100
 #endif
 
+#if __linux__
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#   define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#   define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#   define UDP_GRO 104
+#endif
+#endif
+
+/* Datagrams asked for per recvmmsg() call */
+#define RECV_BATCH      32
+/* With UDP_GRO on, the kernel hands us coalesced datagrams of up to 64KB */
+#define GRO_BATCH       4
+#define GRO_BUF_SZ      65536
+/* Kernel limit on segments in one UDP_SEGMENT send (UDP_MAX_SEGMENTS) */
+#define GSO_MAX_SEGS    64
+#define GSO_MAX_SZ      65000
+
 #if __linux__ && defined(IP_RECVORIGDSTADDR)
 #   define DST_MSG_SZ sizeof(struct sockaddr_in)
 #elif __linux__
@@ -76,7 +98,16 @@
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) > (b) ? (b) : (a))
 
-#define CTL_SZ CMSG_SPACE(MAX(DST_MSG_SZ, sizeof(struct in6_pktinfo)) +  ECN_SZ)
+#if __linux__
+#define GRO_SZ CMSG_SPACE(sizeof(int))
+#define GSO_SZ CMSG_SPACE(sizeof(uint16_t))
+#else
+#define GRO_SZ 0
+#define GSO_SZ 0
+#endif
+
+#define CTL_SZ CMSG_SPACE(MAX(DST_MSG_SZ, sizeof(struct in6_pktinfo)) +  ECN_SZ \
+                          + GRO_SZ)
 
 int UdpListener::s_rtsigNo = -1;
 
@@ -160,6 +191,19 @@ struct packets_in
 #ifndef _NOT_USE_SHM_
     packet_buf_t           **packet_bufs;
     lsquic_cid_t            *cids;        /* Copied into separate array for speed */
+    /* recvmmsg() state, `mmsgs' is NULL if the syscall is not available.
+     * With UDP_GRO, datagrams are first read into `gro_data' and split
+     * into `packet_bufs'; `gro_idx'/`gro_off' track the split position so
+     * that leftovers carry over into the next batch.
+     */
+    struct mmsghdr          *mmsgs;
+    struct iovec            *mmsg_iovs;
+    unsigned char           *mmsg_ctl;
+    unsigned char           *gro_data;
+    struct sockaddr_storage *gro_peers;
+    unsigned                 gro_count;
+    unsigned                 gro_idx;
+    unsigned                 gro_off;
 #else
     unsigned char           *packet_data;
     struct iovec            *vecs;
@@ -346,6 +390,7 @@ proc_ancillary (struct msghdr *msg, struct sockaddr_storage *storage
 #if ECN_SUPPORTED
                                                             , uint8_t *ecn
 #endif
+                                                            , int *gro_size
     )
 {
     const struct in6_pktinfo *in6_pkt;
@@ -400,6 +445,13 @@ proc_ancillary (struct msghdr *msg, struct sockaddr_storage *storage
             *ecn = tos & IPTOS_ECN_MASK;
         }
 #endif
+#endif
+#if __linux__
+        else if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            if (gro_size)
+                memcpy(gro_size, CMSG_DATA(cmsg), sizeof(*gro_size));
+        }
 #endif
     }
 }
@@ -475,12 +527,16 @@ enum ctl_what
 #if ECN_SUPPORTED
     CW_ECN          = 1 << 1,
 #endif
+#if __linux__
+    CW_SEGMENT      = 1 << 2,
+#endif
 };
 
 
 static void
 setup_control_msg (struct msghdr *msg, int cw, int ecn,
-    const struct sockaddr *local_sockaddr, unsigned char *buf, size_t bufsz)
+    const struct sockaddr *local_sockaddr, unsigned char *buf, size_t bufsz,
+    uint16_t gso_size = 0)
 {
     struct cmsghdr *cmsg;
     struct sockaddr_in *local_sa;
@@ -566,6 +622,17 @@ setup_control_msg (struct msghdr *msg, int cw, int ecn,
             }
             cw &= ~CW_ECN;
         }
+#endif
+#if __linux__
+        else if (cw & CW_SEGMENT)
+        {
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(gso_size));
+            memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+            ctl_len += CMSG_SPACE(sizeof(gso_size));
+            cw &= ~CW_SEGMENT;
+        }
 #endif
         else
             assert(0);
@@ -640,14 +707,81 @@ ssize_t UdpListener::send(struct iovec *iov, size_t iovlen,
 }
 
 
+#if __linux__
+static size_t spec_len(const struct lsquic_out_spec *spec)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < spec->iovlen; ++i)
+        len += spec->iov[i].iov_len;
+    return len;
+}
+
+
+static bool same_sockaddr(const struct sockaddr *a, const struct sockaddr *b)
+{
+    if (a == b)
+        return true;
+    if (a->sa_family != b->sa_family)
+        return false;
+    if (AF_INET == a->sa_family)
+        return ((const struct sockaddr_in *)a)->sin_port
+                    == ((const struct sockaddr_in *)b)->sin_port
+            && ((const struct sockaddr_in *)a)->sin_addr.s_addr
+                    == ((const struct sockaddr_in *)b)->sin_addr.s_addr;
+    if (AF_INET6 == a->sa_family)
+        return ((const struct sockaddr_in6 *)a)->sin6_port
+                    == ((const struct sockaddr_in6 *)b)->sin6_port
+            && memcmp(&((const struct sockaddr_in6 *)a)->sin6_addr,
+                      &((const struct sockaddr_in6 *)b)->sin6_addr,
+                      sizeof(struct in6_addr)) == 0;
+    return !a->sa_family;
+}
+
+
+/* Returns the number of specs starting at `spec' that can go out as one
+ * UDP_SEGMENT send: same path and ECN, equal sizes except for a shorter
+ * last one.
+ */
+static unsigned gso_run(const struct lsquic_out_spec *spec,
+                        const struct lsquic_out_spec *end, unsigned max_iov)
+{
+    const struct lsquic_out_spec *next;
+    size_t seg_sz = spec_len(spec), total = seg_sz, sz;
+    unsigned n_iov = spec->iovlen;
+
+    for (next = spec + 1; next < end && next - spec < GSO_MAX_SEGS; ++next)
+    {
+        sz = spec_len(next);
+        if (sz > seg_sz || total + sz > GSO_MAX_SZ
+            || n_iov + next->iovlen > max_iov
+            || next->ecn != spec->ecn
+            || !same_sockaddr(next->dest_sa, spec->dest_sa)
+            || !same_sockaddr(next->local_sa, spec->local_sa))
+            break;
+        total += sz;
+        n_iov += next->iovlen;
+        if (sz < seg_sz)
+        {
+            ++next;
+            break;
+        }
+    }
+    return next - spec;
+}
+#endif
+
+
 int UdpListener::sendPackets(const struct lsquic_out_spec *spec,
                              unsigned count)
 {
 #if __linux__
+    const struct lsquic_out_spec *const specs = spec;
     const struct lsquic_out_spec *const end = spec + count;
-    unsigned i;
+    unsigned i, j, n, n_iov;
     int cw;
     struct mmsghdr mmsgs[1024];
+    unsigned n_specs[ sizeof(mmsgs) / sizeof(mmsgs[0]) ];
+    struct iovec iovs[1024];
     union {
         /* cmsg(3) recommends union for proper alignment */
         unsigned char buf[ CMSG_SPACE(
@@ -661,6 +795,7 @@ int UdpListener::sendPackets(const struct lsquic_out_spec *spec,
 #if ECN_SUPPORTED
             + ECN_SZ
 #endif
+            + GSO_SZ
                                                                   ) ];
         struct cmsghdr cmsg;
     } ancil [ sizeof(mmsgs) / sizeof(mmsgs[0]) ];
@@ -668,15 +803,36 @@ int UdpListener::sendPackets(const struct lsquic_out_spec *spec,
     if (getEvents() & POLLOUT)
         return -1;
 
-    for (i = 0; spec < end && i < sizeof(mmsgs) / sizeof(mmsgs[0]); ++i, ++spec)
+    n_iov = 0;
+    for (i = 0; spec < end && i < sizeof(mmsgs) / sizeof(mmsgs[0]); ++i)
     {
+        n = m_iGso ? gso_run(spec, end, sizeof(iovs) / sizeof(iovs[0]) - n_iov)
+                   : 1;
         mmsgs[i].msg_hdr.msg_name       = (void *) spec->dest_sa;
         mmsgs[i].msg_hdr.msg_namelen    = (AF_INET == spec->dest_sa->sa_family ?
                                             sizeof(struct sockaddr_in) :
                                             sizeof(struct sockaddr_in6)),
-        mmsgs[i].msg_hdr.msg_iov        = spec->iov;
-        mmsgs[i].msg_hdr.msg_iovlen     = spec->iovlen;
         mmsgs[i].msg_hdr.msg_flags      = 0;
+        if (n > 1)
+        {
+            /* Glue the run into one super-datagram, the kernel (or NIC)
+             * cuts it back into packets of the first packet's size.
+             */
+            mmsgs[i].msg_hdr.msg_iov = &iovs[n_iov];
+            for (j = 0; j < n; ++j)
+            {
+                memcpy(&iovs[n_iov], spec[j].iov,
+                       spec[j].iovlen * sizeof(struct iovec));
+                n_iov += spec[j].iovlen;
+            }
+            mmsgs[i].msg_hdr.msg_iovlen = &iovs[n_iov]
+                                          - mmsgs[i].msg_hdr.msg_iov;
+        }
+        else
+        {
+            mmsgs[i].msg_hdr.msg_iov        = spec->iov;
+            mmsgs[i].msg_hdr.msg_iovlen     = spec->iovlen;
+        }
         if (spec->local_sa->sa_family)
             cw = CW_SENDADDR;
         else
@@ -685,17 +841,36 @@ int UdpListener::sendPackets(const struct lsquic_out_spec *spec,
         if (spec->ecn)
             cw |= CW_ECN;
 #endif
+        if (n > 1)
+            cw |= CW_SEGMENT;
         if (cw)
             setup_control_msg(&mmsgs[i].msg_hdr, cw, spec->ecn, spec->local_sa,
-                                    ancil[i].buf, sizeof(ancil[i].buf));
+                              ancil[i].buf, sizeof(ancil[i].buf),
+                              (uint16_t)spec_len(spec));
         else
         {
             mmsgs[i].msg_hdr.msg_control = NULL;
             mmsgs[i].msg_hdr.msg_controllen = 0;
         }
+        n_specs[i] = n;
+        spec += n;
     }
 
     int ret = ls_sendmmsg(getfd(), mmsgs, i, 0);
+    if (ret < 0 && errno == EIO && m_iGso)
+    {
+        /* The egress device cannot do checksum offload for UDP_SEGMENT */
+        LS_NOTICE(this, "UDP GSO send failed, disable GSO on this socket");
+        m_iGso = 0;
+        return sendPackets(specs, count);
+    }
+    if (ret > 0)
+    {
+        /* Report packets, not super-datagrams, back to lsquic */
+        for (j = 0, n = 0; j < (unsigned)ret; ++j)
+            n += n_specs[j];
+        ret = n;
+    }
     if (ret < (int) count)
     {
         if (errno == EPERM)
@@ -1323,6 +1498,7 @@ enum rop UdpListener::readOnePacket(struct read_iter *iter)
 #if ECN_SUPPORTED
         , &packet_buf->ecn
 #endif
+        , NULL
     );
 
 
@@ -1342,6 +1518,263 @@ enum rop UdpListener::readOnePacket(struct read_iter *iter)
 }
 
 
+#ifndef _NOT_USE_SHM_
+/* Record the datagram already copied into the current packet buffer.
+ * Returns false if it is dropped for not having a connection ID.
+ */
+bool UdpListener::acceptPacket(struct read_iter *iter, struct msghdr *msg,
+                               size_t len)
+{
+    packet_buf_t *const packet_buf = m_pPacketsIn->packet_bufs[iter->ri_idx];
+    lsquic_cid_t cid;
+
+    if (0 != lsquic_cid_from_packet(packet_buf->data, len, &cid))
+        return false;
+
+    if (msg->msg_name != &packet_buf->peer_addr)
+        memcpy(&packet_buf->peer_addr, msg->msg_name, msg->msg_namelen);
+    memcpy(&packet_buf->local_addr, m_addr.get(),
+           AF_INET == m_addr.get()->sa_family ?
+                sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6));
+    packet_buf->ecn = 0;
+    proc_ancillary(msg, &packet_buf->local_addr
+#if ECN_SUPPORTED
+        , &packet_buf->ecn
+#endif
+        , NULL
+    );
+    packet_buf->data_len = len;
+    m_pPacketsIn->cids[iter->ri_idx] = cid;
+    LS_DBG_M(this, "%s: read in packet #%u, size: %zu", __func__,
+             iter->ri_idx, len);
+
+    iter->ri_idx += 1;
+    return true;
+}
+
+
+/* Read up to RECV_BATCH datagrams straight into packet buffers with a
+ * single recvmmsg() call.
+ */
+enum rop UdpListener::readPackets(struct read_iter *iter)
+{
+#if __linux__
+    struct packets_in *const pin = m_pPacketsIn;
+    unsigned i, n, base;
+    int got;
+
+    if (pin->gro_data)
+        return readGroPackets(iter);
+
+    if (iter->ri_idx >= pin->n_avail)
+    {
+        LS_DBG_M(this, "%s: out of room in packets_in", __func__);
+        return ROP_NOROOM;
+    }
+    base = iter->ri_idx;
+    n = MIN(pin->n_avail - base, RECV_BATCH);
+    for (i = 0; i < n; ++i)
+    {
+        packet_buf_t *const packet_buf = pin->packet_bufs[base + i];
+        struct msghdr *msg = &pin->mmsgs[i].msg_hdr;
+        pin->mmsg_iovs[i].iov_base = packet_buf->data;
+        pin->mmsg_iovs[i].iov_len  = sizeof(packet_buf->data);
+        msg->msg_name       = &packet_buf->peer_addr;
+        msg->msg_namelen    = sizeof(packet_buf->peer_addr);
+        msg->msg_iov        = &pin->mmsg_iovs[i];
+        msg->msg_iovlen     = 1;
+        msg->msg_control    = pin->mmsg_ctl + i * CTL_SZ;
+        msg->msg_controllen = CTL_SZ;
+        msg->msg_flags      = 0;
+    }
+
+    got = ls_recvmmsg(getfd(), pin->mmsgs, n, 0);
+    if (got <= 0)
+    {
+        if (!(EAGAIN == errno || EWOULDBLOCK == errno))
+            LS_ERROR("recvmmsg: %s", strerror(errno));
+        return ROP_ERROR;
+    }
+
+    for (i = 0; i < (unsigned)got; ++i)
+    {
+        /* Keep accepted packets contiguous if an earlier one was dropped */
+        if (iter->ri_idx != base + i)
+        {
+            packet_buf_t *tmp = pin->packet_bufs[iter->ri_idx];
+            pin->packet_bufs[iter->ri_idx] = pin->packet_bufs[base + i];
+            pin->packet_bufs[base + i] = tmp;
+        }
+        acceptPacket(iter, &pin->mmsgs[i].msg_hdr, pin->mmsgs[i].msg_len);
+    }
+
+    /* A short read means the socket has been drained */
+    return (unsigned)got < n ? ROP_ERROR : ROP_OK;
+#else
+    return readOnePacket(iter);
+#endif
+}
+
+
+#if __linux__
+int UdpListener::recvGroBatch()
+{
+    struct packets_in *const pin = m_pPacketsIn;
+    unsigned i;
+    int got;
+
+    for (i = 0; i < GRO_BATCH; ++i)
+    {
+        struct msghdr *msg = &pin->mmsgs[i].msg_hdr;
+        pin->mmsg_iovs[i].iov_base = pin->gro_data + i * GRO_BUF_SZ;
+        pin->mmsg_iovs[i].iov_len  = GRO_BUF_SZ;
+        msg->msg_name       = &pin->gro_peers[i];
+        msg->msg_namelen    = sizeof(pin->gro_peers[i]);
+        msg->msg_iov        = &pin->mmsg_iovs[i];
+        msg->msg_iovlen     = 1;
+        msg->msg_control    = pin->mmsg_ctl + i * CTL_SZ;
+        msg->msg_controllen = CTL_SZ;
+        msg->msg_flags      = 0;
+    }
+    pin->gro_idx = 0;
+    pin->gro_off = 0;
+    got = ls_recvmmsg(getfd(), pin->mmsgs, GRO_BATCH, 0);
+    if (got < 0)
+    {
+        if (!(EAGAIN == errno || EWOULDBLOCK == errno))
+            LS_ERROR("recvmmsg: %s", strerror(errno));
+        got = 0;
+    }
+    pin->gro_count = got;
+    return got;
+}
+#endif
+
+
+/* UDP_GRO variant: each received message may hold several datagrams of
+ * the same flow, `gro_size' bytes each except for the last one.  They are
+ * split into individual packet buffers here.
+ */
+enum rop UdpListener::readGroPackets(struct read_iter *iter)
+{
+#if __linux__
+    struct packets_in *const pin = m_pPacketsIn;
+
+    while (iter->ri_idx < pin->n_avail)
+    {
+        if (pin->gro_idx >= pin->gro_count && recvGroBatch() == 0)
+            return ROP_ERROR;
+
+        struct msghdr *msg = &pin->mmsgs[pin->gro_idx].msg_hdr;
+        unsigned len = pin->mmsgs[pin->gro_idx].msg_len;
+        struct sockaddr_storage local_addr;
+        uint8_t ecn;
+        int gro_size = 0;
+        if (!(msg->msg_flags & MSG_TRUNC))
+            proc_ancillary(msg, &local_addr
+#if ECN_SUPPORTED
+                , &ecn
+#endif
+                , &gro_size);
+        if (gro_size <= 0 || gro_size > (int)len)
+            gro_size = len;
+        if ((msg->msg_flags & MSG_TRUNC)
+            || gro_size > (int)sizeof(pin->packet_bufs[0]->data))
+        {
+            LS_DBG_L(this, "%s: drop %u byte datagram", __func__, len);
+            ++pin->gro_idx;
+            pin->gro_off = 0;
+            continue;
+        }
+
+        unsigned char *data = (unsigned char *)msg->msg_iov[0].iov_base;
+        while (pin->gro_off < len && iter->ri_idx < pin->n_avail)
+        {
+            unsigned seg = MIN((unsigned)gro_size, len - pin->gro_off);
+            memcpy(pin->packet_bufs[iter->ri_idx]->data,
+                   data + pin->gro_off, seg);
+            pin->gro_off += seg;
+            acceptPacket(iter, msg, seg);
+        }
+        if (pin->gro_off >= len)
+        {
+            ++pin->gro_idx;
+            pin->gro_off = 0;
+        }
+    }
+    LS_DBG_M(this, "%s: out of room in packets_in", __func__);
+    return ROP_NOROOM;
+#else
+    return readOnePacket(iter);
+#endif
+}
+
+
+/* Decide how this socket is read and written: recvmmsg() batching if the
+ * kernel has it, UDP_GRO only on top of that (coalesced reads need the
+ * large buffers), and UDP_SEGMENT sends if the kernel accepts the option.
+ */
+void UdpListener::initUdpOffload()
+{
+    struct packets_in *const pin = m_pPacketsIn;
+#if __linux__
+    int val = 0;
+    socklen_t len = sizeof(val);
+    bool gro = false;
+
+    m_iGso = (getsockopt(getfd(), SOL_UDP, UDP_SEGMENT, &val, &len) == 0);
+
+    if (!is_recvmmsg_available())
+    {
+        LS_INFO(this, "recvmmsg() not available, GSO %s", m_iGso ? "on" : "off");
+        return;
+    }
+
+    pin->mmsgs = (struct mmsghdr *)calloc(RECV_BATCH, sizeof(*pin->mmsgs));
+    pin->mmsg_iovs = (struct iovec *)calloc(RECV_BATCH,
+                                            sizeof(*pin->mmsg_iovs));
+    pin->mmsg_ctl = (unsigned char *)malloc(RECV_BATCH * CTL_SZ);
+    if (!pin->mmsgs || !pin->mmsg_iovs || !pin->mmsg_ctl)
+    {
+        free(pin->mmsgs);
+        free(pin->mmsg_iovs);
+        free(pin->mmsg_ctl);
+        pin->mmsgs = NULL;
+        pin->mmsg_iovs = NULL;
+        pin->mmsg_ctl = NULL;
+    }
+    else
+    {
+        /* GRO is only switched on once the large buffers are in place, a
+         * coalesced datagram would be truncated by the per-packet ones.
+         */
+        pin->gro_data = (unsigned char *)malloc(GRO_BATCH * GRO_BUF_SZ);
+        pin->gro_peers = (struct sockaddr_storage *)
+                    calloc(GRO_BATCH, sizeof(*pin->gro_peers));
+        val = 1;
+        if (pin->gro_data && pin->gro_peers)
+        {
+            /* Best effort, kernels older than 5.0 do not have it */
+            gro = (setsockopt(getfd(), SOL_UDP, UDP_GRO, &val,
+                              sizeof(val)) == 0);
+            if (!gro)
+                LS_DBG_L(this, "UDP_GRO not available: %s", strerror(errno));
+        }
+        if (!gro)
+        {
+            free(pin->gro_data);
+            free(pin->gro_peers);
+            pin->gro_data = NULL;
+            pin->gro_peers = NULL;
+        }
+    }
+    LS_INFO(this, "recvmmsg() %s, GRO %s, GSO %s", pin->mmsgs ? "on" : "off",
+            gro ? "on" : "off", m_iGso ? "on" : "off");
+#endif
+}
+#endif
+
+
 int UdpListener::onRead()
 {
     /* The code below assumes this value is smaller than one second */
@@ -1376,6 +1809,15 @@ int UdpListener::onRead()
 #endif
         rctx.rc_riter.ri_idx = 0;
 
+#ifndef _NOT_USE_SHM_
+        if (m_pPacketsIn->mmsgs)
+        {
+            do
+                rop = readPackets(&rctx.rc_riter);
+            while (ROP_OK == rop);
+        }
+        else
+#endif
         do
             rop = readOnePacket(&rctx.rc_riter);
         while (ROP_OK == rop);
@@ -1389,11 +1831,16 @@ int UdpListener::onRead()
             processPacketsInBatch(&rctx);
 
         gettimeofday(&end, NULL);
-        if ((start.tv_sec == end.tv_sec &&
+        if (((start.tv_sec == end.tv_sec &&
                 start.tv_usec + MAX_USEC_PER_LOOP <= end.tv_usec) ||
             (start.tv_sec == end.tv_sec - 1 &&
                 start.tv_usec + MAX_USEC_PER_LOOP <= end.tv_usec + 1000000) ||
             (start.tv_sec <  end.tv_sec - 1))
+#ifndef _NOT_USE_SHM_
+            /* Split GRO leftovers are already off the socket, finish them */
+            && m_pPacketsIn->gro_idx >= m_pPacketsIn->gro_count
+#endif
+            )
         {
             LS_DBG_M(this, "%s: take a breather reading packets "
                 "after exceeding timer", __func__);
@@ -1468,6 +1915,14 @@ int UdpListener::initPacketsIn(void)
     m_pPacketsIn->n_avail = 0;
     m_pPacketsIn->cids        = (lsquic_cid_t  *) calloc(n_alloc, sizeof(m_pPacketsIn->cids[0]));
     m_pPacketsIn->packet_bufs = (packet_buf_t **) calloc(n_alloc, sizeof(m_pPacketsIn->packet_bufs[0]));
+    m_pPacketsIn->mmsgs       = NULL;
+    m_pPacketsIn->mmsg_iovs   = NULL;
+    m_pPacketsIn->mmsg_ctl    = NULL;
+    m_pPacketsIn->gro_data    = NULL;
+    m_pPacketsIn->gro_peers   = NULL;
+    m_pPacketsIn->gro_count   = 0;
+    m_pPacketsIn->gro_idx     = 0;
+    m_pPacketsIn->gro_off     = 0;
 #else
     m_pPacketsIn->data_sz = recvsz;
     m_pPacketsIn->packet_data = (unsigned char *) malloc(recvsz);
@@ -1495,6 +1950,9 @@ int UdpListener::initPacketsIn(void)
                                                     )
     {
         LS_INFO(this, "%s: allocated %u packets", __func__, n_alloc);
+#ifndef _NOT_USE_SHM_
+        initUdpOffload();
+#endif
         return 0;
     }
     else
@@ -1508,6 +1966,11 @@ void UdpListener::cleanupPacketsIn(void)
 #ifndef _NOT_USE_SHM_
         free(m_pPacketsIn->cids);
         free(m_pPacketsIn->packet_bufs);
+        free(m_pPacketsIn->mmsgs);
+        free(m_pPacketsIn->mmsg_iovs);
+        free(m_pPacketsIn->mmsg_ctl);
+        free(m_pPacketsIn->gro_data);
+        free(m_pPacketsIn->gro_peers);
 #else
         free(m_pPacketsIn->packet_data);
         free(m_pPacketsIn->ctlmsg_data);
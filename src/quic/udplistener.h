@@ -46,6 +46,7 @@ public:
         , m_pEngine(NULL)
         , m_pTcpPeer(NULL)
         , m_id(-1)
+        , m_iGso(0)
         , m_pPacketsIn(NULL)
     {}
 
@@ -54,6 +55,7 @@ public:
         , m_pEngine(pEngine)
         , m_pTcpPeer(pTcpPeer)
         , m_id(-1)
+        , m_iGso(0)
         , m_pPacketsIn(NULL)
     {}
 
@@ -129,6 +131,7 @@ private:
     GSockAddr       m_addr;
     int             m_id;
     ReusePortFds        m_reusePortFds;
+    int             m_iGso;         /* UDP_SEGMENT usable on this socket */
 
     static int      s_rtsigNo;
 
@@ -138,6 +141,13 @@ private:
     void cleanupPacketsIn();
 
     enum rop readOnePacket(struct read_iter *);
+#ifndef _NOT_USE_SHM_
+    enum rop readPackets(struct read_iter *);
+    enum rop readGroPackets(struct read_iter *);
+    int recvGroBatch();
+    bool acceptPacket(struct read_iter *, struct msghdr *, size_t len);
+    void initUdpOffload();
+#endif
     void startReading(struct read_ctx *);
     void processPacketsInBatch(struct read_ctx *);
     void finishReading(struct read_ctx *);
@@ -67,6 +67,10 @@ typedef struct ls_shmhtable_s
     uint8_t         x_unused[2];
     LsShmHTableStat x_stat;         // hash statistics
     uint8_t         x_reserved[256];
+
+    // LSSHM_FLAG_SEQREAD sequence, LRU and TID info live at the other end.
+    volatile uint32_t *getSeq()
+    {   return (volatile uint32_t *)&x_reserved[0];   }
     
     LsHashLruInfo_s *getLruInfo()
     {   return (LsHashLruInfo_s *)&x_reserved[sizeof(x_reserved) 
@@ -429,6 +433,7 @@ LsShmHash::LsShmHash(LsShmPool *pool, const char *name,
     m_iRef = 0;
     m_status = LSSHM_NOTREADY;
     m_pShmLock = NULL;
+    m_pSeq = NULL;
     m_iAutoLock = 1;      // enableLock()
 
     if (m_hf != NULL)
@@ -527,10 +532,17 @@ int LsShmHash::init(LsShmOffset_t offset)
     // check the magic and mode
     if ((m_iMagic != pTable->x_iMagic)
         || (m_iMode != pTable->x_iMode)
-        || (m_iFlags != pTable->x_iFlags))
+        || ((m_iFlags ^ pTable->x_iFlags) & ~LSSHM_FLAG_SEQREAD))
         return LS_FAIL;
+    // SEQREAD is only safe if every writer bumps the sequence, so the table
+    // created it decides; older tables keep the plain locked lookup.
+    m_iFlags = (m_iFlags & ~LSSHM_FLAG_SEQREAD)
+               | (pTable->x_iFlags & LSSHM_FLAG_SEQREAD);
     m_pShmLock = m_pPool->lockPool()->offset2pLock(pTable->x_iLockOffset);
 
+    if (m_iFlags & LSSHM_FLAG_SEQREAD)
+        m_pSeq = pTable->getSeq();
+
     if (m_iFlags & LSSHM_FLAG_LRU)
         m_iterExtraSpace = sizeof(LsShmLruLink);
     //if ((m_iFlags & LSSHM_FLAG_LRU_MODE2) || (m_iFlags & LSSHM_FLAG_LRU_MODE3))
@@ -1401,6 +1413,90 @@ LsShmHash::iteroffset LsShmHash::findPtr(LsShmHash *pThis,
 }
 
 
+#define LSSHM_SEQREAD_RETRY     4
+#define LSSHM_SEQREAD_MAXCHAIN  64
+
+
+/*
+ * Optimistic lookup for LSSHM_FLAG_SEQREAD tables, done without the lock.
+ * A writer may be relinking or releasing elements underneath us, so every
+ * offset is range checked against the local mapping before it is touched,
+ * and the result is only trusted if the sequence is even and unchanged
+ * across the walk.  Returns LS_FAIL to make the caller take the lock.
+ */
+int LsShmHash::findSeqRead(ls_strpair_t *pParms, iteroffset *pIterOff)
+{
+    LsShmHTable *pTable = getHTable();
+    LsShmXSize_t maxSize = m_pPool->getShm()->oldMaxSize();
+    int keyLen = ls_str_len(&pParms->key);
+    LsShmHKey key;
+    if (m_iMode)
+        key = (*m_hf)(ls_str_buf(&pParms->key), keyLen);
+    else
+    {
+        key = (LsShmHKey)(long)ls_str_buf(&pParms->key);
+        keyLen = sizeof(LsShmHKey);
+    }
+
+    for (int retry = 0; retry < LSSHM_SEQREAD_RETRY; ++retry)
+    {
+        uint32_t seq = *m_pSeq;
+        if (seq & 1)
+            return LS_FAIL;
+        ls_barrier();
+
+        LsShmSize_t capacity = pTable->x_iCapacity;
+        LsShmOffset_t offHIdx = pTable->x_iHIdx;
+        if (capacity == 0 || offHIdx != pTable->x_iHIdxNew)
+            return LS_FAIL;
+        uint32_t hashIndx = getIndex(key, capacity);
+        LsShmOffset_t offSlot = offHIdx + hashIndx * sizeof(LsShmHIterOff);
+        if (offSlot + sizeof(LsShmHIterOff) > maxSize)
+            return LS_FAIL;
+
+        LsShmHIterOff offset = *(LsShmHIterOff *)m_pPool->offset2ptr(offSlot);
+        int chain = 0;
+        while (offset.m_iOffset != 0)
+        {
+            if (offset.m_iOffset + sizeof(LsShmHElem) + sizeof(ls_vardata_t)
+                    > maxSize
+                || ++chain > LSSHM_SEQREAD_MAXCHAIN)
+                break;
+            LsShmHElem *pElem =
+                (LsShmHElem *)m_pPool->offset2ptr(offset.m_iOffset);
+            LsShmHElemLen_t len = pElem->x_iLen;
+            if (len < (LsShmHElemLen_t)(sizeof(LsShmHElem)
+                                        + sizeof(ls_vardata_t))
+                || offset.m_iOffset + len > maxSize)
+                break;
+            if ((pElem->x_hkey == key)
+                && (pElem->getKeyLen() == keyLen)
+                && (keyLen <= (int)(len - sizeof(LsShmHElem)
+                                    - sizeof(ls_vardata_t)))
+                && (m_iMode
+                    ? ((*m_vc)(ls_str_buf(&pParms->key), pElem->getKey(),
+                               keyLen) == 0)
+                    : (*(LsShmHKey *)pElem->getKey() == key)))
+            {
+                ls_barrier();
+                if (*m_pSeq != seq)
+                    break;
+                *pIterOff = offset;
+                return LS_OK;
+            }
+            offset.m_iOffset = pElem->x_iNext.m_iOffset;
+        }
+        ls_barrier();
+        if (*m_pSeq == seq && offset.m_iOffset == 0)
+        {
+            *pIterOff = offset;
+            return LS_OK;
+        }
+    }
+    return LS_FAIL;
+}
+
+
 LsShmHash::iteroffset LsShmHash::getPtr(LsShmHash *pThis,
                                         ls_strpair_t *pParms, int *pFlag)
 {
@@ -23,6 +23,7 @@ class debugBase;
 #endif
 
 #include <lsdef.h>
+#include <lsr/ls_atomic.h>
 #include <lsr/ls_str.h>
 #include <shm/lsshm.h>
 #include <shm/lsshmpool.h>
@@ -31,6 +32,7 @@ class debugBase;
 #define LSSHM_FLAG_LRU          (1<<0)
 #define LSSHM_FLAG_TID          (1<<1)    // `transaction' id
 #define LSSHM_FLAG_TID_SLAVE    (1<<2)    // do *not* generate new tid, nor notify
+#define LSSHM_FLAG_SEQREAD      (1<<3)    // lock free find, writers bump a seqlock
 
 /**
  * @file
@@ -412,8 +414,12 @@ public:
     //
     iteroffset findIterator(ls_strpair_t *pParms)
     {
+        iteroffset iterOff;
+        if (m_pSeq != NULL && m_iAutoLock
+            && findSeqRead(pParms, &iterOff) == LS_OK)
+            return iterOff;
         autoLockChkRehash();
-        iteroffset iterOff = (*m_find)(this, pParms);
+        iterOff = (*m_find)(this, pParms);
         autoUnlock();
         return iterOff;
     }
@@ -635,19 +641,24 @@ public:
     {
         if (m_iAutoLock != 0)
             return 0;
-        return getPool()->getShm()->lockRemap(m_pShmLock);
+        return lockEx();
     }
 
     int unlock()
-    {   return m_iAutoLock ? 0 : ls_shmlock_unlock(m_pShmLock); }
+    {   return m_iAutoLock ? 0 : unlockEx(); }
 
     int lockEx()
     {
-        return getPool()->getShm()->lockRemap(m_pShmLock);
+        int ret = getPool()->getShm()->lockRemap(m_pShmLock);
+        seqWriteBegin();
+        return ret;
     }
 
     int unlockEx()
-    {   return ls_shmlock_unlock(m_pShmLock); }
+    {
+        seqWriteEnd();
+        return ls_shmlock_unlock(m_pShmLock);
+    }
 
     void lockChkRehash();
 
@@ -742,12 +753,27 @@ protected:
             assert(m_pPool->getShm()->isLocked(m_pShmLock));
             return 0;
         }
-        return getPool()->getShm()->lockRemap(m_pShmLock);
+        return lockEx();
     }
 
     int autoUnlock()
     {   assert(m_pPool->getShm()->isLocked(m_pShmLock));
-        return m_iAutoLock && ls_shmlock_unlock(m_pShmLock); }
+        return m_iAutoLock && unlockEx(); }
+
+    // LSSHM_FLAG_SEQREAD: the sequence is odd while a writer holds the lock.
+    void seqWriteBegin()
+    {
+        if (m_pSeq != NULL)
+            ls_atomic_or_fetch(m_pSeq, 1);
+    }
+
+    void seqWriteEnd()
+    {
+        if (m_pSeq != NULL && (*m_pSeq & 1))
+            ls_atomic_add(m_pSeq, 1);
+    }
+
+    int findSeqRead(ls_strpair_t *pParms, iteroffset *pIterOff);
 
     void autoLockChkRehash();
 
@@ -799,6 +825,7 @@ protected:
     int8_t              m_iMode;        // mode 0=Num, 1=Ptr
     uint8_t             m_iFlags;       // lru=0x01, tid=0x02, tid_slave=0x04
     ls_shmlock_t       *m_pShmLock;     // local lock for Hash
+    volatile uint32_t  *m_pSeq;         // seqlock for LSSHM_FLAG_SEQREAD
     LsShmStatus_t       m_status;
     LsShmHashLruAddon  *m_pLruAddon;
     LsShmObsIter_t     *m_pObservers;
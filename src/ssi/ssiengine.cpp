@@ -21,8 +21,10 @@
 #include "ssiscript.h"
 #include "ssiruntime.h"
 #include "ssiconfig.h"
+#include "ssifragcache.h"
 
 #include <http/handlertype.h>
+#include <http/hiochainstream.h>
 #include <http/httpcgitool.h>
 #include <http/httpmethod.h>
 #include <http/httpsession.h>
@@ -474,7 +476,21 @@ int SsiEngine::processSubReq(HttpSession *pSession, SubstItem *pItem)
         }
     }
     if (achBuf[0] == '/')
-        return startSubSession(pSession, achBuf, p - achBuf, pQs, iQsLen);
+    {
+        char achKey[4096];
+        const char *pKey = NULL;
+        SsiFragCache &cache = SsiFragCache::getInstance();
+        if ((attr != SSI_ATTR_EXEC_CGI) && cache.isEnabled()
+            && (SsiFragCache::buildKey(pSession, achBuf, p - achBuf, pQs,
+                                       iQsLen, achKey, sizeof(achKey)) > 0))
+        {
+            if (cache.serve(pSession, achKey))
+                return 0;
+            pKey = achKey;
+        }
+        return startSubSession(pSession, achBuf, p - achBuf, pQs, iQsLen,
+                               pKey);
+    }
     else
     {
         LS_INFO(pSession->getLogSession(),
@@ -488,7 +504,8 @@ int SsiEngine::processSubReq(HttpSession *pSession, SubstItem *pItem)
 
 int SsiEngine::startSubSession(HttpSession *pSession,
                                const char *pUri, int uriLen,
-                               const char *pQs, int qsLen)
+                               const char *pQs, int qsLen,
+                               const char *pFragKey)
 {
     lsi_subreq_t subSessionInfo;
     memset(&subSessionInfo, 0, sizeof(lsi_subreq_t));
@@ -499,12 +516,13 @@ int SsiEngine::startSubSession(HttpSession *pSession,
     subSessionInfo.m_method = HttpMethod::HTTP_GET;
     subSessionInfo.m_flag |= SUB_REQ_SETREFERER;
 
-    return startSubSession(pSession, &subSessionInfo);
+    return startSubSession(pSession, &subSessionInfo, pFragKey);
 }
 
 
 int SsiEngine::startSubSession(HttpSession *pSession,
-                               lsi_subreq_t *pSubSessionInfo)
+                               lsi_subreq_t *pSubSessionInfo,
+                               const char *pFragKey)
 {
     HttpSession *pSubSession = pSession->newSubSession(pSubSessionInfo);
     if (!pSubSession)
@@ -513,6 +531,9 @@ int SsiEngine::startSubSession(HttpSession *pSession,
         return -1;
     }
 
+    if (pFragKey)
+        ((HioChainStream *)pSubSession->getStream())->setFragment(
+            SsiFragCache::getInstance().beginCapture(pFragKey));
     pSubSession->getStream()->setFlag(HIO_FLAG_PASS_SETCOOKIE, 1);
     pSubSession->setSsiRuntime(pSession->getSsiRuntime());
     pSubSession->setFlag(HSF_NO_ERROR_PAGE);
@@ -19,6 +19,7 @@
 #define SSIENGINE_H
 
 
+#include <lsdef.h>
 #include <http/httphandler.h>
 
 struct lsi_subreq_s;
@@ -93,11 +94,13 @@ private:
     static int toLocalAbsUrl(HttpSession *pSession, const char *pRelUrl,
                              int urlLen, char *pAbsUrl, int absLen);
     static int startSubSession(HttpSession *pSession, const char *pURI,
-                               int uriLen, const char *pQS, int qsLen);
+                               int uriLen, const char *pQS, int qsLen,
+                               const char *pFragKey = NULL);
     static int processSubSessionRet(int ret, HttpSession *pSession,
                                     HttpSession *pSubSession);
     static int startSubSession(HttpSession *pSession,
-                               struct lsi_subreq_s *pSubSessionInfo);
+                               struct lsi_subreq_s *pSubSessionInfo,
+                               const char *pFragKey = NULL);
 
 };
 
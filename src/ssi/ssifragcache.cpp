@@ -0,0 +1,327 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "ssifragcache.h"
+
+#include <http/handlertype.h>
+#include <http/httphandler.h>
+#include <http/httpreq.h>
+#include <http/httpresp.h>
+#include <http/httpsession.h>
+#include <http/httpstatuscode.h>
+#include <http/httpvhost.h>
+#include <http/rewriterule.h>
+#include <http/rewriterulelist.h>
+#include <log4cxx/logger.h>
+#include <util/datetime.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LS_SINGLETON(SsiFragCache);
+
+
+SsiFragment::SsiFragment(const char *pKey, int keyLen)
+    : m_sKey(pKey, keyLen)
+    , m_body(0)
+    , m_tmExpire(0)
+    , m_tmChecked(0)
+    , m_ino(0)
+    , m_mtime(0)
+    , m_size(0)
+    , m_iMaxSize(0)
+    , m_iOverflow(0)
+{
+}
+
+
+int SsiFragment::append(const char *pBuf, int len)
+{
+    if (m_iOverflow)
+        return 0;
+    if (m_body.size() + len > m_iMaxSize)
+    {
+        m_iOverflow = 1;
+        m_body.resize(0);
+        return 0;
+    }
+    return m_body.append(pBuf, len);
+}
+
+
+int SsiFragment::appendFile(int fd, off_t off, size_t size)
+{
+    int ret;
+    if (m_iOverflow)
+        return 0;
+    if (m_body.size() + (off_t)size > m_iMaxSize)
+    {
+        m_iOverflow = 1;
+        m_body.resize(0);
+        return 0;
+    }
+    if (m_body.guarantee(size) == -1)
+        return LS_FAIL;
+    while (size > 0)
+    {
+        ret = pread(fd, m_body.end(), size, off);
+        if (ret <= 0)
+        {
+            if ((ret == -1) && (errno == EINTR))
+                continue;
+            m_iOverflow = 1;
+            m_body.resize(0);
+            return LS_FAIL;
+        }
+        m_body.used(ret);
+        off += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+
+SsiFragCache::SsiFragCache()
+    : m_map(29)
+    , m_iUsed(0)
+    , m_iMaxSize(0)
+    , m_iFileTtl(300)
+    , m_iDynTtl(0)
+    , m_iHits(0)
+    , m_iMisses(0)
+{
+}
+
+
+SsiFragCache::~SsiFragCache()
+{
+    SsiFragment *pFrag;
+    while ((pFrag = (SsiFragment *)m_lru.pop_front()) != NULL)
+        delete pFrag;
+    m_map.clear();
+}
+
+
+int SsiFragCache::buildKey(HttpSession *pSession, const char *pUri,
+                           int uriLen, const char *pQs, int qsLen,
+                           char *pKey, int keyLen)
+{
+    const HttpVHost *pVHost = pSession->getReq()->getVHost();
+    int len = snprintf(pKey, keyLen, "%s:%.*s%s%.*s",
+                       pVHost ? pVHost->getName() : "", uriLen, pUri,
+                       (qsLen > 0) ? "?" : "", (qsLen > 0) ? qsLen : 0,
+                       (qsLen > 0) ? pQs : "");
+    if (len >= keyLen)
+        return LS_FAIL;
+    return len;
+}
+
+
+void SsiFragCache::remove(SsiFragment *pFrag)
+{
+    m_map.remove(pFrag->getKey());
+    m_lru.remove(pFrag);
+    m_iUsed -= pFrag->m_body.size();
+}
+
+
+void SsiFragCache::makeRoom(int size)
+{
+    SsiFragment *pFrag;
+    while ((m_iUsed + size > m_iMaxSize) && !m_lru.empty())
+    {
+        pFrag = (SsiFragment *)m_lru.begin();
+        remove(pFrag);
+        delete pFrag;
+    }
+}
+
+
+int SsiFragCache::isValid(SsiFragment *pFrag)
+{
+    struct stat st;
+    if (DateTime::s_curTime >= pFrag->m_tmExpire)
+        return 0;
+    if ((pFrag->m_sFile.len() == 0)
+        || (pFrag->m_tmChecked == DateTime::s_curTime))
+        return 1;
+    pFrag->m_tmChecked = DateTime::s_curTime;
+    if (stat(pFrag->m_sFile.c_str(), &st) == -1)
+        return 0;
+    return ((st.st_ino == pFrag->m_ino) && (st.st_mtime == pFrag->m_mtime)
+            && (st.st_size == pFrag->m_size));
+}
+
+
+int SsiFragCache::serve(HttpSession *pSession, const char *pKey)
+{
+    HashStringMap<SsiFragment *>::iterator iter = m_map.find(pKey);
+    if (iter == m_map.end())
+    {
+        ++m_iMisses;
+        return 0;
+    }
+    SsiFragment *pFrag = iter.second();
+    if (!isValid(pFrag))
+    {
+        LS_DBG_M(pSession->getLogSession(),
+                 "[SSI] cached fragment is stale: %s", pKey);
+        remove(pFrag);
+        delete pFrag;
+        ++m_iMisses;
+        return 0;
+    }
+    m_lru.remove(pFrag);
+    m_lru.append(pFrag);
+    ++m_iHits;
+    LS_DBG_M(pSession->getLogSession(),
+             "[SSI] serve %d bytes from fragment cache: %s",
+             pFrag->m_body.size(), pKey);
+    if (pFrag->m_body.size() > 0)
+        pSession->appendDynBody(pFrag->m_body.begin(), pFrag->m_body.size());
+    return 1;
+}
+
+
+SsiFragment *SsiFragCache::beginCapture(const char *pKey)
+{
+    SsiFragment *pFrag = new SsiFragment(pKey, strlen(pKey));
+    if (pFrag)
+        pFrag->m_iMaxSize = m_iMaxSize / 16;
+    return pFrag;
+}
+
+
+static int isPrivate(HttpRespHeaders &headers)
+{
+    const char *pVal;
+    int len;
+    if ((headers.getHeader(HttpRespHeaders::H_SET_COOKIE, &len) != NULL)
+        || (headers.getHeader(HttpRespHeaders::H_VARY, &len) != NULL))
+        return 1;
+    pVal = headers.getHeader(HttpRespHeaders::H_CACHE_CTRL, &len);
+    if (pVal && ((memmem(pVal, len, "no-store", 8) != NULL)
+                 || (memmem(pVal, len, "no-cache", 8) != NULL)
+                 || (memmem(pVal, len, "private", 7) != NULL)))
+        return 1;
+    return 0;
+}
+
+
+static int hasRewriteCond(const HttpContext *pContext)
+{
+    const RewriteRule *pRule;
+    if (!(pContext->rewriteEnabled() & REWRITE_ON)
+        || !pContext->getRewriteRules())
+        return 0;
+    pRule = pContext->getRewriteRules()->begin();
+    for (; pRule; pRule = (const RewriteRule *)pRule->next())
+    {
+        if (pRule->getFirstCond())
+            return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * The body depends on who asked for it if the sub request went through
+ * authentication, access control or a conditional rewrite rule.
+ */
+static int isRestricted(HttpReq *pReq)
+{
+    AAAData aaa;
+    int satisfyAny;
+    const HttpContext *pContext = pReq->getContext();
+    const HttpContext *pVHostRoot = &pReq->getVHost()->getRootContext();
+
+    if (pReq->getAuthUser())
+        return 1;
+    if (pContext)
+    {
+        pReq->getAAAData(aaa, satisfyAny);
+        if (aaa.m_pHTAuth || aaa.m_pRequired || aaa.m_pAccessCtrl
+            || aaa.m_pAuthorizer)
+            return 1;
+        while ((!pContext->hasRewriteConfig()) && (pContext->getParent())
+               && (pContext->getParent() != pVHostRoot))
+            pContext = pContext->getParent();
+        if (hasRewriteCond(pContext))
+            return 1;
+    }
+    return hasRewriteCond(pVHostRoot);
+}
+
+
+void SsiFragCache::endCapture(HttpSession *pSubSession, SsiFragment *pFrag)
+{
+    HttpReq *pReq = pSubSession->getReq();
+    const HttpHandler *pHandler = pReq->getHttpHandler();
+    struct stat st;
+    int ttl;
+
+    if (pFrag->isOverflow() || !pSubSession->isEndResponse()
+        || (pReq->getStatusCode() != SC_200)
+        || isPrivate(pSubSession->getResp()->getRespHeaders())
+        || isRestricted(pReq))
+    {
+        delete pFrag;
+        return;
+    }
+    if (pHandler && (pHandler->getType() == HandlerType::HT_STATIC))
+    {
+        if (!pReq->getRealPath()
+            || (stat(pReq->getRealPath()->c_str(), &st) == -1)
+            || (st.st_size != pFrag->m_body.size()))
+        {
+            delete pFrag;
+            return;
+        }
+        pFrag->m_sFile.setStr(pReq->getRealPath()->c_str(),
+                              pReq->getRealPath()->len());
+        pFrag->m_ino = st.st_ino;
+        pFrag->m_mtime = st.st_mtime;
+        pFrag->m_size = st.st_size;
+        pFrag->m_tmChecked = DateTime::s_curTime;
+        ttl = m_iFileTtl;
+    }
+    else
+        ttl = m_iDynTtl;
+    if (ttl <= 0)
+    {
+        delete pFrag;
+        return;
+    }
+    pFrag->m_tmExpire = DateTime::s_curTime + ttl;
+
+    HashStringMap<SsiFragment *>::iterator iter = m_map.find(pFrag->getKey());
+    if (iter != m_map.end())
+    {
+        SsiFragment *pOld = iter.second();
+        remove(pOld);
+        delete pOld;
+    }
+    makeRoom(pFrag->m_body.size());
+    m_map.insert(pFrag->getKey(), pFrag);
+    m_lru.append(pFrag);
+    m_iUsed += pFrag->m_body.size();
+    LS_DBG_M(pSubSession->getLogSession(),
+             "[SSI] cached %d bytes fragment for %d seconds: %s",
+             pFrag->m_body.size(), ttl, pFrag->getKey());
+}
@@ -0,0 +1,132 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef SSIFRAGCACHE_H
+#define SSIFRAGCACHE_H
+
+
+#include <lsdef.h>
+#include <util/autobuf.h>
+#include <util/autostr.h>
+#include <util/dlinkqueue.h>
+#include <util/hashstringmap.h>
+#include <util/tsingleton.h>
+
+#include <sys/types.h>
+#include <time.h>
+
+class HttpSession;
+
+/**
+ * Captured body of an SSI include.  A fragment served by the static file
+ * handler also remembers the file it came from and is dropped as soon as
+ * that file changes.
+ */
+class SsiFragment : public DLinkedObj
+{
+public:
+    SsiFragment(const char *pKey, int keyLen);
+    ~SsiFragment() {}
+
+    const char *getKey() const      {   return m_sKey.c_str();  }
+    const AutoBuf &getBody() const  {   return m_body;          }
+
+    int append(const char *pBuf, int len);
+    int appendFile(int fd, off_t off, size_t size);
+    int isOverflow() const          {   return m_iOverflow;     }
+
+private:
+    friend class SsiFragCache;
+
+    AutoStr2    m_sKey;
+    AutoBuf     m_body;
+    time_t      m_tmExpire;
+    time_t      m_tmChecked;
+    AutoStr2    m_sFile;    // empty if not from a static file
+    ino_t       m_ino;
+    time_t      m_mtime;
+    off_t       m_size;
+    int         m_iMaxSize;
+    int         m_iOverflow;
+
+    LS_NO_COPY_ASSIGN(SsiFragment);
+};
+
+
+class SsiFragCache : public TSingleton<SsiFragCache>
+{
+    friend class TSingleton<SsiFragCache>;
+
+    HashStringMap<SsiFragment *>    m_map;
+    DLinkQueue                      m_lru;      // least recently used first
+    long                            m_iUsed;
+    long                            m_iMaxSize;
+    int                             m_iFileTtl;
+    int                             m_iDynTtl;
+    long                            m_iHits;
+    long                            m_iMisses;
+
+    SsiFragCache();
+
+    void remove(SsiFragment *pFrag);
+    void makeRoom(int size);
+    int  isValid(SsiFragment *pFrag);
+
+public:
+    ~SsiFragCache();
+
+    void setMaxSize(long size)      {   m_iMaxSize = size;      }
+    void setFileTtl(int ttl)        {   m_iFileTtl = ttl;       }
+    void setDynTtl(int ttl)         {   m_iDynTtl = ttl;        }
+    int  isEnabled() const          {   return m_iMaxSize > 0;  }
+
+    /**
+     * The key is the vhost name, the include URI and its query string.
+     */
+    static int buildKey(HttpSession *pSession, const char *pUri, int uriLen,
+                        const char *pQs, int qsLen, char *pKey, int keyLen);
+
+    /**
+     * Append a cached fragment to the response of pSession.  Returns 1 on a
+     * hit, 0 if a sub request is needed.
+     */
+    int serve(HttpSession *pSession, const char *pKey);
+
+    /**
+     * Called before the sub session runs, its body is copied into the
+     * returned fragment as it is passed to the parent.
+     */
+    SsiFragment *beginCapture(const char *pKey);
+
+    /**
+     * Called when the sub session is closed, keeps the fragment if the
+     * response is cacheable and the same for every client, otherwise
+     * deletes it.
+     */
+    void endCapture(HttpSession *pSubSession, SsiFragment *pFrag);
+
+    long getHits() const            {   return m_iHits;         }
+    long getMisses() const          {   return m_iMisses;       }
+    int  getCount() const           {   return m_map.size();    }
+    long getUsed() const            {   return m_iUsed;         }
+
+    LS_NO_COPY_ASSIGN(SsiFragCache);
+};
+
+LS_SINGLETON_DECL(SsiFragCache);
+
+#endif // SSIFRAGCACHE_H
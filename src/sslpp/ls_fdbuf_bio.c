@@ -439,6 +439,15 @@ static int bio_fd_write(BIO *b, const char *in, int inl)
         return -1;
     }
 
+    if (fdbio->m_flag & LS_FDBIO_KTLS_TX)
+    {
+        // The kernel owns the write keys, a userspace record would be sent
+        // as plaintext.
+        DEBUG_MESSAGE("[FDBIO] bio_fd_write, kTLS TX is active, refuse write\n");
+        errno = EPROTO;
+        return -1;
+    }
+
     if (fdbio->m_flag & LS_FDBIO_BUFFERING)
     {
         ret = ls_fdbio_buff_write(fdbio, fd, in, inl);
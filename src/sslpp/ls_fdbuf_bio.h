@@ -51,7 +51,8 @@ enum LS_FDBIO_FLAG
     LS_FDBIO_BUFFERING = 2,
     LS_FDBIO_CLOSED = 4,
     LS_FDBIO_NEED_READ_EVT = 8,
-    LS_FDBIO_RBUF_ALLOC = 16
+    LS_FDBIO_RBUF_ALLOC = 16,
+    LS_FDBIO_KTLS_TX = 32
 };
 
 /**
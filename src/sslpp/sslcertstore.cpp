@@ -0,0 +1,852 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#include <sslpp/sslcertstore.h>
+#include <sslpp/sslcontext.h>
+#include <sslpp/sslsesscache.h>
+#include <sslpp/sslutil.h>
+
+#include <log4cxx/logger.h>
+#include <lsr/ls_offload.h>
+#include <lsr/xxhash.h>
+#include <shm/lsshmhash.h>
+#include <util/datetime.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define shmSsl              "SSL"
+#define shmSslCertStore     "SSLCertStore"
+
+#define SSLCERTSTORE_MAX_NAME       253
+#define SSLCERTSTORE_MAX_FILE       (256 * 1024)
+#define SSLCERTSTORE_WORKERS        2
+#define SSLCERTSTORE_TRIM_INTERVAL  60
+
+
+enum
+{
+    CERT_LOAD_ERROR,
+    CERT_LOAD_NONE,
+    CERT_LOAD_SAME,
+    CERT_LOAD_NEW,
+};
+
+
+/**
+ * What the store shares through SHM for one certificate, the key and the
+ * certificate chain follow the header as PEM. A record is keyed by the
+ * file base name, so all names served by "_.<parent>" share one. Only
+ * found certificates are shared, records not revalidated for
+ * SSLCERTSTORE_SHM_TTL are trimmed.
+ */
+typedef struct SslCertShmRec_s
+{
+    uint64_t    x_stamp;
+    int32_t     x_tmChecked;
+    int32_t     x_iKeyLen;
+    int32_t     x_iCertLen;
+    int32_t     x_iReserved;
+    char        x_data[0];
+} SslCertShmRec_t;
+
+
+struct SslCertWaiter : public LinkedObj
+{
+    AsyncCertDoneCb m_cb;
+    void           *m_pParam;
+};
+
+
+struct SslCertStoreEntry : public DLinkedObj
+{
+    AutoStr2         m_name;
+    SslContext      *m_pCtx;
+    uint64_t         m_stamp;
+    time_t           m_tmChecked;
+    int              m_iWild;
+    SslCertLoadTask *m_pTask;
+    LinkQueue        m_waiters;
+};
+
+
+struct SslRetiredCtx : public DLinkedObj
+{
+    SslContext      *m_pCtx;
+    time_t           m_tmRetired;
+};
+
+
+static struct Offloader *s_pLoadOffloader = NULL;
+
+
+static int statPair(const char *pDir, const char *pBase,
+                    char *pCert, char *pKey, int size,
+                    struct stat *pStCert, struct stat *pStKey)
+{
+    lsnprintf(pCert, size, "%s/%s.crt", pDir, pBase);
+    lsnprintf(pKey, size, "%s/%s.key", pDir, pBase);
+    if ((stat(pCert, pStCert) == -1) || !S_ISREG(pStCert->st_mode))
+        return LS_FAIL;
+    if ((stat(pKey, pStKey) == -1) || !S_ISREG(pStKey->st_mode))
+        return LS_FAIL;
+    return LS_OK;
+}
+
+
+static int readPem(const char *pFile, off_t size, AutoStr2 *pOut)
+{
+    if (size <= 0 || size > SSLCERTSTORE_MAX_FILE)
+        return LS_FAIL;
+    int fd = open(pFile, O_RDONLY);
+    if (fd == -1)
+        return LS_FAIL;
+    char *pBuf = pOut->prealloc(size + 1);
+    int len = 0, n = 0;
+    while (pBuf && len < size)
+    {
+        n = read(fd, pBuf + len, size - len);
+        if (n > 0)
+            len += n;
+        else if (n == 0 || errno != EINTR)
+            break;
+    }
+    close(fd);
+    if (!pBuf || n == -1 || len <= 0)
+        return LS_FAIL;
+    pBuf[len] = 0;
+    pOut->setLen(len);
+    return LS_OK;
+}
+
+
+static uint64_t makeStamp(const struct stat *pStCert,
+                          const struct stat *pStKey, int isWild)
+{
+    int64_t fp[7];
+    fp[0] = pStCert->st_ino;
+    fp[1] = pStCert->st_mtime;
+    fp[2] = pStCert->st_size;
+    fp[3] = pStKey->st_ino;
+    fp[4] = pStKey->st_mtime;
+    fp[5] = pStKey->st_size;
+    fp[6] = isWild;
+    return XXH64(fp, sizeof(fp), 0) | 1;
+}
+
+
+/**
+ * "_.<parent>" for a name that may be served by a wildcard certificate,
+ * NULL when the parent would be a top level domain.
+ */
+static const char *getWildName(const char *pName, char *pBuf, int size)
+{
+    const char *pParent = strchr(pName, '.');
+    if (!pParent || !strchr(pParent + 1, '.'))
+        return NULL;
+    lsnprintf(pBuf, size, "_%s", pParent);
+    return pBuf;
+}
+
+
+void SslCertStore::loadFiles(SslCertLoadTask *pTask)
+{
+    char achCert[PATH_MAX];
+    char achKey[PATH_MAX];
+    char achWild[SSLCERTSTORE_MAX_NAME + 2];
+    struct stat stCert, stKey;
+    const char *pName = pTask->m_name.c_str();
+    const char *pWild;
+
+    pTask->m_iWild = 0;
+    if (statPair(pTask->m_pDir, pName, achCert, achKey, PATH_MAX,
+                 &stCert, &stKey) == LS_FAIL)
+    {
+        pWild = getWildName(pName, achWild, sizeof(achWild));
+        if (!pWild || statPair(pTask->m_pDir, pWild, achCert, achKey,
+                               PATH_MAX, &stCert, &stKey) == LS_FAIL)
+        {
+            pTask->m_iResult = CERT_LOAD_NONE;
+            return;
+        }
+        pTask->m_iWild = 1;
+    }
+    pTask->m_file.setStr(achCert);
+    pTask->m_stamp = makeStamp(&stCert, &stKey, pTask->m_iWild);
+    if (pTask->m_stamp == pTask->m_oldStamp)
+    {
+        pTask->m_iResult = CERT_LOAD_SAME;
+        return;
+    }
+    if (readPem(achKey, stKey.st_size, &pTask->m_key) == LS_OK
+        && readPem(achCert, stCert.st_size, &pTask->m_cert) == LS_OK)
+        pTask->m_iResult = CERT_LOAD_NEW;
+}
+
+
+static int cert_load_perform(ls_offload *item)
+{
+    SslCertStore::loadFiles((SslCertLoadTask *)item);
+    return 0;
+}
+
+
+static void cert_load_release(ls_offload *item)
+{
+    SslCertLoadTask *pTask = (SslCertLoadTask *)item;
+    if (--pTask->m_header.ref_cnt > 0)
+        return;
+    delete pTask;
+}
+
+
+static void cert_load_done(void *param)
+{
+    SslCertStore::getInstance().onLoaded((SslCertLoadTask *)param);
+}
+
+
+static struct ls_offload_api s_certLoadApi =
+{
+    cert_load_perform,
+    cert_load_release,
+    cert_load_done
+};
+
+
+static struct Offloader *getLoadOffloader()
+{
+    if (!s_pLoadOffloader)
+        s_pLoadOffloader = offloader_new("SSL_CERT_STORE",
+                                         SSLCERTSTORE_WORKERS);
+    return s_pLoadOffloader;
+}
+
+
+LS_SINGLETON(SslCertStore);
+
+
+SslCertStore::SslCertStore()
+    : m_iMaxEntries(SSLCERTSTORE_DEFAULT_SIZE)
+    , m_pShmStore(NULL)
+    , m_tmLastTrim(0)
+{
+}
+
+
+SslCertStore::~SslCertStore()
+{
+}
+
+
+int SslCertStore::initShm(int uid, int gid)
+{
+    LsShm *pShm;
+    LsShmPool *pPool;
+
+    if ((pShm = LsShm::open(shmSsl, 0)) == NULL)
+        return LS_FAIL;
+    pShm->chperm(uid, gid, 0600);
+    if ((pPool = pShm->getGlobalPool()) == NULL)
+        return LS_FAIL;
+    if ((m_pShmStore = pPool->getNamedHash(shmSslCertStore, 1000,
+                        LsShmHash::hashXXH32, memcmp, LSSHM_FLAG_LRU)) == NULL)
+        return LS_FAIL;
+    m_pShmStore->disableAutoLock(); // we will be responsible for the lock
+    return LS_OK;
+}
+
+
+int SslCertStore::init(const char *pDir, int iMaxEntries, int iEnableTicket,
+                       int uid, int gid)
+{
+    struct stat st;
+    if (stat(pDir, &st) == -1 || !S_ISDIR(st.st_mode))
+    {
+        LS_ERROR("[SSL] Certificate store directory %s is not accessible.",
+                 pDir);
+        return LS_FAIL;
+    }
+    m_sDir.setStr(pDir);
+    m_iMaxEntries = iMaxEntries;
+
+    m_config.m_sName = "SslCertStore";
+    m_config.m_sCiphers = "ALL:!ADH:!EXPORT56:RC4+RSA:+HIGH:+MEDIUM:+SSLv2:+EXP";
+    m_config.m_iProtocol = SslContext::SSL_TLS_SAFE;
+    m_config.m_iEnableECDHE = 1;
+    m_config.m_iEnableSpdy = 15;
+    m_config.m_iEnableTicket = iEnableTicket;
+
+    if (initShm(uid, gid) == LS_FAIL)
+        LS_WARN("[SSL] Certificate store failed to attach SHM, "
+                "certificates will not be shared between workers.");
+    SslUtil::setAsyncCertFunc(addAsyncLookup, removeAsyncLookup);
+    LS_INFO("[SSL] Certificate store enabled, directory: %s, "
+            "per-worker cache size: %d.", pDir, iMaxEntries);
+    return LS_OK;
+}
+
+
+bool SslCertStore::isValidName(const char *pName, int iNameLen)
+{
+    if (iNameLen <= 0 || iNameLen > SSLCERTSTORE_MAX_NAME)
+        return false;
+    if (*pName == '.' || *pName == '_')
+        return false;
+    for (int i = 0; i < iNameLen; ++i)
+    {
+        char ch = pName[i];
+        if (ch == '.')
+        {
+            if (i + 1 < iNameLen && pName[i + 1] == '.')
+                return false;
+        }
+        else if (!islower(ch) && !isdigit(ch) && ch != '-' && ch != '_')
+            return false;
+    }
+    return true;
+}
+
+
+SslCertStoreEntry *SslCertStore::getEntry(const char *pName)
+{
+    SslCertStoreMap::iterator iter = m_map.find(pName);
+    if (iter == m_map.end())
+        return NULL;
+    return iter.second();
+}
+
+
+SslCertStoreEntry *SslCertStore::newEntry(const char *pName, int iNameLen)
+{
+    SslCertStoreEntry *pEntry = new SslCertStoreEntry();
+    if (!pEntry)
+        return NULL;
+    pEntry->m_name.setStr(pName, iNameLen);
+    pEntry->m_pCtx = NULL;
+    pEntry->m_stamp = 0;
+    pEntry->m_tmChecked = 0;
+    pEntry->m_iWild = 0;
+    pEntry->m_pTask = NULL;
+    m_map.insert(pEntry->m_name.c_str(), pEntry);
+    m_negative.append(pEntry);
+    return pEntry;
+}
+
+
+/**
+ * Fails when every unknown name in m_negative is still being loaded.
+ */
+SslCertStoreEntry *SslCertStore::addEntry(const char *pName, int iNameLen)
+{
+    if (m_negative.size() >= m_iMaxEntries)
+        evict(&m_negative);
+    if (m_negative.size() >= m_iMaxEntries)
+        return NULL;
+    return newEntry(pName, iNameLen);
+}
+
+
+/**
+ * Entries with a context are kept in m_lru, the ones without in
+ * m_negative, so a flood of unknown names cannot push out certificates.
+ */
+DLinkQueue *SslCertStore::getList(const SslCertStoreEntry *pEntry)
+{
+    return pEntry->m_pCtx ? &m_lru : &m_negative;
+}
+
+
+void SslCertStore::touch(SslCertStoreEntry *pEntry)
+{
+    DLinkQueue *pList = getList(pEntry);
+    if (pEntry->next() == pList->end())
+        return;
+    pList->remove(pEntry);
+    pList->append(pEntry);
+}
+
+
+/**
+ * Make room for a new entry by dropping the least recently used ones,
+ * entries with a load in flight are kept as the offloader still refers
+ * to them by name.
+ */
+void SslCertStore::evict(DLinkQueue *pList)
+{
+    DLinkedObj *pObj = pList->begin();
+    while (pList->size() >= m_iMaxEntries && pObj != pList->end())
+    {
+        SslCertStoreEntry *pEntry = (SslCertStoreEntry *)pObj;
+        pObj = pObj->next();
+        if (pEntry->m_pTask)
+            continue;
+        LS_DBG_L("[SSL] Certificate store evict %s.", pEntry->m_name.c_str());
+        pList->remove(pEntry);
+        m_map.remove(pEntry->m_name.c_str());
+        retireCtx(pEntry->m_pCtx);
+        delete pEntry;
+    }
+}
+
+
+void SslCertStore::expireNegative()
+{
+    DLinkedObj *pObj = m_negative.begin();
+    while (pObj != m_negative.end())
+    {
+        SslCertStoreEntry *pEntry = (SslCertStoreEntry *)pObj;
+        pObj = pObj->next();
+        if (pEntry->m_pTask || DateTime::s_curTime - pEntry->m_tmChecked
+                               < SSLCERTSTORE_NEGATIVE_TTL)
+            continue;
+        m_negative.remove(pEntry);
+        m_map.remove(pEntry->m_name.c_str());
+        delete pEntry;
+    }
+}
+
+
+/**
+ * A context may still be in use by handshakes in progress, it is only
+ * released after SSLCERTSTORE_RETIRE_DELAY.
+ */
+void SslCertStore::setCtx(SslCertStoreEntry *pEntry, SslContext *pCtx)
+{
+    DLinkQueue *pOld = getList(pEntry);
+    DLinkQueue *pNew;
+    retireCtx(pEntry->m_pCtx);
+    pEntry->m_pCtx = pCtx;
+    pNew = getList(pEntry);
+    if (pNew == pOld)
+        return;
+    pOld->remove(pEntry);
+    if (pNew->size() >= m_iMaxEntries)
+        evict(pNew);
+    pNew->append(pEntry);
+}
+
+
+void SslCertStore::retireCtx(SslContext *pCtx)
+{
+    if (!pCtx)
+        return;
+    SslRetiredCtx *pRetired = new SslRetiredCtx();
+    if (pRetired)
+    {
+        pRetired->m_pCtx = pCtx;
+        pRetired->m_tmRetired = DateTime::s_curTime;
+        m_retired.append(pRetired);
+    }
+}
+
+
+void SslCertStore::onTimer()
+{
+    while (!m_retired.empty())
+    {
+        SslRetiredCtx *pRetired = (SslRetiredCtx *)m_retired.begin();
+        if (DateTime::s_curTime - pRetired->m_tmRetired
+            < SSLCERTSTORE_RETIRE_DELAY)
+            break;
+        m_retired.pop_front();
+        delete pRetired->m_pCtx;
+        delete pRetired;
+    }
+    expireNegative();
+    if (m_pShmStore && DateTime::s_curTime - m_tmLastTrim
+                       >= SSLCERTSTORE_TRIM_INTERVAL)
+    {
+        m_tmLastTrim = DateTime::s_curTime;
+        m_pShmStore->lock();
+        m_pShmStore->trim(DateTime::s_curTime - SSLCERTSTORE_SHM_TTL,
+                          NULL, NULL);
+        m_pShmStore->unlock();
+    }
+}
+
+
+SslContext *SslCertStore::buildCtx(const char *pName,
+                                   const char *pKey, int iKeyLen,
+                                   const char *pCert, int iCertLen)
+{
+    m_config.m_iEnableCache = SslSessCache::getInstance().isReady();
+    return SslContext::configPem(pName, pKey, iKeyLen, pCert, iCertLen,
+                                 &m_config);
+}
+
+
+/**
+ * Must be called with the SHM lock held. Returns when the record was last
+ * checked if that is after \a tmMin, the PEM data is only copied out
+ * when the stamp differs from \a curStamp.
+ */
+time_t SslCertStore::readShm(const char *pKey, int iKeyLen, time_t tmMin,
+                             uint64_t curStamp, uint64_t *pStamp,
+                             AutoStr2 *pPemKey, AutoStr2 *pPemCert)
+{
+    int valLen;
+    LsShmOffset_t offVal = m_pShmStore->find(pKey, iKeyLen, &valLen);
+    if (offVal == 0 || valLen < (int)sizeof(SslCertShmRec_t))
+        return 0;
+    SslCertShmRec_t *pRec = (SslCertShmRec_t *)m_pShmStore->offset2ptr(offVal);
+    if (pRec->x_tmChecked <= tmMin
+        || valLen < (int)sizeof(*pRec) + pRec->x_iKeyLen + pRec->x_iCertLen)
+        return 0;
+    *pStamp = pRec->x_stamp;
+    if (pRec->x_stamp != curStamp)
+    {
+        pPemKey->setStr(pRec->x_data, pRec->x_iKeyLen);
+        pPemCert->setStr(pRec->x_data + pRec->x_iKeyLen, pRec->x_iCertLen);
+    }
+    return pRec->x_tmChecked;
+}
+
+
+/**
+ * Pick up a certificate another worker saved to SHM after our last check.
+ * A new entry may start from the wildcard record of its parent, but still
+ * checks the files at once since the name may have a certificate of its
+ * own.
+ */
+int SslCertStore::loadFromShm(SslCertStoreEntry *pEntry)
+{
+    AutoStr2 key, cert;
+    char achWild[SSLCERTSTORE_MAX_NAME + 2];
+    const char *pWild;
+    uint64_t stamp = 0;
+    time_t tmChecked = 0;
+    int isWild = 0;
+
+    if (!m_pShmStore)
+        return LS_FAIL;
+    m_pShmStore->lock();
+    if (!pEntry->m_iWild)
+        tmChecked = readShm(pEntry->m_name.c_str(), pEntry->m_name.len(),
+                            pEntry->m_tmChecked, pEntry->m_stamp, &stamp,
+                            &key, &cert);
+    if (!tmChecked && pEntry->m_tmChecked == 0
+        && (pWild = getWildName(pEntry->m_name.c_str(), achWild,
+                                sizeof(achWild))) != NULL)
+    {
+        tmChecked = readShm(pWild, strlen(pWild), 0, pEntry->m_stamp,
+                            &stamp, &key, &cert);
+        isWild = 1;
+    }
+    m_pShmStore->unlock();
+
+    if (tmChecked == 0)
+        return LS_FAIL;
+    if (stamp != pEntry->m_stamp)
+    {
+        SslContext *pCtx = buildCtx(pEntry->m_name.c_str(), key.c_str(),
+                                    key.len(), cert.c_str(), cert.len());
+        if (!pCtx)
+            return LS_FAIL;
+        setCtx(pEntry, pCtx);
+        pEntry->m_stamp = stamp;
+    }
+    pEntry->m_iWild = isWild;
+    pEntry->m_tmChecked = isWild ? 0 : tmChecked;
+    return LS_OK;
+}
+
+
+void SslCertStore::saveToShm(SslCertStoreEntry *pEntry,
+                             const SslCertLoadTask *pTask)
+{
+    char achWild[SSLCERTSTORE_MAX_NAME + 2];
+    const char *pWild = getWildName(pEntry->m_name.c_str(), achWild,
+                                    sizeof(achWild));
+    const char *pKey = pEntry->m_name.c_str();
+    int keyLen = pEntry->m_name.len();
+    int valLen;
+
+    if (!m_pShmStore)
+        return;
+    if (pTask->m_iResult == CERT_LOAD_NONE)
+    {
+        m_pShmStore->lock();
+        m_pShmStore->remove(pKey, keyLen);
+        if (pWild)
+            m_pShmStore->remove(pWild, strlen(pWild));
+        m_pShmStore->unlock();
+        return;
+    }
+    if (pTask->m_iWild && pWild)
+    {
+        pKey = pWild;
+        keyLen = strlen(pWild);
+    }
+    if (pTask->m_iResult == CERT_LOAD_SAME)
+    {
+        ls_strpair_t parms;
+        ls_str_set(&parms.key, (char *)pKey, keyLen);
+        m_pShmStore->lock();
+        LsShmHash::iteroffset iterOff = m_pShmStore->findIterator(&parms);
+        if (iterOff.m_iOffset != 0)
+        {
+            LsShmHash::iterator iter = m_pShmStore->offset2iterator(iterOff);
+            SslCertShmRec_t *pRec = (SslCertShmRec_t *)iter->getVal();
+            if (iter->getValLen() >= (int)sizeof(SslCertShmRec_t)
+                && pRec->x_stamp == pEntry->m_stamp)
+            {
+                pRec->x_tmChecked = pEntry->m_tmChecked;
+                m_pShmStore->touchLru(iterOff);
+            }
+        }
+        m_pShmStore->unlock();
+        return;
+    }
+
+    int pemKeyLen = pTask->m_key.len();
+    int pemCertLen = pTask->m_cert.len();
+    valLen = sizeof(SslCertShmRec_t) + pemKeyLen + pemCertLen;
+    SslCertShmRec_t *pRec = (SslCertShmRec_t *)malloc(valLen);
+    if (!pRec)
+        return;
+    pRec->x_stamp = pEntry->m_stamp;
+    pRec->x_tmChecked = pEntry->m_tmChecked;
+    pRec->x_iKeyLen = pemKeyLen;
+    pRec->x_iCertLen = pemCertLen;
+    pRec->x_iReserved = 0;
+    memcpy(pRec->x_data, pTask->m_key.c_str(), pemKeyLen);
+    memcpy(pRec->x_data + pemKeyLen, pTask->m_cert.c_str(), pemCertLen);
+    m_pShmStore->lock();
+    if (m_pShmStore->set(pKey, keyLen, pRec, valLen) == 0)
+        LS_DBG_L("[SSL] Certificate store failed to save %s to SHM.", pKey);
+    m_pShmStore->unlock();
+    free(pRec);
+}
+
+
+SslCertLoadTask *SslCertStore::newTask(SslCertStoreEntry *pEntry)
+{
+    SslCertLoadTask *pTask = new SslCertLoadTask();
+    if (!pTask)
+        return NULL;
+    memset(&pTask->m_header, 0, sizeof(pTask->m_header));
+    pTask->m_header.api = &s_certLoadApi;
+    pTask->m_header.param_task_done = pTask;
+    pTask->m_name.setStr(pEntry->m_name.c_str(), pEntry->m_name.len());
+    pTask->m_pDir = m_sDir.c_str();
+    pTask->m_oldStamp = pEntry->m_stamp;
+    pTask->m_stamp = 0;
+    pTask->m_iWild = 0;
+    pTask->m_iResult = CERT_LOAD_ERROR;
+    pEntry->m_pTask = pTask;
+    return pTask;
+}
+
+
+int SslCertStore::startLoad(SslCertStoreEntry *pEntry)
+{
+    struct Offloader *pOffloader = getLoadOffloader();
+    if (!pOffloader)
+        return LS_FAIL;
+    SslCertLoadTask *pTask = newTask(pEntry);
+    if (!pTask)
+        return LS_FAIL;
+    //offloader_enqueue() releases the task by itself on failure.
+    if (offloader_enqueue(pOffloader, &pTask->m_header) == -1)
+    {
+        pEntry->m_pTask = NULL;
+        pEntry->m_tmChecked = DateTime::s_curTime;
+        return LS_FAIL;
+    }
+    LS_DBG_L("[SSL] Certificate store loading %s.", pEntry->m_name.c_str());
+    return LS_OK;
+}
+
+
+SslContext *SslCertStore::lookup(const char *pName, int iNameLen, int *pWait)
+{
+    *pWait = 0;
+    if (!isEnabled() || !isValidName(pName, iNameLen))
+        return NULL;
+
+    SslCertStoreEntry *pEntry = getEntry(pName);
+    if (!pEntry)
+    {
+        if ((pEntry = addEntry(pName, iNameLen)) == NULL)
+            return NULL;
+        loadFromShm(pEntry);
+    }
+    else
+    {
+        touch(pEntry);
+        if (!pEntry->m_pTask && DateTime::s_curTime - pEntry->m_tmChecked
+                                >= SSLCERTSTORE_REVALIDATE)
+            loadFromShm(pEntry);
+    }
+
+    // keep serving the current context while it is being revalidated.
+    if (!pEntry->m_pTask && DateTime::s_curTime - pEntry->m_tmChecked
+                            >= SSLCERTSTORE_REVALIDATE)
+        startLoad(pEntry);
+
+    if (pEntry->m_pCtx)
+        return pEntry->m_pCtx;
+    // only the first look for a name is waited for, a known miss being
+    // revalidated falls through to the vhost map.
+    if (pEntry->m_pTask && pEntry->m_tmChecked == 0)
+        *pWait = 1;
+    return NULL;
+}
+
+
+void SslCertStore::onLoaded(SslCertLoadTask *pTask)
+{
+    SslCertStoreEntry *pEntry = getEntry(pTask->m_name.c_str());
+    if (!pEntry || pEntry->m_pTask != pTask)
+        return;
+    pEntry->m_pTask = NULL;
+    pEntry->m_tmChecked = DateTime::s_curTime;
+
+    switch (pTask->m_iResult)
+    {
+    case CERT_LOAD_NEW:
+    {
+        SslContext *pCtx = buildCtx(pEntry->m_name.c_str(),
+                                    pTask->m_key.c_str(), pTask->m_key.len(),
+                                    pTask->m_cert.c_str(), pTask->m_cert.len());
+        if (!pCtx)
+            break;
+        LS_DBG_L("[SSL] Certificate store loaded %s for %s.",
+                pTask->m_file.c_str(), pEntry->m_name.c_str());
+        setCtx(pEntry, pCtx);
+        pEntry->m_stamp = pTask->m_stamp;
+        pEntry->m_iWild = pTask->m_iWild;
+        saveToShm(pEntry, pTask);
+        break;
+    }
+    case CERT_LOAD_NONE:
+        if (pEntry->m_pCtx)
+            LS_DBG_L("[SSL] Certificate store no longer has a certificate "
+                     "for %s.", pEntry->m_name.c_str());
+        setCtx(pEntry, NULL);
+        pEntry->m_stamp = 0;
+        pEntry->m_iWild = 0;
+        saveToShm(pEntry, pTask);
+        break;
+    case CERT_LOAD_SAME:
+        saveToShm(pEntry, pTask);
+        break;
+    default:
+        LS_WARN("[SSL] Certificate store failed to read %s for %s.",
+                pTask->m_file.c_str(), pEntry->m_name.c_str());
+        break;
+    }
+    wakeWaiters(pEntry);
+}
+
+
+/**
+ * Callbacks resume handshakes, which may look up other names and evict
+ * this entry, so the waiter list and the name are taken out first.
+ */
+void SslCertStore::wakeWaiters(SslCertStoreEntry *pEntry)
+{
+    LinkQueue waiters;
+    SslCertWaiter *pWaiter;
+    char achName[SSLCERTSTORE_MAX_NAME + 1];
+
+    if (pEntry->m_waiters.size() == 0)
+        return;
+    while ((pWaiter = (SslCertWaiter *)pEntry->m_waiters.pop()) != NULL)
+        waiters.push(pWaiter);
+    lstrncpy(achName, pEntry->m_name.c_str(), sizeof(achName));
+    while ((pWaiter = (SslCertWaiter *)waiters.pop()) != NULL)
+    {
+        AsyncCertDoneCb cb = pWaiter->m_cb;
+        void *pParam = pWaiter->m_pParam;
+        delete pWaiter;
+        (*cb)(pParam, achName);
+    }
+}
+
+
+static int lcaseDomain(const char *pDomain, int iDomainLen, char *pBuf,
+                       int size)
+{
+    if (!pDomain)
+        return -1;
+    if (iDomainLen <= 0)
+        iDomainLen = strlen(pDomain);
+    if (iDomainLen >= size)
+        return -1;
+    for (int i = 0; i < iDomainLen; ++i)
+        pBuf[i] = tolower(pDomain[i]);
+    pBuf[iDomainLen] = 0;
+    return iDomainLen;
+}
+
+
+/**
+ * Registered with SslUtil::setAsyncCertFunc(). Returns 1 when the caller
+ * will be called back, otherwise the handshake should be retried at once.
+ */
+int SslCertStore::addAsyncLookup(AsyncCertDoneCb cb, void *pParam,
+                                 const char *pDomain, int iDomainLen)
+{
+    char achName[SSLCERTSTORE_MAX_NAME + 1];
+    if (lcaseDomain(pDomain, iDomainLen, achName, sizeof(achName)) == -1)
+        return LS_FAIL;
+    SslCertStoreEntry *pEntry = getInstance().getEntry(achName);
+    if (!pEntry || !pEntry->m_pTask)
+        return 0;
+    SslCertWaiter *pWaiter = new SslCertWaiter();
+    if (!pWaiter)
+        return LS_FAIL;
+    pWaiter->m_cb = cb;
+    pWaiter->m_pParam = pParam;
+    pEntry->m_waiters.push(pWaiter);
+    return 1;
+}
+
+
+int SslCertStore::removeAsyncLookup(AsyncCertDoneCb cb, void *pParam,
+                                    const char *pDomain, int iDomainLen)
+{
+    char achName[SSLCERTSTORE_MAX_NAME + 1];
+    if (lcaseDomain(pDomain, iDomainLen, achName, sizeof(achName)) == -1)
+        return LS_FAIL;
+    SslCertStoreEntry *pEntry = getInstance().getEntry(achName);
+    if (!pEntry)
+        return 0;
+    LinkedObj *pPrev = pEntry->m_waiters.head();
+    SslCertWaiter *pWaiter;
+    while ((pWaiter = (SslCertWaiter *)pPrev->next()) != NULL)
+    {
+        if (pWaiter->m_cb == cb && pWaiter->m_pParam == pParam)
+        {
+            pEntry->m_waiters.removeNext(pPrev);
+            delete pWaiter;
+            break;
+        }
+        pPrev = pWaiter;
+    }
+    return 0;
+}
+
@@ -0,0 +1,152 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#ifndef SSLCERTSTORE_H
+#define SSLCERTSTORE_H
+
+#include <lsdef.h>
+#include <lsr/ls_offload.h>
+#include <sslpp/ssldef.h>
+#include <sslpp/sslcontextconfig.h>
+#include <util/autostr.h>
+#include <util/dlinkqueue.h>
+#include <util/hashstringmap.h>
+#include <util/tsingleton.h>
+
+#include <stdint.h>
+#include <time.h>
+
+
+#define SSLCERTSTORE_DEFAULT_SIZE   1000
+#define SSLCERTSTORE_REVALIDATE     10      // seconds
+#define SSLCERTSTORE_RETIRE_DELAY   60      // seconds
+#define SSLCERTSTORE_NEGATIVE_TTL   60      // seconds
+#define SSLCERTSTORE_SHM_TTL        600     // seconds
+
+class LsShmHash;
+class SslContext;
+struct SslCertStoreEntry;
+
+typedef HashStringMap<SslCertStoreEntry *> SslCertStoreMap;
+
+#ifdef RUN_TEST
+namespace SuiteSslCertStore {
+    class TestNegativeCache;
+};
+#endif
+
+/**
+ * A load job handed to the offloader threads, it only touches the file
+ * system, the context is built in the event loop when the job is done.
+ */
+struct SslCertLoadTask
+{
+    ls_offload_t    m_header;
+    AutoStr2        m_name;
+    const char     *m_pDir;
+    uint64_t        m_oldStamp;
+    uint64_t        m_stamp;
+    AutoStr2        m_key;
+    AutoStr2        m_cert;
+    AutoStr2        m_file;
+    int             m_iWild;
+    int             m_iResult;
+};
+
+/**
+ * On-demand certificate store. Certificates are looked up by SNI name as
+ * "<dir>/<name>.crt" and "<dir>/<name>.key", falling back to "_.<parent>"
+ * for a wildcard. Files are read by an offloader thread, the PEM data is
+ * shared between workers through SHM, each worker keeps an LRU of the
+ * SslContext objects built from it.  Names without a certificate are
+ * only remembered per worker, in a separate LRU with the same size limit
+ * that expires after SSLCERTSTORE_NEGATIVE_TTL.
+ */
+class SslCertStore : public TSingleton<SslCertStore>
+{
+    friend class TSingleton<SslCertStore>;
+#ifdef RUN_TEST
+    friend class SuiteSslCertStore::TestNegativeCache;
+#endif
+
+public:
+    int  init(const char *pDir, int iMaxEntries, int iEnableTicket,
+              int uid, int gid);
+    bool isEnabled() const          {   return m_sDir.c_str() != NULL;  }
+    int  size() const               {   return m_lru.size();            }
+
+    /**
+     * Returns the context for pName, or NULL. *pWait is set when the
+     * first load of the name is running and the caller may wait for it,
+     * never while a known miss is revalidated.
+     */
+    SslContext *lookup(const char *pName, int iNameLen, int *pWait);
+
+    void onLoaded(SslCertLoadTask *pTask);
+    void onTimer();
+
+    static int addAsyncLookup(AsyncCertDoneCb cb, void *pParam,
+                              const char *pDomain, int iDomainLen);
+    static int removeAsyncLookup(AsyncCertDoneCb cb, void *pParam,
+                                 const char *pDomain, int iDomainLen);
+
+    static bool isValidName(const char *pName, int iNameLen);
+    static void loadFiles(SslCertLoadTask *pTask);
+
+private:
+    SslCertStore();
+    ~SslCertStore();
+
+    int  initShm(int uid, int gid);
+    SslCertStoreEntry *getEntry(const char *pName);
+    SslCertStoreEntry *newEntry(const char *pName, int iNameLen);
+    SslCertStoreEntry *addEntry(const char *pName, int iNameLen);
+    DLinkQueue *getList(const SslCertStoreEntry *pEntry);
+    void touch(SslCertStoreEntry *pEntry);
+    void evict(DLinkQueue *pList);
+    void expireNegative();
+    SslCertLoadTask *newTask(SslCertStoreEntry *pEntry);
+    int  startLoad(SslCertStoreEntry *pEntry);
+    int  loadFromShm(SslCertStoreEntry *pEntry);
+    time_t readShm(const char *pKey, int iKeyLen, time_t tmMin,
+                   uint64_t curStamp, uint64_t *pStamp, AutoStr2 *pPemKey,
+                   AutoStr2 *pPemCert);
+    void saveToShm(SslCertStoreEntry *pEntry, const SslCertLoadTask *pTask);
+    SslContext *buildCtx(const char *pName, const char *pKey, int iKeyLen,
+                         const char *pCert, int iCertLen);
+    void setCtx(SslCertStoreEntry *pEntry, SslContext *pCtx);
+    void retireCtx(SslContext *pCtx);
+    void wakeWaiters(SslCertStoreEntry *pEntry);
+
+private:
+    AutoStr2            m_sDir;
+    int                 m_iMaxEntries;
+    SslContextConfig    m_config;
+    SslCertStoreMap     m_map;
+    DLinkQueue          m_lru;
+    DLinkQueue          m_negative;
+    DLinkQueue          m_retired;
+    LsShmHash          *m_pShmStore;
+    time_t              m_tmLastTrim;
+
+    LS_NO_COPY_ASSIGN(SslCertStore);
+};
+
+LS_SINGLETON_DECL(SslCertStore);
+
+#endif // SSLCERTSTORE_H
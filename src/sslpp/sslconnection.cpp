@@ -29,6 +29,7 @@
 #include <openssl/err.h>
 
 #include <sslpp/sslerror.h>
+#include <sslpp/sslktls.h>
 #include <sslpp/sslsesscache.h>
 #include <sslpp/sslcert.h>
 #include <sslpp/sslutil.h>
@@ -38,6 +39,7 @@
 #include <string.h>
 #include <assert.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <sys/socket.h>
 
@@ -111,6 +113,7 @@ void SslConnection::release()
     SSL_free(m_ssl);
     m_ssl = NULL;
     m_iWant = 0;
+    m_bio.m_flag &= ~LS_FDBIO_KTLS_TX;
 }
 
 
@@ -170,6 +173,8 @@ int SslConnection::write(const char *pBuf, int len)
     m_iWant = 0;
     if (len <= 0)
         return 0;
+    if (isKtlsTx())
+        return ktlsWritev(pBuf, len, NULL, 0);
     int ret = SSL_write(m_ssl, pBuf, len);
 
     LS_DBG_M("SSL_write( %p, %p, %d) return %d, pending %d\n",
@@ -203,6 +208,19 @@ int SslConnection::writev(const struct iovec *vect, int count,
     char *pCurEnd;
     char achBuf[4096];
 
+    if (isKtlsTx())
+    {
+        m_iWant = 0;
+        ret = ktlsWritev(NULL, 0, vect, count);
+        if (finished)
+        {
+            int total = 0;
+            for (; vect < pEnd; ++vect)
+                total += vect->iov_len;
+            *finished = (ret == total);
+        }
+        return ret;
+    }
     pBufEnd = achBuf + 4096;
     pCurEnd = achBuf;
     for (; vect < pEnd ;)
@@ -249,6 +267,37 @@ int SslConnection::writev(const struct iovec *vect, int count,
 }
 
 
+// Plain socket write once the kernel does the record encryption.
+int SslConnection::ktlsWritev(const char *pBuf, int len,
+                              const struct iovec *vect, int count)
+{
+    int fd = SSL_get_fd(m_ssl);
+    int ret = vect ? ::writev(fd, vect, count) : ::write(fd, pBuf, len);
+    if (ret >= 0)
+        return ret;
+    if (errno == EAGAIN || errno == EINTR)
+    {
+        m_iWant |= LAST_WRITE | WANT_WRITE;
+        return 0;
+    }
+    return LS_FAIL;
+}
+
+
+int SslConnection::enableKtlsTx()
+{
+    if (!SslKtls::isEnabled() || !isConnected() || wpending() > 0)
+        return LS_FAIL;
+    if (SslKtls::enableTx(m_ssl, SSL_get_fd(m_ssl)) != LS_OK)
+        return LS_FAIL;
+    setWriteBuffering(0);
+    m_bio.m_flag |= LS_FDBIO_KTLS_TX;
+    setFlag(F_KTLS_TX, 1);
+    LS_DBG_L("[SSL: %p] kTLS TX enabled, cipher %s.", this, getCipherName());
+    return LS_OK;
+}
+
+
 int SslConnection::wpending()
 {
     return m_bio.m_wbuf_used - m_bio.m_wbuf_sent;
@@ -272,6 +321,7 @@ int SslConnection::shutdown(int bidirectional)
 {
     assert(m_ssl);
 
+    int ktls = isKtlsTx();
     m_flag = 0;
     if (m_iStatus == ACCEPTING)
     {
@@ -282,6 +332,13 @@ int SslConnection::shutdown(int bidirectional)
     if (m_iStatus != DISCONNECTED)
     {
         m_iWant = 0;
+        if (ktls)
+        {
+            // libssl no longer has the write keys.
+            SslKtls::sendCloseNotify(SSL_get_fd(m_ssl));
+            m_iStatus = DISCONNECTED;
+            return 0;
+        }
         setWriteBuffering(0);
         SSL_set_shutdown(m_ssl, SSL_RECEIVED_SHUTDOWN);
         //SSL_set_quiet_shutdown( m_ssl, !bidirectional );
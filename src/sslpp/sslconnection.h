@@ -53,6 +53,7 @@ public:
         F_ASYNC_PK          = 8,
         F_ASYNC_CERT_FAIL   = 16,
         F_HANDSHAKE_DONE    = 32,
+        F_KTLS_TX           = 64,
     };
 
     char wantRead() const   {   return m_iWant & WANT_READ;     }
@@ -91,6 +92,8 @@ public:
     bool isConnected()      {   return m_iStatus == CONNECTED;  }
     int tryagain();
     void setWriteBuffering(int buffering);
+    int  enableKtlsTx();
+    bool isKtlsTx() const   {   return m_flag & F_KTLS_TX;  }
 
     int asyncFetchCert(AsyncCertDoneCb cb, void *pParam);
     void cancelAsyncFetchCert(AsyncCertDoneCb cb, void *pParam);
@@ -161,6 +164,9 @@ private:
     static int32_t s_iConnIdx;
     ls_fdbio_data m_bio;
 
+    int ktlsWritev(const char *pBuf, int len, const struct iovec *vect,
+                   int count);
+
     LS_NO_COPY_ASSIGN(SslConnection);
 };
 
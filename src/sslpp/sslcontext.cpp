@@ -24,6 +24,7 @@
 #include <sslpp/sslcontextconfig.h>
 #include <sslpp/sslasyncpk.h>
 #include <sslpp/sslcertcomp.h>
+#include <sslpp/sslcertstore.h>
 
 #include <log4cxx/logger.h>
 #include <util/stringtool.h>
@@ -107,6 +108,48 @@ SslContext *SslContext::config(SslContext *pContext, const char *pZcDomainName,
     return pContext;
 }
 
+
+/**
+ * Build a new context from in-memory PEM data, pCert may carry the chain
+ * after the leaf certificate. Options are taken from pConfig.
+ */
+SslContext *SslContext::configPem(const char *pName,
+                                  const char *pKey, int iKeyLen,
+                                  const char *pCert, int iCertLen,
+                                  SslContextConfig *pConfig)
+{
+    SslContext *pNewContext = new SslContext(SslContext::SSL_ALL);
+    LS_DBG_L("[SSL] [CONFIG] Create SslContext (PEM) for %s: %p",
+             pName, pNewContext);
+    if (!pNewContext)
+        return NULL;
+    if (pNewContext->init())
+    {
+        delete pNewContext;
+        return NULL;
+    }
+    int keyLen = SslUtil::loadPrivateKey(pNewContext->m_pCtx, pKey, iKeyLen);
+    if ((keyLen <= 1)
+        || (SslUtil::loadCert(pNewContext->m_pCtx, pCert, iCertLen, 1) != 1)
+        || !pNewContext->checkPrivateKey())
+    {
+        LS_ERROR("[SSL] Config SSL Context for %s with key and certificate "
+                 "failed: %s", pName, SslError().what());
+        delete pNewContext;
+        return NULL;
+    }
+    pNewContext->m_iKeyLen = keyLen;
+    if (pNewContext->configOptions(pConfig) == LS_FAIL)
+    {
+        delete pNewContext;
+        return NULL;
+    }
+#ifdef SSLCERTCOMP
+    SslCertComp::enableCertComp(pNewContext->m_pCtx);
+#endif
+    return pNewContext;
+}
+
 int SslContext::loadCA(const char *pBundle)
 {
 
@@ -1225,7 +1268,29 @@ int SslContext::servername_cb(SSL *ssl, void *arg)
     len = SslUtil::getLcaseServerName(ssl, name, sizeof(name));
     if (len < 4)
         return SslUtil::CERTCB_RET_OK;
-    if (s_sniLookup)
+    SslCertStore &store = SslCertStore::getInstance();
+    if (store.isEnabled())
+    {
+        int wait;
+        SslContext *pStoreCtx = store.lookup(name, len, &wait);
+        // a configured vhost is served at once while the store looks the
+        // name up in the background.
+        if (wait && s_sniLookup
+            && (pCtx = (*s_sniLookup)(arg, name)) != NULL)
+            wait = 0;
+        SslConnection *conn = SslConnection::get(ssl);
+        if (conn && (void *)conn != (void *)(long)SslConnection::F_ECDSA_AVAIL
+            && !conn->getFlag(SslConnection::F_ASYNC_CERT_FAIL)
+            && conn->wantAsyncCtx(wait) == 1)
+        {
+            LS_DBG_H("SslContext::servername_cb() wait for cert store to "
+                     "load '%s'.", name);
+            return SslUtil::CERTCB_RET_WAIT;
+        }
+        if (pStoreCtx)
+            return pStoreCtx->applyToSsl(ssl);
+    }
+    if (!pCtx && s_sniLookup)
         pCtx = (*s_sniLookup)(arg, name);
     if (!pCtx)
     {
@@ -70,6 +70,11 @@ public:
     static SslContext *config(SslContext *pContext, const char *pZcDomainName,
         const char * pKey, const char * pCert, const char * pBundle);
 
+    static SslContext *configPem(const char *pName,
+                                 const char *pKey, int iKeyLen,
+                                 const char *pCert, int iCertLen,
+                                 SslContextConfig *pConfig);
+
     static SslContext *configMultiCerts(SslContext *pContext,
                                         SslContextConfig *pConfig);
     static SslContext *configOneCert(SslContext *pContext, const char * key_file,
@@ -0,0 +1,233 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "sslktls.h"
+
+#include <log4cxx/logger.h>
+
+#include <openssl/ssl.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#if defined(__linux__)
+#include <linux/tls.h>
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS     282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP     31
+#endif
+
+// Key extraction needs BoringSSL's key block accessors.
+#if defined(__linux__) && defined(TLS_TX) && defined(OPENSSL_IS_BORINGSSL)
+#define LS_KTLS_SUPPORT
+#endif
+
+
+int SslKtls::s_iEnabled = 0;
+
+
+void SslKtls::setEnabled(int enable)
+{
+#ifdef LS_KTLS_SUPPORT
+    s_iEnabled = enable;
+#else
+    if (enable)
+        LS_NOTICE("[SSL] Kernel TLS is not supported by this build, "
+                  "'sslKtls' ignored.");
+#endif
+}
+
+
+#ifdef LS_KTLS_SUPPORT
+
+union KtlsCryptoInfo
+{
+    struct tls_crypto_info                      info;
+    struct tls12_crypto_info_aes_gcm_128        gcm128;
+    struct tls12_crypto_info_aes_gcm_256        gcm256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305  chacha20;
+#endif
+};
+
+
+static void putSeq(unsigned char *pDest, uint64_t seq)
+{
+    for (int i = 7; i >= 0; --i)
+    {
+        pDest[i] = (unsigned char)seq;
+        seq >>= 8;
+    }
+}
+
+
+/**
+ * Fill key[keyLen] and iv[12] with the server write key and the fixed
+ * nonce part from the TLS 1.2 AEAD key block: client key, server key,
+ * client IV, server IV.
+ */
+static int getWriteKey(SSL *ssl, int nid, uint8_t *pKey, size_t keyLen,
+                       uint8_t *pIv, size_t ivLen)
+{
+    uint8_t block[2 * (32 + 12)];
+    size_t fixedIvLen = (nid == NID_chacha20_poly1305) ? 12 : 4;
+    size_t blockLen = SSL_get_key_block_len(ssl);
+    if (blockLen != 2 * (keyLen + fixedIvLen)
+        || !SSL_generate_key_block(ssl, block, blockLen))
+        return LS_FAIL;
+    memcpy(pKey, block + keyLen, keyLen);
+    memset(pIv, 0, ivLen);
+    memcpy(pIv, block + 2 * keyLen + fixedIvLen, fixedIvLen);
+    OPENSSL_cleanse(block, sizeof(block));
+    return LS_OK;
+}
+
+
+int SslKtls::enableTx(SSL *ssl, int fd)
+{
+    KtlsCryptoInfo ci;
+    uint8_t key[32];
+    uint8_t iv[12];
+    size_t keyLen;
+    socklen_t ciLen;
+    int version = SSL_version(ssl);
+    const SSL_CIPHER *pCipher = SSL_get_current_cipher(ssl);
+    int nid = pCipher ? SSL_CIPHER_get_cipher_nid(pCipher) : NID_undef;
+    uint64_t seq = SSL_get_write_sequence(ssl);
+
+    // No TLS 1.3, SSL_read() could not rekey the kernel on a KeyUpdate.
+    if (version != TLS1_2_VERSION)
+        return LS_FAIL;
+    switch (nid)
+    {
+    case NID_aes_128_gcm:
+        keyLen = 16;
+        break;
+    case NID_aes_256_gcm:
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+#endif
+        keyLen = 32;
+        break;
+    default:
+        return LS_FAIL;
+    }
+    if (getWriteKey(ssl, nid, key, keyLen, iv, sizeof(iv)) != LS_OK)
+        return LS_FAIL;
+
+    memset(&ci, 0, sizeof(ci));
+    ci.info.version = TLS_1_2_VERSION;
+    switch (nid)
+    {
+    case NID_aes_128_gcm:
+        ci.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(ci.gcm128.key, key, keyLen);
+        memcpy(ci.gcm128.salt, iv, 4);
+        // TLS 1.2 GCM uses the record sequence as explicit nonce.
+        putSeq(ci.gcm128.iv, seq);
+        putSeq(ci.gcm128.rec_seq, seq);
+        ciLen = sizeof(ci.gcm128);
+        break;
+    case NID_aes_256_gcm:
+        ci.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy(ci.gcm256.key, key, keyLen);
+        memcpy(ci.gcm256.salt, iv, 4);
+        putSeq(ci.gcm256.iv, seq);
+        putSeq(ci.gcm256.rec_seq, seq);
+        ciLen = sizeof(ci.gcm256);
+        break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    default:
+        ci.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        memcpy(ci.chacha20.key, key, keyLen);
+        memcpy(ci.chacha20.iv, iv, 12);
+        putSeq(ci.chacha20.rec_seq, seq);
+        ciLen = sizeof(ci.chacha20);
+        break;
+#endif
+    }
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(iv, sizeof(iv));
+
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == -1)
+    {
+        LS_DBG_L("[SSL] fd %d: TCP_ULP tls not available: %s", fd,
+                 strerror(errno));
+        OPENSSL_cleanse(&ci, sizeof(ci));
+        return LS_FAIL;
+    }
+    int ret = setsockopt(fd, SOL_TLS, TLS_TX, &ci, ciLen);
+    OPENSSL_cleanse(&ci, sizeof(ci));
+    if (ret == -1)
+    {
+        // The ULP stays attached but without keys it passes data through
+        // untouched, so userspace TLS keeps working.
+        LS_DBG_L("[SSL] fd %d: TLS_TX rejected cipher %d: %s", fd, nid,
+                 strerror(errno));
+        return LS_FAIL;
+    }
+    return LS_OK;
+}
+
+
+int SslKtls::sendCloseNotify(int fd)
+{
+    static const unsigned char alert[2] = { 1, 0 };    // warning, close_notify
+    char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    iov.iov_base = (void *)alert;
+    iov.iov_len = sizeof(alert);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(cmsg) = 21;                              // alert
+    return (sendmsg(fd, &msg, MSG_DONTWAIT) == sizeof(alert)) ? LS_OK
+                                                              : LS_FAIL;
+}
+
+#else
+
+int SslKtls::enableTx(SSL *ssl, int fd)
+{
+    return LS_FAIL;
+}
+
+
+int SslKtls::sendCloseNotify(int fd)
+{
+    return LS_FAIL;
+}
+
+#endif // LS_KTLS_SUPPORT
+
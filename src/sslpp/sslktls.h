@@ -0,0 +1,54 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifndef SSLKTLS_H
+#define SSLKTLS_H
+
+#include <sslpp/ssldef.h>
+
+/**
+ * Hands TLS record encryption for the send side of an established
+ * connection to the kernel (Linux kTLS), so plain write(), writev() and
+ * sendfile() produce TLS records.  Receiving stays in userspace.
+ */
+class SslKtls
+{
+    static int s_iEnabled;
+
+    SslKtls();
+    ~SslKtls();
+    SslKtls(const SslKtls &rhs);
+    void operator=(const SslKtls &rhs);
+public:
+    static void setEnabled(int enable);
+    static int  isEnabled()         {   return s_iEnabled;  }
+
+    /**
+     * Install the current write keys and sequence number on fd, TLS 1.2
+     * only, as a TLS 1.3 KeyUpdate cannot be answered once the kernel
+     * owns the send side.
+     * Returns LS_OK, or LS_FAIL if the TLS library, protocol version,
+     * cipher or kernel does not support it; the connection is untouched
+     * in that case and keeps using SSL_write().
+     */
+    static int enableTx(SSL *ssl, int fd);
+
+    // Send a close_notify alert through the kernel record layer.
+    static int sendCloseNotify(int fd);
+};
+
+#endif // SSLKTLS_H
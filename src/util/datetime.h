@@ -19,6 +19,7 @@
 #define DATETIME_H
 
 
+#include <stdint.h>
 #include <time.h>
 #include <lsr/ls_atomic.h>
 
@@ -39,6 +40,9 @@ public:
     {   return ls_atomic_value(&s_curTime);      }
     static inline int getCurTimeUs()
     {   return ls_atomic_value(&s_curTimeUs);     }
+    // cached time in microseconds since the epoch
+    static inline int64_t getCurTimeInUs()
+    {   return (int64_t)s_curTime * 1000000 + s_curTimeUs;  }
 
 };
 
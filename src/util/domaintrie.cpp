@@ -0,0 +1,159 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#include "domaintrie.h"
+
+#include <lsr/xxhash.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct DomainTrie::Node
+{
+    const Node *m_pParent;
+    void       *m_pValue;
+    int         m_iLabelLen;
+    const char *m_pLabel;
+};
+
+
+static inline const char *lastDot(const char *pBegin, const char *pEnd)
+{
+    while (--pEnd >= pBegin)
+        if (*pEnd == '.')
+            return pEnd;
+    return NULL;
+}
+
+
+static hash_key_t hashEdge(const void *pKey)
+{
+    const DomainTrie::Node *pNode = (const DomainTrie::Node *)pKey;
+    return XXH64(pNode->m_pLabel, pNode->m_iLabelLen,
+                 (unsigned long long)(uintptr_t)pNode->m_pParent);
+}
+
+
+static int cmpEdge(const void *pKey1, const void *pKey2)
+{
+    const DomainTrie::Node *p1 = (const DomainTrie::Node *)pKey1;
+    const DomainTrie::Node *p2 = (const DomainTrie::Node *)pKey2;
+    if ((p1->m_pParent != p2->m_pParent)
+        || (p1->m_iLabelLen != p2->m_iLabelLen))
+        return 1;
+    return memcmp(p1->m_pLabel, p2->m_pLabel, p1->m_iLabelLen);
+}
+
+
+DomainTrie::DomainTrie()
+    : m_edges(64, hashEdge, cmpEdge)
+    , m_pRoot(NULL)
+    , m_iValues(0)
+{
+    m_pRoot = (Node *)calloc(1, sizeof(Node));
+}
+
+
+DomainTrie::~DomainTrie()
+{
+    clear();
+    free(m_pRoot);
+}
+
+
+void DomainTrie::clear()
+{
+    GHash::iterator iter;
+    for (iter = m_edges.begin(); iter != m_edges.end();
+         iter = m_edges.next(iter))
+        free(iter->second());
+    m_edges.clear();
+    m_iValues = 0;
+}
+
+
+const DomainTrie::Node *DomainTrie::getChild(const Node *pParent,
+        const char *pLabel, int len) const
+{
+    Node key;
+    key.m_pParent = pParent;
+    key.m_pLabel = pLabel;
+    key.m_iLabelLen = len;
+    GHash::const_iterator iter = m_edges.find(&key);
+    if (iter == m_edges.end())
+        return NULL;
+    return (const Node *)iter->second();
+}
+
+
+void *DomainTrie::add(const char *pSuffix, int len, void *pValue)
+{
+    const char *pEnd = pSuffix + len;
+    const char *pLabel;
+    Node *pNode = m_pRoot;
+    if (!m_pRoot || (len <= 0))
+        return pValue;
+    while (pEnd > pSuffix)
+    {
+        pLabel = lastDot(pSuffix, pEnd);
+        pLabel = pLabel ? pLabel + 1 : pSuffix;
+        Node *pChild = (Node *)getChild(pNode, pLabel, pEnd - pLabel);
+        if (!pChild)
+        {
+            pChild = (Node *)malloc(sizeof(Node) + (pEnd - pLabel));
+            if (!pChild)
+                return pValue;
+            pChild->m_pParent = pNode;
+            pChild->m_pValue = NULL;
+            pChild->m_iLabelLen = pEnd - pLabel;
+            pChild->m_pLabel = (char *)(pChild + 1);
+            memmove((char *)(pChild + 1), pLabel, pEnd - pLabel);
+            m_edges.insert(pChild, pChild);
+        }
+        pNode = pChild;
+        pEnd = pLabel - 1;
+    }
+    if (pNode->m_pValue)
+        return pNode->m_pValue;
+    pNode->m_pValue = pValue;
+    ++m_iValues;
+    return NULL;
+}
+
+
+void *DomainTrie::match(const char *pHost, int len) const
+{
+    const char *pEnd = pHost + len;
+    const char *pDot;
+    const Node *pNode = m_pRoot;
+    void *pBest = NULL;
+    while (pEnd > pHost)
+    {
+        pDot = lastDot(pHost, pEnd);
+        if (!pDot)
+            break;  //the left most label is the '*' part
+        pNode = getChild(pNode, pDot + 1, pEnd - pDot - 1);
+        if (!pNode)
+            break;
+        if (pNode->m_pValue)
+            pBest = pNode->m_pValue;
+        pEnd = pDot;
+    }
+    return pBest;
+}
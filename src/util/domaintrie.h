@@ -0,0 +1,65 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+
+#ifndef DOMAINTRIE_H
+#define DOMAINTRIE_H
+
+
+#include <lsdef.h>
+#include <util/ghash.h>
+
+/**
+ * Trie over reversed DNS labels, "www.example.com" is stored as
+ * com -> example -> www. All edges live in one hash keyed by
+ * (parent node, label), so a lookup costs one probe per label and stops
+ * at the first label nobody registered.
+ */
+class DomainTrie
+{
+public:
+    struct Node;
+
+    DomainTrie();
+    ~DomainTrie();
+
+    /**
+     * Registers pValue for every host ending with ".<pSuffix>". An existing
+     * value for the same suffix is kept and returned, NULL on success.
+     */
+    void *add(const char *pSuffix, int len, void *pValue);
+
+    /**
+     * Longest registered suffix of pHost, NULL if none.
+     */
+    void *match(const char *pHost, int len) const;
+
+    void clear();
+    int  size() const   {   return m_iValues;   }
+
+private:
+    GHash       m_edges;
+    Node       *m_pRoot;
+    int         m_iValues;
+
+    const Node *getChild(const Node *pParent, const char *pLabel,
+                         int len) const;
+
+    LS_NO_COPY_ASSIGN(DomainTrie);
+};
+
+#endif
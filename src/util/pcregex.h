@@ -24,8 +24,6 @@
 #include <pcre.h>
 #include <pcreposix.h>
 
-//#define _USE_PCRE_JIT_
-
 
 class RegexResult : private ls_pcreres_t
 {
@@ -60,13 +58,6 @@ public:
     ~Pcregex()
     {   ls_pcre_d(this); }
 
-#ifdef _USE_PCRE_JIT_
-#if !defined(__sparc__) && !defined(__sparc64__)
-    static void initJitStack();
-    static pcre_jit_stack *getJitStack();
-    static void releaseJitStack(void *pValue);
-#endif
-#endif
     int  compile(const char *regex, int options, int matchLimit = 0,
                  int recursionLimit = 0)
     {
@@ -76,12 +67,6 @@ public:
     int  exec(const char *subject, int length, int startoffset,
               int options, int *ovector, int ovecsize) const
     {
-#ifdef _USE_PCRE_JIT_
-#if !defined(__sparc__) && !defined(__sparc64__)
-        pcre_jit_stack *stack = getJitStack();
-        pcre_assign_jit_stack(m_extra, NULL, stack);
-#endif
-#endif
         return pcre_exec(regex, extra, subject, length, startoffset,
                          options, ovector, ovecsize);
     }
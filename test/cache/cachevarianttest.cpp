@@ -0,0 +1,268 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <modules/cache/cachevariant.h>
+#include <modules/cache/dirhashcacheentry.h>
+
+#include <ls.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "unittest-cpp/UnitTest++.h"
+
+
+static void initEntry(DirHashCacheEntry *pEntry, int type, off_t bodyLen)
+{
+    CeHeader &header = pEntry->getHeader();
+    header.m_tmCreated = 1600000000;
+    header.m_msCreated = 123;
+    header.m_valPart2Len = bodyLen;
+    pEntry->markReady(type);
+}
+
+
+static void initVarHeader(CacheVariantHeader *pHeader, CacheEntry *pEntry)
+{
+    const CeHeader &header = pEntry->getHeader();
+    pHeader->m_iMagic = CE_VARIANT_ID;
+    pHeader->m_tmCreated = header.m_tmCreated;
+    pHeader->m_msCreated = header.m_msCreated;
+    pHeader->m_iSrcLen = header.m_valPart2Len;
+}
+
+
+static void writeVariant(const char *pPath, const CacheVariantHeader *pHeader,
+                         const char *pBody, int len)
+{
+    FILE *fp = fopen(pPath, "w");
+    CHECK(fp != NULL);
+    if (!fp)
+        return;
+    CHECK(fwrite(pHeader, 1, sizeof(*pHeader), fp) == sizeof(*pHeader));
+    CHECK(fwrite(pBody, 1, len, fp) == (size_t)len);
+    fclose(fp);
+}
+
+
+static void initTask(CacheVariantTask *pTask, CacheEntry *pEntry,
+                     const char *pPath, int fdSrc, int srcType, int type,
+                     off_t offset, off_t len)
+{
+    pTask->m_pEntry = pEntry;
+    pTask->m_path.setStr(pPath);
+    pTask->m_fdSrc = fdSrc;
+    pTask->m_iSrcType = srcType;
+    pTask->m_iType = type;
+    pTask->m_lOffset = offset;
+    pTask->m_lLength = len;
+    initVarHeader(&pTask->m_varHeader, pEntry);
+    pTask->m_lResult = LS_FAIL;
+}
+
+
+static int fileExists(const char *pPath)
+{
+    struct stat st;
+    return (stat(pPath, &st) == 0);
+}
+
+
+SUITE(CacheVariant)
+{
+    TEST(Select)
+    {
+        char achDir[] = "/tmp/cachevarXXXXXX";
+        char achEntry[256], achPath[256];
+        char achBody[1024];
+        CacheVariantHeader varHeader;
+        const int gzip = 1 << LSI_GZIP_COMPRESS;
+        const int br = 1 << LSI_BR_COMPRESS;
+        const int id = 1 << LSI_NO_COMPRESS;
+
+        CHECK(mkdtemp(achDir) != NULL);
+        snprintf(achEntry, sizeof(achEntry), "%s/entry", achDir);
+        memset(achBody, 'v', sizeof(achBody));
+
+        DirHashCacheEntry entry;
+        initEntry(&entry, LSI_GZIP_COMPRESS, 4096);
+        initVarHeader(&varHeader, &entry);
+
+        // nothing built yet, the stored body is served
+        CHECK(CacheVariant::select(&entry, achEntry, br | gzip, 4096)
+              == LSI_GZIP_COMPRESS);
+        CHECK(CacheVariant::select(&entry, achEntry, id, 4096)
+              == LSI_GZIP_COMPRESS);
+
+        snprintf(achPath, sizeof(achPath), "%s.br", achEntry);
+        writeVariant(achPath, &varHeader, achBody, 100);
+        CHECK(CacheVariant::select(&entry, achEntry, br | gzip | id, 4096)
+              == LSI_BR_COMPRESS);
+        CHECK(entry.getVariantFd(LSI_BR_COMPRESS) != -1);
+        CHECK(entry.getVariantLen(LSI_BR_COMPRESS) == 100);
+
+        // the stored body wins when it is preferred over a ready variant
+        CHECK(CacheVariant::select(&entry, achEntry, gzip, 4096)
+              == LSI_GZIP_COMPRESS);
+
+        // a variant left by an older copy of the entry is ignored
+        snprintf(achPath, sizeof(achPath), "%s.id", achEntry);
+        varHeader.m_tmCreated -= 10;
+        writeVariant(achPath, &varHeader, achBody, sizeof(achBody));
+        CHECK(CacheVariant::select(&entry, achEntry, id, 4096)
+              == LSI_GZIP_COMPRESS);
+        CHECK(entry.getVariantFd(LSI_NO_COMPRESS) == -1);
+
+        // small bodies never get a variant
+        CHECK(CacheVariant::select(&entry, achEntry, br,
+                                   CE_VARIANT_MIN_SIZE - 1)
+              == LSI_GZIP_COMPRESS);
+
+        DirHashCacheEntry plain;
+        initEntry(&plain, LSI_NO_COMPRESS, 4096);
+        CHECK(CacheVariant::select(&plain, achEntry, br | gzip, 4096)
+              == LSI_NO_COMPRESS);
+
+        entry.closeVariants();
+        CacheVariant::removeFiles(achEntry);
+        CHECK(!fileExists(achPath));
+        rmdir(achDir);
+    }
+
+
+    TEST(Build)
+    {
+        char achDir[] = "/tmp/cachevarXXXXXX";
+        char achSrc[256], achEntry[256], achGz[256], achId[256];
+        char achBody[8192], achOut[sizeof(achBody)];
+        CacheVariantTask task;
+        struct stat st;
+        int i;
+
+        CHECK(mkdtemp(achDir) != NULL);
+        snprintf(achSrc, sizeof(achSrc), "%s/src", achDir);
+        snprintf(achEntry, sizeof(achEntry), "%s/entry", achDir);
+        snprintf(achGz, sizeof(achGz), "%s.gz", achEntry);
+        snprintf(achId, sizeof(achId), "%s.id", achEntry);
+        for (i = 0; i < (int)sizeof(achBody); ++i)
+            achBody[i] = 'a' + (i % 7) * (i % 5);
+
+        DirHashCacheEntry entry;
+        initEntry(&entry, LSI_NO_COMPRESS, sizeof(achBody));
+
+        // the stored body sits behind some header bytes in the entry file
+        int fd = open(achSrc, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        CHECK(fd != -1);
+        CHECK(write(fd, "headers", 7) == 7);
+        CHECK(write(fd, achBody, sizeof(achBody)) == (ssize_t)sizeof(achBody));
+
+        initTask(&task, &entry, achGz, fd, LSI_NO_COMPRESS, LSI_GZIP_COMPRESS,
+                 7, sizeof(achBody));
+        off_t gzLen = CacheVariant::buildFile(&task);
+        CHECK(gzLen > 0 && gzLen < (off_t)sizeof(achBody));
+        CHECK(stat(achGz, &st) == 0);
+        CHECK(st.st_size == gzLen + CacheVariant::getBodyOffset());
+        close(fd);
+
+        // decode the gzip variant back to identity and compare
+        fd = open(achGz, O_RDONLY);
+        CHECK(fd != -1);
+        initTask(&task, &entry, achId, fd, LSI_GZIP_COMPRESS, LSI_NO_COMPRESS,
+                 CacheVariant::getBodyOffset(), gzLen);
+        CHECK(CacheVariant::buildFile(&task) == (off_t)sizeof(achBody));
+        close(fd);
+
+        CacheVariantHeader varHeader;
+        fd = open(achId, O_RDONLY);
+        CHECK(fd != -1);
+        CHECK(read(fd, &varHeader, sizeof(varHeader))
+              == (ssize_t)sizeof(varHeader));
+        CHECK(memcmp(&varHeader, &task.m_varHeader, sizeof(varHeader)) == 0);
+        CHECK(read(fd, achOut, sizeof(achOut)) == (ssize_t)sizeof(achOut));
+        CHECK(memcmp(achOut, achBody, sizeof(achBody)) == 0);
+        close(fd);
+
+        // a truncated source fails and leaves no file behind
+        unlink(achId);
+        fd = open(achGz, O_RDONLY);
+        initTask(&task, &entry, achId, fd, LSI_GZIP_COMPRESS, LSI_NO_COMPRESS,
+                 CacheVariant::getBodyOffset(), gzLen + 100);
+        CHECK(CacheVariant::buildFile(&task) == LS_FAIL);
+        CHECK(!fileExists(achId));
+        close(fd);
+
+        unlink(achSrc);
+        CacheVariant::removeFiles(achEntry);
+        rmdir(achDir);
+    }
+
+
+    TEST(Discard)
+    {
+        char achDir[] = "/tmp/cachevarXXXXXX";
+        char achPath[256];
+        char achBody[300];
+        CacheVariantTask task;
+
+        CHECK(mkdtemp(achDir) != NULL);
+        snprintf(achPath, sizeof(achPath), "%s/entry.br", achDir);
+        memset(achBody, 'd', sizeof(achBody));
+
+        DirHashCacheEntry entry;
+        initEntry(&entry, LSI_GZIP_COMPRESS, 4096);
+
+        // a build for a current entry is kept
+        initTask(&task, &entry, achPath, -1, LSI_GZIP_COMPRESS,
+                 LSI_BR_COMPRESS, 0, 4096);
+        writeVariant(achPath, &task.m_varHeader, achBody, sizeof(achBody));
+        task.m_lResult = sizeof(achBody);
+        CacheVariant::finishBuild(&task);
+        CHECK(fileExists(achPath));
+
+        // the entry was replaced by a newer copy during the build
+        entry.getHeader().m_tmCreated += 5;
+        CacheVariant::finishBuild(&task);
+        CHECK(!fileExists(achPath));
+
+        // purged, but a variant of the newer copy is there already
+        entry.getHeader().m_tmCreated -= 5;
+        entry.setDirty();
+        CacheVariantHeader newer = task.m_varHeader;
+        newer.m_tmCreated += 5;
+        writeVariant(achPath, &newer, achBody, sizeof(achBody));
+        CacheVariant::finishBuild(&task);
+        CHECK(fileExists(achPath));
+
+        writeVariant(achPath, &task.m_varHeader, achBody, sizeof(achBody));
+        CacheVariant::finishBuild(&task);
+        CHECK(!fileExists(achPath));
+
+        // a failed build is not tried again
+        task.m_lResult = LS_FAIL;
+        CacheVariant::finishBuild(&task);
+        CHECK(entry.isVariantFailed(LSI_BR_COMPRESS));
+
+        rmdir(achDir);
+    }
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <edio/timerwheel.h>
+
+#include <stdio.h>
+#include "unittest-cpp/UnitTest++.h"
+
+
+struct TwItem
+{
+    TimerWheelNode  m_node;
+    int             m_iFired;
+
+    TwItem() : m_node(this), m_iFired(0)   {}
+};
+
+
+SUITE(TimerWheelTest)
+{
+    TEST(testExpireOrder)
+    {
+        static const uint32_t s_delays[] =
+        {   1, 2, 63, 64, 65, 100, 4095, 4096, 4097, 70000, 300000  };
+        const int n = sizeof(s_delays) / sizeof(s_delays[0]);
+        TimerWheel wheel;
+        TwItem items[n];
+        TimerWheelNode due;
+        TimerWheelNode *pNode;
+        int i;
+
+        // Start off a slot boundary so cascades happen mid-run.
+        for (i = 0; i < 37; ++i)
+        {
+            TimerWheel::initList(&due);
+            wheel.advance(&due);
+            CHECK(TimerWheel::popFront(&due) == NULL);
+        }
+        for (i = 0; i < n; ++i)
+        {
+            wheel.add(&items[i].m_node, s_delays[i]);
+            CHECK(items[i].m_node.isArmed());
+        }
+        wheel.add(&items[1].m_node, 3);     // re-arm replaces
+        items[2].m_node.unlink();           // cancel
+
+        for (uint32_t tick = 1; tick <= 300000; ++tick)
+        {
+            TimerWheel::initList(&due);
+            wheel.advance(&due);
+            while ((pNode = TimerWheel::popFront(&due)) != NULL)
+                ((TwItem *)pNode->getObj())->m_iFired = tick;
+        }
+        for (i = 0; i < n; ++i)
+        {
+            if (i == 1)
+                CHECK(items[i].m_iFired == 3);
+            else if (i == 2)
+                CHECK(items[i].m_iFired == 0);
+            else
+                CHECK(items[i].m_iFired == (int)s_delays[i]);
+            CHECK(!items[i].m_node.isArmed());
+        }
+    }
+}
+
+#endif
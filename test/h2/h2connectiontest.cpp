@@ -0,0 +1,156 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <h2/h2connection.h>
+#include <h2/h2stream.h>
+#include <http/httprespheaders.h>
+
+#include <stdio.h>
+#include <string.h>
+#include "unittest-cpp/UnitTest++.h"
+
+
+/**
+ * Decodes a header block as a client would, into "name: value\n" lines.
+ */
+static int decodeBlock(struct lshpack_dec *pDec, const unsigned char *pSrc,
+                       int len, char *pOut, int outLen)
+{
+    const unsigned char *pEnd = pSrc + len;
+    char achBuf[1024];
+    lsxpack_header_t hdr;
+    int n = 0;
+
+    while (pSrc < pEnd)
+    {
+        lsxpack_header_prepare_decode(&hdr, achBuf, 0, sizeof(achBuf));
+        if (lshpack_dec_decode(pDec, &pSrc, pEnd, &hdr) < 0)
+            return LS_FAIL;
+        n += snprintf(pOut + n, outLen - n, "%.*s: %.*s\n",
+                      (int)hdr.name_len, lsxpack_header_get_name(&hdr),
+                      (int)hdr.val_len, lsxpack_header_get_value(&hdr));
+        if (n >= outLen)
+            return LS_FAIL;
+    }
+    return n;
+}
+
+
+static void buildResp(HttpRespHeaders *pHeaders, const char *pEtag,
+                      const char *pCustom)
+{
+    pHeaders->reset();
+    pHeaders->add(HttpRespHeaders::H_SERVER, "LiteSpeed", 9);
+    pHeaders->add(HttpRespHeaders::H_CONTENT_TYPE, "text/html", 9);
+    pHeaders->add(HttpRespHeaders::H_VARY, "Accept-Encoding", 15);
+    if (pCustom)
+        pHeaders->add("x-custom", 8, pCustom, strlen(pCustom));
+    if (pEtag)
+        pHeaders->add(HttpRespHeaders::H_ETAG, pEtag, strlen(pEtag));
+}
+
+
+static void buildExpected(char *pOut, int outLen, const char *pEtag,
+                          const char *pCustom)
+{
+    int n = snprintf(pOut, outLen, ":status: 200\nserver: LiteSpeed\n"
+                     "content-type: text/html\nvary: Accept-Encoding\n");
+    if (pCustom)
+        n += snprintf(pOut + n, outLen - n, "x-custom: %s\n", pCustom);
+    if (pEtag)
+        snprintf(pOut + n, outLen - n, "etag: %s\n", pEtag);
+}
+
+
+static const H2HdrTemplate *findTemplate(const H2HdrTemplate *pTmpl,
+                                         uint32_t gen)
+{
+    for (int i = 0; i < H2_HDR_TMPL_SLOTS; ++i)
+    {
+        if (pTmpl[i].m_iLen > 0 && pTmpl[i].m_uiEncGen == gen)
+            return &pTmpl[i];
+    }
+    return NULL;
+}
+
+
+SUITE(H2Connection)
+{
+    TEST(HpackTemplate)
+    {
+        // each set is sent a few times in a row, so the encoder history
+        // gets its headers into the dynamic table
+        static const struct
+        {
+            const char *m_pEtag;
+            const char *m_pCustom;
+            int         m_iRepeat;
+        } s_resps[] =
+        {
+            {   NULL,       NULL,   4   },
+            {   "\"v1\"",   NULL,   3   },
+            {   NULL,       NULL,   3   },
+            {   NULL,       "1",    3   },
+            {   NULL,       NULL,   2   },
+            {   "\"v2\"",   NULL,   3   },
+            {   NULL,       NULL,   2   },
+        };
+        H2Connection conn;
+        H2Stream stream;
+        HttpRespHeaders headers;
+        struct lshpack_dec dec;
+        unsigned char achBlock[4096];
+        char achDecoded[4096], achExpected[4096];
+        int len;
+        uint32_t gen;
+
+        CHECK(conn.m_uiHpackEncGen == 0);
+        lshpack_dec_init(&dec);
+        for (unsigned i = 0; i < sizeof(s_resps) / sizeof(s_resps[0]); ++i)
+        {
+            gen = conn.m_uiHpackEncGen;
+            buildExpected(achExpected, sizeof(achExpected),
+                          s_resps[i].m_pEtag, s_resps[i].m_pCustom);
+            for (int j = 0; j < s_resps[i].m_iRepeat; ++j)
+            {
+                buildResp(&headers, s_resps[i].m_pEtag, s_resps[i].m_pCustom);
+                len = conn.encodeRespHeaders(&stream, &headers, achBlock,
+                                             sizeof(achBlock));
+                CHECK(len > 0);
+                CHECK(decodeBlock(&dec, achBlock, len, achDecoded,
+                                  sizeof(achDecoded)) > 0);
+                CHECK(strcasecmp(achDecoded, achExpected) == 0);
+            }
+            if (s_resps[i].m_pEtag || s_resps[i].m_pCustom)
+            {
+                // the dynamic table changed after the block was stored
+                CHECK(conn.m_uiHpackEncGen != gen);
+            }
+            else
+            {
+                // the block is stored, and replayed from now on
+                CHECK(findTemplate(conn.m_hdrTmpl, conn.m_uiHpackEncGen)
+                      != NULL);
+            }
+        }
+        lshpack_dec_cleanup(&dec);
+    }
+}
+
+#endif
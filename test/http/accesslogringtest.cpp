@@ -0,0 +1,117 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <http/accesslog.h>
+#include <http/accesslogring.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "unittest-cpp/UnitTest++.h"
+
+
+SUITE(AccessLogRingTest)
+{
+    TEST(testAppend)
+    {
+        char achBuf[ALR_SLOT_SIZE];
+        char achLong[ALR_SLOT_SIZE];
+        AccessLogRec *pRec = (AccessLogRec *)achBuf;
+        memset(achLong, 'a', sizeof(achLong));
+
+        pRec->init(1, ALR_COMBINED);
+        CHECK(pRec->append(ALR_ADDR, "127.0.0.1", 9) == LS_OK);
+        CHECK(pRec->m_iStrLen[ALR_ADDR] == 9);
+        CHECK(memcmp(pRec->getStr(ALR_ADDR), "127.0.0.1", 9) == 0);
+
+        // A field that does not fit fails unless truncation is asked for.
+        CHECK(pRec->append(ALR_REQLINE, achLong, sizeof(achLong)) == LS_FAIL);
+        CHECK(pRec->m_iStrLen[ALR_REQLINE] == 0);
+        CHECK(!(pRec->m_iFlags & ALR_TRUNCATED));
+        CHECK(pRec->append(ALR_REQLINE, achLong, sizeof(achLong), 1)
+              == LS_OK);
+        CHECK(pRec->m_iFlags & ALR_TRUNCATED);
+        CHECK(pRec->m_iLen == ALR_MAX_REC_LEN);
+
+        AccessLogRing &ring = AccessLogRing::getInstance();
+        CHECK(ring.pushText(1, achLong, ALR_MAX_REC_LEN) == LS_FAIL);
+    }
+
+
+    TEST(testFull)
+    {
+        char achBuf[ALR_SLOT_SIZE];
+        AccessLogRec *pRec = (AccessLogRec *)achBuf;
+        AccessLogRing &ring = AccessLogRing::getInstance();
+        ring.setSize(ALR_MIN_SLOTS * ALR_SLOT_SIZE);
+        CHECK(ring.init() == LS_OK);
+        CHECK(ring.isEnabled());
+
+        pRec->init(-1, ALR_COMBINED);
+        CHECK(pRec->append(ALR_ADDR, "::1", 3) == LS_OK);
+        for (int i = 0; i < ALR_MIN_SLOTS; ++i)
+            CHECK(ring.push(pRec) == LS_OK);
+        CHECK(ring.push(pRec) == LS_FAIL);
+
+        // Records of unknown logs are dropped, which frees the slots.
+        ring.consume(0);
+        CHECK(ring.push(pRec) == LS_OK);
+        ring.consume(0);
+        ring.release();
+        CHECK(!ring.isEnabled());
+    }
+
+
+    TEST(testConsume)
+    {
+        char achDir[] = "/tmp/alrtestXXXXXX";
+        char achPath[256];
+        char achLine[256];
+        const char *pLine = "alr text line\n";
+        AccessLogRing &ring = AccessLogRing::getInstance();
+
+        CHECK(mkdtemp(achDir) != NULL);
+        snprintf(achPath, sizeof(achPath), "%s/access.log", achDir);
+        ring.setSize(ALR_MIN_SLOTS * ALR_SLOT_SIZE);
+        CHECK(ring.init() == LS_OK);
+        {
+            AccessLog log;
+            CHECK(log.init(achPath, 0) == 0);
+            CHECK(log.getId() >= 0);
+            CHECK(AccessLog::getLog(log.getId()) == &log);
+            CHECK(ring.pushText(log.getId(), pLine, strlen(pLine)) == LS_OK);
+            ring.consume(0);
+        }
+
+        FILE *fp = fopen(achPath, "r");
+        CHECK(fp != NULL);
+        if (fp)
+        {
+            CHECK(fgets(achLine, sizeof(achLine), fp) != NULL);
+            CHECK(strcmp(achLine, pLine) == 0);
+            fclose(fp);
+        }
+        unlink(achPath);
+        rmdir(achDir);
+        ring.release();
+    }
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <http/htaccesscache.h>
+#include <http/httpcontext.h>
+#include <http/httpvhost.h>
+#include <http/rewriterule.h>
+#include <http/rewriterulelist.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "unittest-cpp/UnitTest++.h"
+
+
+static void writeHta(const char *pPath, const char *pRules)
+{
+    FILE *fp = fopen(pPath, "w");
+    CHECK(fp != NULL);
+    if (!fp)
+        return;
+    fputs(pRules, fp);
+    fclose(fp);
+}
+
+
+static int countRules(const HttpContext *pContext)
+{
+    int n = 0;
+    if (!pContext->getRewriteRules())
+        return -1;
+    for (RewriteRule *p = pContext->getRewriteRules()->begin(); p;
+         p = (RewriteRule *)p->next())
+        ++n;
+    return n;
+}
+
+
+SUITE(HtAccessCache)
+{
+    TEST(Reload)
+    {
+        char achDir[] = "/tmp/htacacheXXXXXX";
+        char achDir1[256], achDir2[256], achHta1[256], achHta2[256];
+        const char *pRules = "RewriteEngine On\n"
+                             "RewriteBase /base/\n"
+                             "RewriteRule ^a$ /b [L]\n";
+        HtAccessCache &cache = HtAccessCache::getInstance();
+        HttpVHost vhost("htacache.test");
+        HttpContext parent, ctx1, ctx2;
+
+        CHECK(mkdtemp(achDir) != NULL);
+        snprintf(achDir1, sizeof(achDir1), "%s/one/", achDir);
+        snprintf(achDir2, sizeof(achDir2), "%s/two/", achDir);
+        snprintf(achHta1, sizeof(achHta1), "%s.htaccess", achDir1);
+        snprintf(achHta2, sizeof(achHta2), "%s.htaccess", achDir2);
+        mkdir(achDir1, 0755);
+        mkdir(achDir2, 0755);
+        parent.enableRewrite(0);
+        ctx1.set("/one/", achDir1, NULL);
+        ctx2.set("/two/", achDir2, NULL);
+        ctx1.setParent(&parent);
+        ctx2.setParent(&parent);
+        int entries = cache.getEntryCount();
+
+        // no file
+        CHECK(cache.attach(&vhost, &ctx1, achHta1) == 0);
+        CHECK(ctx1.getRewriteRules() == NULL);
+
+        // the same content is parsed once and shared
+        writeHta(achHta1, pRules);
+        writeHta(achHta2, pRules);
+        CHECK(cache.attach(&vhost, &ctx1, achHta1) == 1);
+        CHECK(cache.attach(&vhost, &ctx2, achHta2) == 1);
+        CHECK(countRules(&ctx1) == 1);
+        CHECK(ctx1.getRewriteRules() == ctx2.getRewriteRules());
+        CHECK(cache.getEntryCount() == entries + 1);
+        CHECK(ctx1.rewriteEnabled() == REWRITE_ON);
+        CHECK(strcmp(ctx1.getRewriteBase()->c_str(), "/base/") == 0);
+
+        // RewriteEngine and RewriteBase go away with the directives
+        writeHta(achHta1, "RewriteRule ^c$ /d [L]\nRewriteRule ^e$ /f [L]\n");
+        cache.recheckAll();
+        CHECK(countRules(&ctx1) == 2);
+        CHECK(countRules(&ctx2) == 1);
+        CHECK(cache.getEntryCount() == entries + 2);
+        CHECK(!(ctx1.getConfigBits() & BIT_REWRITE_ENGINE));
+        CHECK(ctx1.rewriteEnabled() != REWRITE_ON);
+        CHECK(!ctx1.hasRewriteBase());
+        CHECK(ctx2.rewriteEnabled() == REWRITE_ON);
+
+        // attaching again rereads the file
+        CHECK(cache.attach(&vhost, &ctx2, achHta2) == 1);
+        CHECK(countRules(&ctx2) == 1);
+        CHECK(ctx2.rewriteEnabled() == REWRITE_ON);
+
+        // a bad rule ends the list there, like the uncached parser does
+        writeHta(achHta1, "RewriteRule ^g$ /h [L]\nRewriteRule\n");
+        cache.recheckAll();
+        CHECK(countRules(&ctx1) == 1);
+
+        // nothing watches the files here, a stat notices the change
+        writeHta(achHta2, "RewriteRule ^i$ /j [L]\nRewriteRule ^k$ /l [L]\n");
+        cache.recheckUnwatched();
+        CHECK(countRules(&ctx2) == 2);
+        CHECK(countRules(&ctx1) == 1);
+
+        // removed
+        unlink(achHta1);
+        cache.recheckAll();
+        CHECK(ctx1.getRewriteRules() == NULL);
+        CHECK(cache.getEntryCount() == entries + 1);
+
+        cache.detach(&ctx1);
+        cache.detach(&ctx2);
+        CHECK(cache.getEntryCount() == entries);
+        unlink(achHta2);
+        rmdir(achDir1);
+        rmdir(achDir2);
+        rmdir(achDir);
+    }
+}
+
+#endif
@@ -28,6 +28,7 @@
 #ifdef RUN_TEST
 #include <stdio.h>
 #include "httpheadertest.h"
+#include <http/headerscanner.h>
 #include <http/httpheader.h>
 #include <http/httprespheaders.h>
 #include <http/httpstatuscode.h>
@@ -142,6 +143,9 @@ SUITE(HttpHeaderTest)
                 //printf( "%s\n", s_pHeaders[i] );
                 int index = HttpHeader::getIndex2(s_pHeaders[i]);
                 CHECK(i == index);
+                index = HttpHeader::getIndex(s_pHeaders[i],
+                                             strlen(s_pHeaders[i]));
+                CHECK(i == index);
                 CHECK((int)strlen(s_pHeaders[i]) ==
                       HttpHeader::getHeaderStringLen(i));
 //            CHECK( 0 == strncasecmp( s_pHeaders[i],
@@ -153,6 +157,9 @@ SUITE(HttpHeaderTest)
 //            CHECK( NULL == HttpHeader::getHeader( i ));
                 CHECK(HttpHeader::H_HEADER_END ==
                       HttpHeader::getIndex2(s_pHeaders[i]));
+                CHECK(HttpHeader::H_HEADER_END ==
+                      HttpHeader::getIndex(s_pHeaders[i],
+                                           strlen(s_pHeaders[i])));
             }
         }
 
@@ -194,6 +201,45 @@ SUITE(HttpHeaderTest)
         }
     }
 
+    TEST(testScanner)
+    {
+        static const char s_achBuf[] =
+            "Host: www.example.com\r\n"
+            "X-Very-Long-Header-Name-Without-Any-Colon-In-It\r\n"
+            "Cookie: a=b:c; d=e\r\n"
+            "\r\n"
+            "A:\nB\n:C:";
+        const char *pEnd = s_achBuf + sizeof(s_achBuf) - 1;
+        const char *p, *pLine, *pColon, *pLineRef, *pColonRef;
+        int pass;
+
+        printf("\nHeaderScanner uses %s\n", HeaderScanner::getImplName());
+        for (pass = 0; pass < 2; ++pass)
+        {
+            HeaderScanner::useScalar(pass == 1);
+            // Every start offset, so each block boundary case is hit.
+            for (p = s_achBuf; p < pEnd; ++p)
+            {
+                pLine = HeaderScanner::findLine(p, pEnd, &pColon);
+                pLineRef = (const char *)memchr(p, '\n', pEnd - p);
+                CHECK(pLine == pLineRef);
+                if (!pLineRef)
+                    continue;
+                pColonRef = (const char *)memchr(p, ':', pLineRef - p);
+                CHECK(pColon == pColonRef);
+            }
+        }
+        HeaderScanner::useScalar(false);
+
+        p = "X_Custom-Header.1~";
+        CHECK(HeaderScanner::isToken(p, p + strlen(p)) == 1);
+        p = "Bad Name";
+        CHECK(HeaderScanner::isToken(p, p + strlen(p)) == 0);
+        p = "Bad(Name)";
+        CHECK(HeaderScanner::isToken(p, p + strlen(p)) == 0);
+        CHECK(HeaderScanner::isToken(p, p) == 0);
+    }
+
     TEST(testInstance)
     {
 //    HttpHeader header;
@@ -0,0 +1,82 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <http/httppriority.h>
+#include <http/hiostream.h>
+
+#include <string.h>
+#include "unittest-cpp/UnitTest++.h"
+
+
+static int parseStr(const char *pValue, int *urgency, int *incremental)
+{
+    *urgency = HIO_PRIORITY_DEFAULT;
+    *incremental = 0;
+    return HttpPriority::parse(pValue, strlen(pValue), urgency, incremental);
+}
+
+
+SUITE(HttpPriorityTest)
+{
+    TEST(testParse)
+    {
+        int u, i;
+        CHECK(parseStr("u=1", &u, &i) == LS_OK);
+        CHECK(u == 1 && i == 0);
+        CHECK(parseStr("u=5, i", &u, &i) == LS_OK);
+        CHECK(u == 5 && i == 1);
+        CHECK(parseStr("i=?1,u=0", &u, &i) == LS_OK);
+        CHECK(u == 0 && i == 1);
+        CHECK(parseStr("u=2, i=?0", &u, &i) == LS_OK);
+        CHECK(u == 2 && i == 0);
+
+        // Unknown members and parameters are skipped, quoted commas too.
+        CHECK(parseStr("x=\"a,u=0\";p=1, u=6;q", &u, &i) == LS_OK);
+        CHECK(u == 6 && i == 0);
+
+        // Out of range or malformed values are ignored.
+        CHECK(parseStr("u=8", &u, &i) == LS_FAIL);
+        CHECK(u == HIO_PRIORITY_DEFAULT);
+        CHECK(parseStr("u=12", &u, &i) == LS_FAIL);
+        CHECK(parseStr("u=-1", &u, &i) == LS_FAIL);
+        CHECK(parseStr("i=1", &u, &i) == LS_FAIL);
+        CHECK(i == 0);
+        CHECK(parseStr("", &u, &i) == LS_FAIL);
+    }
+
+    TEST(testMimeUrgency)
+    {
+        int i = -1;
+        CHECK(HttpPriority::getMimeUrgency("text/html; charset=UTF-8", 24, &i)
+              == HIO_PRIORITY_HTML);
+        CHECK(i == 0);
+        CHECK(HttpPriority::getMimeUrgency("text/css", 8, &i)
+              == HIO_PRIORITY_CSS);
+        CHECK(HttpPriority::getMimeUrgency("image/webp", 10, &i)
+              == HIO_PRIORITY_IMAGE);
+        CHECK(i == 1);
+        CHECK(HttpPriority::getMimeUrgency("text/htmlx", 10, &i) == -1);
+        CHECK(HttpPriority::getMimeUrgency("application/json", 16, &i) == -1);
+        CHECK(HttpPriority::getMimeUrgency(NULL, 0, &i) == -1);
+        CHECK(HttpPriority::getMimeUrgency("text/css", 8, &i)
+              < HttpPriority::getMimeUrgency("image/png", 9, &i));
+    }
+}
+
+#endif
@@ -20,10 +20,15 @@
 #include "rewritetest.h"
 #include <http/rewriterule.h>
 #include <http/rewritemap.h>
+#include <http/rewritemapdb.h>
 #include <http/httpheader.h>
 #include <http/httpstatuscode.h>
 #include "unittest-cpp/UnitTest++.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 
 
 void testParseCond()
@@ -194,5 +199,59 @@ TEST(RewriteTest_testParse)
     testParseCond();
     testParseRule();
 }
-#endif
 
+
+TEST(RewriteTest_testMapDb)
+{
+    char achDir[] = "/tmp/rewritemaptest.XXXXXX";
+    char achSrc[256];
+    char achDb[256];
+    char achType[300];
+    char achValue[256];
+    CHECK(mkdtemp(achDir) != NULL);
+    snprintf(achSrc, sizeof(achSrc), "%s/map.txt", achDir);
+    FILE *fp = fopen(achSrc, "w");
+    CHECK(fp != NULL);
+    if (!fp)
+    {
+        rmdir(achDir);
+        return;
+    }
+    fprintf(fp, "# legacy urls\n"
+            "/old/a.html   /new/a   # moved\n"
+            "/old/b.html\t/new/b\n"
+            "  /indented   /skipped\n"
+            "/old/a.html   /dup\n"
+            "/empty\n");
+    fclose(fp);
+    snprintf(achDb, sizeof(achDb), "%s%s", achSrc, RWMAP_DB_SUFFIX);
+
+    RewriteMap map;
+    map.setName("legacy");
+    snprintf(achType, sizeof(achType), "txt:%s", achSrc);
+    CHECK(map.parseType_Source(achType) == 0);
+    CHECK(RewriteMapDb::isDbFile(achDb));
+
+    int len = map.lookup("/old/a.html", 11, achValue, sizeof(achValue));
+    CHECK(len == 6);
+    CHECK(memcmp(achValue, "/new/a", 6) == 0);
+    len = map.lookup("/old/b.html", 11, achValue, sizeof(achValue));
+    CHECK(len == 6);
+    CHECK(memcmp(achValue, "/new/b", 6) == 0);
+    CHECK(map.lookup("/empty", 6, achValue, sizeof(achValue)) == 0);
+    CHECK(map.lookup("/indented", 9, achValue, sizeof(achValue)) == -1);
+    CHECK(map.lookup("/old/c.html", 11, achValue, sizeof(achValue)) == -1);
+
+    RewriteMap dbm;
+    dbm.setName("legacy_dbm");
+    snprintf(achType, sizeof(achType), "dbm:%s", achDb);
+    CHECK(dbm.parseType_Source(achType) == 0);
+    len = dbm.lookup("/old/b.html", 11, achValue, sizeof(achValue));
+    CHECK(len == 6);
+
+    unlink(achDb);
+    unlink(achSrc);
+    rmdir(achDir);
+}
+
+#endif
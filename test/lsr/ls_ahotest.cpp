@@ -62,6 +62,32 @@ TEST(ls_AhoTest_test)
 
 }
 
+
+static int ls_aho_markHit(void *ctx, void *arg)
+{
+    ((int *)arg)[(long)ctx] = 1;
+    return 0;
+}
+
+
+TEST(ls_AhoTest_searchAll)
+{
+    static const char *pats[] = { "wp-admin", "admin-ajax", "min", ".php" };
+    int hits[4] = { 0, 0, 0, 0 };
+    ls_aho_t *pThis = ls_aho_new(0);
+    for (long i = 0; i < 4; ++i)
+        CHECK(ls_aho_addpattern(pThis, pats[i], strlen(pats[i]),
+                                (void *)i) == 1);
+    CHECK(ls_aho_maketree(pThis, 1) == 1);
+
+    // "min" ends inside "wp-admin", ".php" follows it
+    const char *pInput = "/WP-ADMIN/admin.PHP";
+    CHECK(ls_aho_search_all(pThis, pInput, strlen(pInput),
+                            ls_aho_markHit, hits) == 4);
+    CHECK(hits[0] == 1 && hits[1] == 0 && hits[2] == 1 && hits[3] == 1);
+    ls_aho_delete(pThis);
+}
+
 ls_aho_t *ls_aho_initTree(const char *acceptBuf[], int bufCount,
                           int sensitive, int seq)
 {
@@ -275,4 +275,57 @@ TEST(shmPerProcess_test)
     //CHECK(pStat->m_bckt[SZ_TESTBCKT / 8].m_iBkReleased == rcnt);
 }
 
+
+TEST(shmSeqRead_test)
+{
+    LsShm *pShm;
+    LsShmPool *pGPool;
+    LsShmHash *pHash;
+    char achKey[32];
+    int i, len, valLen;
+    LsShmOffset_t aOff[100];
+
+    CHECK((pShm = LsShm::open("SHMSEQREAD", 0, g_pShmDirName)) != NULL);
+    if (pShm == NULL)
+        return;
+    pShm->deleteFile();
+    CHECK((pGPool = pShm->getGlobalPool()) != NULL);
+    if (pGPool == NULL)
+        return;
+
+    CHECK((pHash = pGPool->getNamedHash("seqHash", 0, LsShmHash::hashXXH32,
+                                        memcmp, LSSHM_FLAG_SEQREAD)) != NULL);
+    if (pHash == NULL)
+        return;
+    CHECK((pHash->getFlags() & LSSHM_FLAG_SEQREAD) != 0);
+
+    // enough inserts to force a rehash underneath the optimistic reader
+    for (i = 0; i < 100; ++i)
+    {
+        len = snprintf(achKey, sizeof(achKey), "seqkey%d", i);
+        CHECK((aOff[i] = pHash->insert(achKey, len, &i, sizeof(i))) != 0);
+    }
+    for (i = 0; i < 100; ++i)
+    {
+        len = snprintf(achKey, sizeof(achKey), "seqkey%d", i);
+        CHECK(pHash->find(achKey, len, &valLen) == aOff[i]);
+        CHECK(valLen == sizeof(i));
+    }
+    CHECK(pHash->find("nokey", 5, &valLen) == 0);
+    CHECK(pHash->remove("seqkey7", 7) != 0);
+    CHECK(pHash->find("seqkey7", 7, &valLen) == 0);
+
+    // an existing table without the flag keeps the locked lookup
+    LsShmHash *pPlain;
+    CHECK((pPlain = pGPool->getNamedHash("plainHash", 0, LsShmHash::hashXXH32,
+                                         memcmp, LSSHM_FLAG_NONE)) != NULL);
+    if (pPlain == NULL)
+        return;
+    pPlain->close();
+    CHECK((pPlain = pGPool->getNamedHash("plainHash", 0, LsShmHash::hashXXH32,
+                                         memcmp, LSSHM_FLAG_SEQREAD)) != NULL);
+    if (pPlain != NULL)
+        CHECK((pPlain->getFlags() & LSSHM_FLAG_SEQREAD) == 0);
+}
+
 #endif
@@ -0,0 +1,203 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <sslpp/sslcertstore.h>
+#include <util/datetime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "unittest-cpp/UnitTest++.h"
+
+
+static void writeFile(const char *pDir, const char *pName, const char *pData,
+                      int len)
+{
+    char achPath[256];
+    snprintf(achPath, sizeof(achPath), "%s/%s", pDir, pName);
+    FILE *fp = fopen(achPath, "w");
+    CHECK(fp != NULL);
+    if (!fp)
+        return;
+    CHECK(fwrite(pData, 1, len, fp) == (size_t)len);
+    fclose(fp);
+}
+
+
+static void removeFile(const char *pDir, const char *pName)
+{
+    char achPath[256];
+    snprintf(achPath, sizeof(achPath), "%s/%s", pDir, pName);
+    unlink(achPath);
+}
+
+
+static void initTask(SslCertLoadTask *pTask, const char *pDir,
+                     const char *pName, uint64_t oldStamp)
+{
+    pTask->m_name.setStr(pName);
+    pTask->m_pDir = pDir;
+    pTask->m_oldStamp = oldStamp;
+    pTask->m_stamp = 0;
+    pTask->m_iWild = 0;
+    pTask->m_iResult = -1;
+}
+
+
+SUITE(SslCertStore)
+{
+    TEST(ValidName)
+    {
+        CHECK(SslCertStore::isValidName("www.example.com", 15));
+        CHECK(SslCertStore::isValidName("a-b.c_d.example", 15));
+        CHECK(!SslCertStore::isValidName("", 0));
+        CHECK(!SslCertStore::isValidName(".example.com", 12));
+        CHECK(!SslCertStore::isValidName("_.example.com", 13));
+        CHECK(!SslCertStore::isValidName("www..example.com", 16));
+        CHECK(!SslCertStore::isValidName("WWW.example.com", 15));
+        CHECK(!SslCertStore::isValidName("../etc/passwd", 13));
+    }
+
+
+    TEST(LoadFiles)
+    {
+        char achDir[] = "/tmp/certstoreXXXXXX";
+        int bigLen = 200 * 1024;
+        char *pBig = (char *)malloc(bigLen);
+        SslCertLoadTask task;
+
+        CHECK(mkdtemp(achDir) != NULL);
+        CHECK(pBig != NULL);
+        memset(pBig, 'k', bigLen);
+        writeFile(achDir, "www.example.com.crt", "cert", 4);
+        writeFile(achDir, "www.example.com.key", pBig, bigLen);
+        writeFile(achDir, "_.example.org.crt", "wild cert", 9);
+        writeFile(achDir, "_.example.org.key", "wild key", 8);
+
+        initTask(&task, achDir, "www.example.com", 0);
+        SslCertStore::loadFiles(&task);
+        CHECK(task.m_iResult == 3);     // CERT_LOAD_NEW
+        CHECK(task.m_iWild == 0);
+        CHECK(task.m_key.len() == bigLen);
+        CHECK(memcmp(task.m_key.c_str(), pBig, bigLen) == 0);
+        CHECK(strcmp(task.m_cert.c_str(), "cert") == 0);
+
+        // unchanged files are not read again
+        uint64_t stamp = task.m_stamp;
+        initTask(&task, achDir, "www.example.com", stamp);
+        SslCertStore::loadFiles(&task);
+        CHECK(task.m_iResult == 2);     // CERT_LOAD_SAME
+
+        initTask(&task, achDir, "shop.example.org", 0);
+        SslCertStore::loadFiles(&task);
+        CHECK(task.m_iResult == 3);
+        CHECK(task.m_iWild == 1);
+        CHECK(strcmp(task.m_key.c_str(), "wild key") == 0);
+
+        // a wildcard never covers the bare parent or a top level domain
+        initTask(&task, achDir, "example.org", 0);
+        SslCertStore::loadFiles(&task);
+        CHECK(task.m_iResult == 1);     // CERT_LOAD_NONE
+        initTask(&task, achDir, "www.example.net", 0);
+        SslCertStore::loadFiles(&task);
+        CHECK(task.m_iResult == 1);
+
+        removeFile(achDir, "www.example.com.crt");
+        removeFile(achDir, "www.example.com.key");
+        removeFile(achDir, "_.example.org.crt");
+        removeFile(achDir, "_.example.org.key");
+        rmdir(achDir);
+        free(pBig);
+    }
+
+
+    TEST(NegativeCache)
+    {
+        char achDir[] = "/tmp/certstoreXXXXXX";
+        char achName[64];
+        SslCertLoadTask *pTasks[4];
+        SslCertStore &store = SslCertStore::getInstance();
+        int i, wait;
+
+        CHECK(mkdtemp(achDir) != NULL);
+        store.m_sDir.setStr(achDir);
+        store.m_iMaxEntries = 4;
+        DateTime::s_curTime = time(NULL);
+
+        // a name without a certificate only takes a slot of m_negative
+        for (i = 0; i < 6; ++i)
+        {
+            snprintf(achName, sizeof(achName), "n%d.example.com", i);
+            SslCertStoreEntry *pEntry = store.addEntry(achName,
+                                                       strlen(achName));
+            CHECK(pEntry != NULL);
+            SslCertLoadTask *pTask = store.newTask(pEntry);
+            SslCertStore::loadFiles(pTask);
+            store.onLoaded(pTask);
+            delete pTask;
+        }
+        CHECK(store.m_negative.size() == 4);
+        CHECK(store.size() == 0);
+        CHECK(store.getEntry("n0.example.com") == NULL);
+        CHECK(store.getEntry("n5.example.com") != NULL);
+        CHECK(store.lookup("n5.example.com", 14, &wait) == NULL);
+        CHECK(wait == 0);
+
+        // a known miss being revalidated is never waited for
+        SslCertLoadTask *pTask = store.newTask(store.getEntry("n5.example.com"));
+        CHECK(store.lookup("n5.example.com", 14, &wait) == NULL);
+        CHECK(wait == 0);
+        SslCertStore::loadFiles(pTask);
+        store.onLoaded(pTask);
+        delete pTask;
+
+        // it expires after SSLCERTSTORE_NEGATIVE_TTL
+        DateTime::s_curTime += SSLCERTSTORE_NEGATIVE_TTL;
+        store.onTimer();
+        CHECK(store.m_negative.size() == 0);
+        CHECK(store.getEntry("n5.example.com") == NULL);
+
+        // names still being loaded are not evicted, new ones are refused
+        for (i = 0; i < 4; ++i)
+        {
+            snprintf(achName, sizeof(achName), "p%d.example.com", i);
+            SslCertStoreEntry *pEntry = store.addEntry(achName,
+                                                       strlen(achName));
+            CHECK(pEntry != NULL);
+            pTasks[i] = store.newTask(pEntry);
+        }
+        CHECK(store.addEntry("q.example.com", 13) == NULL);
+        for (i = 0; i < 4; ++i)
+        {
+            SslCertStore::loadFiles(pTasks[i]);
+            store.onLoaded(pTasks[i]);
+            delete pTasks[i];
+        }
+        CHECK(store.addEntry("q.example.com", 13) != NULL);
+
+        DateTime::s_curTime += SSLCERTSTORE_NEGATIVE_TTL;
+        store.onTimer();
+        CHECK(store.m_negative.size() == 0);
+        store.m_sDir.setStr(NULL);
+        rmdir(achDir);
+    }
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*****************************************************************************
+*    Open LiteSpeed is an open source HTTP server.                           *
+*    Copyright (C) 2013 - 2022  LiteSpeed Technologies, Inc.                 *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation, either version 3 of the License, or       *
+*    (at your option) any later version.                                     *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful,         *
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the            *
+*    GNU General Public License for more details.                            *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see http://www.gnu.org/licenses/.      *
+*****************************************************************************/
+#ifdef RUN_TEST
+
+#include <util/domaintrie.h>
+
+#include <string.h>
+
+#include "unittest-cpp/UnitTest++.h"
+
+
+static void *matchHost(DomainTrie &trie, const char *pHost)
+{
+    return trie.match(pHost, strlen(pHost));
+}
+
+
+TEST(DomainTrieTest_match)
+{
+    DomainTrie trie;
+    int a, b, c;
+
+    CHECK(trie.add("example.com", 11, &a) == NULL);
+    CHECK(trie.add("shop.example.com", 16, &b) == NULL);
+    CHECK(trie.add("example.org", 11, &c) == NULL);
+    CHECK(trie.add("example.com", 11, &c) == &a);
+    CHECK(trie.size() == 3);
+
+    CHECK(matchHost(trie, "www.example.com") == &a);
+    CHECK(matchHost(trie, "a.b.example.com") == &a);
+    CHECK(matchHost(trie, "x.shop.example.com") == &b);
+    CHECK(matchHost(trie, "shop.example.com") == &a);
+    CHECK(matchHost(trie, "www.example.org") == &c);
+    CHECK(matchHost(trie, "example.com") == NULL);
+    CHECK(matchHost(trie, "www.example.net") == NULL);
+    CHECK(matchHost(trie, "wwwexample.com") == NULL);
+    CHECK(matchHost(trie, "com") == NULL);
+    CHECK(matchHost(trie, "") == NULL);
+
+    trie.clear();
+    CHECK(trie.size() == 0);
+    CHECK(matchHost(trie, "www.example.com") == NULL);
+    CHECK(trie.add("example.com", 11, &b) == NULL);
+    CHECK(matchHost(trie, "www.example.com") == &b);
+}
+
+#endif